@@ -0,0 +1,121 @@
+/**
+ * @file arena.h
+ * @brief Bump-pointer allocator for objects that live for one command line.
+ *         Everything allocated from an arena is released at once by
+ *         arena_reset(); there is no per-object free.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * @def ARENA_BLOCK_SIZE
+ * @brief The default size of the blocks an arena takes from malloc.
+ */
+#define ARENA_BLOCK_SIZE 8192
+
+/**
+ * @struct ArenaBlock
+ * @brief A chunk of memory obtained from malloc and carved up by the arena.
+ */
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t size;
+  size_t used;
+  _Alignas(16) char data[];
+} ArenaBlock;
+
+/**
+ * @struct ArenaStats
+ * @brief Allocation counters.
+ */
+typedef struct {
+  size_t allocations; /**< Allocations served by the arena. */
+  size_t mallocs;     /**< Blocks the arena had to get from malloc. */
+  size_t bytes;       /**< Bytes handed out. */
+} ArenaStats;
+
+/**
+ * @struct Arena
+ * @brief A list of blocks; allocations are served from the first one.
+ *
+ * current counts since the last reset, last holds the counters of the
+ * previous reset cycle and total the counters since arena_init().
+ */
+typedef struct {
+  ArenaBlock *blocks;
+  size_t block_size;
+  ArenaStats current;
+  ArenaStats last;
+  ArenaStats total;
+} Arena;
+
+/**
+ * @brief Initializes an empty arena.
+ *
+ * @param arena The arena to initialize.
+ * @param block_size The size of the blocks taken from malloc.
+ */
+void arena_init(Arena *arena, size_t block_size);
+
+/**
+ * @brief Allocates memory from an arena.
+ *
+ * @param arena The arena.
+ * @param size The number of bytes.
+ * @return Memory aligned for any type, or NULL on failure.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Allocates zeroed memory for an array from an arena.
+ *
+ * @param arena The arena.
+ * @param count The number of elements.
+ * @param size The size of one element.
+ * @return Zeroed memory, or NULL on failure.
+ */
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+
+/**
+ * @brief Copies a string into an arena.
+ *
+ * @param arena The arena.
+ * @param s The string to copy.
+ * @return The copy, or NULL on failure.
+ */
+char *arena_strdup(Arena *arena, const char *s);
+
+/**
+ * @brief Copies at most n bytes of a string into an arena.
+ *
+ * @param arena The arena.
+ * @param s The string to copy.
+ * @param n The maximum number of bytes to copy.
+ * @return The NUL-terminated copy, or NULL on failure.
+ */
+char *arena_strndup(Arena *arena, const char *s, size_t n);
+
+/**
+ * @brief Releases everything allocated from an arena.
+ *
+ * When the last cycle needed more than one block, the blocks are replaced by
+ * a single one big enough for all of it, so a repeated workload stops calling
+ * malloc after the first cycle.
+ *
+ * @param arena The arena to reset.
+ */
+void arena_reset(Arena *arena);
+
+/**
+ * @brief Frees all memory held by an arena.
+ *
+ * @param arena The arena to free.
+ */
+void arena_free(Arena *arena);
+
+#endif
@@ -10,25 +10,82 @@
 
 #include "job_utils.h"
 
+/**
+ * @enum BuiltinPlace
+ * @brief Where a builtin runs, as given in Builtin::in_process.
+ */
+enum BuiltinPlace {
+  /** Changes the shell. Alone it runs in the shell; as a pipeline stage it
+   *  runs in a forked child, so that, as in other shells, `cd` or `export`
+   *  in a pipeline does not change the shell. */
+  BUILTIN_STATEFUL = 0,
+  /** Neither changes the shell nor waits for input or time, so it runs in
+   *  the shell even as a pipeline stage. */
+  BUILTIN_IN_PROCESS = 1,
+  /** May wait for input or time. It always runs in a forked child as a job,
+   *  even alone, so that Ctrl-Z stops it and Ctrl-C ends it as it would an
+   *  external command. */
+  BUILTIN_BLOCKING = 2,
+};
+
 /**
  * @struct Builtin
  * @brief Represents a built-in command.
  *
  * @var name The name of the built-in command.
  * @var func A pointer to the function that implements the built-in command.
+ * @var in_process Where the command runs, one of the BuiltinPlace values.
  */
 typedef struct {
   char *name;
   int (*func)(Process *, Job **);
+  int in_process;
 } Builtin;
 
+/**
+ * @def BUILTIN_MAX
+ * @brief The size of builtin_commands, including the builtins loaded with
+ *        `enable -f` and the terminating entry.
+ */
+#define BUILTIN_MAX 64
+
+/**
+ * @def BUILTIN_API_VERSION
+ * @brief The version of Builtin and of the job structures plugins are
+ *        given. It changes whenever either changes.
+ */
+#define BUILTIN_API_VERSION 1
+
+/**
+ * @def BUILTIN_REGISTER_SYMBOL
+ * @brief The registration function a builtin plugin exports.
+ */
+#define BUILTIN_REGISTER_SYMBOL "yega_register_builtins"
+
+/**
+ * @brief The registration function of a builtin plugin.
+ *
+ * It is called once after the plugin is loaded. It should return -1 if it
+ * was not built for @p api_version, and otherwise call @p add for each of
+ * its builtins and return 0. The names must stay valid while the plugin is
+ * loaded, which is until the shell exits.
+ *
+ * @param api_version BUILTIN_API_VERSION of the shell.
+ * @param add Offers one builtin to the shell; returns 0, or -1 if the
+ *        shell has no room for it.
+ */
+typedef int (*BuiltinRegister)(int api_version,
+                               int (*add)(const Builtin *builtin));
+
 /**
  * @var builtin_commands
  * @brief An array of built-in commands.
  *
- * This array contains all the built-in commands supported by the shell.
+ * This array contains all the built-in commands supported by the shell,
+ * followed by the ones loaded with `enable -f`, and ends with an entry
+ * whose name is NULL. Entries never move, so their indices can be kept.
  */
-extern Builtin builtin_commands[];
+extern Builtin builtin_commands[BUILTIN_MAX];
 
 /**
  * @brief Changes the current working directory.
@@ -111,4 +168,231 @@ int bg_func(Process *proc, Job **job_head);
  */
 int jobs_func(Process *proc, Job **job_head);
 
+/**
+ * @brief Displays how much the previous command lines allocated from the
+ * line arena.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success.
+ */
+int memstats_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Displays the pipeline cache counters, or empties the cache with -c.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 on a usage error.
+ */
+int pcache_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Lists the remembered command paths with their hits, forgets them
+ * with -r, or looks up the given names.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if a name was not found.
+ */
+int hash_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Tells how each name would be run: builtin, hashed path or path.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if a name was not found.
+ */
+int type_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Shows or selects how children are started: fork, posix_spawn, vfork
+ * or the zygote pool.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 on a usage error.
+ */
+int spawn_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Prints its arguments separated by spaces.
+ *
+ * -n leaves out the final newline and -e interprets backslash escapes.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if the output could not be written.
+ */
+int echo_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Formats its arguments, reusing the format until they run out.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 on a bad number or conversion, 2 on misuse.
+ */
+int printf_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Evaluates a conditional expression; also runs as `[`.
+ *
+ * The file tests are those of coreutils test(1), including -t fd, -k, -O,
+ * -G and -N.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 if the expression is true, 1 if it is false, 2 on a bad one.
+ */
+int test_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Does nothing, successfully.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0.
+ */
+int true_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Does nothing, unsuccessfully.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 1.
+ */
+int false_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Waits for the sum of its arguments, in seconds with an optional
+ *        s, m, h or d suffix.
+ *
+ * The wait is a clock_nanosleep() to an absolute deadline on the monotonic
+ * clock; Ctrl-C ends it. `inf` or `infinity` waits until then, and `nan`
+ * is rejected.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 on a bad interval, 130 if interrupted.
+ */
+int sleep_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Copies files, or stdin, to stdout.
+ *
+ * The data is moved by the kernel where it can: copy_file_range() between
+ * files, sendfile() from a file and splice() with a pipe.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if a file could not be copied, 130 if
+ *         interrupted.
+ */
+int cat_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Lists the builtins, or loads builtins from a shared object with
+ *        `enable -f file [name...]`.
+ *
+ * Loaded builtins take precedence over commands of the same name and run
+ * like the others: with redirections, and in pipelines. One with the name
+ * of a builtin already there replaces it.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if the file could not be loaded or a name was
+ *         not found in it, 2 on a usage error.
+ */
+int enable_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Shows or sets a resource limit of the children the shell starts:
+ *        `ulimit [-H|-S] [-a|-cdflmnstuv] [limit|unlimited]`.
+ *
+ * Limits are in the units of other shells' ulimit. The shell's own limits
+ * are left alone.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 for a limit the children could not take, 2 on a
+ *         usage error.
+ */
+int ulimit_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Shows or sets the niceness increment of the children the shell
+ *        starts: `nice [[-n] increment]`.
+ *
+ * As in nice(1), `-N` is the same as `-n N`, so `nice -5` adds 5 and
+ * `nice --5` subtracts 5.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 2 on a usage error.
+ */
+int nice_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Shows or sets the CPUs the children the shell starts may run on:
+ *        `affinity [cpu-list]`, e.g. `affinity 0-3,8`.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if the shell's affinity cannot be read, 2 on a
+ *         usage error.
+ */
+int affinity_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Shows, starts or stops the jobserver that caps how many jobs and
+ *        make recipes run at once: `jobserver [off|tokens]`.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if the jobserver cannot be started, 2 on a usage
+ *         error.
+ */
+int jobserver_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Runs a command once per input, several at a time, each as a
+ *        background job: `parallel [-j N] [-k] [-u] [--halt policy]
+ *        [--joblog file] command [word...] [::: input...]`.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return The number of failed runs, at most 101; the status of the run that
+ *         halted them with `--halt`; 2 on a usage error.
+ */
+int parallel_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Prints what a background job started with JOBOUTPUT=capture has
+ *        written so far, or all of it once it ended: `joblog [%job]`.
+ *
+ * @param proc The process that is executing the command.
+ * @param job_head The head of the job list.
+ * @return 0 on success, 1 if the job's output was not captured, 2 on a usage
+ *         error.
+ */
+int joblog_func(Process *proc, Job **job_head);
+
+/**
+ * @brief Turns leading ulimit, nice and affinity words of each stage into
+ *        that stage's resource settings, so `affinity 0-3 nice 5 cmd` runs
+ *        cmd itself with both applied in its child before exec.
+ *
+ * A prefix replaces the shell-wide default of the same setting. Words that
+ * are not followed by a command, or do not parse, are left to the builtin.
+ * Builtins that run in the shell ignore the settings.
+ *
+ * @param proc_head The head of the process list.
+ * @param arena The arena the settings are allocated in.
+ * @return 0 on success, -1 if allocation fails.
+ */
+int take_resource_prefixes(Process *proc_head, Arena *arena);
+
 #endif
\ No newline at end of file
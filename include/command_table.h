@@ -0,0 +1,116 @@
+/**
+ * @file command_table.h
+ * @brief Parent-side table of command names: builtins, executables found in
+ *         PATH and names that were not found. Commands are resolved here
+ *         before forking, so children exec a known path.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @def COMMAND_TABLE_BUCKETS
+ * @brief The number of hash buckets; a power of two.
+ */
+#define COMMAND_TABLE_BUCKETS 256
+
+/**
+ * @def COMMAND_NEGATIVE_TTL
+ * @brief Seconds a "not found" entry is trusted before PATH is searched
+ * again, so a newly installed program is picked up.
+ */
+#define COMMAND_NEGATIVE_TTL 2
+
+/**
+ * @enum CommandKind
+ * @brief What a command name resolved to.
+ */
+typedef enum {
+  COMMAND_NOT_FOUND,
+  COMMAND_BUILTIN,
+  COMMAND_FILE,
+  COMMAND_DENIED /**< A pathname that exists but may not be executed. */
+} CommandKind;
+
+/**
+ * @struct CommandEntry
+ * @brief A resolved command name.
+ */
+typedef struct CommandEntry {
+  struct CommandEntry *next;
+  uint64_t hash;
+  CommandKind kind;
+  int builtin;     /**< Index into builtin_commands for builtins. */
+  char *path;      /**< The executable for files, the pathname for denied
+                        ones, NULL otherwise. */
+  size_t hits;     /**< Lookups answered by this entry. */
+  time_t expires;  /**< When a "not found" entry must be checked again. */
+  char name[];
+} CommandEntry;
+
+/**
+ * @struct CommandTable
+ * @brief Hash table of resolved command names.
+ *
+ * Entries for files and missing commands are dropped when PATH changes.
+ * Builtins are entered once and stay.
+ */
+typedef struct {
+  CommandEntry *buckets[COMMAND_TABLE_BUCKETS];
+  size_t count;
+  size_t hits;
+  size_t misses;
+  char *path; /**< The PATH the entries were resolved against. */
+} CommandTable;
+
+/**
+ * @var command_table
+ * @brief The shell's command table.
+ */
+extern CommandTable command_table;
+
+/**
+ * @brief Enters the builtins into the command table.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int command_table_init(void);
+
+/**
+ * @brief Enters a builtin, replacing whatever the name resolved to.
+ *
+ * @param name The name; the table keeps a copy.
+ * @param builtin The index in builtin_commands.
+ * @return 0 on success, -1 on failure.
+ */
+int command_table_add_builtin(const char *name, int builtin);
+
+/**
+ * @brief Resolves a command name.
+ *
+ * A cached file is checked with a single access() call and looked up again
+ * if it is gone. Names containing a `/` are not cached; one that access()
+ * refuses with EACCES is COMMAND_DENIED rather than COMMAND_NOT_FOUND.
+ *
+ * @param name The command name.
+ * @return The entry. It stays valid until the next call.
+ */
+const CommandEntry *find_command(const char *name);
+
+/**
+ * @brief Drops the entries for files and missing commands.
+ */
+void command_table_forget(void);
+
+/**
+ * @brief Frees every entry, including builtins.
+ */
+void command_table_free(void);
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * @file cpu_topology.h
+ * @brief Opt-in placement of pipeline stages from the CPU topology in
+ *         /sys/devices/system/cpu. With `PLACEMENT=topology`, the stages of
+ *         a pipeline are pinned to neighbouring cores that share the last
+ *         level cache, and successive jobs are spread across packages.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+/* cpu_set_t needs _GNU_SOURCE before the first system header. */
+#include <sched.h>
+#include <stddef.h>
+
+/**
+ * @def CPU_TOPOLOGY_ROOT
+ * @brief Where the kernel describes the CPUs.
+ */
+#define CPU_TOPOLOGY_ROOT "/sys/devices/system/cpu"
+
+/**
+ * @struct CacheDomain
+ * @brief CPUs sharing a last level cache, within one package.
+ */
+typedef struct {
+  int package;
+  size_t first; /**< Index of the first CPU in CpuTopology.cpus. */
+  size_t count;
+} CacheDomain;
+
+/**
+ * @struct CpuTopology
+ * @brief The CPUs the shell may use, grouped by cache domain.
+ *
+ * Domains are ordered by package. Within a domain the first hardware thread
+ * of every core comes before the second ones, so neighbouring entries are
+ * separate cores as long as there are any.
+ */
+typedef struct {
+  int *cpus;
+  size_t num_cpus;
+  CacheDomain *domains;
+  size_t num_domains;
+  size_t *spread; /**< Domain indices, alternating between packages. */
+  size_t next_job;
+} CpuTopology;
+
+/**
+ * @struct Placement
+ * @brief Where the stages of one job go.
+ */
+typedef struct {
+  const CpuTopology *topo;
+  const CacheDomain *domain;
+  size_t package_first; /**< The range of the domain's package in cpus. */
+  size_t package_count;
+  int num_stages;
+  int next_stage;
+} Placement;
+
+/**
+ * @brief Reads the topology of the CPUs in @p allowed.
+ *
+ * A CPU whose package cannot be read counts as package 0, and one whose
+ * caches cannot be read has a domain of its own.
+ *
+ * @param topo Receives the topology; free it with cpu_topology_free().
+ * @param root CPU_TOPOLOGY_ROOT, or a copy of its layout.
+ * @param allowed The CPUs to place stages on.
+ * @return 0 on success, -1 if no CPU was found.
+ */
+int cpu_topology_load(CpuTopology *topo, const char *root,
+                      const cpu_set_t *allowed);
+
+/**
+ * @brief Frees a topology.
+ *
+ * @param topo The topology.
+ */
+void cpu_topology_free(CpuTopology *topo);
+
+/**
+ * @brief Returns the topology of the CPUs the shell may run on, reading it
+ *        the first time.
+ *
+ * @return The topology, or NULL if it cannot be read.
+ */
+CpuTopology *system_topology(void);
+
+/**
+ * @brief Chooses the cache domain of a job; successive jobs get domains of
+ *        different packages.
+ *
+ * @param placement Receives the choice.
+ * @param topo The topology.
+ * @param num_stages The number of stages that will be placed.
+ */
+void placement_start(Placement *placement, CpuTopology *topo,
+                     int num_stages);
+
+/**
+ * @brief Returns the CPUs of the next stage.
+ *
+ * A stage of a pipeline gets one core, next to the previous stage's; when
+ * the domain is full the following cores of the package are used, going
+ * round to its first ones, but never those of another package. A job of
+ * one stage gets its whole domain, so its threads share the cache.
+ *
+ * @param placement The job's placement.
+ * @param set Receives the CPUs.
+ */
+void placement_next(Placement *placement, cpu_set_t *set);
+
+#endif
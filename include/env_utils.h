@@ -3,8 +3,8 @@
  * @brief Utilities for handling environment variables.
  *         Adds, deletes, and updates environment variables.
  *         Creates the envp array of pointers.
- *         Envoronment variables are stored in a hash table
- *         implemented as a linked list.
+ *         Envoronment variables are stored in an open-addressing hash
+ *         table that is resized incrementally.
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
@@ -12,34 +12,83 @@
 #ifndef ENV_UTILS_H
 #define ENV_UTILS_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
- * @def TABLESIZE
- * @brief The size of the hash table used to store environment variables.
+ * @def VARIABLE_TABLE_MIN
+ * @brief The number of slots the variable table starts with; a power of two.
  */
-#define TABLESIZE 100
+#define VARIABLE_TABLE_MIN 64
 
 /**
  * @struct Variable
  * @brief Represents an environment variable.
  *
  * This struct contains the key, value, and export status of an environment
- * variable. It also contains a pointer to the next variable in the linked list.
+ * variable. Variables are also linked in the order they were first set, which
+ * is the order build_envp() and dump_variables() list them in.
  */
 typedef struct Variable {
   char *key;
-  char *value;
+  char *entry; /**< "KEY=VALUE", ready to be passed to execve. */
+  char *value; /**< Points into entry. */
   int exported;
   struct Variable *next;
+  struct Variable *prev;
 } Variable;
 
+/**
+ * @struct VariableSlot
+ * @brief A slot of the open-addressing table.
+ *
+ * The full hash is stored so probing and resizing never rehash a key.
+ */
+typedef struct {
+  uint64_t hash;
+  Variable *var; /**< NULL if the slot was never used. */
+} VariableSlot;
+
+/**
+ * @struct VariableTable
+ * @brief A linear-probing hash table with a power-of-two number of slots.
+ *
+ * When the table gets too full, a table twice the size is allocated and the
+ * old slots are moved over a few at a time by the following operations, so
+ * no single lookup or insertion pays for the whole resize. Until then,
+ * lookups search both tables.
+ */
+typedef struct {
+  VariableSlot *slots;
+  size_t mask;       /**< Number of slots minus one. */
+  size_t used;       /**< Slots in use, including deleted ones. */
+  size_t count;      /**< Variables in both tables. */
+  VariableSlot *old; /**< The table being moved, or NULL. */
+  size_t old_mask;
+  size_t old_live;   /**< Variables still in the old table. */
+  size_t migrated;   /**< The next old slot to move. */
+  Variable *first;   /**< The variable that was set first. */
+  Variable *last;
+  unsigned long generation; /**< Bumped when an exported variable changes. */
+  char **envp;              /**< Cached by build_envp(). */
+  size_t envp_capacity;
+  unsigned long envp_generation; /**< The generation envp was built for. */
+} VariableTable;
+
 /**
  * @var variable_table
- * @brief An array of pointers to the heads of the linked lists of environment
- * variables.
+ * @brief The shell's variables, filled from the environment at startup.
+ */
+extern VariableTable variable_table;
+
+/**
+ * @brief Adds every `KEY=VALUE` entry of an environment as an exported
+ * variable.
  *
- * This array is used to implement the hash table.
+ * @param envp The NULL-terminated environment, usually environ.
+ * @return 0 on success, -1 on failure.
  */
-extern Variable *variable_table[];
+int import_environment(char **envp);
 
 /**
  * @brief Looks up an environment variable by its key.
@@ -49,6 +98,15 @@ extern Variable *variable_table[];
  */
 Variable *lookup(const char *key);
 
+/**
+ * @brief Looks up a variable whose name is not NUL-terminated.
+ *
+ * @param key The name.
+ * @param len The length of the name.
+ * @return A pointer to the variable if found, or NULL if not found.
+ */
+Variable *lookup_len(const char *key, size_t len);
+
 /**
  * @brief Adds or updates an environment variable.
  *
@@ -93,23 +151,35 @@ int parse_key_value_inplace(char *input, char **key_out, char **val_out);
 /**
  * @brief Gets the full path of a command.
  *
+ * The directories are taken from the PATH variable in the variable table.
+ *
  * @param command The command to get the full path for.
  * @return The full path of the command, or NULL if not found.
  */
 char *get_full_path(const char *command);
 
 /**
- * @brief Builds an array of environment variable pointers.
+ * @brief Returns the environment for execve.
+ *
+ * The array is cached and only rebuilt after an exported variable was set or
+ * removed; its entries are the variables' own "KEY=VALUE" strings. It belongs
+ * to the variable table and must not be freed or modified.
  *
  * @return An array of environment variable pointers, or NULL on error.
  */
 char **build_envp(void);
 
-
+/**
+ * @brief Frees all variables and the cached environment.
+ */
 void free_variable_table(void);
 
+/**
+ * @brief Gets the environment for a job.
+ *
+ * @param envpp Receives the array returned by build_envp().
+ * @return 0 on success, -1 on failure.
+ */
 int initialize_envp(char ***envpp);
 
-void free_envp(char **envp);
-
 #endif
\ No newline at end of file
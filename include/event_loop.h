@@ -0,0 +1,89 @@
+/**
+ * @file event_loop.h
+ * @brief Waiting at the prompt. One epoll set holds the terminal, a signalfd
+ *         for SIGCHLD, SIGINT and SIGQUIT, and a pidfd for every process of a
+ *         background job, so a job's end is reported as soon as it happens
+ *         and the shell sleeps until something does.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stddef.h>
+
+#include "job_utils.h"
+
+/**
+ * @def EVENT_LOOP_MAX_EVENTS
+ * @brief The number of events taken from epoll at a time.
+ */
+#define EVENT_LOOP_MAX_EVENTS 16
+
+/**
+ * @struct EventLoop
+ * @brief The descriptors the prompt waits on, and input read past the line
+ *        last returned.
+ */
+typedef struct {
+  int epoll_fd;
+  int signal_fd;
+  int poll_stdin; /**< 0 if stdin cannot be watched, as for a regular file. */
+  char *pending;  /**< Read from stdin but not returned yet. */
+  size_t pending_len;
+  size_t pending_size;
+  int eof;
+  Job **job_head;         /**< The jobs whose notices are printed. */
+  unsigned long wakeups;  /**< Returns from epoll_wait(), for tests. */
+} EventLoop;
+
+/**
+ * @brief Sets up the epoll set, the signalfd and the stdin watch.
+ *
+ * @param loop The loop to set up.
+ * @param job_head The head of the shell's job list.
+ * @return 0 on success, -1 on failure.
+ */
+int event_loop_init(EventLoop *loop, Job **job_head);
+
+/**
+ * @brief Closes the loop's descriptors and frees its buffer.
+ *
+ * @param loop The loop.
+ */
+void event_loop_free(EventLoop *loop);
+
+/**
+ * @brief Watches the running processes of a job, which must stay in the job
+ *        list, through pidfds, and its capture pipe if it has one.
+ *
+ * Processes without a pidfd, as on kernels before 5.3, are still seen
+ * through SIGCHLD. The capture stays watched after the job ends, until it
+ * is closed.
+ *
+ * @param loop The loop.
+ * @param job The job, after persist_job().
+ */
+void event_loop_watch_job(EventLoop *loop, Job *job);
+
+/**
+ * @brief Prints a prompt and waits for a line of input.
+ *
+ * While waiting, children are reaped as they change, and the notices of jobs
+ * that ended or stopped are printed on their own lines followed by the
+ * prompt again; what was typed so far stays in the terminal's line buffer.
+ * SIGCHLD, SIGINT and SIGQUIT are blocked only while waiting, so the
+ * handlers see them while commands run.
+ *
+ * @param loop The loop.
+ * @param prompt The prompt.
+ * @param line Receives the line with its newline, like getline().
+ * @param size The size of *line.
+ * @return 0 on success; -1 with errno EINTR after SIGINT or SIGQUIT, with
+ * loop->eof set at the end of input, or with errno set on failure.
+ */
+int event_loop_read_line(EventLoop *loop, const char *prompt, char **line,
+                         size_t *size);
+
+#endif
@@ -23,4 +23,18 @@
  */
 int executor(Job *job, Job **job_head);
 
+/**
+ * @brief Replaces the shell with the job's command.
+ *
+ * Used for the last command of a -c string or script: rather than forking
+ * and waiting, the shell applies the redirections itself and execs the
+ * command, which keeps the shell's pid. If execve() fails the process exits
+ * with 126, as a child would.
+ *
+ * @param job A foreground job of one stage.
+ * @note Returns only if the job is not a single external command that was
+ *       found; the caller then runs it with executor().
+ */
+void exec_in_place(Job *job);
+
 #endif
\ No newline at end of file
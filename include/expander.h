@@ -11,8 +11,6 @@
 
 #include "parser.h"
 
-#define MAXSIZ 1024
-
 /**
  * @var last_exit_status
  * @brief The last exit status of a command.
@@ -22,13 +20,13 @@ extern int last_exit_status;
 /**
  * @brief Expands shell syntax for a given command.
  *
- * This function takes a Command struct and an array of environment variables as
- * input. It expands the shell syntax in the command using the provided
- * environment variables.
+ * Expands `$NAME`, `${NAME}`, `$$` and `$?` wherever the tokenizer marked
+ * them (see EXPANSION_MARK), any number of times per word, in the arguments
+ * and in the redirection targets. Unset variables expand to nothing.
  *
  * @param cmd The Command struct to expand.
- * @param envp The array of environment variables.
+ * @param arena The arena the expanded words are allocated in.
  */
-void expander(Command *cmd);
+void expander(Command *cmd, Arena *arena);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+/**
+ * @file fd_writer.h
+ * @brief Small buffered writer on a file descriptor. Builtins use it instead
+ *         of stdio, so their output goes to whatever descriptor 1 is while
+ *         they run and nothing is left in a stdio buffer afterwards.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef FD_WRITER_H
+#define FD_WRITER_H
+
+#include <stddef.h>
+
+/**
+ * @def FD_WRITER_SIZE
+ * @brief The size of a writer's buffer.
+ */
+#define FD_WRITER_SIZE 4096
+
+/**
+ * @struct FdWriter
+ * @brief Output collected for one descriptor.
+ */
+typedef struct {
+  int fd;
+  int failed; /**< Set once a write fails; later output is dropped. */
+  size_t len;
+  char buf[FD_WRITER_SIZE];
+} FdWriter;
+
+/**
+ * @brief Starts an empty writer on a descriptor.
+ *
+ * @param w  The writer.
+ * @param fd The descriptor written to.
+ */
+void fd_writer_init(FdWriter *w, int fd);
+
+/**
+ * @brief Appends bytes, writing the buffer out when it fills up.
+ *
+ * @param w    The writer.
+ * @param data The bytes.
+ * @param n    The number of bytes.
+ * @return 0 on success, -1 if a write failed.
+ */
+int fd_writer_put(FdWriter *w, const char *data, size_t n);
+
+/**
+ * @brief Appends a string.
+ *
+ * @param w The writer.
+ * @param s The string.
+ * @return 0 on success, -1 if a write failed.
+ */
+int fd_writer_puts(FdWriter *w, const char *s);
+
+/**
+ * @brief Appends one character.
+ *
+ * @param w The writer.
+ * @param c The character.
+ * @return 0 on success, -1 if a write failed.
+ */
+int fd_writer_putc(FdWriter *w, char c);
+
+/**
+ * @brief Appends formatted text, like printf().
+ *
+ * @param w   The writer.
+ * @param fmt The format.
+ * @return 0 on success, -1 on failure.
+ */
+int fd_writer_printf(FdWriter *w, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Writes out whatever is buffered.
+ *
+ * @param w The writer.
+ * @return 0 if everything appended so far was written, -1 otherwise.
+ */
+int fd_writer_flush(FdWriter *w);
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * @file hash.h
+ * @brief String hashing shared by the shell's hash tables.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Hashes a run of bytes.
+ *
+ * Reads eight bytes per step and finishes with a 64-bit avalanche, so all
+ * bits of the result are usable as a table index.
+ *
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @return The 64-bit hash.
+ */
+uint64_t hash_bytes(const void *data, size_t len);
+
+/**
+ * @brief Hashes a NUL-terminated string.
+ *
+ * @param s The string to hash.
+ * @return The same value as hash_bytes() over the string's characters.
+ */
+uint64_t hash_string(const char *s);
+
+#endif
@@ -15,9 +15,10 @@
  * @brief Checks whether a process is a built-in command.
  *
  * This function checks whether the given process is a built-in command.
+ * The name is looked up in the command table.
  *
  * @param proc The process to check.
- * @return 1 if the process is a built-in command, 0 otherwise.
+ * @return The index in builtin_commands, -1 if it is not a built-in.
  */
 int is_bulitin(Process *proc);
 
@@ -25,7 +26,9 @@ int is_bulitin(Process *proc);
  * @brief Executes a built-in routine.
  *
  * This function executes a built-in routine based on the given function number
- * and process information.
+ * and process information. The command's `<`, `>` and `>>` redirections are
+ * applied to the shell's own descriptors for the duration of the call; if one
+ * fails the builtin does not run and $? is 1.
  *
  * @param func_num The function number of the built-in routine to execute.
  * @param proc_head The head of the process list.
@@ -1,7 +1,7 @@
 /**
  * @file io_redirection.h
  * @brief Function prototypes for setting up input and output redirection for
- * child processes and closing pipe ends and freeing pipes.
+ * child processes and closing pipe ends.
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
@@ -14,55 +14,113 @@
 #include "parser.h"
 
 /**
- * @brief Sets up the output redirection for a child process.
+ * @def CHILD_ACTIONS_MAX
+ * @brief The most actions a stage needs: stdin, stdout, stdout and stderr
+ * into a capture pipe, the two jobserver descriptors and the final close.
+ * Pipes are close-on-exec, so the count does not grow with the pipeline.
+ */
+#define CHILD_ACTIONS_MAX 7
+
+/**
+ * @enum ChildActionKind
+ * @brief What a child does to its file descriptors before exec.
+ */
+typedef enum { ACTION_OPEN, ACTION_DUP2, ACTION_CLOSE_FROM } ChildActionKind;
+
+/**
+ * @struct ChildAction
+ * @brief One step of a child's descriptor setup.
  *
- * This function configures the output redirection for a child process based on
- * the provided command and pipe information.
+ * ACTION_OPEN opens path onto target, ACTION_DUP2 duplicates fd onto target
+ * and ACTION_CLOSE_FROM closes fd and every descriptor above it. The list
+ * maps one to one onto posix_spawn file actions.
+ */
+typedef struct {
+  ChildActionKind kind;
+  int fd;
+  int target;
+  int flags;
+  const char *path;
+  const char *error; /**< Reported when the action fails. */
+} ChildAction;
+
+/**
+ * @brief Computes the redirections and pipe plumbing of a pipeline stage.
  *
- * @param cmd        The command structure containing the output redirection
- * information.
+ * The stage only duplicates its own pipe ends; the pipes are close-on-exec,
+ * and descriptors above stderr are closed as a safety net.
+ *
+ * @param cmd        The command of the stage.
  * @param pipes      A 2D array of pipe file descriptors.
- * @param proc_num   The process number of the child process.
+ * @param proc_num   The index of the stage.
  * @param num_procs  The total number of processes.
+ * @param actions    Receives at most CHILD_ACTIONS_MAX actions.
  *
- * @return An integer indicating the success or failure of the operation.
+ * @return The number of actions.
  */
-int child_stdout_setup(Command *cmd, int (*pipes)[2], int proc_num,
-                       int num_procs);
+size_t build_child_actions(const Command *cmd, int (*pipes)[2], int proc_num,
+                           int num_procs, ChildAction *actions);
 
 /**
- * @brief Sets up the input redirection for a child process.
+ * @brief Performs an action list in the child.
  *
- * This function configures the input redirection for a child process based on
- * the provided command and pipe information.
+ * Only async-signal-safe calls are made, so it may run in a vfork child.
  *
- * @param cmd        The command structure containing the input redirection
- * information.
- * @param pipes      A 2D array of pipe file descriptors.
- * @param proc_num   The process number of the child process.
+ * @param actions      The actions.
+ * @param num_actions  The number of actions.
  *
- * @return An integer indicating the success or failure of the operation.
+ * @return NULL on success, the failed action otherwise.
+ */
+const ChildAction *apply_child_actions(const ChildAction *actions,
+                                       size_t num_actions);
+
+/**
+ * @struct RedirectionFrame
+ * @brief The descriptors the shell replaced to run a builtin, kept so they
+ * can be put back afterwards.
  */
-int child_stdin_setup(Command *cmd, int (*pipes)[2], int proc_num);
+typedef struct {
+  int target[CHILD_ACTIONS_MAX];
+  int saved[CHILD_ACTIONS_MAX]; /**< A copy of target, -1 if it was closed. */
+  size_t count;
+} RedirectionFrame;
 
 /**
- * @brief Closes the unused pipe ends for all processes.
+ * @brief Performs an action list in the shell itself, saving what it
+ *        replaces.
  *
- * This function closes the unused pipe ends for all processes to prevent file
- * descriptor leaks.
+ * Builtins run in the shell process, so their redirections are applied with
+ * dup2() around the call instead of in a child. Pending stdio output is
+ * flushed first so it reaches the descriptor it was written for.
+ * ACTION_CLOSE_FROM is skipped. On failure the descriptors already replaced
+ * are restored and errno describes the failed action.
  *
- * @param num_procs  The total number of processes.
- * @param pipes      A 2D array of pipe file descriptors.
+ * @param actions      The actions.
+ * @param num_actions  The number of actions.
+ * @param frame        Receives the saved descriptors.
+ *
+ * @return NULL on success, the failed action otherwise.
  */
-void close_pipe_ends(int num_procs, int (*pipes)[2]);
+const ChildAction *push_redirections(const ChildAction *actions,
+                                     size_t num_actions,
+                                     RedirectionFrame *frame);
 
 /**
- * @brief Frees the pipe resources.
+ * @brief Restores the descriptors saved by push_redirections().
  *
- * This function frees the pipe resources to prevent memory leaks.
+ * @param frame  The saved descriptors; it is empty afterwards.
+ */
+void pop_redirections(RedirectionFrame *frame);
+
+/**
+ * @brief Closes the pipe ends the parent still holds.
  *
+ * This function closes the pipe ends that are still open to prevent file
+ * descriptor leaks. Closed ends are marked with -1.
+ *
+ * @param num_procs  The total number of processes.
  * @param pipes      A 2D array of pipe file descriptors.
  */
-void free_pipes(int (*pipes)[2]);
+void close_pipe_ends(int num_procs, int (*pipes)[2]);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,169 @@
+/**
+ * @file job_capture.h
+ * @brief Capturing what background jobs print. With JOBOUTPUT=capture every
+ *         background job writes its stdout and stderr into a pipe of its
+ *         own instead of the terminal; the prompt drains the pipe into a
+ *         bounded buffer and `joblog %N` prints it back.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef JOB_CAPTURE_H
+#define JOB_CAPTURE_H
+
+#include <stddef.h>
+
+#include "io_redirection.h"
+#include "job_utils.h"
+
+/**
+ * @def CAPTURE_RING_SIZE
+ * @brief The most recent output of a job kept in memory.
+ */
+#define CAPTURE_RING_SIZE (64 * 1024)
+
+/**
+ * @def CAPTURE_SPILL_MAX
+ * @brief The earliest output of a job kept in a memory file once the ring
+ *        is full. What comes between the two is dropped.
+ */
+#define CAPTURE_SPILL_MAX (4 * 1024 * 1024)
+
+/**
+ * @def CAPTURE_PIPE_SIZE
+ * @brief The pipe size asked for, so a job can run ahead of the prompt for
+ *        a while before it blocks on a full pipe.
+ */
+#define CAPTURE_PIPE_SIZE (1024 * 1024)
+
+/**
+ * @def CAPTURE_DRAIN_MAX
+ * @brief The most read from one pipe per wakeup, so a job that writes fast
+ *        cannot keep the prompt from the terminal.
+ */
+#define CAPTURE_DRAIN_MAX (256 * 1024)
+
+/**
+ * @struct JobCapture
+ * @brief A job's pipe and what was read from it.
+ *
+ * Output goes into the ring until it is full; then the oldest bytes of the
+ * ring move to the spill file, and once that is full too they are dropped,
+ * so a job holds at most CAPTURE_RING_SIZE bytes of memory and
+ * CAPTURE_SPILL_MAX of memory file however much it prints. The capture
+ * outlives the job and is kept under its number until a new job takes it.
+ */
+typedef struct JobCapture {
+  int fd;       /**< The read end, non-blocking; -1 once it is closed. */
+  int write_fd; /**< Given to the job's processes, then closed; or -1. */
+  int epoll_fd; /**< The epoll set watching fd, or -1. */
+  int spill_fd; /**< A memfd with the earliest output, or -1. */
+  size_t spilled; /**< Bytes in the spill file. */
+  size_t dropped; /**< Bytes lost between the spill file and the ring. */
+  char *ring;
+  size_t size;  /**< Grows up to CAPTURE_RING_SIZE. */
+  size_t start; /**< The oldest byte in the ring. */
+  size_t len;
+  int job_num;
+} JobCapture;
+
+/**
+ * @brief Tells whether background jobs started now are captured, that is,
+ *        whether JOBOUTPUT is `capture`.
+ *
+ * @return 1 if they are, 0 otherwise.
+ */
+int capture_enabled(void);
+
+/**
+ * @brief Gives a job a capture pipe.
+ *
+ * @param job The job, before its processes are started.
+ * @return 0 on success, -1 on failure.
+ */
+int capture_open(Job *job);
+
+/**
+ * @brief Sends a stage's stderr, and its stdout if it is the last stage and
+ *        not redirected, into the job's capture.
+ *
+ * The final ACTION_CLOSE_FROM of the list is replaced by the duplications
+ * and a new ACTION_CLOSE_FROM. Nothing changes without a capture.
+ *
+ * @param capture The job's capture, or NULL.
+ * @param cmd The command of the stage.
+ * @param last 1 for the last stage.
+ * @param actions The list from build_child_actions(), with room for
+ *        CHILD_ACTIONS_MAX actions.
+ * @param num_actions The number of actions in it.
+ * @return The new number of actions.
+ */
+size_t capture_child_actions(const JobCapture *capture, const Command *cmd,
+                             int last, ChildAction *actions,
+                             size_t num_actions);
+
+/**
+ * @brief Closes the shell's copy of the write end once the job's processes
+ *        have theirs, so the pipe ends when they do.
+ *
+ * @param capture The capture, or NULL.
+ */
+void capture_close_writer(JobCapture *capture);
+
+/**
+ * @brief Reads what is waiting in the pipe without blocking.
+ *
+ * @param capture The capture.
+ * @param relay_fd Where to copy the output as well, as for a job in the
+ *        foreground; -1 for nowhere.
+ * @param limit The most to read, such as CAPTURE_DRAIN_MAX.
+ * @return 1 once the pipe is closed, 0 if more may come, -1 on failure.
+ */
+int capture_drain(JobCapture *capture, int relay_fd, size_t limit);
+
+/**
+ * @brief Called as a job leaves the job list: reads the rest of its output
+ *        and keeps the capture under the job's number.
+ *
+ * @param job The job.
+ */
+void capture_finish(Job *job);
+
+/**
+ * @brief Drops the kept capture of an earlier job with this number.
+ *
+ * @param job_num The number a new job takes.
+ */
+void capture_discard(int job_num);
+
+/**
+ * @brief Finds the capture of the job with this number, running or ended.
+ *
+ * @param job_num The job number.
+ * @return The capture, or NULL if the job was not captured.
+ */
+JobCapture *capture_find(int job_num);
+
+/**
+ * @brief Returns the number of the job that ended last with a capture.
+ *
+ * @return The number, or 0 if there is none.
+ */
+int capture_last_finished(void);
+
+/**
+ * @brief Writes everything a capture holds, oldest first, with a note
+ *        where output was dropped.
+ *
+ * @param capture The capture.
+ * @param fd Where to write.
+ * @return 0 on success, -1 on failure.
+ */
+int capture_replay(const JobCapture *capture, int fd);
+
+/**
+ * @brief Frees the captures of the jobs that ended.
+ */
+void capture_free_all(void);
+
+#endif
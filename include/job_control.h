@@ -23,6 +23,15 @@
  */
 extern int last_exit_status;
 
+/**
+ * @var shell_interactive
+ * @brief Whether the shell reads commands from a terminal.
+ *
+ * A shell running a -c string or a script leaves the terminal alone: it
+ * neither takes it at startup nor hands it to its jobs.
+ */
+extern int shell_interactive;
+
 /**
  * @brief Sets up job control for a given job.
  *
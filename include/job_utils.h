@@ -13,30 +13,76 @@
 #include "parser.h"
 #include "process_utils.h"
 
+/**
+ * @def JOB_TABLE_MIN
+ * @brief The number of job numbers and process slots the job table starts
+ * with; a power of two.
+ */
+#define JOB_TABLE_MIN 64
+
 /**
  * @struct Job
  * @brief Represents a job in the job list.
  *
  * This struct contains information about a job, including its command, process
- * group ID, and job number.
+ * group ID, and job number. A job built for the current command line lives in
+ * that line's arena; persist_job() moves it to the heap when it has to
+ * outlive the line. The list is linked both ways, and the prev of its head is
+ * the last job, so jobs are added and removed without walking it.
  */
 typedef struct Job {
   struct Job *next;
+  struct Job *prev;
   char *command;
   Process *first_process;
+  Arena *arena; /**< The arena the job lives in, or NULL once persisted. */
   pid_t pgid;
   pid_t *pids;
   int job_num;
   int num_procs;
   int background;
+  unsigned int token; /**< The jobserver generation of the token the job
+                           holds, or 0; see jobserver.h. */
+  int quiet;    /**< Started by parallel, which reports it itself. */
+  char *output; /**< A file holding the job's output, printed when it is
+                     reported done; NULL if it writes straight out. */
+  struct JobCapture *capture; /**< Where its output goes with
+                                   JOBOUTPUT=capture; see job_capture.h. */
 } Job;
 
-extern struct Pending {
-  pid_t pid;
-  int status;
-} pending_bg_jobs[256];
+/**
+ * @struct ProcessSlot
+ * @brief A slot of the table from process IDs to processes.
+ */
+typedef struct {
+  pid_t pid; /**< 0 if the slot is empty. */
+  Process *proc;
+  int pidfd; /**< Closed once the process is reaped; -1 if there is none. */
+} ProcessSlot;
 
-extern int pending_indx;
+/**
+ * @struct JobTable
+ * @brief The jobs in the list by job number, and their processes by ID.
+ *
+ * A job takes the lowest free number and gives it back when it is freed. The
+ * processes are in a linear-probing table with a power-of-two number of
+ * slots, so a status from waitpid() finds its process without searching the
+ * jobs.
+ */
+typedef struct {
+  Job **jobs;        /**< Indexed by job number; NULL for free numbers. */
+  size_t capacity;   /**< Entries in jobs. */
+  size_t next_free;  /**< No number below it is free. */
+  ProcessSlot *procs;
+  size_t proc_mask;  /**< Number of process slots minus one. */
+  size_t num_procs;
+} JobTable;
+
+/**
+ * @var job_table
+ * @brief The shell's jobs by number and their processes by ID.
+ */
+extern JobTable job_table;
 
 /**
  * @brief Initializes a new job control structure.
@@ -47,17 +93,35 @@ extern int pending_indx;
  * @param cmd_ptr     The command structure.
  * @param proc_ptr    The process structure.
  * @param job_head    The head of the job list.
+ * @param arena       The arena the job is allocated in.
  *
  * @return A pointer to the newly created job structure.
  */
 Job *initialize_job_control(char *line_buffer, Command *cmd_ptr,
-                            Process *proc_ptr, Job **job_head);
+                            Process *proc_ptr, Job **job_head, Arena *arena);
+
+/**
+ * @brief Moves a job out of its arena.
+ *
+ * Background and stopped jobs stay in the job list after the command line is
+ * done. This copies such a job, its processes and commands to the heap and
+ * puts the copy in the original's place in the list. Jobs that are no longer
+ * in the list and jobs that are already on the heap are left alone.
+ *
+ * @param job      The job to move.
+ * @param job_head The head of the job list.
+ *
+ * @return The job as it is now linked in the list, or NULL if it is not in
+ * the list or could not be copied.
+ */
+Job *persist_job(Job *job, Job **job_head);
 
 /**
  * @brief Frees a job structure and its associated resources.
  *
  * This function frees a job structure and its associated resources, including
- * the command string and process list.
+ * the command string and process list. A job still in its arena is only
+ * unlinked; the arena releases its memory.
  *
  * @param job  The job structure to free.
  * @param head The head of the job list.
@@ -94,40 +158,105 @@ void free_all_jobs(Job **head);
 void kill_jobs(Job **job_head);
 
 /**
- * @brief Finds a job in the job list based on a process.
+ * @brief Finds the job a `fg` or `bg` command names.
  *
- * This function searches for a job in the job list that contains a given
- * process.
+ * With no argument this is the last job; otherwise the argument is %N and the
+ * job is looked up by number.
  *
- * @param proc    The process structure.
+ * @param proc    The `fg` or `bg` process.
  * @param job_head The head of the job list.
  *
- * @return A pointer to the job structure that contains the process, or NULL if
- * not found.
+ * @return The job, or NULL if there is no such job.
  */
 Job *find_job(Process *proc, Job **job_head);
 
 /**
- * @brief Queues a pending process.
+ * @brief Adds a started process to the job table.
+ *
+ * @param proc The process; its pid must be set.
+ *
+ * @return 0 on success, -1 if the table could not grow.
+ */
+int job_table_add_process(Process *proc);
+
+/**
+ * @brief Returns the process with a given ID.
+ *
+ * @param pid The process ID.
+ *
+ * @return The process, or NULL if no job in the table has it.
+ */
+Process *job_table_find_process(pid_t pid);
+
+/**
+ * @brief Gives a process in the job table a pidfd, which the table closes
+ *        when the process is reaped or removed.
  *
- * This function adds a pending process to the queue of pending processes.
+ * @param pid The process ID.
+ * @param pidfd The pidfd.
  *
- * @param pid   The process ID of the pending process.
- * @param status The status of the pending process.
+ * @return 0 on success, -1 if the process is not in the table.
  */
-void queue_pending_procs(pid_t pid, int status);
+int job_table_set_pidfd(pid_t pid, int pidfd);
 
 /**
- * @brief Marks background jobs as pending.
+ * @brief Frees the job table once the job list is empty.
+ */
+void job_table_free(void);
+
+/**
+ * @brief Records a status from waitpid() in the process it belongs to.
  *
- * This function marks all background jobs as pending.
+ * @param pid    The process ID waitpid() returned.
+ * @param status The status it returned.
  *
- * @param job_head       The head of the job list.
- * @param pending_bg_jobs An array of pending background jobs.
- * @param pending_count  The number of pending background jobs.
+ * @return The process, or NULL if it is not in the job table.
  */
-void mark_bg_jobs(Job **job_head, struct Pending pending_bg_jobs[],
-                  int pending_count);
+Process *mark_process(pid_t pid, int status);
+
+/**
+ * @brief Reaps every child that has exited or stopped and records its status
+ *        in its process.
+ *
+ * Only safe while no foreground job is running, since it would take the
+ * statuses wait_for_children() waits for.
+ */
+void reap_children(void);
+
+/**
+ * @brief Records the statuses of children that changed since the last call.
+ *
+ * The SIGCHLD handler only sets child_changed; the children are reaped here.
+ * While SIGCHLD is blocked, as it is while a foreground job runs, they are
+ * left for the next call.
+ */
+void mark_bg_jobs(void);
+
+/**
+ * @brief Waits like waitpid() for a process of a job.
+ *
+ * With job control a job is a process group and any of its processes is
+ * waited for. Without it, as in `-c` and script mode, the processes stay in
+ * the shell's group, so they are waited for one by one, in order, skipping
+ * those that completed.
+ *
+ * @param job    The job.
+ * @param status Receives the status.
+ * @param flags  Flags for waitpid().
+ * @return The pid, 0 with WNOHANG if nothing changed, or -1 with errno set;
+ *         ECHILD once there is nothing left to wait for.
+ */
+pid_t wait_job(Job *job, int *status, int flags);
+
+/**
+ * @brief Sends a signal to every process of a job: its process group with
+ *        job control, and otherwise each process that has not completed.
+ *
+ * @param job The job.
+ * @param sig The signal.
+ * @return 0 on success, -1 if no process could be signalled.
+ */
+int signal_job(const Job *job, int sig);
 
 /**
  * @brief Drains the remaining statuses of a job.
@@ -194,15 +323,23 @@ void clear_stopped_mark(Job *job);
  */
 void notify_bg_jobs(Job **job_head);
 
+/**
+ * @brief Copies a file of collected output to stdout and removes it.
+ *
+ * @param path The file; freed and set to NULL.
+ */
+void print_output_file(char **path);
+
 /**
  * @brief Formats job information for display.
  *
  * This function formats job information, including the job number, process
  * group ID, and status, for display.
  *
+ * @param fd    Where to write: stdout for `jobs`, stderr for notices.
  * @param job   The job structure.
  * @param status A buffer to store the formatted job information.
  */
-void format_job_info(Job *job, char *status);
+void format_job_info(int fd, Job *job, char *status);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+/**
+ * @file jobserver.h
+ * @brief A GNU make jobserver shared by the shell's jobs. `jobserver N` puts
+ *         N tokens in a FIFO; every background job takes one before it is
+ *         started and gives it back when it is reaped, and make, which finds
+ *         the FIFO through MAKEFLAGS, takes one for each extra recipe it
+ *         runs, so all of them together run at most N things at a time.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <stddef.h>
+
+#include "io_redirection.h"
+#include "job_utils.h"
+
+/**
+ * @def JOBSERVER_READ_FD
+ * @brief The descriptor children read tokens from, as named in MAKEFLAGS.
+ */
+#define JOBSERVER_READ_FD 3
+
+/**
+ * @def JOBSERVER_WRITE_FD
+ * @brief The descriptor children give tokens back on.
+ */
+#define JOBSERVER_WRITE_FD 4
+
+/**
+ * @def JOBSERVER_MAX
+ * @brief The most tokens; they must all fit in the FIFO's buffer.
+ */
+#define JOBSERVER_MAX 4096
+
+/**
+ * @struct Jobserver
+ * @brief The FIFO and what the shell knows about its tokens.
+ *
+ * The FIFO is opened twice: children get a blocking descriptor, which make
+ * expects, and the shell reads through its own non-blocking one so waiting
+ * for a token can also watch for children and Ctrl+C.
+ */
+typedef struct {
+  int child_fd; /**< Passed to children; -1 when there is no server. */
+  int shell_fd; /**< Non-blocking. */
+  int tokens;   /**< How many tokens were put in. */
+  unsigned int generation; /**< Tells a job's token from an older server's. */
+  char *saved_makeflags;   /**< MAKEFLAGS before the server, or NULL. */
+  int saved_exported;
+} Jobserver;
+
+/**
+ * @var jobserver
+ * @brief The shell's jobserver.
+ */
+extern Jobserver jobserver;
+
+/**
+ * @brief Starts a jobserver, replacing any running one.
+ *
+ * MAKEFLAGS gets `-jN --jobserver-auth=3,4` appended and is exported, so
+ * every make the shell starts uses the tokens.
+ *
+ * @param tokens The number of tokens, 1 to JOBSERVER_MAX.
+ * @return 0 on success, -1 on failure.
+ */
+int jobserver_start(int tokens);
+
+/**
+ * @brief Stops the jobserver and puts MAKEFLAGS back as it was.
+ *
+ * Running jobs keep what they took; their tokens are dropped when they end.
+ */
+void jobserver_stop(void);
+
+/**
+ * @brief Tells whether a jobserver is running.
+ *
+ * @return 1 if it is, 0 otherwise.
+ */
+int jobserver_active(void);
+
+/**
+ * @brief Returns the number of tokens nobody holds.
+ *
+ * @return The free tokens, or -1 if there is no jobserver.
+ */
+int jobserver_free_tokens(void);
+
+/**
+ * @brief Takes a token for a job that is about to be started.
+ *
+ * If none is free, waits until one is given back. Meanwhile children are
+ * reaped and the tokens of the shell's finished jobs returned; Ctrl+C stops
+ * the wait.
+ *
+ * @param job The job.
+ * @param job_head The head of the job list.
+ * @return 0 once the job holds a token or if there is no jobserver; -1 if
+ *         the wait was interrupted or failed.
+ */
+int jobserver_take(Job *job, Job **job_head);
+
+/**
+ * @brief Gives back a job's token, if it holds one.
+ *
+ * @param job The job.
+ */
+void jobserver_put(Job *job);
+
+/**
+ * @brief Passes the jobserver to a child.
+ *
+ * The final ACTION_CLOSE_FROM of the list is replaced by duplicating the
+ * FIFO onto JOBSERVER_READ_FD and JOBSERVER_WRITE_FD and closing what is
+ * above them. Nothing changes without a jobserver.
+ *
+ * @param actions The list from build_child_actions(), with room for
+ *        CHILD_ACTIONS_MAX actions.
+ * @param num_actions The number of actions in it.
+ * @return The new number of actions.
+ */
+size_t jobserver_child_actions(ChildAction *actions, size_t num_actions);
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @file parallel.h
+ * @brief The scheduler behind `parallel`: a command template run once per
+ *         input, a fixed number at a time. Every task is a background job
+ *         of its own, with its own process group and job number, started
+ *         through the executor like any other; the scheduler only decides
+ *         when, and collects what each one printed.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "arena.h"
+#include "job_utils.h"
+
+/**
+ * @def PARALLEL_PLACEHOLDER
+ * @brief Replaced by the input in every word of the template. A template
+ *        without it gets the input as its last word.
+ */
+#define PARALLEL_PLACEHOLDER "{}"
+
+/**
+ * @def PARALLEL_ARGS
+ * @brief Separates the template from the inputs; without it the inputs are
+ *        the lines of stdin.
+ */
+#define PARALLEL_ARGS ":::"
+
+/**
+ * @def PARALLEL_MAX_FAILED
+ * @brief The highest exit status that counts failed tasks, as in GNU
+ *        parallel.
+ */
+#define PARALLEL_MAX_FAILED 101
+
+/**
+ * @enum HaltWhen
+ * @brief What `--halt` does once its condition is met.
+ */
+typedef enum {
+  HALT_NEVER, /**< Run every task. */
+  HALT_SOON,  /**< Start no more; let the running tasks finish. */
+  HALT_NOW,   /**< Terminate the running tasks too. */
+} HaltWhen;
+
+/**
+ * @struct HaltPolicy
+ * @brief `--halt when,fail=N` or `--halt when,success=N`.
+ */
+typedef struct {
+  HaltWhen when;
+  int on_success; /**< Count successes instead of failures. */
+  int threshold;
+} HaltPolicy;
+
+/**
+ * @enum TaskState
+ * @brief Where a task is in its life.
+ */
+typedef enum {
+  TASK_QUEUED,
+  TASK_RUNNING,
+  TASK_DONE,    /**< Finished, its output not printed yet. */
+  TASK_PRINTED,
+} TaskState;
+
+/**
+ * @struct ParallelTask
+ * @brief One input and what became of it.
+ */
+typedef struct {
+  char *arg;
+  TaskState state;
+  Job *job;     /**< While it runs. */
+  char *output; /**< The file collecting its stdout, or NULL. */
+  int status;   /**< As from waitpid(). */
+  struct timespec start;
+  double runtime; /**< Seconds. */
+} ParallelTask;
+
+/**
+ * @struct ParallelRun
+ * @brief The template, the tasks and the scheduler's state.
+ *
+ * Tasks are started in input order: the first queued one goes to whichever
+ * slot frees up first. The slots are the indices of the running tasks.
+ */
+typedef struct {
+  char **template; /**< The command words, NULL-terminated. */
+  int has_placeholder;
+  int slots;
+  int keep_order; /**< Print outputs in input order, not as tasks finish. */
+  int ungroup;    /**< Let tasks write straight to stdout. */
+  HaltPolicy halt;
+  const char *joblog_path;
+  FILE *joblog;
+  ParallelTask *tasks;
+  size_t num_tasks;
+  size_t capacity; /**< Tasks there is room for. */
+  char *input; /**< The lines read from stdin, which the inputs point into. */
+  size_t next;       /**< The first queued task. */
+  size_t next_print; /**< With keep_order, the next task to print. */
+  size_t *running;   /**< Indices of the running tasks. */
+  int num_running;
+  int failed;
+  int succeeded;
+  HaltWhen halted;
+  int halt_status;   /**< The exit status of the task that halted the run. */
+  int interrupted;
+  int suspended;
+  Arena arena; /**< Holds the job being started. */
+} ParallelRun;
+
+/**
+ * @brief Reads the options, template and inputs of a `parallel` command.
+ *
+ * `parallel [-j N] [-k] [-u] [--halt when,fail|success=N] [--joblog file]
+ * command [word...] [::: input...]`. Without `:::` the inputs are the lines
+ * read from stdin. Errors are reported on stderr.
+ *
+ * @param run Receives the run.
+ * @param argv The words of the command, starting with `parallel`.
+ * @return 0 on success, -1 on a usage error or failure; the run needs
+ *         parallel_free() either way.
+ */
+int parallel_parse(ParallelRun *run, char **argv);
+
+/**
+ * @brief Runs every task and prints their outputs.
+ *
+ * Tasks get /dev/null as stdin. Children are reaped while waiting; Ctrl+C
+ * stops the run and interrupts the running tasks. Ctrl+Z stops the running
+ * tasks and leaves them in the job list, where `jobs`, `fg` and `bg` see
+ * them; their output is printed when they are reported done, and the tasks
+ * not started yet are dropped.
+ *
+ * @param run The parsed run.
+ * @param job_head The head of the job list.
+ * @return The status of the task that halted the run; otherwise the number
+ *         of failed tasks, at most PARALLEL_MAX_FAILED; 130 after Ctrl+C and
+ *         148 after Ctrl+Z.
+ */
+int parallel_run(ParallelRun *run, Job **job_head);
+
+/**
+ * @brief Frees a run, removing the output files it still holds.
+ *
+ * @param run The run.
+ */
+void parallel_free(ParallelRun *run);
+
+#endif
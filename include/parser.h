@@ -2,8 +2,8 @@
  * @file parser.h
  * @brief Implements functionalities for parsing user command. Related to
  * parsing phase. Includes functions for allocating and freeing memory for
- * commands. Also includes functions for validating the position of special
- * characters.
+ * commands. The pipeline is parsed in one pass over the tokens, which also
+ * validates the position of special characters.
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
@@ -13,11 +13,8 @@
 
 #include <stddef.h>
 
-/**
- * @def OPERATORSLEN
- * @brief The number of special operator characters recognized by the parser.
- */
-#define OPERATORSLEN 4
+#include "arena.h"
+#include "tokenizer.h"
 
 /**
  * @struct Command
@@ -39,48 +36,69 @@ typedef struct {
  * @brief Frees the memory allocated for a Command struct.
  *
  * This function releases the memory allocated for the Command struct and its
- * members.
+ * members. Only for commands made by copy_command(); commands parsed into an
+ * arena are released with the arena.
  *
  * @param cmd The Command struct to free.
  */
 void free_struct_memory(Command *cmd);
 
+/**
+ * @brief Copies a Command struct to the heap.
+ *
+ * Used for commands that must outlive the arena they were parsed into. The
+ * copy is released with free_struct_memory().
+ *
+ * @param cmd The Command struct to copy.
+ * @return The copy, or NULL on failure.
+ */
+Command *copy_command(const Command *cmd);
+
 /**
  * @brief Parses a command from an array of tokens.
  *
  * This function takes an array of tokens and parses them into a Command struct.
+ * The tokens must form a single command; use parse_stage() for pipelines.
  *
+ * @param line The line buffer the tokens point into.
  * @param tokens The array of tokens to parse.
  * @param command_ptr A pointer to the Command struct to fill.
  * @param num_tokens The number of tokens in the array.
+ * @param arena The arena the Command struct is allocated in.
  * @return 0 on success, -1 on failure.
  */
-int parse(char *tokens[], Command **command_ptr, size_t num_tokens);
+int parse(char *line, const Token tokens[], Command **command_ptr,
+          size_t num_tokens, Arena *arena);
 
 /**
- * @brief Prints the contents of a Command struct.
+ * @brief Parses the pipeline stage that starts at a given token.
  *
- * This function prints the command arguments, input and output file names, and
- * flags for output append and background execution.
+ * Stops after the `|` that ends the stage, or at the end of the tokens. The
+ * placement of `|`, `&` and redirections is checked on the way. The argv
+ * strings point into the line buffer, so the command is only valid as long
+ * as the line is; use copy_command() to keep it longer.
  *
- * @param command_ptr The Command struct to print.
+ * @param line The line buffer the tokens point into.
+ * @param tokens The array of tokens.
+ * @param num_tokens The number of tokens in the array.
+ * @param indx The index of the stage's first token; on success, the index of
+ *             the next stage's first token, or num_tokens.
+ * @param command_ptr A pointer to the Command struct to fill.
+ * @param arena The arena the Command struct is allocated in.
+ * @return 0 on success, -1 on failure.
  */
-void print_command_ptr(Command *command_ptr);
+int parse_stage(char *line, const Token tokens[], size_t num_tokens,
+                size_t *indx, Command **command_ptr, Arena *arena);
 
 /**
- * @brief Splits a command into sub-commands separated by pipes.
+ * @brief Prints the contents of a Command struct.
  *
- * This function takes an array of tokens and splits them into sub-commands
- * separated by pipes.
+ * This function prints the command arguments, input and output file names, and
+ * flags for output append and background execution.
  *
- * @param tokens The array of tokens to split.
- * @param num_tokens The number of tokens in the array.
- * @param cmd_ptr A pointer to the Command struct to fill.
- * @param indx The index of the current token.
- * @return The index of the next token, or -1 on failure.
+ * @param command_ptr The Command struct to print.
  */
-int split_on_pipe(char *tokens[], size_t num_tokens, Command **cmd_ptr,
-                  int indx);
+void print_command_ptr(Command *command_ptr);
 
 /**
  * @brief Gets the raw input from the user.
@@ -88,19 +106,9 @@ int split_on_pipe(char *tokens[], size_t num_tokens, Command **cmd_ptr,
  * This function reads a line of input from the user and returns it as a string.
  *
  * @param line_buffer A buffer to store the input line.
+ * @param arena The arena the copy is allocated in.
  * @return The input line as a string.
  */
-char *get_raw_input(char *line_buffer);
-
-/**
- * @brief Checks if a character is a valid background character.
- *
- * This function checks if a character is a valid background character.
- *
- * @param tokens The array of tokens to check.
- * @param num_tokens The number of tokens in the array.
- * @return 1 if the character is valid, 0 otherwise.
- */
-int is_background_char_valid(char *tokens[], size_t num_tokens);
+char *get_raw_input(char *line_buffer, Arena *arena);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+/**
+ * @file pipeline_cache.h
+ * @brief LRU cache of parsed pipelines keyed by the raw command line. A hit
+ *         skips tokenizing and parsing; the template is cloned into the line
+ *         arena and only expanded.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "process_utils.h"
+
+/**
+ * @def PIPELINE_CACHE_SIZE
+ * @brief The maximum number of pipelines kept in the cache.
+ */
+#define PIPELINE_CACHE_SIZE 256
+
+/**
+ * @def PIPELINE_CACHE_BUCKETS
+ * @brief The number of hash buckets; a power of two.
+ */
+#define PIPELINE_CACHE_BUCKETS 512
+
+/**
+ * @struct StageTemplate
+ * @brief One command of a cached pipeline, before expansion.
+ *
+ * Strings are offsets into the template's string block; -1 means none.
+ */
+typedef struct {
+  size_t first_arg; /**< Index of the stage's first argument in args. */
+  size_t argc;
+  long infile;
+  long outfile;
+  int append_output;
+  int background;
+} StageTemplate;
+
+/**
+ * @struct PipelineTemplate
+ * @brief A cached pipeline. Header, stages, argument offsets and strings
+ * live in one allocation.
+ */
+typedef struct PipelineTemplate {
+  struct PipelineTemplate *hash_next;
+  struct PipelineTemplate *lru_prev; /**< Towards the most recently used. */
+  struct PipelineTemplate *lru_next;
+  uint64_t hash;
+  size_t key_len;      /**< The raw line is the first string in strings. */
+  size_t num_stages;
+  size_t num_args;
+  size_t strings_len;  /**< Bytes of stage strings after the key. */
+  StageTemplate *stages;
+  size_t *args;
+  char *strings;
+} PipelineTemplate;
+
+/**
+ * @struct PipelineCache
+ * @brief Hash table of templates threaded on an LRU list.
+ */
+typedef struct {
+  PipelineTemplate *buckets[PIPELINE_CACHE_BUCKETS];
+  PipelineTemplate *lru_head; /**< The most recently used template. */
+  PipelineTemplate *lru_tail;
+  size_t count;
+  size_t capacity;
+  size_t hits;
+  size_t misses;
+} PipelineCache;
+
+/**
+ * @brief Initializes an empty cache.
+ *
+ * @param cache The cache to initialize.
+ * @param capacity The maximum number of templates, at most
+ *                 PIPELINE_CACHE_SIZE; 0 selects PIPELINE_CACHE_SIZE.
+ */
+void pipeline_cache_init(PipelineCache *cache, size_t capacity);
+
+/**
+ * @brief Looks up a raw command line.
+ *
+ * Counts a hit or a miss. A hit becomes the most recently used template.
+ *
+ * @param cache The cache.
+ * @param line The raw command line.
+ * @param len The length of the line.
+ * @return The template, or NULL on a miss.
+ */
+const PipelineTemplate *pipeline_cache_lookup(PipelineCache *cache,
+                                              const char *line, size_t len);
+
+/**
+ * @brief Stores the parsed, not yet expanded pipeline of a command line.
+ *
+ * Evicts the least recently used template when the cache is full.
+ *
+ * @param cache The cache.
+ * @param line The raw command line.
+ * @param len The length of the line.
+ * @param proc_head The process list built from the line.
+ * @return 0 on success, -1 on failure.
+ */
+int pipeline_cache_store(PipelineCache *cache, const char *line, size_t len,
+                         const Process *proc_head);
+
+/**
+ * @brief Builds the process list of a cached pipeline in an arena.
+ *
+ * The strings are copied with the rest, so the clone may be expanded and
+ * modified freely.
+ *
+ * @param tpl The template.
+ * @param cmd_ptr Receives the command of the last stage.
+ * @param proc_ptr Receives the head of the process list.
+ * @param arena The arena to build in.
+ * @return The head of the process list, or NULL on failure.
+ */
+Process *pipeline_instantiate(const PipelineTemplate *tpl, Command **cmd_ptr,
+                              Process **proc_ptr, Arena *arena);
+
+/**
+ * @brief Frees all templates. The counters are kept.
+ *
+ * @param cache The cache to clear.
+ */
+void pipeline_cache_clear(PipelineCache *cache);
+
+#endif
@@ -50,18 +50,24 @@ int setup_exec_resource(Job *job, JobResource *job_res);
 int create_pipes(Job *job, JobResource *job_res);
 
 /**
- * @brief Forks and sets up child and parent processes for a job.
+ * @brief Starts the processes of a job and sets up the parent side.
  *
- * This function forks and sets up child and parent processes for a job,
- * including setting up the process group ID and signal handling.
+ * The redirections and pipe ends of each stage are computed as an action
+ * list and handed to the current spawn backend; see spawn_backend.h.
+ * Builtin stages that only report shell state run in the shell itself and
+ * are complete on return; other builtin stages are forked but not exec'd.
  *
  * @param job The job to fork and set up processes for.
  * @param job_res The JobResource struct containing the pipes.
- * @param pgid The process group ID of the job.
+ * @param pgid The process group ID of the job; stays 0 if no child was
+ *             started.
  * @param prev_mask The previous signal mask.
+ * @param envp The environment of the children.
+ * @param job_head The head of the job list, for builtin stages.
  * @return 0 on success, -1 on failure.
  */
 int fork_and_setup_processes(Job *job, JobResource job_res, int *pgid,
-                             sigset_t *prev_mask, char **envp);
+                             sigset_t *prev_mask, char **envp,
+                             Job **job_head);
 
 #endif
\ No newline at end of file
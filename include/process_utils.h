@@ -22,6 +22,10 @@
 typedef struct Process {
   struct Process *next;
   Command *cmd;
+  const char *path; /**< The resolved executable, NULL if not found. */
+  int builtin;      /**< Index in builtin_commands, -1 if external. */
+  const struct ResourceSettings *resources; /**< Set by ulimit, nice or
+                                                 affinity prefixes. */
   pid_t pid;
   int completed;
   int stopped;
@@ -29,18 +33,31 @@ typedef struct Process {
 } Process;
 
 /**
- * @brief Initializes a new process.
+ * @brief Builds the process list of a pipeline.
  *
- * This function creates a new process and initializes its fields.
+ * The tokens are walked once; each stage is parsed and appended to the list
+ * through a tail pointer. Variables are not expanded yet, so the list can be
+ * stored in the pipeline cache first; see expand_processes().
  *
+ * @param line          The line buffer the tokens point into.
  * @param tokens        Array of tokens representing the command to execute.
  * @param num_tokens    Number of tokens in the tokens array.
- * @param cmd_ptr       Pointer to the command structure.
+ * @param cmd_ptr       Receives the command of the last stage.
  * @param proc_ptr      Pointer to the process structure.
+ * @param arena         The arena processes and commands are allocated in.
  *
  * @return A pointer to the head of the process list.
  */
-Process *initalize_processes(char *tokens[], size_t num_tokens,
-                             Command **cmd_ptr, Process **proc_ptr);
+Process *initalize_processes(char *line, const Token tokens[],
+                             size_t num_tokens, Command **cmd_ptr,
+                             Process **proc_ptr, Arena *arena);
+
+/**
+ * @brief Expands the variables in the commands of a process list.
+ *
+ * @param proc_head The head of the process list.
+ * @param arena The arena expanded words are allocated in.
+ */
+void expand_processes(Process *proc_head, Arena *arena);
 
 #endif
\ No newline at end of file
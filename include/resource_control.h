@@ -0,0 +1,108 @@
+/**
+ * @file resource_control.h
+ * @brief Resource settings of children: rlimits, niceness and CPU affinity.
+ *         The ulimit, nice and affinity builtins set shell-wide defaults or,
+ *         as command prefixes, settings for one command; the child applies
+ *         them itself just before exec, so no wrapper process is started.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef RESOURCE_CONTROL_H
+#define RESOURCE_CONTROL_H
+
+/* cpu_set_t needs _GNU_SOURCE before the first system header. */
+#include <sched.h>
+#include <stddef.h>
+#include <sys/resource.h>
+
+/**
+ * @def RESOURCE_LIMITS_MAX
+ * @brief The most limits one settings record holds; one per resource
+ *        ulimit knows.
+ */
+#define RESOURCE_LIMITS_MAX 10
+
+/**
+ * @struct ResourceLimit
+ * @brief A new soft and/or hard limit for one resource.
+ */
+typedef struct {
+  int resource; /**< RLIMIT_*. */
+  int set_soft;
+  int set_hard;
+  rlim_t soft;
+  rlim_t hard;
+} ResourceLimit;
+
+/**
+ * @struct ResourceSettings
+ * @brief What a child changes about itself before exec.
+ */
+typedef struct ResourceSettings {
+  int set_nice;
+  int nice; /**< Added to the niceness the child inherits. */
+  int set_affinity;
+  cpu_set_t affinity;
+  size_t num_limits;
+  ResourceLimit limits[RESOURCE_LIMITS_MAX];
+} ResourceSettings;
+
+/**
+ * @var resource_defaults
+ * @brief The settings every child gets unless its command says otherwise.
+ */
+extern ResourceSettings resource_defaults;
+
+/**
+ * @brief Records a limit, replacing the parts of an earlier one for the
+ *        same resource that it sets.
+ *
+ * @param settings The settings to change.
+ * @param limit The limit.
+ */
+void set_resource_limit(ResourceSettings *settings, const ResourceLimit *limit);
+
+/**
+ * @brief Combines the shell-wide defaults with a command's own settings,
+ *        which take precedence.
+ *
+ * @param out Receives the combination.
+ * @param own The command's settings, or NULL.
+ * @return 1 if the child has anything to change, 0 otherwise.
+ */
+int merge_resources(ResourceSettings *out, const ResourceSettings *own);
+
+/**
+ * @brief Applies settings to the calling process.
+ *
+ * Only async-signal-safe calls are made, so it may run in a vfork child.
+ * A niceness that cannot be set is not an error, as with nice(1).
+ *
+ * @param settings The settings.
+ * @return NULL on success, otherwise a description of what failed, with
+ *         errno set.
+ */
+const char *apply_resources(const ResourceSettings *settings);
+
+/**
+ * @brief Parses a CPU list such as "0-3,8".
+ *
+ * "all" is every CPU the shell may run on.
+ *
+ * @param list The list.
+ * @param set Receives the CPUs.
+ * @return 0 on success, -1 if the list is malformed or empty.
+ */
+int parse_cpu_list(const char *list, cpu_set_t *set);
+
+/**
+ * @brief Formats a CPU set as a list such as "0-3,8".
+ *
+ * @param set The CPUs.
+ * @param buf Receives the list.
+ * @param size The size of @p buf.
+ */
+void format_cpu_list(const cpu_set_t *set, char *buf, size_t size);
+
+#endif
@@ -16,6 +16,35 @@
 #ifndef SHELL_H
 #define SHELL_H
 
-int shell(void);
+#include "arena.h"
+#include "pipeline_cache.h"
+
+/**
+ * @var line_arena
+ * @brief Holds everything built for the current command line.
+ *
+ * It is reset before each prompt; jobs that outlive their command line are
+ * copied out of it by persist_job().
+ */
+extern Arena line_arena;
+
+/**
+ * @var pipeline_cache
+ * @brief Parsed pipelines of recently run command lines.
+ */
+extern PipelineCache pipeline_cache;
+
+/**
+ * @brief Runs the shell.
+ *
+ * With `-c string` the shell runs the string, with a file name it runs the
+ * file, and otherwise it reads commands from the terminal. The last command
+ * of a string or file replaces the shell when nothing is left to wait for.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments, as passed to main().
+ * @return The exit status of the shell.
+ */
+int shell(int argc, char *argv[]);
 
 #endif
\ No newline at end of file
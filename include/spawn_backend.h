@@ -0,0 +1,98 @@
+/**
+ * @file spawn_backend.h
+ * @brief Starting the processes of a pipeline with fork(), posix_spawn() or
+ *         clone(CLONE_VM | CLONE_VFORK). The child's setup is computed in the
+ *         parent as an action list, so every backend performs the same steps.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef SPAWN_BACKEND_H
+#define SPAWN_BACKEND_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "io_redirection.h"
+
+/**
+ * @enum SpawnBackend
+ * @brief How children are started.
+ */
+typedef enum {
+  SPAWN_FORK,        /**< fork(), then set up and exec in the child. */
+  SPAWN_POSIX_SPAWN, /**< posix_spawn() with file actions and attributes. */
+  SPAWN_VFORK,       /**< clone(CLONE_VM | CLONE_VFORK) on a private stack. */
+  SPAWN_ZYGOTE       /**< A warm child of the zygote pool; see zygote.h. */
+} SpawnBackend;
+
+/**
+ * @var spawn_backend
+ * @brief The backend used to start children. Defaults to SPAWN_POSIX_SPAWN.
+ */
+extern SpawnBackend spawn_backend;
+
+/**
+ * @struct SpawnPlan
+ * @brief Everything a child needs, prepared by the parent.
+ */
+typedef struct {
+  const char *path;            /**< The executable, NULL if not found. */
+  char **argv;
+  char **envp;
+  pid_t pgid;                  /**< The group to join, 0 for a new one and
+                                    -1 to stay in the current one. */
+  int foreground;              /**< Take the terminal before exec. */
+  const sigset_t *mask;        /**< The signal mask to exec with. */
+  const ChildAction *actions;
+  size_t num_actions;
+  const struct ResourceSettings *resources; /**< Applied before exec when
+                                                 set; see resource_control.h */
+  int (*run)(void *arg);       /**< Called instead of exec when set; its
+                                    result is the exit status. */
+  void *arg;
+} SpawnPlan;
+
+/**
+ * @brief Starts a child with the current backend.
+ *
+ * A child that cannot be set up or exec'd reports the error on stderr and
+ * exits with 127 for a missing command, 126 if execve() fails and 1 if the
+ * setup fails. posix_spawn() reports such failures to the parent instead, so
+ * those stages are started again with fork() to keep that behavior. A plan
+ * with a run function is always forked, since the function needs its own
+ * copy of the shell.
+ *
+ * @param plan The child's setup.
+ * @return The pid of the child, or -1 if no child could be created.
+ */
+pid_t spawn_process(const SpawnPlan *plan);
+
+/**
+ * @brief Sets up and execs a child according to a plan; never returns.
+ *
+ * Only async-signal-safe calls are made before execve().
+ *
+ * @param plan The child's setup.
+ */
+void exec_child(const SpawnPlan *plan);
+
+/**
+ * @brief Selects a backend by name: "fork", "posix_spawn", "vfork" or
+ * "zygote".
+ *
+ * @param name The name of the backend.
+ * @return 0 on success, -1 for an unknown name.
+ */
+int set_spawn_backend(const char *name);
+
+/**
+ * @brief Returns the name of a backend.
+ *
+ * @param backend The backend.
+ * @return The name accepted by set_spawn_backend().
+ */
+const char *spawn_backend_name(SpawnBackend backend);
+
+#endif
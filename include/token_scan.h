@@ -0,0 +1,75 @@
+/**
+ * @file token_scan.h
+ * @brief Delimiter scanning used by the tokenizer. Finds the next byte that
+ * ends a run of plain word characters, using SSE2 or AVX2 when the CPU
+ * supports them.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef TOKEN_SCAN_H
+#define TOKEN_SCAN_H
+
+#include <stddef.h>
+
+/**
+ * @enum ScanKernel
+ * @brief The implementations of scan_delimiter().
+ */
+typedef enum { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 } ScanKernel;
+
+/**
+ * @brief Checks whether a byte ends a run of plain word characters.
+ *
+ * Delimiters are whitespace, quotes, backslash, the operators > < & | and
+ * the NUL byte.
+ *
+ * @param c The byte to check.
+ * @return 1 if the byte is a delimiter, 0 otherwise.
+ */
+int is_scan_delimiter(unsigned char c);
+
+/**
+ * @brief Finds the first delimiter in a buffer.
+ *
+ * @param s The buffer to scan.
+ * @param len The number of bytes that may be read from s.
+ * @return The index of the first delimiter, or len if there is none.
+ */
+size_t scan_delimiter(const char *s, size_t len);
+
+/**
+ * @brief The individual kernels behind scan_delimiter().
+ *
+ * The SIMD kernels must only be called when token_scan_supported() reports
+ * them as available.
+ */
+size_t scan_delimiter_scalar(const char *s, size_t len);
+size_t scan_delimiter_sse2(const char *s, size_t len);
+size_t scan_delimiter_avx2(const char *s, size_t len);
+
+/**
+ * @brief Checks whether a kernel can run on this CPU.
+ *
+ * @param kernel The kernel to check.
+ * @return 1 if supported, 0 otherwise.
+ */
+int token_scan_supported(ScanKernel kernel);
+
+/**
+ * @brief Forces scan_delimiter() to use a given kernel.
+ *
+ * The best supported kernel is picked on first use; this is meant for tests
+ * and benchmarks.
+ *
+ * @param kernel The kernel to use.
+ * @return 0 on success, -1 if the kernel is not supported.
+ */
+int token_scan_select(ScanKernel kernel);
+
+/**
+ * @brief Returns the kernel currently used by scan_delimiter().
+ */
+ScanKernel token_scan_kernel(void);
+
+#endif
@@ -10,64 +10,190 @@
 #define TOKENIZER_H
 
 #include <stddef.h>
+#include <sys/types.h>
 
 /**
- * @def MAXTOKENS
- * @brief The maximum number of tokens that can be stored in the tokens array.
+ * @def SPECIALCHARLEN
+ * @brief The number of special characters recognized by the tokenizer.
  */
-#define MAXTOKENS 1000
+#define SPECIALCHARLEN 4
 
 /**
- * @def MAXLEN
- * @brief The maximum length of a single token.
+ * @def EXPANSION_MARK
+ * @brief Stands in word text for a `$` that starts an expansion.
+ *
+ * Quotes are gone once a word is tokenized, so a `$` that was unquoted or
+ * inside double quotes is replaced by this byte; a `$` that was single
+ * quoted or escaped stays as it is. The expander turns marks back into
+ * variable values or a literal `$`.
  */
-#define MAXLEN 100
+#define EXPANSION_MARK '\001'
 
 /**
- * @def SPECIALCHARLEN
- * @brief The number of special characters recognized by the tokenizer.
+ * @enum TokenKind
+ * @brief The kind of a token produced by the tokenizer.
+ *
+ * Words carry their text in the line buffer. Operators are identified by
+ * their kind alone; use token_text() to get their spelling.
  */
-#define SPECIALCHARLEN 4
+typedef enum {
+  TOKEN_WORD,
+  TOKEN_PIPE,         /**< | */
+  TOKEN_OR,           /**< || */
+  TOKEN_BACKGROUND,   /**< & */
+  TOKEN_AND,          /**< && */
+  TOKEN_REDIR_IN,     /**< < */
+  TOKEN_HEREDOC,      /**< << */
+  TOKEN_REDIR_OUT,    /**< > */
+  TOKEN_REDIR_APPEND  /**< >> */
+} TokenKind;
+
+/**
+ * @struct Token
+ * @brief A slice of the line buffer.
+ *
+ * For words, the text starts at line + offset, is length bytes long and is
+ * NUL-terminated in place once tokenize_line() returns. Quotes and escapes
+ * have already been removed, and expansions are marked with EXPANSION_MARK.
+ */
+typedef struct {
+  size_t offset;
+  size_t length;
+  TokenKind kind;
+} Token;
+
+/**
+ * @struct TokenVector
+ * @brief A growable array of tokens.
+ *
+ * The storage is kept between calls to tokenize_line() so that a long-lived
+ * vector stops allocating once it has grown to the size of the typical line.
+ */
+typedef struct {
+  Token *items;
+  size_t count;
+  size_t capacity;
+} TokenVector;
+
+/**
+ * @enum LexState
+ * @brief Where the lexer stopped when it ran out of input.
+ */
+typedef enum {
+  LEX_START,        /**< Between tokens. */
+  LEX_WORD,         /**< Inside an unquoted part of a word. */
+  LEX_SINGLE_QUOTE, /**< Inside '...'. */
+  LEX_DOUBLE_QUOTE  /**< Inside "...". */
+} LexState;
+
+/**
+ * @def LEX_COMPLETE
+ * @brief lexer_feed() result: the command is complete.
+ */
+#define LEX_COMPLETE 0
+
+/**
+ * @def LEX_INCOMPLETE
+ * @brief lexer_feed() result: the command continues on the next line.
+ */
+#define LEX_INCOMPLETE 1
+
+/**
+ * @struct Lexer
+ * @brief Resumable tokenizer state.
+ *
+ * Positions are offsets, not pointers, so the line buffer may be reallocated
+ * between lexer_feed() calls while continuation lines are appended to it.
+ */
+typedef struct {
+  size_t read;       /**< Offset of the next byte to lex. */
+  size_t write;      /**< Offset where the current word's next byte goes. */
+  size_t word_start; /**< Offset of the current word. */
+  LexState state;
+} Lexer;
 
 /**
  * @brief Reads a line of input from the user and stores it in the provided
  * buffer.
  *
+ * @param prompt The prompt to print.
  * @param line_buffer A pointer to a pointer to store the input line.
  * @param read A pointer to an ssize_t to store the number of characters read.
  * @param buffsize A pointer to a size_t to store the size of the buffer.
  * @return 0 on success, -1 on failure.
  */
-int prompt_and_read(char **line_buffer, ssize_t *read, size_t *buffsize);
+int prompt_and_read(const char *prompt, char **line_buffer, ssize_t *read,
+                    size_t *buffsize);
+
+/**
+ * @brief Returns the text of a token.
+ *
+ * @param line The line buffer the token was produced from.
+ * @param tok The token.
+ * @return A pointer into the line for words, or a static string for
+ * operators.
+ */
+const char *token_text(const char *line, const Token *tok);
 
 /**
- * @brief Prints the tokens in the provided array.
+ * @brief Prints the tokens in the provided vector.
  *
- * @param tokens An array of tokens to print.
- * @param token_num The number of tokens in the array.
+ * @param line The line buffer the tokens were produced from.
+ * @param tokens The tokens to print.
  */
-void print_tokens(char *tokens[], int token_num);
+void print_tokens(const char *line, const TokenVector *tokens);
 
 /**
- * @brief Tokenizes a line of input into an array of tokens.
+ * @brief Tokenizes a line of input in place.
+ *
+ * Any previous contents of the vector are discarded. The line is modified:
+ * quotes and escapes are removed and every word is NUL-terminated.
  *
  * @param line The line of input to tokenize.
- * @param tokens An array to store the tokens.
- * @param max_tokens The maximum number of tokens that can be stored in the
- * array.
- * @param max_len The maximum length of a single token.
- * @param token_num A pointer to an int to store the number of tokens found.
+ * @param tokens The vector that receives the tokens.
  * @return 0 on success, -1 on failure.
  */
-int tokenize_line(char *line, char *tokens[], int max_tokens, int max_len,
-                  int *token_num);
+int tokenize_line(char *line, TokenVector *tokens);
+
+/**
+ * @brief Starts lexing a new command.
+ *
+ * @param lexer The lexer to reset.
+ * @param tokens The vector that will receive the tokens; it is cleared.
+ */
+void lexer_reset(Lexer *lexer, TokenVector *tokens);
+
+/**
+ * @brief Lexes the input that arrived since the previous call.
+ *
+ * The line buffer holds everything fed so far; only the bytes from the
+ * lexer's read offset up to len are looked at. A command is incomplete when
+ * it ends inside quotes, with a backslash-newline, or with a trailing `|`.
+ * The caller then appends the next line and calls again.
+ *
+ * @param lexer The lexer state.
+ * @param line The line buffer, NUL-terminated at len.
+ * @param len The length of the line buffer.
+ * @param tokens The vector that receives the tokens.
+ * @return LEX_COMPLETE, LEX_INCOMPLETE, or -1 on failure.
+ */
+int lexer_feed(Lexer *lexer, char *line, size_t len, TokenVector *tokens);
+
+/**
+ * @brief Ends an incomplete command because no more input will arrive.
+ *
+ * @param lexer The lexer state.
+ * @param line The line buffer.
+ * @param tokens The vector holding the tokens.
+ * @return 0 if the tokens can be used as they are, -1 on unmatched quotes.
+ */
+int lexer_finish(Lexer *lexer, char *line, TokenVector *tokens);
 
 /**
- * @brief Frees the memory allocated for the tokens in the provided array.
+ * @brief Frees the storage owned by a token vector.
  *
- * @param tokens An array of tokens to free.
- * @param token_num The number of tokens in the array.
+ * @param tokens The vector to free.
  */
-void free_memory(char *tokens[], int token_num);
+void free_memory(TokenVector *tokens);
 
-#endif
\ No newline at end of file
+#endif
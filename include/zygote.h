@@ -0,0 +1,61 @@
+/**
+ * @file zygote.h
+ * @brief Opt-in pool of pre-forked children. A small helper process, forked
+ *         while the shell is still small, keeps warm children waiting on a
+ *         Unix socket; the shell sends each one a spawn plan with its file
+ *         descriptors and the child execs it.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <sys/types.h>
+
+#include "spawn_backend.h"
+
+/**
+ * @def ZYGOTE_WARM
+ * @brief The number of children kept waiting for a command.
+ */
+#define ZYGOTE_WARM 4
+
+/**
+ * @def ZYGOTE_MAX_MESSAGE
+ * @brief The largest spawn request; bigger plans are forked by the shell.
+ */
+#define ZYGOTE_MAX_MESSAGE (64 * 1024)
+
+/**
+ * @brief Starts the helper process unless it is running.
+ *
+ * Warm children are created with CLONE_PARENT, so they are children of the
+ * shell: setpgid(), waitpid() and terminal handoff work as for fork().
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int zygote_start(void);
+
+/**
+ * @brief Tells whether the helper process is running.
+ *
+ * @return 1 if it is running, 0 otherwise.
+ */
+int zygote_running(void);
+
+/**
+ * @brief Starts a child from the pool.
+ *
+ * @param plan The child's setup.
+ * @return The pid of the child, or -1 if the pool could not take the plan;
+ *         the caller then starts the child itself.
+ */
+pid_t zygote_spawn(const SpawnPlan *plan);
+
+/**
+ * @brief Stops the helper process; the warm children exit on their own.
+ */
+void zygote_stop(void);
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @file pathname.c
+ * @brief Example builtin plugin: basename and dirname, which scripts call
+ *         in loops. Build with `make plugins` and load with
+ *         `enable -f build/plugins/pathname.so`.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "builtin.h"
+
+int yega_register_builtins(int api_version,
+                           int (*add)(const Builtin *builtin));
+
+/* The length of path without its trailing slashes, at least 1 if path is
+ * not empty. */
+static size_t trimmed_length(const char *path) {
+  size_t len = strlen(path);
+  while (len > 1 && path[len - 1] == '/')
+    len--;
+  return len;
+}
+
+static int basename_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+
+  if (!argv[1] || (argv[2] && argv[3])) {
+    fprintf(stderr, "basename: usage: basename name [suffix]\n");
+    return 2;
+  }
+  const char *path = argv[1];
+  size_t len = trimmed_length(path);
+  size_t start = len;
+  while (start > 0 && path[start - 1] != '/')
+    start--;
+  if (start == len && len > 0) // the path is "/"
+    start--;
+
+  const char *suffix = argv[2];
+  size_t suffix_len = suffix ? strlen(suffix) : 0;
+  if (suffix_len && suffix_len < len - start &&
+      memcmp(path + len - suffix_len, suffix, suffix_len) == 0)
+    len -= suffix_len;
+
+  dprintf(STDOUT_FILENO, "%.*s\n", (int)(len - start), path + start);
+  return 0;
+}
+
+static int dirname_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+
+  if (!argv[1] || argv[2]) {
+    fprintf(stderr, "dirname: usage: dirname name\n");
+    return 2;
+  }
+  const char *path = argv[1];
+  size_t len = trimmed_length(path);
+  while (len > 0 && path[len - 1] != '/')
+    len--;
+  while (len > 1 && path[len - 1] == '/')
+    len--;
+
+  if (len == 0)
+    dprintf(STDOUT_FILENO, ".\n");
+  else
+    dprintf(STDOUT_FILENO, "%.*s\n", (int)len, path);
+  return 0;
+}
+
+int yega_register_builtins(int api_version,
+                           int (*add)(const Builtin *builtin)) {
+  static const Builtin builtins[] = {{"basename", basename_func, 1},
+                                     {"dirname", dirname_func, 1}};
+
+  if (api_version != BUILTIN_API_VERSION)
+    return -1;
+  for (size_t i = 0; i < sizeof builtins / sizeof *builtins; i++) {
+    if (add(&builtins[i]) < 0)
+      return -1;
+  }
+  return 0;
+}
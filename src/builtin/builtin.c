@@ -7,6 +7,7 @@
 
 #define _POSIX_C_SOURCE 200809L
 
+#include <limits.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,34 +16,72 @@
 #include <unistd.h>
 
 #include "builtin.h"
+#include "command_table.h"
 #include "env_utils.h"
 #include "executor.h"
+#include "job_capture.h"
+#include "jobserver.h"
+#include "parallel.h"
 #include "process_utils.h"
+#include "shell.h"
 #include "signal_utils.h"
-
-Builtin builtin_commands[] = {{"cd", cd_func},         {"help", help_func},
-                              {"exit", exit_func},     {"pwd", pwd_func},
-                              {"export", export_func}, {"unset", unset_func},
-                              {"fg", fg_func},         {"bg", bg_func},
-                              {"jobs", jobs_func},     {NULL, NULL}};
+#include "spawn_backend.h"
+#include "zygote.h"
+
+Builtin builtin_commands[BUILTIN_MAX] = {{"cd", cd_func, 0},
+                              {"help", help_func, 1},
+                              {"exit", exit_func, 0},
+                              {"pwd", pwd_func, 1},
+                              {"export", export_func, 0},
+                              {"unset", unset_func, 0},
+                              {"fg", fg_func, 0},
+                              {"bg", bg_func, 0},
+                              {"jobs", jobs_func, 1},
+                              {"memstats", memstats_func, 1},
+                              {"pcache", pcache_func, 0},
+                              {"hash", hash_func, 0},
+                              {"type", type_func, 1},
+                              {"spawn", spawn_func, 0},
+                              {"echo", echo_func, 1},
+                              {"printf", printf_func, 1},
+                              {"test", test_func, 1},
+                              {"[", test_func, 1},
+                              {"true", true_func, 1},
+                              {"false", false_func, 1},
+                              {"sleep", sleep_func, BUILTIN_BLOCKING},
+                              {"cat", cat_func, BUILTIN_BLOCKING},
+                              {"enable", enable_func, 0},
+                              {"ulimit", ulimit_func, 0},
+                              {"nice", nice_func, 0},
+                              {"affinity", affinity_func, 0},
+                              {"jobserver", jobserver_func, 0},
+                              {"parallel", parallel_func, 0},
+                              {"joblog", joblog_func, 1},
+                              {NULL, NULL, 0}};
 
 int jobs_func(Process *proc, Job **job_head) {
-  mark_bg_jobs(job_head, pending_bg_jobs, pending_indx);
+  mark_bg_jobs();
   (void)proc;
   Job *j = *job_head;
   Job *next = NULL;
   while (j) {
     next = j->next;
+    /* In `jobs | grep x` the pipeline itself is in the list, and it is the
+     * only job still in the line arena. */
+    if (j->arena) {
+      j = next;
+      continue;
+    }
     if (job_is_completed(j)) {
       // it should be freed by now!
-      format_job_info(j, "Done");
+      format_job_info(STDOUT_FILENO, j, "Done");
       free_job(j, job_head);
       j = next;
       continue;
     }
 
     char *status = job_is_stopped(j) ? "Stopped" : "Running";
-    format_job_info(j, status);
+    format_job_info(STDOUT_FILENO, j, status);
     j = next;
   }
 
@@ -53,7 +92,7 @@ int fg_func(Process *proc, Job **job_head) {
 
   /********** I AM NOT SURE ABOUT THIS PART *********************/
   // Step -1: drain all background jobs and mark them before running the fg job
-  mark_bg_jobs(job_head, pending_bg_jobs, pending_indx);
+  mark_bg_jobs();
   // notify_bg_jobs(job_head);
   /**************************************************************/
 
@@ -84,8 +123,8 @@ int fg_func(Process *proc, Job **job_head) {
     // clear the stopped member for each process
     clear_stopped_mark(found_job);
     // show the command
-    printf("%s\n", found_job->command);
-    if (kill(-found_job->pgid, SIGCONT) < 0) {
+    dprintf(STDOUT_FILENO, "%s\n", found_job->command);
+    if (signal_job(found_job, SIGCONT) < 0) {
       perror("fg");
       sigprocmask(SIG_SETMASK, &prev_mask, NULL);
       return 1;
@@ -101,7 +140,7 @@ int bg_func(Process *proc, Job **job_head) {
 
   /********** I AM NOT SURE ABOUT THIS PART *********************/
   // Step -1: drain all background jobs and mark them before running the bg job
-  mark_bg_jobs(job_head, pending_bg_jobs, pending_indx);
+  mark_bg_jobs();
   // notify_bg_jobs(job_head);
   /**************************************************************/
 
@@ -133,8 +172,8 @@ int bg_func(Process *proc, Job **job_head) {
     // clear the stopped member for each process
     clear_stopped_mark(found_job);
     // show the command
-    printf("%s &\n", found_job->command);
-    if (kill(-found_job->pgid, SIGCONT) < 0) {
+    dprintf(STDOUT_FILENO, "%s &\n", found_job->command);
+    if (signal_job(found_job, SIGCONT) < 0) {
       perror("bg");
       sigprocmask(SIG_SETMASK, &prev_mask, NULL);
       return 1;
@@ -152,11 +191,12 @@ int cd_func(Process *proc, Job **job_head) {
   Command *cmd = proc->cmd;
 
   if (cmd->argv[1] == NULL || strcmp(cmd->argv[1], "~") == 0) {
-    path = getenv("HOME");
-    if (path == NULL) {
+    Variable *home = lookup("HOME");
+    if (home == NULL) {
       fprintf(stderr, "cd: HOME not set\n");
       return 1;
     }
+    path = home->value;
   } else
     path = cmd->argv[1];
 
@@ -170,9 +210,10 @@ int cd_func(Process *proc, Job **job_head) {
 int help_func(Process *proc, Job **job_head) {
   (void)proc;
   (void)job_head;
-  printf("Yega Shell\n");
-  printf("Type the name of the command, and hit enter.\n");
-  printf("Use the man command for information on other programs.\n");
+  dprintf(STDOUT_FILENO, "Yega Shell\n");
+  dprintf(STDOUT_FILENO, "Type the name of the command, and hit enter.\n");
+  dprintf(STDOUT_FILENO,
+          "Use the man command for information on other programs.\n");
 
   return 0;
 }
@@ -191,7 +232,7 @@ int pwd_func(Process *proc, Job **job_head) {
   (void)job_head;
   char *cwd = getcwd(NULL, 0);
   if (cwd) {
-    printf("%s\n", cwd);
+    dprintf(STDOUT_FILENO, "%s\n", cwd);
     free(cwd);
     return 0;
   } else {
@@ -241,4 +282,195 @@ int unset_func(Process *proc, Job **job_head) {
     return 1;
   }
   return 0;
-}
\ No newline at end of file
+}
+
+int memstats_func(Process *proc, Job **job_head) {
+  (void)proc;
+  (void)job_head;
+  ArenaStats *last = &line_arena.last;
+  ArenaStats *total = &line_arena.total;
+
+  dprintf(STDOUT_FILENO,
+          "last command: %zu allocations, %zu malloc calls, %zu bytes\n",
+          last->allocations, last->mallocs, last->bytes);
+  dprintf(STDOUT_FILENO,
+          "all commands: %zu allocations, %zu malloc calls, %zu bytes\n",
+          total->allocations, total->mallocs, total->bytes);
+  return 0;
+}
+
+int pcache_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  Command *cmd = proc->cmd;
+
+  if (cmd->argv[1] && strcmp(cmd->argv[1], "-c") == 0) {
+    pipeline_cache_clear(&pipeline_cache);
+    return 0;
+  } else if (cmd->argv[1]) {
+    fprintf(stderr, "pcache: usage: pcache [-c]\n");
+    return 1;
+  }
+
+  dprintf(STDOUT_FILENO,
+          "pipeline cache: %zu hits, %zu misses, %zu/%zu entries\n",
+          pipeline_cache.hits, pipeline_cache.misses, pipeline_cache.count,
+          pipeline_cache.capacity);
+  return 0;
+}
+
+int hash_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  int status = 0;
+
+  if (argv[1] && strcmp(argv[1], "-r") == 0) {
+    command_table_forget();
+    return 0;
+  }
+
+  if (argv[1]) {
+    for (int i = 1; argv[i]; i++) {
+      const CommandEntry *entry = find_command(argv[i]);
+      if (!entry || entry->kind == COMMAND_NOT_FOUND ||
+          entry->kind == COMMAND_DENIED) {
+        fprintf(stderr, "hash: %s: not found\n", argv[i]);
+        status = 1;
+      }
+    }
+    return status;
+  }
+
+  dprintf(STDOUT_FILENO, "hits\tcommand\n");
+  for (size_t i = 0; i < COMMAND_TABLE_BUCKETS; i++) {
+    for (CommandEntry *e = command_table.buckets[i]; e; e = e->next) {
+      if (e->kind == COMMAND_FILE)
+        dprintf(STDOUT_FILENO, "%4zu\t%s\n", e->hits, e->path);
+    }
+  }
+  dprintf(STDOUT_FILENO, "command table: %zu hits, %zu misses, %zu entries\n",
+          command_table.hits, command_table.misses, command_table.count);
+  return 0;
+}
+
+int type_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  int status = 0;
+
+  for (int i = 1; argv[i]; i++) {
+    size_t misses = command_table.misses;
+    const CommandEntry *entry = find_command(argv[i]);
+
+    if (!entry || entry->kind == COMMAND_NOT_FOUND ||
+        entry->kind == COMMAND_DENIED) {
+      fprintf(stderr, "type: %s: not found\n", argv[i]);
+      status = 1;
+    } else if (entry->kind == COMMAND_BUILTIN) {
+      dprintf(STDOUT_FILENO, "%s is a shell builtin\n", argv[i]);
+    } else if (command_table.misses == misses && !strchr(argv[i], '/')) {
+      dprintf(STDOUT_FILENO, "%s is hashed (%s)\n", argv[i], entry->path);
+    } else {
+      dprintf(STDOUT_FILENO, "%s is %s\n", argv[i], entry->path);
+    }
+  }
+  return status;
+}
+
+int spawn_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+
+  if (!argv[1]) {
+    dprintf(STDOUT_FILENO, "spawn backend: %s\n",
+            spawn_backend_name(spawn_backend));
+    return 0;
+  }
+  if (argv[2] || set_spawn_backend(argv[1]) < 0) {
+    fprintf(stderr, "spawn: usage: spawn [fork|posix_spawn|vfork|zygote]\n");
+    return 1;
+  }
+  if (spawn_backend == SPAWN_ZYGOTE && zygote_start() < 0)
+    return 1;
+  return 0;
+}
+
+int jobserver_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  char *end;
+
+  if (!argv[1]) {
+    if (jobserver_active())
+      dprintf(STDOUT_FILENO, "jobserver: %d tokens, %d free\n",
+              jobserver.tokens, jobserver_free_tokens());
+    else
+      dprintf(STDOUT_FILENO, "jobserver: off\n");
+    return 0;
+  }
+  if (!argv[2] && strcmp(argv[1], "off") == 0) {
+    jobserver_stop();
+    return 0;
+  }
+
+  long tokens = strtol(argv[1], &end, 10);
+  if (argv[2] || end == argv[1] || *end || tokens < 1 ||
+      tokens > JOBSERVER_MAX) {
+    fprintf(stderr, "jobserver: usage: jobserver [off|1-%d]\n",
+            JOBSERVER_MAX);
+    return 2;
+  }
+  if (jobserver_start((int)tokens) < 0) {
+    perror("jobserver");
+    return 1;
+  }
+  return 0;
+}
+
+int parallel_func(Process *proc, Job **job_head) {
+  ParallelRun run;
+  int status = parallel_parse(&run, proc->cmd->argv) < 0
+                   ? 2
+                   : parallel_run(&run, job_head);
+
+  parallel_free(&run);
+  return status;
+}
+
+int joblog_func(Process *proc, Job **job_head) {
+  char **argv = proc->cmd->argv;
+  long num = 0;
+
+  if (argv[1] && argv[2]) {
+    fprintf(stderr, "joblog: usage: joblog [%%job]\n");
+    return 2;
+  }
+  if (!argv[1]) {
+    // the job fg would take, else the one that ended last
+    Job *j = *job_head ? (*job_head)->prev : NULL;
+    while (j && j->arena)
+      j = j == *job_head ? NULL : j->prev;
+    num = j && j->capture ? j->job_num : capture_last_finished();
+  } else {
+    const char *arg = argv[1][0] == '%' ? argv[1] + 1 : argv[1];
+    char *end;
+    num = strtol(arg, &end, 10);
+    if (end == arg || *end || num <= 0 || num > INT_MAX) {
+      fprintf(stderr, "joblog: usage: joblog [%%job]\n");
+      return 2;
+    }
+  }
+
+  JobCapture *capture = num ? capture_find((int)num) : NULL;
+  if (!capture) {
+    fprintf(stderr, "joblog: %s: no captured output\n",
+            argv[1] ? argv[1] : "current job");
+    return 1;
+  }
+  // take what is waiting in the pipe first
+  capture_drain(capture, -1, CAPTURE_PIPE_SIZE);
+  if (capture_replay(capture, STDOUT_FILENO) < 0) {
+    perror("joblog");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file plugin.c
+ * @brief The enable builtin: loads builtins from shared objects and appends
+ *         them to builtin_commands, so they are dispatched like the others.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "command_table.h"
+
+/* What the plugin being loaded registered. */
+static Builtin offered[BUILTIN_MAX];
+static int num_offered;
+
+static int offer_builtin(const Builtin *builtin);
+static int builtin_count(void);
+static int add_builtin(const Builtin *builtin);
+static int load_builtins(const char *file, char **names);
+
+static int offer_builtin(const Builtin *builtin) {
+  if (num_offered == BUILTIN_MAX || !builtin->name || !builtin->func)
+    return -1;
+  offered[num_offered++] = *builtin;
+  return 0;
+}
+
+static int builtin_count(void) {
+  int n = 0;
+  while (builtin_commands[n].name)
+    n++;
+  return n;
+}
+
+/* Appends a builtin, keeping the entry that ends the array. One with the
+ * name of a builtin replaces it in its slot, so loading a plugin again
+ * neither lists its builtins twice nor uses up slots. */
+static int add_builtin(const Builtin *builtin) {
+  int n = builtin_count();
+
+  for (int i = 0; i < n; i++) {
+    if (strcmp(builtin_commands[i].name, builtin->name) == 0) {
+      builtin_commands[i] = *builtin;
+      return 0;
+    }
+  }
+  if (n == BUILTIN_MAX - 1) {
+    fprintf(stderr, "enable: %s: too many builtins\n", builtin->name);
+    return -1;
+  }
+  if (command_table_add_builtin(builtin->name, n) < 0)
+    return -1;
+  builtin_commands[n] = *builtin;
+  return 0;
+}
+
+static int load_builtins(const char *file, char **names) {
+  void *handle = dlopen(file, RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    fprintf(stderr, "enable: %s\n", dlerror());
+    return 1;
+  }
+
+  BuiltinRegister reg;
+  *(void **)&reg = dlsym(handle, BUILTIN_REGISTER_SYMBOL);
+  if (!reg) {
+    fprintf(stderr, "enable: %s: no %s function\n", file,
+            BUILTIN_REGISTER_SYMBOL);
+    dlclose(handle);
+    return 1;
+  }
+  num_offered = 0;
+  if (reg(BUILTIN_API_VERSION, offer_builtin) < 0) {
+    fprintf(stderr, "enable: %s: rejected builtin API version %d\n", file,
+            BUILTIN_API_VERSION);
+    dlclose(handle);
+    return 1;
+  }
+
+  int status = 0, added = 0;
+  if (!*names) {
+    for (int i = 0; i < num_offered; i++) {
+      if (add_builtin(&offered[i]) < 0)
+        return 1;
+      added++;
+    }
+  }
+  for (; *names; names++) {
+    int i = 0;
+    while (i < num_offered && strcmp(offered[i].name, *names) != 0)
+      i++;
+    if (i == num_offered) {
+      fprintf(stderr, "enable: %s: not found in %s\n", *names, file);
+      status = 1;
+    } else if (add_builtin(&offered[i]) < 0) {
+      return 1;
+    } else {
+      added++;
+    }
+  }
+
+  // the added builtins' code and names stay mapped until the shell exits
+  if (!added)
+    dlclose(handle);
+  return status;
+}
+
+int enable_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+
+  if (!argv[1]) {
+    for (int i = 0; builtin_commands[i].name; i++)
+      dprintf(STDOUT_FILENO, "enable %s\n", builtin_commands[i].name);
+    return 0;
+  }
+  if (strcmp(argv[1], "-f") != 0 || !argv[2]) {
+    fprintf(stderr, "enable: usage: enable [-f file [name...]]\n");
+    return 2;
+  }
+  return load_builtins(argv[2], argv + 3);
+}
@@ -0,0 +1,352 @@
+/**
+ * @file resources.c
+ * @brief The ulimit, nice and affinity builtins. Alone they set the
+ *         defaults of every child the shell starts; in front of a command
+ *         they set that command's own, and take_resource_prefixes() removes
+ *         them from its words before the command is looked up.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "resource_control.h"
+
+/* The increment of a nice prefix without a number, as for nice(1). */
+#define DEFAULT_NICE 10
+
+#define SOFT_LIMIT 1
+#define HARD_LIMIT 2
+
+typedef struct {
+  char option;
+  int resource;
+  rlim_t unit;
+  const char *name;
+} LimitOption;
+
+static const LimitOption limit_options[RESOURCE_LIMITS_MAX] = {
+    {'c', RLIMIT_CORE, 1024, "core file size (blocks)"},
+    {'d', RLIMIT_DATA, 1024, "data seg size (kbytes)"},
+    {'f', RLIMIT_FSIZE, 1024, "file size (blocks)"},
+    {'l', RLIMIT_MEMLOCK, 1024, "max locked memory (kbytes)"},
+    {'m', RLIMIT_RSS, 1024, "max memory size (kbytes)"},
+    {'n', RLIMIT_NOFILE, 1, "open files"},
+    {'s', RLIMIT_STACK, 1024, "stack size (kbytes)"},
+    {'t', RLIMIT_CPU, 1, "cpu time (seconds)"},
+    {'u', RLIMIT_NPROC, 1, "max user processes"},
+    {'v', RLIMIT_AS, 1024, "virtual memory (kbytes)"},
+};
+
+/* What the words of one ulimit, nice or affinity asked for. */
+typedef struct {
+  int has_value; /**< A setting was given, not only a query. */
+  const LimitOption *limit;
+  int which; /**< SOFT_LIMIT and/or HARD_LIMIT, 0 for both. */
+  int all;
+  const char *bad;   /**< The word that did not parse. */
+  const char *error; /**< What is wrong with it. */
+} ResourceWords;
+
+static int parse_number(const char *word, long *value);
+static int parse_ulimit(char **argv, ResourceSettings *settings,
+                        ResourceWords *words);
+static int parse_nice(char **argv, ResourceSettings *settings,
+                      ResourceWords *words);
+static int parse_affinity(char **argv, ResourceSettings *settings,
+                          ResourceWords *words);
+static int parse_resource_words(char **argv, ResourceSettings *settings,
+                                ResourceWords *words);
+static struct rlimit child_limit(const LimitOption *option);
+static void print_limit(const LimitOption *option, int which, int label);
+
+static int parse_number(const char *word, long *value) {
+  char *end;
+
+  if (*word == '\0')
+    return -1;
+  errno = 0;
+  long n = strtol(word, &end, 10);
+  if (*end || errno)
+    return -1;
+  *value = n;
+  return 0;
+}
+
+static int parse_ulimit(char **argv, ResourceSettings *settings,
+                        ResourceWords *words) {
+  int i = 1;
+
+  words->limit = &limit_options[2]; // -f, as in other shells
+  for (; argv[i] && argv[i][0] == '-' && argv[i][1]; i++) {
+    for (const char *c = argv[i] + 1; *c; c++) {
+      if (*c == 'S' || *c == 'H') {
+        words->which |= *c == 'S' ? SOFT_LIMIT : HARD_LIMIT;
+        continue;
+      }
+      if (*c == 'a') {
+        words->all = 1;
+        continue;
+      }
+      size_t n = 0;
+      while (n < RESOURCE_LIMITS_MAX && limit_options[n].option != *c)
+        n++;
+      if (n == RESOURCE_LIMITS_MAX) {
+        words->bad = argv[i];
+        words->error = "invalid option";
+        return -1;
+      }
+      words->limit = &limit_options[n];
+    }
+  }
+  if (!argv[i] || words->all)
+    return i;
+
+  rlim_t value = RLIM_INFINITY;
+  if (strcmp(argv[i], "unlimited") != 0) {
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(argv[i], &end, 10);
+    if (argv[i][0] < '0' || argv[i][0] > '9' || *end || errno ||
+        n > (RLIM_INFINITY - 1) / words->limit->unit) {
+      words->bad = argv[i];
+      words->error = "invalid number";
+      return -1;
+    }
+    value = (rlim_t)n * words->limit->unit;
+  }
+
+  int which = words->which ? words->which : SOFT_LIMIT | HARD_LIMIT;
+  ResourceLimit limit = {.resource = words->limit->resource,
+                         .set_soft = which & SOFT_LIMIT,
+                         .set_hard = which & HARD_LIMIT,
+                         .soft = value,
+                         .hard = value};
+  set_resource_limit(settings, &limit);
+  words->has_value = 1;
+  return i + 1;
+}
+
+static int parse_nice(char **argv, ResourceSettings *settings,
+                      ResourceWords *words) {
+  long value = DEFAULT_NICE;
+  int i = 1;
+
+  if (!argv[1])
+    return 1;
+  if (strcmp(argv[1], "-n") == 0) {
+    if (!argv[2] || parse_number(argv[2], &value) < 0) {
+      words->bad = argv[2] ? argv[2] : "";
+      words->error = "invalid number";
+      return -1;
+    }
+    i = 3;
+  } else if (argv[1][0] == '-' && parse_number(argv[1] + 1, &value) == 0) {
+    // -N is -n N, as in nice(1): `nice -5` lowers the priority by 5
+    i = 2;
+  } else if (parse_number(argv[1], &value) == 0) {
+    i = 2;
+  } else if (argv[1][0] == '-') {
+    words->bad = argv[1];
+    words->error = "invalid option";
+    return -1;
+  }
+  // otherwise the command follows directly
+
+  settings->set_nice = 1;
+  settings->nice = value < -40 ? -40 : value > 40 ? 40 : (int)value;
+  words->has_value = 1;
+  return i;
+}
+
+static int parse_affinity(char **argv, ResourceSettings *settings,
+                          ResourceWords *words) {
+  if (!argv[1])
+    return 1;
+  if (parse_cpu_list(argv[1], &settings->affinity) < 0) {
+    words->bad = argv[1];
+    words->error = "invalid CPU list";
+    return -1;
+  }
+  settings->set_affinity = 1;
+  words->has_value = 1;
+  return 2;
+}
+
+/* Returns the number of words taken, 0 if argv[0] is none of the three
+ * builtins, or -1 if a word does not parse; nothing is printed, since a
+ * prefix that does not parse is left to the builtin. */
+static int parse_resource_words(char **argv, ResourceSettings *settings,
+                                ResourceWords *words) {
+  *words = (ResourceWords){0};
+  if (strcmp(argv[0], "ulimit") == 0)
+    return parse_ulimit(argv, settings, words);
+  if (strcmp(argv[0], "nice") == 0)
+    return parse_nice(argv, settings, words);
+  if (strcmp(argv[0], "affinity") == 0)
+    return parse_affinity(argv, settings, words);
+  return 0;
+}
+
+int take_resource_prefixes(Process *proc_head, Arena *arena) {
+  for (Process *proc = proc_head; proc; proc = proc->next) {
+    ResourceSettings *own = NULL;
+    char **argv = proc->cmd->argv;
+    proc->resources = NULL;
+
+    while (argv[0]) {
+      ResourceSettings next = own ? *own : (ResourceSettings){0};
+      ResourceWords words;
+
+      // anything but a setting followed by a command is left to the builtin
+      int n = parse_resource_words(argv, &next, &words);
+      if (n <= 0 || !words.has_value || !argv[n])
+        break;
+      if (!own && !(own = arena_alloc(arena, sizeof *own))) {
+        perror("arena allocation for resource settings failed");
+        return -1;
+      }
+      *own = next;
+      argv += n;
+    }
+    proc->cmd->argv = argv;
+    proc->resources = own;
+  }
+  return 0;
+}
+
+/* The limit children get: the shell's own, changed by the defaults. */
+static struct rlimit child_limit(const LimitOption *option) {
+  struct rlimit rl = {RLIM_INFINITY, RLIM_INFINITY};
+
+  getrlimit(option->resource, &rl);
+  for (size_t i = 0; i < resource_defaults.num_limits; i++) {
+    const ResourceLimit *l = &resource_defaults.limits[i];
+    if (l->resource != option->resource)
+      continue;
+    if (l->set_soft)
+      rl.rlim_cur = l->soft;
+    if (l->set_hard)
+      rl.rlim_max = l->hard;
+  }
+  return rl;
+}
+
+static void print_limit(const LimitOption *option, int which, int label) {
+  struct rlimit rl = child_limit(option);
+  rlim_t value = which == HARD_LIMIT ? rl.rlim_max : rl.rlim_cur;
+
+  if (label)
+    dprintf(STDOUT_FILENO, "%-28s (-%c) ", option->name, option->option);
+  if (value == RLIM_INFINITY)
+    dprintf(STDOUT_FILENO, "unlimited\n");
+  else
+    dprintf(STDOUT_FILENO, "%llu\n",
+            (unsigned long long)(value / option->unit));
+}
+
+int ulimit_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  ResourceSettings settings = resource_defaults;
+  ResourceWords words;
+
+  int n = parse_resource_words(argv, &settings, &words);
+  if (n < 0) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], words.bad, words.error);
+    return 2;
+  }
+  if (argv[n]) {
+    fprintf(stderr, "ulimit: too many arguments\n");
+    return 2;
+  }
+  if (words.all) {
+    for (size_t i = 0; i < RESOURCE_LIMITS_MAX; i++)
+      print_limit(&limit_options[i], words.which, 1);
+    return 0;
+  }
+  if (!words.has_value) {
+    print_limit(words.limit, words.which, 0);
+    return 0;
+  }
+
+  /* Refuse here what would make every child fail. */
+  struct rlimit shell_rl;
+  getrlimit(words.limit->resource, &shell_rl);
+  ResourceSettings saved = resource_defaults;
+  resource_defaults = settings;
+  struct rlimit rl = child_limit(words.limit);
+  if (rl.rlim_cur > rl.rlim_max) {
+    fprintf(stderr, "ulimit: the soft limit would exceed the hard limit\n");
+    resource_defaults = saved;
+    return 1;
+  }
+  if (rl.rlim_max > shell_rl.rlim_max && geteuid() != 0) {
+    fprintf(stderr, "ulimit: cannot raise the hard limit\n");
+    resource_defaults = saved;
+    return 1;
+  }
+  return 0;
+}
+
+int nice_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  ResourceSettings settings = resource_defaults;
+  ResourceWords words;
+
+  int n = parse_resource_words(argv, &settings, &words);
+  if (n < 0) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], words.bad, words.error);
+    return 2;
+  }
+  if (!words.has_value) {
+    dprintf(STDOUT_FILENO, "%d\n",
+            resource_defaults.set_nice ? resource_defaults.nice : 0);
+    return 0;
+  }
+  if (argv[n]) {
+    fprintf(stderr, "nice: usage: nice [[-n] increment] [command]\n");
+    return 2;
+  }
+  resource_defaults = settings;
+  return 0;
+}
+
+int affinity_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  ResourceSettings settings = resource_defaults;
+  ResourceWords words;
+  char list[1024];
+
+  int n = parse_resource_words(argv, &settings, &words);
+  if (n < 0) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], words.bad, words.error);
+    return 2;
+  }
+  if (!words.has_value) {
+    cpu_set_t set = resource_defaults.affinity;
+    if (!resource_defaults.set_affinity &&
+        sched_getaffinity(0, sizeof set, &set) < 0) {
+      perror("affinity");
+      return 1;
+    }
+    format_cpu_list(&set, list, sizeof list);
+    dprintf(STDOUT_FILENO, "%s\n", list);
+    return 0;
+  }
+  if (argv[n]) {
+    fprintf(stderr, "affinity: usage: affinity [cpu-list] [command]\n");
+    return 2;
+  }
+  resource_defaults = settings;
+  return 0;
+}
@@ -0,0 +1,715 @@
+/**
+ * @file utilities.c
+ * @brief Builtin versions of the small utilities scripts run most often:
+ *         echo, printf, test/[, true, false, sleep and cat. Output goes
+ *         through an FdWriter on descriptor 1.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "fd_writer.h"
+#include "signal_utils.h"
+
+/* Status of a builtin stopped by Ctrl-C, as for a child killed by SIGINT. */
+#define INTERRUPTED_STATUS 130
+
+/* Longer sleeps are cut to this, so the deadline fits in a time_t. */
+#define SLEEP_MAX ((double)(LONG_MAX / 2))
+
+/* The most cat moves with one call. */
+#define CAT_CHUNK (1 << 20)
+
+typedef enum { COPY_RANGE, COPY_SENDFILE, COPY_SPLICE, COPY_READ } CopyMethod;
+
+static int put_escape(FdWriter *w, const char **p, int echo);
+static int put_escaped(FdWriter *w, const char *s, int echo);
+static int put_conversion(FdWriter *w, const char *spec, size_t spec_len,
+                          char conv, const char *arg);
+static int put_format(FdWriter *w, const char *format, char ***args,
+                      int *status);
+static int test_or(char **argv, int argc, int *pos, int *error);
+static int test_and(char **argv, int argc, int *pos, int *error);
+static int test_not(char **argv, int argc, int *pos, int *error);
+static int test_primary(char **argv, int argc, int *pos, int *error);
+static int test_unary(const char *op, const char *arg, int *error);
+static int test_binary(const char *left, const char *op, const char *right,
+                       int *error);
+static int is_unary_op(const char *s);
+static int is_binary_op(const char *s);
+static int parse_integer(const char *s, long long *value);
+static int parse_printf_integer(const char *s, int is_signed,
+                                unsigned long long *value);
+static int parse_interval(const char *s, double *seconds);
+static int write_out(int fd, const char *data, size_t n);
+static int copy_fd(int in, int out, const char *name);
+
+/* Writes the character of the escape sequence at *p, just past the
+ * backslash, and moves *p past it. echo spells octal as \0nnn, printf as
+ * \nnn. Returns 1 for \c, which ends the output, and 0 otherwise. */
+static int put_escape(FdWriter *w, const char **p, int echo) {
+  const char *s = *p;
+  int value = 0, digits = 0;
+
+  switch (*s) {
+  case 'a': value = '\a'; break;
+  case 'b': value = '\b'; break;
+  case 'e': value = 033; break;
+  case 'f': value = '\f'; break;
+  case 'n': value = '\n'; break;
+  case 'r': value = '\r'; break;
+  case 't': value = '\t'; break;
+  case 'v': value = '\v'; break;
+  case '\\': value = '\\'; break;
+  case 'c':
+    *p = s + 1;
+    return 1;
+  case 'x':
+    for (; digits < 2 && isxdigit((unsigned char)s[1 + digits]); digits++) {
+      char c = s[1 + digits];
+      value = value * 16 +
+              (isdigit((unsigned char)c) ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    if (digits == 0)
+      break;
+    fd_writer_putc(w, (char)value);
+    *p = s + 1 + digits;
+    return 0;
+  default:
+    if (*s >= '0' && *s <= '7') {
+      const char *d = s + (echo && *s == '0');
+      for (; digits < 3 && *d >= '0' && *d <= '7'; digits++)
+        value = value * 8 + (*d++ - '0');
+      fd_writer_putc(w, (char)value);
+      *p = d;
+      return 0;
+    }
+    break;
+  }
+
+  if (value == 0) {
+    /* Not an escape: keep the backslash. */
+    fd_writer_putc(w, '\\');
+    return 0;
+  }
+  fd_writer_putc(w, (char)value);
+  *p = s + 1;
+  return 0;
+}
+
+/* Returns 1 when a \c ended the output. */
+static int put_escaped(FdWriter *w, const char *s, int echo) {
+  const char *backslash;
+
+  while ((backslash = strchr(s, '\\'))) {
+    fd_writer_put(w, s, backslash - s);
+    s = backslash + 1;
+    if (put_escape(w, &s, echo))
+      return 1;
+  }
+  fd_writer_puts(w, s);
+  return 0;
+}
+
+int echo_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv + 1;
+  int newline = 1, escapes = 0;
+  FdWriter w;
+
+  /* Options are only recognized before the first operand, and only if every
+   * letter is one of n, e and E. */
+  for (; *argv && (*argv)[0] == '-' && (*argv)[1]; argv++) {
+    if (strspn(*argv + 1, "neE") != strlen(*argv + 1))
+      break;
+    for (const char *c = *argv + 1; *c; c++) {
+      if (*c == 'n')
+        newline = 0;
+      else
+        escapes = *c == 'e';
+    }
+  }
+
+  fd_writer_init(&w, STDOUT_FILENO);
+  for (; *argv; argv++) {
+    if (escapes && put_escaped(&w, *argv, 1))
+      return fd_writer_flush(&w) < 0;
+    if (!escapes)
+      fd_writer_puts(&w, *argv);
+    if (argv[1])
+      fd_writer_putc(&w, ' ');
+  }
+  if (newline)
+    fd_writer_putc(&w, '\n');
+  return fd_writer_flush(&w) < 0;
+}
+
+/* Formats one argument with a conversion spec such as "%-8.3" and the
+ * conversion character. Returns 1 if the argument is not a valid number. */
+static int put_conversion(FdWriter *w, const char *spec, size_t spec_len,
+                          char conv, const char *arg) {
+  char fmt[64];
+  char *end;
+  int bad = 0;
+
+  if (spec_len > sizeof fmt - 4)
+    spec_len = sizeof fmt - 4;
+  memcpy(fmt, spec, spec_len);
+
+  switch (conv) {
+  case 'd':
+  case 'i': {
+    unsigned long long value = 0;
+    if (*arg && parse_printf_integer(arg, 1, &value) < 0)
+      bad = 1;
+    memcpy(fmt + spec_len, "lld", 4);
+    fd_writer_printf(w, fmt, (long long)value);
+    break;
+  }
+  case 'o':
+  case 'u':
+  case 'x':
+  case 'X': {
+    unsigned long long value = 0;
+    if (*arg && parse_printf_integer(arg, 0, &value) < 0)
+      bad = 1;
+    snprintf(fmt + spec_len, 4, "ll%c", conv);
+    fd_writer_printf(w, fmt, value);
+    break;
+  }
+  case 'e':
+  case 'E':
+  case 'f':
+  case 'F':
+  case 'g':
+  case 'G': {
+    double value = 0;
+    if (*arg) {
+      errno = 0;
+      value = strtod(arg, &end);
+      bad = *end != '\0' || errno != 0;
+    }
+    snprintf(fmt + spec_len, 2, "%c", conv);
+    fd_writer_printf(w, fmt, value);
+    break;
+  }
+  case 'c':
+    snprintf(fmt + spec_len, 2, "c");
+    if (*arg)
+      fd_writer_printf(w, fmt, *arg);
+    break;
+  default:
+    snprintf(fmt + spec_len, 2, "s");
+    fd_writer_printf(w, fmt, arg);
+    break;
+  }
+
+  if (bad)
+    fprintf(stderr, "printf: %s: invalid number\n", arg);
+  return bad;
+}
+
+/* Reads an integer argument the way C spells constants: decimal, 0x hex or
+ * 0 octal. A leading ' or " stands for the code of the character after it,
+ * as in printf(1). test takes decimal only; see parse_integer(). */
+static int parse_printf_integer(const char *s, int is_signed,
+                                unsigned long long *value) {
+  char *end;
+
+  if (*s == '\'' || *s == '"') {
+    *value = (unsigned char)s[1];
+    return 0;
+  }
+  errno = 0;
+  *value = is_signed ? (unsigned long long)strtoll(s, &end, 0)
+                     : strtoull(s, &end, 0);
+  return end == s || *end != '\0' || errno != 0 ? -1 : 0;
+}
+
+/* Writes the format once, taking arguments from *args as conversions need
+ * them. Returns 1 when a \c ended the output, -1 on a bad format and 0
+ * otherwise. */
+static int put_format(FdWriter *w, const char *format, char ***args,
+                      int *status) {
+  const char *p = format;
+
+  while (*p) {
+    size_t plain = strcspn(p, "\\%");
+    fd_writer_put(w, p, plain);
+    p += plain;
+
+    if (*p == '\\') {
+      p++;
+      if (put_escape(w, &p, 0))
+        return 1;
+      continue;
+    }
+    if (*p != '%')
+      break;
+    if (p[1] == '%') {
+      fd_writer_putc(w, '%');
+      p += 2;
+      continue;
+    }
+
+    const char *spec = p++;
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789");
+    if (*p == '.') {
+      p++;
+      p += strspn(p, "0123456789");
+    }
+    char conv = *p;
+    if (!conv || !strchr("diouxXeEfFgGcsb", conv)) {
+      fprintf(stderr, "printf: %.*s: invalid conversion\n",
+              (int)(p - spec + (conv != '\0')), spec);
+      return -1;
+    }
+    p++;
+
+    const char *arg = **args ? *(*args)++ : "";
+    if (conv == 'b') {
+      if (put_escaped(w, arg, 1))
+        return 1;
+      continue;
+    }
+    if (put_conversion(w, spec, p - 1 - spec, conv, arg))
+      *status = 1;
+  }
+  return 0;
+}
+
+int printf_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  int status = 0;
+  FdWriter w;
+
+  if (!argv[1]) {
+    fprintf(stderr, "printf: usage: printf format [arguments]\n");
+    return 2;
+  }
+
+  /* The format is reused until the arguments run out. */
+  char **args = argv + 2;
+  fd_writer_init(&w, STDOUT_FILENO);
+  do {
+    char **before = args;
+    int done = put_format(&w, argv[1], &args, &status);
+    if (done < 0)
+      status = 1;
+    if (done || args == before)
+      break;
+  } while (*args);
+
+  if (fd_writer_flush(&w) < 0)
+    return 1;
+  return status;
+}
+
+static int is_unary_op(const char *s) {
+  return s[0] == '-' && s[1] && !s[2] &&
+         strchr("bcdefghkLnNOGprsStuwxz", s[1]);
+}
+
+static int is_binary_op(const char *s) {
+  static const char *const ops[] = {"=",   "==",  "!=",  "<",   ">",
+                                    "-eq", "-ne", "-lt", "-le", "-gt",
+                                    "-ge", "-nt", "-ot", "-ef", NULL};
+  for (int i = 0; ops[i]; i++)
+    if (strcmp(s, ops[i]) == 0)
+      return 1;
+  return 0;
+}
+
+static int parse_integer(const char *s, long long *value) {
+  char *end;
+
+  while (isspace((unsigned char)*s))
+    s++;
+  errno = 0;
+  *value = strtoll(s, &end, 10);
+  while (isspace((unsigned char)*end))
+    end++;
+  return end == s || *end != '\0' || errno != 0 ? -1 : 0;
+}
+
+static int test_unary(const char *op, const char *arg, int *error) {
+  struct stat st;
+  long long fd;
+
+  switch (op[1]) {
+  case 't':
+    if (parse_integer(arg, &fd) < 0 || fd < 0 || fd > INT_MAX) {
+      fprintf(stderr, "test: %s: integer expression expected\n", arg);
+      *error = 1;
+      return 0;
+    }
+    return isatty((int)fd);
+  case 'n': return arg[0] != '\0';
+  case 'z': return arg[0] == '\0';
+  case 'r': return access(arg, R_OK) == 0;
+  case 'w': return access(arg, W_OK) == 0;
+  case 'x': return access(arg, X_OK) == 0;
+  case 'h':
+  case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+  }
+
+  if (stat(arg, &st) < 0)
+    return 0;
+  switch (op[1]) {
+  case 'b': return S_ISBLK(st.st_mode);
+  case 'c': return S_ISCHR(st.st_mode);
+  case 'd': return S_ISDIR(st.st_mode);
+  case 'f': return S_ISREG(st.st_mode);
+  case 'g': return (st.st_mode & S_ISGID) != 0;
+  case 'G': return st.st_gid == getegid();
+  case 'k': return (st.st_mode & S_ISVTX) != 0;
+  case 'N':
+    return st.st_mtim.tv_sec > st.st_atim.tv_sec ||
+           (st.st_mtim.tv_sec == st.st_atim.tv_sec &&
+            st.st_mtim.tv_nsec > st.st_atim.tv_nsec);
+  case 'O': return st.st_uid == geteuid();
+  case 'p': return S_ISFIFO(st.st_mode);
+  case 's': return st.st_size > 0;
+  case 'S': return S_ISSOCK(st.st_mode);
+  case 'u': return (st.st_mode & S_ISUID) != 0;
+  default: return 1; /* -e */
+  }
+}
+
+static int test_binary(const char *left, const char *op, const char *right,
+                       int *error) {
+  if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+    return strcmp(left, right) == 0;
+  if (strcmp(op, "!=") == 0)
+    return strcmp(left, right) != 0;
+  if (strcmp(op, "<") == 0)
+    return strcmp(left, right) < 0;
+  if (strcmp(op, ">") == 0)
+    return strcmp(left, right) > 0;
+
+  if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 ||
+      strcmp(op, "-ef") == 0) {
+    struct stat a, b;
+    int have_a = stat(left, &a) == 0, have_b = stat(right, &b) == 0;
+    if (op[1] == 'e')
+      return have_a && have_b && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    if (op[1] == 'o') {
+      struct stat t = a;
+      int have_t = have_a;
+      a = b, have_a = have_b;
+      b = t, have_b = have_t;
+    }
+    if (!have_a)
+      return 0;
+    if (!have_b)
+      return 1;
+    return a.st_mtim.tv_sec > b.st_mtim.tv_sec ||
+           (a.st_mtim.tv_sec == b.st_mtim.tv_sec &&
+            a.st_mtim.tv_nsec > b.st_mtim.tv_nsec);
+  }
+
+  long long l, r;
+  const char *bad = parse_integer(left, &l) < 0    ? left
+                    : parse_integer(right, &r) < 0 ? right
+                                                   : NULL;
+  if (bad) {
+    fprintf(stderr, "test: %s: integer expression expected\n", bad);
+    *error = 1;
+    return 0;
+  }
+  if (strcmp(op, "-eq") == 0)
+    return l == r;
+  if (strcmp(op, "-ne") == 0)
+    return l != r;
+  if (strcmp(op, "-lt") == 0)
+    return l < r;
+  if (strcmp(op, "-le") == 0)
+    return l <= r;
+  if (strcmp(op, "-gt") == 0)
+    return l > r;
+  return l >= r;
+}
+
+/* expression: and ("-o" and)* */
+static int test_or(char **argv, int argc, int *pos, int *error) {
+  int value = test_and(argv, argc, pos, error);
+  while (*pos < argc && strcmp(argv[*pos], "-o") == 0) {
+    (*pos)++;
+    value = test_and(argv, argc, pos, error) || value;
+  }
+  return value;
+}
+
+/* and: not ("-a" not)* */
+static int test_and(char **argv, int argc, int *pos, int *error) {
+  int value = test_not(argv, argc, pos, error);
+  while (*pos < argc && strcmp(argv[*pos], "-a") == 0) {
+    (*pos)++;
+    value = test_not(argv, argc, pos, error) && value;
+  }
+  return value;
+}
+
+/* not: "!" not | primary */
+static int test_not(char **argv, int argc, int *pos, int *error) {
+  /* A lone "!" is a string. */
+  if (*pos + 1 < argc && strcmp(argv[*pos], "!") == 0) {
+    (*pos)++;
+    return !test_not(argv, argc, pos, error);
+  }
+  return test_primary(argv, argc, pos, error);
+}
+
+/* primary: "(" expression ")" | string binop string | unop string | string */
+static int test_primary(char **argv, int argc, int *pos, int *error) {
+  if (*pos >= argc) {
+    fprintf(stderr, "test: argument expected\n");
+    *error = 1;
+    return 0;
+  }
+
+  const char *arg = argv[*pos];
+  if (*pos + 2 < argc && is_binary_op(argv[*pos + 1])) {
+    *pos += 3;
+    return test_binary(arg, argv[*pos - 2], argv[*pos - 1], error);
+  }
+  if (strcmp(arg, "(") == 0 && *pos + 1 < argc) {
+    (*pos)++;
+    int value = test_or(argv, argc, pos, error);
+    if (*pos >= argc || strcmp(argv[*pos], ")") != 0) {
+      fprintf(stderr, "test: `)' expected\n");
+      *error = 1;
+      return 0;
+    }
+    (*pos)++;
+    return value;
+  }
+  if (*pos + 1 < argc && is_unary_op(arg)) {
+    *pos += 2;
+    return test_unary(arg, argv[*pos - 1], error);
+  }
+  (*pos)++;
+  return arg[0] != '\0';
+}
+
+int test_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  int argc = 0, pos = 1, error = 0;
+
+  while (argv[argc])
+    argc++;
+  if (strcmp(argv[0], "[") == 0) {
+    if (strcmp(argv[argc - 1], "]") != 0) {
+      fprintf(stderr, "[: missing `]'\n");
+      return 2;
+    }
+    argc--;
+  }
+  if (argc == 1)
+    return 1;
+
+  int value = test_or(argv, argc, &pos, &error);
+  if (!error && pos < argc) {
+    fprintf(stderr, "test: %s: unexpected argument\n", argv[pos]);
+    error = 1;
+  }
+  return error ? 2 : !value;
+}
+
+int true_func(Process *proc, Job **job_head) {
+  (void)proc;
+  (void)job_head;
+  return 0;
+}
+
+int false_func(Process *proc, Job **job_head) {
+  (void)proc;
+  (void)job_head;
+  return 1;
+}
+
+/* Accepts a decimal number of seconds with an optional s, m, h or d
+ * suffix, or `inf` / `infinity`. strtod() takes those as well as `nan`;
+ * a number too large for a double fails with ERANGE. */
+static int parse_interval(const char *s, double *seconds) {
+  char *end;
+
+  errno = 0;
+  *seconds = strtod(s, &end);
+  if (end == s || errno != 0 || isnan(*seconds) || *seconds < 0)
+    return -1;
+  switch (*end) {
+  case '\0':
+  case 's': break;
+  case 'm': *seconds *= 60; break;
+  case 'h': *seconds *= 60 * 60; break;
+  case 'd': *seconds *= 24 * 60 * 60; break;
+  default: return -1;
+  }
+  return *end && end[1] ? -1 : 0;
+}
+
+int sleep_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  double total = 0, seconds;
+  struct timespec deadline;
+
+  if (!argv[1]) {
+    fprintf(stderr, "sleep: missing operand\n");
+    return 1;
+  }
+  for (int i = 1; argv[i]; i++) {
+    if (parse_interval(argv[i], &seconds) < 0) {
+      fprintf(stderr, "sleep: invalid time interval '%s'\n", argv[i]);
+      return 1;
+    }
+    total += seconds;
+  }
+
+  // `sleep infinity` waits for a signal
+  if (isinf(total)) {
+    while (!interrupted)
+      pause();
+    return INTERRUPTED_STATUS;
+  }
+  if (total > SLEEP_MAX)
+    total = SLEEP_MAX;
+
+  /* An absolute deadline, so other signals do not stretch the sleep. */
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  time_t whole = (time_t)total;
+  deadline.tv_sec += whole;
+  deadline.tv_nsec += (long)((total - whole) * 1e9);
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  int err;
+  while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                                NULL)) == EINTR) {
+    if (interrupted)
+      return INTERRUPTED_STATUS;
+  }
+  return err != 0;
+}
+
+/* Writes everything unless Ctrl-C stops it; errno tells which. */
+static int write_out(int fd, const char *data, size_t n) {
+  while (n > 0) {
+    ssize_t done = write(fd, data, n);
+    if (done < 0) {
+      if (errno == EINTR && !interrupted)
+        continue;
+      return -1;
+    }
+    data += done;
+    n -= done;
+  }
+  return 0;
+}
+
+/* Copies in to out without going through user space when the kernel can:
+ * copy_file_range() between files, sendfile() from a file, splice() to or
+ * from a pipe, and read()/write() otherwise. A method the pair does not
+ * support fails at once and the next one is tried. */
+static int copy_fd(int in, int out, const char *name) {
+  static char buf[65536];
+  struct stat in_st, out_st;
+  CopyMethod method = COPY_READ;
+
+  if (fstat(in, &in_st) == 0 && fstat(out, &out_st) == 0) {
+    /* Files in /proc claim to be empty, so only a size makes them safe. */
+    if (S_ISREG(in_st.st_mode) && in_st.st_size > 0)
+      method = COPY_RANGE;
+    else if (S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode))
+      method = COPY_SPLICE;
+  }
+
+  for (;;) {
+    ssize_t n;
+
+    switch (method) {
+    case COPY_RANGE:
+      n = copy_file_range(in, NULL, out, NULL, CAT_CHUNK, 0);
+      break;
+    case COPY_SENDFILE:
+      n = sendfile(out, in, NULL, CAT_CHUNK);
+      break;
+    case COPY_SPLICE:
+      n = splice(in, NULL, out, NULL, CAT_CHUNK, SPLICE_F_MOVE);
+      break;
+    default:
+      n = read(in, buf, sizeof buf);
+      if (n > 0 && write_out(out, buf, n) < 0)
+        n = -1;
+      break;
+    }
+
+    if (n == 0)
+      return 0;
+    if (n > 0)
+      continue;
+    if (errno == EINTR) {
+      if (interrupted)
+        return INTERRUPTED_STATUS;
+      continue;
+    }
+    if (method != COPY_READ &&
+        (errno == EINVAL || errno == EXDEV || errno == ENOSYS ||
+         errno == EBADF || errno == EOPNOTSUPP || errno == ESPIPE)) {
+      method++;
+      continue;
+    }
+    fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+    return 1;
+  }
+}
+
+int cat_func(Process *proc, Job **job_head) {
+  (void)job_head;
+  char **argv = proc->cmd->argv;
+  int status = 0;
+
+  if (!argv[1])
+    return copy_fd(STDIN_FILENO, STDOUT_FILENO, "-");
+
+  for (int i = 1; argv[i]; i++) {
+    int fd = STDIN_FILENO;
+    if (strcmp(argv[i], "-") != 0) {
+      fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno));
+        status = 1;
+        continue;
+      }
+    }
+    int copied = copy_fd(fd, STDOUT_FILENO, argv[i]);
+    if (fd != STDIN_FILENO)
+      close(fd);
+    if (copied == INTERRUPTED_STATUS)
+      return copied;
+    if (copied)
+      status = 1;
+  }
+  return status;
+}
@@ -0,0 +1,312 @@
+/**
+ * @file event_loop.c
+ * @brief Waiting at the prompt on the terminal, a signalfd and the pidfds of
+ *         background processes, so job notices are printed when jobs end
+ *         rather than at the next prompt.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+#include "job_capture.h"
+#include "signal_utils.h"
+
+/* The epoll data of stdin and the signalfd; a pidfd's is its process ID,
+ * and a capture pipe's its JobCapture with CAPTURE_TAG set. */
+#define STDIN_TAG ((uint64_t)-1)
+#define SIGNAL_TAG ((uint64_t)-2)
+#define CAPTURE_TAG ((uint64_t)1 << 62)
+
+#define READ_CHUNK 4096
+
+/* What a batch of signals asked for. */
+#define SIGNALED_CHILD 1
+#define SIGNALED_INTERRUPT 2
+
+static int open_pidfd(pid_t pid);
+static void prompt_signals(sigset_t *set);
+static int take_line(EventLoop *loop, char **line, size_t *size);
+static int read_input(EventLoop *loop);
+static int read_signals(EventLoop *loop);
+static void reap_process(pid_t pid);
+static int has_notices(Job *job_head);
+static void print_notices(EventLoop *loop, const char *prompt);
+
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+static void prompt_signals(sigset_t *set) {
+  sigemptyset(set);
+  sigaddset(set, SIGCHLD);
+  sigaddset(set, SIGINT);
+  sigaddset(set, SIGQUIT);
+}
+
+int event_loop_init(EventLoop *loop, Job **job_head) {
+  struct epoll_event ev = {.events = EPOLLIN};
+  sigset_t set;
+
+  memset(loop, 0, sizeof *loop);
+  loop->job_head = job_head;
+  loop->signal_fd = -1;
+  loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop->epoll_fd < 0) {
+    perror("epoll_create1");
+    return -1;
+  }
+
+  prompt_signals(&set);
+  loop->signal_fd = signalfd(-1, &set, SFD_CLOEXEC | SFD_NONBLOCK);
+  ev.data.u64 = SIGNAL_TAG;
+  if (loop->signal_fd < 0 ||
+      epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->signal_fd, &ev) < 0) {
+    perror("signalfd");
+    event_loop_free(loop);
+    return -1;
+  }
+
+  ev.data.u64 = STDIN_TAG;
+  loop->poll_stdin = 1;
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &ev) < 0) {
+    if (errno != EPERM) {
+      perror("epoll_ctl(stdin)");
+      event_loop_free(loop);
+      return -1;
+    }
+    // a regular file, which is always ready
+    loop->poll_stdin = 0;
+  }
+  return 0;
+}
+
+void event_loop_free(EventLoop *loop) {
+  if (loop->signal_fd >= 0)
+    close(loop->signal_fd);
+  if (loop->epoll_fd >= 0)
+    close(loop->epoll_fd);
+  free(loop->pending);
+  loop->pending = NULL;
+  loop->signal_fd = -1;
+  loop->epoll_fd = -1;
+}
+
+void event_loop_watch_job(EventLoop *loop, Job *job) {
+  for (Process *p = job->first_process; p; p = p->next) {
+    if (p->pid <= 0 || p->completed)
+      continue;
+    int fd = open_pidfd(p->pid);
+    if (fd < 0)
+      continue;
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = (uint64_t)p->pid};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 ||
+        job_table_set_pidfd(p->pid, fd) < 0)
+      close(fd);
+  }
+
+  /* The pipe is drained as output arrives, so the job never waits for the
+   * prompt to make room. */
+  JobCapture *capture = job->capture;
+  if (capture && capture->fd >= 0 && capture->epoll_fd < 0) {
+    struct epoll_event ev = {.events = EPOLLIN,
+                             .data.u64 = CAPTURE_TAG | (uintptr_t)capture};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, capture->fd, &ev) == 0)
+      capture->epoll_fd = loop->epoll_fd;
+  }
+}
+
+/* Moves the first line of the pending input, or the rest of it at the end
+ * of input, to *line. Returns 1 if there was one. */
+static int take_line(EventLoop *loop, char **line, size_t *size) {
+  char *newline = memchr(loop->pending, '\n', loop->pending_len);
+  size_t n = newline ? (size_t)(newline - loop->pending) + 1 : 0;
+
+  if (!newline && loop->eof)
+    n = loop->pending_len;
+  if (n == 0)
+    return 0;
+  if (*size < n + 1) {
+    char *p = realloc(*line, n + 1);
+    if (!p) {
+      perror("realloc");
+      return 0;
+    }
+    *line = p;
+    *size = n + 1;
+  }
+  memcpy(*line, loop->pending, n);
+  (*line)[n] = '\0';
+  loop->pending_len -= n;
+  memmove(loop->pending, loop->pending + n, loop->pending_len);
+  return 1;
+}
+
+static int read_input(EventLoop *loop) {
+  if (loop->pending_size < loop->pending_len + READ_CHUNK) {
+    size_t size = loop->pending_len + READ_CHUNK;
+    char *p = realloc(loop->pending, size);
+    if (!p) {
+      perror("realloc");
+      return -1;
+    }
+    loop->pending = p;
+    loop->pending_size = size;
+  }
+
+  ssize_t n = read(STDIN_FILENO, loop->pending + loop->pending_len, READ_CHUNK);
+  if (n > 0) {
+    loop->pending_len += n;
+    return 0;
+  }
+  // a terminal that went away reads as EIO
+  if (n == 0 || errno == EIO) {
+    loop->eof = 1;
+    return 0;
+  }
+  if (errno == EINTR || errno == EAGAIN)
+    return 0;
+  return -1;
+}
+
+static int read_signals(EventLoop *loop) {
+  struct signalfd_siginfo info[8];
+  int what = 0;
+  ssize_t n;
+
+  while ((n = read(loop->signal_fd, info, sizeof info)) > 0) {
+    for (size_t i = 0; i < (size_t)n / sizeof *info; i++)
+      what |= info[i].ssi_signo == SIGCHLD ? SIGNALED_CHILD
+                                            : SIGNALED_INTERRUPT;
+  }
+  return what;
+}
+
+/* A pidfd is readable once its process has exited. */
+static void reap_process(pid_t pid) {
+  int status;
+
+  if (waitpid(pid, &status, WNOHANG | WUNTRACED) > 0)
+    mark_process(pid, status);
+}
+
+static int has_notices(Job *job_head) {
+  for (Job *j = job_head; j; j = j->next) {
+    if (j->arena)
+      continue;
+    if (job_is_completed(j) ? j->background : job_is_stopped(j))
+      return 1;
+  }
+  return 0;
+}
+
+/* Prints the notices below the line being typed and the prompt again under
+ * them; the typed text is still in the terminal's buffer. */
+static void print_notices(EventLoop *loop, const char *prompt) {
+  int notices = has_notices(*loop->job_head);
+
+  if (notices && write(STDERR_FILENO, "\n", 1) == -1) {
+  }
+  notify_bg_jobs(loop->job_head);
+  if (notices) {
+    printf("%s", prompt);
+    fflush(stdout);
+  }
+}
+
+int event_loop_read_line(EventLoop *loop, const char *prompt, char **line,
+                         size_t *size) {
+  struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+  sigset_t set, prev;
+  int status = -1;
+
+  printf("%s", prompt);
+  fflush(stdout);
+
+  /* From here on the signals queue up on the signalfd; whatever the
+   * handlers saw before is picked up first. */
+  prompt_signals(&set);
+  sigprocmask(SIG_BLOCK, &set, &prev);
+  if (child_changed) {
+    child_changed = 0;
+    reap_children();
+    print_notices(loop, prompt);
+  }
+
+  while (1) {
+    if (take_line(loop, line, size)) {
+      status = 0;
+      break;
+    }
+    if (loop->eof)
+      break;
+    if (!loop->poll_stdin) {
+      if (read_input(loop) < 0)
+        break;
+      continue;
+    }
+
+    int n = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, -1);
+    loop->wakeups++;
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      break;
+    }
+
+    int input = 0, signaled = 0, exited = 0;
+    for (int i = 0; i < n; i++) {
+      uint64_t tag = events[i].data.u64;
+      if (tag == STDIN_TAG) {
+        input = 1;
+      } else if (tag == SIGNAL_TAG) {
+        signaled |= read_signals(loop);
+      } else if (tag & CAPTURE_TAG) {
+        capture_drain((JobCapture *)(uintptr_t)(tag & ~CAPTURE_TAG), -1,
+                      CAPTURE_DRAIN_MAX);
+      } else {
+        reap_process((pid_t)tag);
+        exited = 1;
+      }
+    }
+    if (signaled & SIGNALED_CHILD)
+      reap_children();
+    if (exited || (signaled & SIGNALED_CHILD))
+      print_notices(loop, prompt);
+    if (signaled & SIGNALED_INTERRUPT) {
+      // the terminal has dropped the line being typed as well
+      loop->pending_len = 0;
+      if (write(STDOUT_FILENO, "\n", 1) == -1) {
+      }
+      errno = EINTR;
+      break;
+    }
+    if (input && read_input(loop) < 0)
+      break;
+  }
+
+  int saved_errno = errno;
+  sigprocmask(SIG_SETMASK, &prev, NULL);
+  errno = saved_errno;
+  return status;
+}
@@ -9,4 +9,4 @@
 
 #include "shell.h"
 
-int main(void) { return shell(); }
+int main(int argc, char *argv[]) { return shell(argc, argv); }
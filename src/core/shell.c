@@ -24,121 +24,393 @@
 #include <wait.h>
 
 #include "builtin.h"
+#include "command_table.h"
+#include "env_utils.h"
+#include "event_loop.h"
 #include "executor.h"
 #include "expander.h"
 #include "helper.h"
+#include "job_capture.h"
 #include "job_utils.h"
+#include "jobserver.h"
 #include "parser.h"
+#include "pipeline_cache.h"
 #include "process_utils.h"
+#include "shell.h"
 #include "signal_utils.h"
+#include "spawn_backend.h"
 #include "tokenizer.h"
+#include "zygote.h"
 
-int shell(void) {
-  char *tokens[MAXTOKENS];
-  char *line_buffer = NULL;
+/**
+ * @struct CommandInput
+ * @brief The text of the command being read.
+ *
+ * All buffers are reused across prompts.
+ */
+typedef struct {
+  char *line;       /* command being lexed; continuation lines are appended */
+  size_t size;
+  size_t len;
+  char *next;       /* the continuation line just read */
+  size_t next_size;
+  char *raw;        /* untouched copy of the command, shown by `jobs` */
+  size_t raw_size;
+  size_t raw_len;
+  Lexer lexer;
+  const PipelineTemplate *cached; /* set when the line was in the cache */
+  FILE *source;     /* a -c string or script; NULL for the terminal */
+  EventLoop events; /* how the terminal is waited on */
+  int use_events;   /* set when the event loop could be set up */
+} CommandInput;
+
+extern char **environ;
+
+Arena line_arena;
+PipelineCache pipeline_cache;
+
+static int append_text(char **buf, size_t *size, size_t *len,
+                       const char *text, size_t n);
+static int read_line(CommandInput *in, const char *prompt, char **buf,
+                     size_t *size);
+static int read_error(CommandInput *in, int *exit_status);
+static int input_exhausted(CommandInput *in);
+static int input_ended(CommandInput *in);
+static int read_command(CommandInput *in, TokenVector *tokens,
+                        int *exit_status);
+static void free_command_input(CommandInput *in);
+static void strip_newlines(CommandInput *in);
+static void select_spawn_backend(void);
+static int open_input(int argc, char *argv[], CommandInput *in,
+                      int *exit_status);
+
+static int append_text(char **buf, size_t *size, size_t *len,
+                       const char *text, size_t n) {
+  if (*size < *len + n + 1) {
+    size_t new_size = *size ? *size : 128;
+    while (new_size < *len + n + 1)
+      new_size *= 2;
+    char *p = realloc(*buf, new_size);
+    if (!p) {
+      perror("realloc");
+      return -1;
+    }
+    *buf = p;
+    *size = new_size;
+  }
+  memcpy(*buf + *len, text, n);
+  *len += n;
+  (*buf)[*len] = '\0';
+  return 0;
+}
+
+/* Commands come from the terminal with a prompt, or from the -c string or
+ * script without one. */
+static int read_line(CommandInput *in, const char *prompt, char **buf,
+                     size_t *size) {
+  ssize_t read;
+
+  if (in->source)
+    return getline(buf, size, in->source) < 0 ? -1 : 0;
+  if (in->use_events)
+    return event_loop_read_line(&in->events, prompt, buf, size);
+  return prompt_and_read(prompt, buf, &read, size);
+}
+
+static int input_ended(CommandInput *in) {
+  if (in->source)
+    return feof(in->source);
+  return in->use_events ? in->events.eof : feof(stdin);
+}
+
+static int read_error(CommandInput *in, int *exit_status) {
+  FILE *source = in->source ? in->source : stdin;
+
+  if (errno == EINTR) {
+    clearerr(source);
+    return 1;
+  }
+  if (input_ended(in)) {
+    /* A script ends with the status of its last command. */
+    if (in->source)
+      *exit_status = last_exit_status;
+    else
+      fprintf(stderr, "\n");
+    return -1;
+  }
+  perror("getline");
+  *exit_status = EXIT_FAILURE;
+  return -1;
+}
+
+static void strip_newlines(CommandInput *in) {
+  while (in->raw_len > 0 && in->raw[in->raw_len - 1] == '\n')
+    in->raw[--in->raw_len] = '\0';
+}
+
+/* Reads one complete command. A line found in the pipeline cache is not
+ * lexed at all. Otherwise, while the lexer reports that the command goes
+ * on (open quotes, a trailing backslash or `|`), continuation lines are
+ * appended to the line buffer and only the new text is lexed.
+ * Returns 0 when the tokens are ready, 1 when there is nothing to run and -1
+ * when the shell should stop reading. */
+static int read_command(CommandInput *in, TokenVector *tokens,
+                        int *exit_status) {
+  int status;
+
+  if (read_line(in, "YegaShell> ", &in->line, &in->size) < 0)
+    return read_error(in, exit_status);
+
+  /* The tokenizer rewrites the line in place, so keep the original text. */
+  in->len = strlen(in->line);
+  in->raw_len = 0;
+  if (append_text(&in->raw, &in->raw_size, &in->raw_len, in->line, in->len) <
+      0)
+    return 1;
+
+  /* A cached line was a complete command when it was stored, so it is one
+   * now as well. */
+  size_t key_len = in->raw_len;
+  while (key_len > 0 && in->raw[key_len - 1] == '\n')
+    key_len--;
+  in->cached = NULL;
+  if (key_len > 0)
+    in->cached = pipeline_cache_lookup(&pipeline_cache, in->raw, key_len);
+  if (in->cached) {
+    strip_newlines(in);
+    return 0;
+  }
+
+  lexer_reset(&in->lexer, tokens);
+  while ((status = lexer_feed(&in->lexer, in->line, in->len, tokens)) ==
+         LEX_INCOMPLETE) {
+    if (read_line(in, "> ", &in->next, &in->next_size) < 0) {
+      if (errno == EINTR || !input_ended(in))
+        return read_error(in, exit_status);
+      status = lexer_finish(&in->lexer, in->line, tokens);
+      break;
+    }
+
+    size_t n = strlen(in->next);
+    if (append_text(&in->line, &in->size, &in->len, in->next, n) < 0 ||
+        append_text(&in->raw, &in->raw_size, &in->raw_len, in->next, n) < 0)
+      return 1;
+  }
+  if (status < 0) {
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  strip_newlines(in);
+  return 0;
+}
+
+/* Tells whether the command just read was the last one. */
+static int input_exhausted(CommandInput *in) {
+  int c;
+
+  if (!in->source)
+    return 0;
+  if ((c = getc(in->source)) == EOF)
+    return 1;
+  ungetc(c, in->source);
+  return 0;
+}
+
+static void free_command_input(CommandInput *in) {
+  free(in->line);
+  free(in->next);
+  free(in->raw);
+  if (in->source)
+    fclose(in->source);
+  if (in->use_events)
+    event_loop_free(&in->events);
+}
+
+/* YEGA_SPAWN picks the spawn backend at startup. The zygote is started
+ * here, while the shell is still small. */
+static void select_spawn_backend(void) {
+  Variable *vp = lookup("YEGA_SPAWN");
+
+  if (vp && set_spawn_backend(vp->value) < 0)
+    fprintf(stderr, "shell: unknown spawn backend '%s'\n", vp->value);
+  if (spawn_backend == SPAWN_ZYGOTE && zygote_start() < 0)
+    set_spawn_backend("fork");
+}
+
+/* `-c string` runs the string and `script` runs the file; without arguments
+ * the shell reads the terminal. Returns 0 when the input is ready and -1
+ * when the shell should exit with *exit_status right away. */
+static int open_input(int argc, char *argv[], CommandInput *in,
+                      int *exit_status) {
+  if (argc < 2)
+    return 0;
+
+  if (strcmp(argv[1], "-c") == 0) {
+    if (argc < 3) {
+      fprintf(stderr, "shell: -c: option requires an argument\n");
+      *exit_status = 2;
+      return -1;
+    }
+    /* fmemopen() rejects an empty buffer; there is nothing to run anyway. */
+    if (argv[2][0] == '\0')
+      return -1;
+    in->source = fmemopen(argv[2], strlen(argv[2]), "r");
+    if (!in->source) {
+      perror("shell: fmemopen");
+      *exit_status = 2;
+      return -1;
+    }
+  } else {
+    in->source = fopen(argv[1], "re");
+    if (!in->source) {
+      fprintf(stderr, "shell: %s: %s\n", argv[1], strerror(errno));
+      *exit_status = 127;
+      return -1;
+    }
+  }
+  shell_interactive = 0;
+  return 0;
+}
+
+int shell(int argc, char *argv[]) {
+  TokenVector tokens = {0};
+  CommandInput input = {0};
   Command *command_ptr = NULL;
   Process *process_ptr = NULL;
   Job *job_ptr = NULL;
-  ssize_t read;
-  size_t buffsize = 0;
-  int token_num, token_status, prompt_status, executor_status;
+  int read_status, executor_status;
   int exit_status = 0;
 
-  pid_t shell_pgid = getpid();
-  if (setpgid(shell_pgid, shell_pgid) < 0) {
-    perror("shell: setpgid failed");
-    exit(EXIT_FAILURE);
-  }
-  if (tcsetpgrp(STDIN_FILENO, shell_pgid) < 0) {
-    perror("shell: tcsetpgrp failed");
-  }
+  if (open_input(argc, argv, &input, &exit_status) < 0)
+    return exit_status;
 
-  ignore_job_control_signals();
+  if (shell_interactive) {
+    pid_t shell_pgid = getpid();
+    if (setpgid(shell_pgid, shell_pgid) < 0) {
+      perror("shell: setpgid failed");
+      exit(EXIT_FAILURE);
+    }
+    if (tcsetpgrp(STDIN_FILENO, shell_pgid) < 0) {
+      perror("shell: tcsetpgrp failed");
+    }
+    ignore_job_control_signals();
+  }
   init_shell_signals();
+  if (!input.source)
+    input.use_events = event_loop_init(&input.events, &job_ptr) == 0;
+  if (import_environment(environ) < 0)
+    fprintf(stderr, "shell: failed to import the environment\n");
+  select_spawn_backend();
+  arena_init(&line_arena, ARENA_BLOCK_SIZE);
+  pipeline_cache_init(&pipeline_cache, PIPELINE_CACHE_SIZE);
+  if (command_table_init() < 0)
+    fprintf(stderr, "shell: failed to build the command table\n");
 
   /* ----- Prompt Phase ----- */
   while (1) {
+    arena_reset(&line_arena);
     if (interrupted) {
       interrupted = 0;
       continue;
     }
     if (child_changed) {
       child_changed = 0;
-      mark_bg_jobs(&job_ptr, pending_bg_jobs, pending_indx);
+      mark_bg_jobs();
       notify_bg_jobs(&job_ptr);
     }
-    prompt_status = prompt_and_read(&line_buffer, &read, &buffsize);
-    if (prompt_status < 0) {
-      if (errno == EINTR) {
-        clearerr(stdin);
-        continue;
-      } else if (feof(stdin)) {
-        fprintf(stderr, "\n");
-        break; // safe
-      } else {
-        perror("getline");
-        exit_status = EXIT_FAILURE;
-        break;
-      }
-    }
-    if (read > 0 && line_buffer[read - 1] == '\n')
-      line_buffer[read - 1] = '\0';
 
     /* ----- Tokenization Phase ----- */
-    token_num = 0;
-    token_status =
-        tokenize_line(line_buffer, tokens, MAXTOKENS, MAXLEN, &token_num);
-    if (token_status < 0) {
-      fprintf(stderr, "\n");
-      free_memory(tokens, token_num);
-      continue;
-    }
-    if (token_num == 0)
+    read_status = read_command(&input, &tokens, &exit_status);
+    if (read_status < 0)
+      break;
+    if (read_status > 0 || (!input.cached && tokens.count == 0))
       continue;
 
     /* ----- Process Phase ----- */
-    Process *proc_head =
-        initalize_processes(tokens, token_num, &command_ptr, &process_ptr);
+    Process *proc_head;
+    if (input.cached) {
+      proc_head = pipeline_instantiate(input.cached, &command_ptr,
+                                       &process_ptr, &line_arena);
+    } else {
+      proc_head = initalize_processes(input.line, tokens.items, tokens.count,
+                                      &command_ptr, &process_ptr, &line_arena);
+      if (proc_head)
+        pipeline_cache_store(&pipeline_cache, input.raw, input.raw_len,
+                             proc_head);
+    }
+    if (proc_head == NULL)
+      continue;
+    expand_processes(proc_head, &line_arena);
+    if (take_resource_prefixes(proc_head, &line_arena) < 0)
+      continue;
 
-    int func_num = is_bulitin(proc_head);
+    /* A builtin alone runs here; in a pipeline, in the background or when
+     * it may block it is a stage of a job. */
+    int func_num = proc_head->next || command_ptr->background
+                       ? -1
+                       : is_bulitin(proc_head);
+    if (func_num != -1 &&
+        builtin_commands[func_num].in_process == BUILTIN_BLOCKING)
+      func_num = -1;
     if (func_num != -1) {
       if (builtin_routine(func_num, proc_head, &job_ptr, &process_ptr,
                           &command_ptr) < 0) {
         exit_status = last_exit_status;
-        free_memory(tokens, token_num);
         break;
       }
     }
 
     /* ---- Job Control Phase ----- */
     else {
-      Job *new_job =
-          initialize_job_control(line_buffer, command_ptr, proc_head, &job_ptr);
+      Job *new_job = initialize_job_control(input.raw, command_ptr, proc_head,
+                                            &job_ptr, &line_arena);
       if (new_job == NULL) {
         fprintf(stderr, "Error: job control\n");
-        free_memory(tokens, token_num);
         continue;
       }
 
+      /* Tail exec: the last command of a -c string or script, with no
+       * other job left to wait for, takes over the shell's process. */
+      if (!shell_interactive && !new_job->background && job_ptr == new_job &&
+          !new_job->next && input_exhausted(&input))
+        exec_in_place(new_job);
+
       /* ---- Executor Phase ----- */
       executor_status = executor(new_job, &job_ptr);
       if (executor_status == -1) {
         fprintf(stderr, "failed to execute\n");
         exit_status = EXIT_FAILURE;
-        free_memory(tokens, token_num);
         process_ptr = NULL;
         command_ptr = NULL;
         break;
       }
+
+      /* A job still in the list is running in the background or stopped;
+       * move it out of the arena before the next reset, and have the
+       * prompt watch for its end. */
+      Job *kept = persist_job(new_job, &job_ptr);
+      if (kept && input.use_events)
+        event_loop_watch_job(&input.events, kept);
     }
 
     /* ----- Cleanup Phase ----- */
-    free_memory(tokens, token_num);
     process_ptr = NULL;
     command_ptr = NULL;
   }
 
   /* ----- Exit Phase ----- */
-  clean_up(&job_ptr, line_buffer);
+  free_memory(&tokens);
+  clean_up(&job_ptr, input.line);
+  input.line = NULL;
+  job_table_free();
+  capture_free_all();
+  jobserver_stop();
+  free_command_input(&input);
+  arena_free(&line_arena);
+  pipeline_cache_clear(&pipeline_cache);
+  zygote_stop();
+  command_table_free();
+  free_variable_table();
   return exit_status;
 }
@@ -3,8 +3,8 @@
  * @brief Utilities for handling environment variables.
  *         Adds, deletes, and updates environment variables.
  *         Creates the envp array of pointers.
- *         Envoronment variables are stored in a hash table
- *         implemented as a linked list.
+ *         Envoronment variables are stored in an open-addressing hash
+ *         table that is resized incrementally.
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
@@ -16,89 +16,234 @@
 #include <unistd.h>
 
 #include "env_utils.h"
+#include "hash.h"
 
-static unsigned hash(const char *s);
+#define MIGRATE_STEP 32
 
-Variable *variable_table[TABLESIZE] = {NULL};
+static Variable deleted_variable;
+#define DELETED (&deleted_variable)
 
-static unsigned hash(const char *s) {
-  unsigned hashval = 0;
-  while (*s)
-    hashval = *s++ + 31 * hashval;
-  return hashval % TABLESIZE;
+VariableTable variable_table;
+
+static VariableSlot *find_slot(VariableSlot *slots, size_t mask, uint64_t h,
+                               const char *key, size_t len);
+static VariableSlot *find_variable(uint64_t h, const char *key, size_t len);
+static void place(VariableSlot *slots, size_t mask, uint64_t h, Variable *vp);
+static void migrate(size_t steps);
+static int grow(void);
+static Variable *set_variable(const char *key, size_t len, const char *value,
+                              int exported);
+static char *make_entry(const char *key, size_t len, const char *value);
+
+static VariableSlot *find_slot(VariableSlot *slots, size_t mask, uint64_t h,
+                               const char *key, size_t len) {
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    VariableSlot *slot = &slots[i];
+    if (!slot->var)
+      return NULL;
+    if (slot->var != DELETED && slot->hash == h &&
+        memcmp(slot->var->key, key, len) == 0 && slot->var->key[len] == '\0')
+      return slot;
+  }
 }
 
-/* --- Lookup a variable by key --- */
-Variable *lookup(const char *key) {
-  for (Variable *vp = variable_table[hash(key)]; vp; vp = vp->next)
-    if (strcmp(key, vp->key) == 0)
-      return vp;
-  return NULL;
+/* Returns the slot of a variable in either table. */
+static VariableSlot *find_variable(uint64_t h, const char *key, size_t len) {
+  VariableTable *t = &variable_table;
+  VariableSlot *slot = NULL;
+
+  if (!t->slots)
+    return NULL;
+  migrate(MIGRATE_STEP);
+  slot = find_slot(t->slots, t->mask, h, key, len);
+  if (!slot && t->old)
+    slot = find_slot(t->old, t->old_mask, h, key, len);
+  return slot;
 }
 
-Variable *add_variable(const char *key, const char *value, int exported) {
-  Variable *vp = lookup(key);
-  if (!vp) {
-    vp = malloc(sizeof(Variable));
-    if (!vp) {
-      perror("malloc");
-      return NULL;
+static void place(VariableSlot *slots, size_t mask, uint64_t h, Variable *vp) {
+  size_t i = h & mask;
+  while (slots[i].var && slots[i].var != DELETED)
+    i = (i + 1) & mask;
+  if (!slots[i].var)
+    variable_table.used++;
+  slots[i].hash = h;
+  slots[i].var = vp;
+}
+
+/* Moves up to steps slots of the old table. Moved slots are marked deleted
+ * rather than emptied so that probes for the rest still get past them. */
+static void migrate(size_t steps) {
+  VariableTable *t = &variable_table;
+
+  while (t->old && steps-- > 0) {
+    if (t->migrated > t->old_mask) {
+      free(t->old);
+      t->old = NULL;
+      break;
     }
-    vp->key = strdup(key);
-    vp->value = strdup(value);
-    if (!vp->key || !vp->value) {
-      perror("strdup");
-      free(vp->key);
-      free(vp->value);
-      free(vp);
-      return NULL;
+    VariableSlot *slot = &t->old[t->migrated++];
+    if (slot->var && slot->var != DELETED) {
+      place(t->slots, t->mask, slot->hash, slot->var);
+      slot->var = DELETED;
+      t->old_live--;
     }
-    vp->exported = exported;
-    /* Insert at head of chain */
-    unsigned idx = hash(key);
-    vp->next = variable_table[idx];
-    variable_table[idx] = vp;
-  } else {
-    /* Found: overwrite value and exported flag */
-    free(vp->value);
-    vp->value = strdup(value);
-    if (!vp->value) {
-      perror("strdup");
+  }
+}
+
+/* Starts moving to a fresh table. It is twice as big unless most of the
+ * used slots only hold deleted entries. */
+static int grow(void) {
+  VariableTable *t = &variable_table;
+  size_t size = t->slots ? t->mask + 1 : VARIABLE_TABLE_MIN;
+
+  migrate(SIZE_MAX);
+  if (t->slots && t->count * 2 >= size)
+    size *= 2;
+
+  VariableSlot *slots = calloc(size, sizeof *slots);
+  if (!slots) {
+    perror("calloc");
+    return -1;
+  }
+  t->old = t->slots;
+  t->old_mask = t->mask;
+  t->old_live = t->count;
+  t->migrated = 0;
+  t->slots = slots;
+  t->mask = size - 1;
+  t->used = 0;
+  return 0;
+}
+
+/* Builds the "KEY=VALUE" string a variable is stored as, which is also its
+ * envp entry. */
+static char *make_entry(const char *key, size_t len, const char *value) {
+  size_t value_len = strlen(value);
+  char *entry = malloc(len + 1 + value_len + 1);
+  if (!entry) {
+    perror("malloc");
+    return NULL;
+  }
+  memcpy(entry, key, len);
+  entry[len] = '=';
+  memcpy(entry + len + 1, value, value_len + 1);
+  return entry;
+}
+
+static Variable *set_variable(const char *key, size_t len, const char *value,
+                              int exported) {
+  VariableTable *t = &variable_table;
+  uint64_t h = hash_bytes(key, len);
+  VariableSlot *slot = find_variable(h, key, len);
+
+  if (slot) {
+    /* Found: overwrite value and exported flag. The new value may be the old
+     * one, so copy before freeing. */
+    Variable *vp = slot->var;
+    char *entry = make_entry(key, len, value);
+    if (!entry)
       return NULL;
-    }
+    if (vp->exported || exported)
+      t->generation++;
+    free(vp->entry);
+    vp->entry = entry;
+    vp->value = entry + len + 1;
     vp->exported = exported;
+    return vp;
+  }
+
+  if (!t->slots || (t->used + t->old_live + 1) * 4 > (t->mask + 1) * 3)
+    if (grow() < 0)
+      return NULL;
+
+  Variable *vp = malloc(sizeof *vp + len + 1);
+  if (!vp) {
+    perror("malloc");
+    return NULL;
   }
+  vp->key = (char *)(vp + 1);
+  memcpy(vp->key, key, len);
+  vp->key[len] = '\0';
+  vp->entry = make_entry(key, len, value);
+  if (!vp->entry) {
+    free(vp);
+    return NULL;
+  }
+  vp->value = vp->entry + len + 1;
+  vp->exported = exported;
+  if (exported)
+    t->generation++;
+
+  place(t->slots, t->mask, h, vp);
+  t->count++;
+  vp->next = NULL;
+  vp->prev = t->last;
+  if (t->last)
+    t->last->next = vp;
+  else
+    t->first = vp;
+  t->last = vp;
   return vp;
 }
 
-int remove_variable(const char *key) {
-  unsigned idx = hash(key);
-  Variable *vp = variable_table[idx];
-  Variable *prev = NULL;
+/* --- Lookup a variable by key --- */
+Variable *lookup(const char *key) { return lookup_len(key, strlen(key)); }
 
-  while (vp) {
-    if (strcmp(vp->key, key) == 0) {
-      if (prev)
-        prev->next = vp->next;
-      else
-        variable_table[idx] = vp->next;
-      free(vp->key);
-      free(vp->value);
-      free(vp);
-      return 0;
-    }
-    prev = vp;
-    vp = vp->next;
+Variable *lookup_len(const char *key, size_t len) {
+  VariableSlot *slot = find_variable(hash_bytes(key, len), key, len);
+  return slot ? slot->var : NULL;
+}
+
+Variable *add_variable(const char *key, const char *value, int exported) {
+  return set_variable(key, strlen(key), value, exported);
+}
+
+int import_environment(char **envp) {
+  for (; *envp; envp++) {
+    char *eq = strchr(*envp, '=');
+    if (!eq || eq == *envp)
+      continue;
+    if (!set_variable(*envp, eq - *envp, eq + 1, 1))
+      return -1;
   }
-  return -1;
+  return 0;
+}
+
+int remove_variable(const char *key) {
+  VariableTable *t = &variable_table;
+  size_t len = strlen(key);
+  uint64_t h = hash_bytes(key, len);
+  VariableSlot *slot = find_variable(h, key, len);
+
+  if (!slot)
+    return -1;
+
+  Variable *vp = slot->var;
+  if (t->old && slot >= t->old && slot <= t->old + t->old_mask)
+    t->old_live--;
+  slot->var = DELETED;
+  t->count--;
+  if (vp->exported)
+    t->generation++;
+
+  if (vp->prev)
+    vp->prev->next = vp->next;
+  else
+    t->first = vp->next;
+  if (vp->next)
+    vp->next->prev = vp->prev;
+  else
+    t->last = vp->prev;
+  free(vp->entry);
+  free(vp);
+  return 0;
 }
 
 void dump_variables(void) {
-  for (int i = 0; i < TABLESIZE; i++) {
-    for (Variable *vp = variable_table[i]; vp; vp = vp->next) {
-      printf("%s=%s %s\n", vp->key, vp->value,
-             vp->exported ? "(exported)" : "");
-    }
+  for (Variable *vp = variable_table.first; vp; vp = vp->next) {
+    dprintf(STDOUT_FILENO, "%s=%s %s\n", vp->key, vp->value,
+            vp->exported ? "(exported)" : "");
   }
 }
 
@@ -113,17 +258,17 @@ int is_valid_identifier(const char *s) {
 }
 
 void free_variable_table(void) {
-  for (int i = 0; i < TABLESIZE; i++) {
-    Variable *vp = variable_table[i];
-    while (vp) {
-      Variable *next = vp->next;
-      free(vp->key);
-      free(vp->value);
-      free(vp);
-      vp = next;
-    }
-    variable_table[i] = NULL;
+  Variable *vp = variable_table.first;
+  while (vp) {
+    Variable *next = vp->next;
+    free(vp->entry);
+    free(vp);
+    vp = next;
   }
+  free(variable_table.slots);
+  free(variable_table.old);
+  free(variable_table.envp);
+  memset(&variable_table, 0, sizeof variable_table);
 }
 
 int parse_key_value_inplace(char *input, char **key_out, char **val_out) {
@@ -143,11 +288,11 @@ char *get_full_path(const char *command) {
     return NULL;
   }
 
-  char *path = getenv("PATH");
+  Variable *path = lookup("PATH");
   if (!path)
     return NULL;
 
-  char *paths = strdup(path);
+  char *paths = strdup(path->value);
   if (!paths)
     return NULL;
 
@@ -168,41 +313,31 @@ char *get_full_path(const char *command) {
 }
 
 char **build_envp(void) {
-  int count = 0;
-  for (int i = 0; i < TABLESIZE; i++)
-    for (Variable *vp = variable_table[i]; vp; vp = vp->next)
-      if (vp->exported)
-        count++;
-
-  char **envp = malloc((count + 1) * sizeof(char *));
-  if (!envp) {
-    perror("malloc envp array");
-    return NULL;
-  }
+  VariableTable *t = &variable_table;
+
+  if (t->envp && t->envp_generation == t->generation)
+    return t->envp;
 
-  int idx = 0;
-  for (int i = 0; i < TABLESIZE; i++) {
-    for (Variable *vp = variable_table[i]; vp; vp = vp->next) {
-      if (!vp->exported)
-        continue;
-
-      size_t len = strlen(vp->key) + 1 + strlen(vp->value) + 1;
-      char *entry = malloc(len);
-      if (!entry) {
-        perror("malloc envp entry");
-        for (int k = 0; k < idx; k++)
-          free(envp[k]);
-        free(envp);
-        return NULL;
-      }
-
-      snprintf(entry, len, "%s=%s", vp->key, vp->value);
-      envp[idx++] = entry;
+  if (t->envp_capacity < t->count + 1) {
+    size_t capacity = t->envp_capacity ? t->envp_capacity : 64;
+    while (capacity < t->count + 1)
+      capacity *= 2;
+    char **envp = realloc(t->envp, capacity * sizeof *envp);
+    if (!envp) {
+      perror("realloc envp array");
+      return NULL;
     }
+    t->envp = envp;
+    t->envp_capacity = capacity;
   }
 
-  envp[idx] = NULL;
-  return envp;
+  size_t idx = 0;
+  for (Variable *vp = t->first; vp; vp = vp->next)
+    if (vp->exported)
+      t->envp[idx++] = vp->entry;
+  t->envp[idx] = NULL;
+  t->envp_generation = t->generation;
+  return t->envp;
 }
 
 int initialize_envp(char ***envpp) {
@@ -211,9 +346,3 @@ int initialize_envp(char ***envpp) {
     return -1;
   return 0;
 }
-
-void free_envp(char **envp) {
-  for (int i = 0; envp[i]; i++)
-    free(envp[i]);
-  free(envp);
-}
\ No newline at end of file
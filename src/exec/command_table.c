@@ -0,0 +1,215 @@
+/**
+ * @file command_table.c
+ * @brief Parent-side table of command names. Builtins, executables found in
+ *         PATH and names that were not found are remembered, so a command is
+ *         searched in PATH once instead of once per fork.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "command_table.h"
+#include "env_utils.h"
+#include "hash.h"
+
+CommandTable command_table;
+
+/* Answers names containing a `/`, which are never entered. */
+static CommandEntry *scratch;
+static size_t scratch_size;
+
+static time_t now(void);
+static void check_path(void);
+static CommandEntry **find_link(uint64_t hash, const char *name);
+static CommandEntry *new_entry(uint64_t hash, const char *name);
+static void resolve(CommandEntry *entry);
+static const CommandEntry *find_pathname(const char *name);
+
+static time_t now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+/* Forgets what was found when PATH is not the one it was found in. */
+static void check_path(void) {
+  Variable *vp = lookup("PATH");
+  const char *path = vp ? vp->value : NULL;
+
+  if (path == command_table.path)
+    return;
+  if (path && command_table.path && strcmp(path, command_table.path) == 0)
+    return;
+
+  command_table_forget();
+  free(command_table.path);
+  command_table.path = path ? strdup(path) : NULL;
+}
+
+static CommandEntry **find_link(uint64_t hash, const char *name) {
+  CommandEntry **link =
+      &command_table.buckets[hash & (COMMAND_TABLE_BUCKETS - 1)];
+
+  for (; *link; link = &(*link)->next) {
+    if ((*link)->hash == hash && strcmp((*link)->name, name) == 0)
+      break;
+  }
+  return link;
+}
+
+static CommandEntry *new_entry(uint64_t hash, const char *name) {
+  size_t len = strlen(name);
+  CommandEntry *entry = calloc(1, sizeof *entry + len + 1);
+
+  if (!entry) {
+    perror("calloc for command entry failed");
+    return NULL;
+  }
+  entry->hash = hash;
+  entry->builtin = -1;
+  memcpy(entry->name, name, len + 1);
+
+  CommandEntry **bucket =
+      &command_table.buckets[hash & (COMMAND_TABLE_BUCKETS - 1)];
+  entry->next = *bucket;
+  *bucket = entry;
+  command_table.count++;
+  return entry;
+}
+
+static void resolve(CommandEntry *entry) {
+  free(entry->path);
+  entry->path = get_full_path(entry->name);
+  entry->kind = entry->path ? COMMAND_FILE : COMMAND_NOT_FOUND;
+  entry->expires = entry->path ? 0 : now() + COMMAND_NEGATIVE_TTL;
+}
+
+static const CommandEntry *find_pathname(const char *name) {
+  size_t len = strlen(name);
+
+  if (scratch_size < len + 1) {
+    CommandEntry *entry = realloc(scratch, sizeof *entry + len + 1);
+    if (!entry) {
+      perror("realloc for command entry failed");
+      return NULL;
+    }
+    scratch = entry;
+    scratch_size = len + 1;
+  }
+  memset(scratch, 0, sizeof *scratch);
+  memcpy(scratch->name, name, len + 1);
+  scratch->builtin = -1;
+  if (access(name, X_OK) == 0) {
+    scratch->kind = COMMAND_FILE;
+    scratch->path = scratch->name;
+  } else if (errno == EACCES) {
+    scratch->kind = COMMAND_DENIED;
+    scratch->path = scratch->name;
+  }
+  return scratch;
+}
+
+int command_table_init(void) {
+  for (int i = 0; builtin_commands[i].name != NULL; i++) {
+    const char *name = builtin_commands[i].name;
+    uint64_t hash = hash_string(name);
+
+    if (*find_link(hash, name))
+      continue;
+    CommandEntry *entry = new_entry(hash, name);
+    if (!entry)
+      return -1;
+    entry->kind = COMMAND_BUILTIN;
+    entry->builtin = i;
+  }
+  return 0;
+}
+
+int command_table_add_builtin(const char *name, int builtin) {
+  uint64_t hash = hash_string(name);
+  CommandEntry *entry = *find_link(hash, name);
+
+  if (!entry && !(entry = new_entry(hash, name)))
+    return -1;
+  free(entry->path);
+  entry->path = NULL;
+  entry->kind = COMMAND_BUILTIN;
+  entry->builtin = builtin;
+  return 0;
+}
+
+const CommandEntry *find_command(const char *name) {
+  if (strchr(name, '/'))
+    return find_pathname(name);
+
+  check_path();
+
+  uint64_t hash = hash_string(name);
+  CommandEntry *entry = *find_link(hash, name);
+
+  if (entry) {
+    int stale = 0;
+    if (entry->kind == COMMAND_FILE)
+      stale = access(entry->path, X_OK) < 0;
+    else if (entry->kind == COMMAND_NOT_FOUND)
+      stale = now() >= entry->expires;
+
+    if (!stale) {
+      command_table.hits++;
+      entry->hits++;
+      return entry;
+    }
+  } else {
+    entry = new_entry(hash, name);
+    if (!entry)
+      return NULL;
+  }
+
+  command_table.misses++;
+  resolve(entry);
+  return entry;
+}
+
+void command_table_forget(void) {
+  for (size_t i = 0; i < COMMAND_TABLE_BUCKETS; i++) {
+    CommandEntry **link = &command_table.buckets[i];
+    while (*link) {
+      CommandEntry *entry = *link;
+      if (entry->kind == COMMAND_BUILTIN) {
+        link = &entry->next;
+        continue;
+      }
+      *link = entry->next;
+      free(entry->path);
+      free(entry);
+      command_table.count--;
+    }
+  }
+}
+
+void command_table_free(void) {
+  for (size_t i = 0; i < COMMAND_TABLE_BUCKETS; i++) {
+    CommandEntry *entry = command_table.buckets[i];
+    while (entry) {
+      CommandEntry *next = entry->next;
+      free(entry->path);
+      free(entry);
+      entry = next;
+    }
+    command_table.buckets[i] = NULL;
+  }
+  command_table.count = 0;
+  free(command_table.path);
+  command_table.path = NULL;
+  free(scratch);
+  scratch = NULL;
+  scratch_size = 0;
+}
@@ -0,0 +1,244 @@
+/**
+ * @file cpu_topology.c
+ * @brief Reading the CPU topology from sysfs and choosing the CPUs of the
+ *         stages of a job from it.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu_topology.h"
+#include "resource_control.h"
+
+/* The cache indices looked at under cpuN/cache. */
+#define CACHE_INDICES 16
+
+typedef struct {
+  int cpu;
+  int package;
+  int core;
+  int rank;   /* Which hardware thread of its core it is. */
+  int domain; /* The lowest CPU sharing its last level cache. */
+} CpuInfo;
+
+static int read_file(const char *path, char *buf, size_t size);
+static int read_number(const char *path, int fallback);
+static int last_level_cache(const char *root, int cpu);
+static int compare_cpus(const void *a, const void *b);
+static int build_spread(CpuTopology *topo);
+
+static int read_file(const char *path, char *buf, size_t size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  ssize_t n = read(fd, buf, size - 1);
+  close(fd);
+  if (n <= 0)
+    return -1;
+  buf[n] = '\0';
+  buf[strcspn(buf, "\n")] = '\0';
+  return 0;
+}
+
+static int read_number(const char *path, int fallback) {
+  char buf[32];
+  return read_file(path, buf, sizeof buf) == 0 ? atoi(buf) : fallback;
+}
+
+/* Returns the lowest CPU sharing the highest data cache of cpu, or cpu
+ * itself if the caches cannot be read. */
+static int last_level_cache(const char *root, int cpu) {
+  char path[PATH_MAX], buf[256];
+  int best_level = 0, domain = cpu;
+
+  for (int i = 0; i < CACHE_INDICES; i++) {
+    snprintf(path, sizeof path, "%s/cpu%d/cache/index%d/type", root, cpu, i);
+    if (read_file(path, buf, sizeof buf) < 0)
+      break;
+    if (strcmp(buf, "Instruction") == 0)
+      continue;
+
+    snprintf(path, sizeof path, "%s/cpu%d/cache/index%d/level", root, cpu, i);
+    int level = read_number(path, 0);
+    snprintf(path, sizeof path, "%s/cpu%d/cache/index%d/shared_cpu_list", root,
+             cpu, i);
+    cpu_set_t shared;
+    if (level <= best_level || read_file(path, buf, sizeof buf) < 0 ||
+        parse_cpu_list(buf, &shared) < 0)
+      continue;
+
+    best_level = level;
+    domain = 0;
+    while (domain < CPU_SETSIZE && !CPU_ISSET(domain, &shared))
+      domain++;
+  }
+  return domain;
+}
+
+static int compare_cpus(const void *a, const void *b) {
+  const CpuInfo *x = a, *y = b;
+
+  if (x->package != y->package)
+    return x->package - y->package;
+  if (x->domain != y->domain)
+    return x->domain - y->domain;
+  if (x->rank != y->rank)
+    return x->rank - y->rank;
+  return x->cpu - y->cpu;
+}
+
+/* Orders the domains so that consecutive entries are in different packages
+ * while there are any: the first domain of each package, then the second
+ * ones, and so on. */
+static int build_spread(CpuTopology *topo) {
+  size_t n = 0;
+
+  topo->spread = malloc(topo->num_domains * sizeof *topo->spread);
+  if (!topo->spread)
+    return -1;
+  for (size_t round = 0; n < topo->num_domains; round++) {
+    size_t start = 0;
+    while (start < topo->num_domains) {
+      size_t end = start;
+      while (end < topo->num_domains &&
+             topo->domains[end].package == topo->domains[start].package)
+        end++;
+      if (start + round < end)
+        topo->spread[n++] = start + round;
+      start = end;
+    }
+  }
+  return 0;
+}
+
+int cpu_topology_load(CpuTopology *topo, const char *root,
+                      const cpu_set_t *allowed) {
+  char path[PATH_MAX], buf[1024];
+  cpu_set_t online;
+  CpuInfo *info = NULL;
+  size_t n = 0;
+
+  memset(topo, 0, sizeof *topo);
+  snprintf(path, sizeof path, "%s/online", root);
+  if (read_file(path, buf, sizeof buf) < 0 || parse_cpu_list(buf, &online) < 0)
+    online = *allowed;
+
+  info = malloc(CPU_SETSIZE * sizeof *info);
+  if (!info)
+    return -1;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, allowed) || !CPU_ISSET(cpu, &online))
+      continue;
+    CpuInfo *c = &info[n++];
+    c->cpu = cpu;
+    snprintf(path, sizeof path, "%s/cpu%d/topology/physical_package_id", root,
+             cpu);
+    c->package = read_number(path, 0);
+    snprintf(path, sizeof path, "%s/cpu%d/topology/core_id", root, cpu);
+    c->core = read_number(path, cpu);
+    c->domain = last_level_cache(root, cpu);
+    c->rank = 0;
+    for (size_t i = 0; i + 1 < n; i++) {
+      if (info[i].package == c->package && info[i].core == c->core)
+        c->rank++;
+    }
+  }
+  if (n == 0) {
+    free(info);
+    return -1;
+  }
+  qsort(info, n, sizeof *info, compare_cpus);
+
+  topo->cpus = malloc(n * sizeof *topo->cpus);
+  topo->domains = malloc(n * sizeof *topo->domains);
+  if (!topo->cpus || !topo->domains) {
+    free(info);
+    cpu_topology_free(topo);
+    return -1;
+  }
+  for (size_t i = 0; i < n; i++) {
+    topo->cpus[i] = info[i].cpu;
+    if (i == 0 || info[i].package != info[i - 1].package ||
+        info[i].domain != info[i - 1].domain)
+      topo->domains[topo->num_domains++] =
+          (CacheDomain){.package = info[i].package, .first = i};
+    topo->domains[topo->num_domains - 1].count++;
+  }
+  topo->num_cpus = n;
+  free(info);
+
+  if (build_spread(topo) < 0) {
+    cpu_topology_free(topo);
+    return -1;
+  }
+  return 0;
+}
+
+void cpu_topology_free(CpuTopology *topo) {
+  free(topo->cpus);
+  free(topo->domains);
+  free(topo->spread);
+  memset(topo, 0, sizeof *topo);
+}
+
+CpuTopology *system_topology(void) {
+  static CpuTopology topo;
+  static int state; // 0 not read yet, 1 read, -1 unreadable
+
+  if (state == 0) {
+    cpu_set_t allowed;
+    state = sched_getaffinity(0, sizeof allowed, &allowed) == 0 &&
+                    cpu_topology_load(&topo, CPU_TOPOLOGY_ROOT, &allowed) == 0
+                ? 1
+                : -1;
+  }
+  return state > 0 ? &topo : NULL;
+}
+
+void placement_start(Placement *placement, CpuTopology *topo,
+                     int num_stages) {
+  size_t domain = topo->spread[topo->next_job++ % topo->num_domains];
+  size_t first = domain, end = domain + 1;
+
+  // domains are ordered by package, so its CPUs are one range
+  while (first > 0 &&
+         topo->domains[first - 1].package == topo->domains[domain].package)
+    first--;
+  while (end < topo->num_domains &&
+         topo->domains[end].package == topo->domains[domain].package)
+    end++;
+
+  placement->topo = topo;
+  placement->domain = &topo->domains[domain];
+  placement->package_first = topo->domains[first].first;
+  placement->package_count = topo->domains[end - 1].first +
+                             topo->domains[end - 1].count -
+                             placement->package_first;
+  placement->num_stages = num_stages;
+  placement->next_stage = 0;
+}
+
+void placement_next(Placement *placement, cpu_set_t *set) {
+  const CpuTopology *topo = placement->topo;
+  const CacheDomain *domain = placement->domain;
+
+  CPU_ZERO(set);
+  if (placement->num_stages <= 1) {
+    for (size_t i = 0; i < domain->count; i++)
+      CPU_SET(topo->cpus[domain->first + i], set);
+    return;
+  }
+  size_t offset = domain->first - placement->package_first +
+                  (size_t)placement->next_stage++;
+  CPU_SET(topo->cpus[placement->package_first +
+                     offset % placement->package_count],
+          set);
+}
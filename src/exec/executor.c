@@ -8,27 +8,61 @@
  * @date 2025-06-06
  */
 
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "command_table.h"
 #include "env_utils.h"
 #include "io_redirection.h"
+#include "job_capture.h"
 #include "job_control.h"
+#include "jobserver.h"
 #include "process_control.h"
+#include "resource_control.h"
 #include "signal_utils.h"
+#include "spawn_backend.h"
+#include "zygote.h"
 
+static int resolve_commands(Job *job);
 static int execute(Job *job, Job **job_head);
-static void cleanup_job_execution(int num_procs, JobResource *job_res, char **envp);
+static void cleanup_job_execution(int num_procs, JobResource *job_res);
+
+/* Looks every stage up in the command table before forking, so children
+ * exec a known path and builtin stages are known. A denied pathname keeps
+ * its path, so that its exec fails with EACCES, but does not count. Returns
+ * the number of stages that were found. */
+static int resolve_commands(Job *job) {
+  int found = 0;
+
+  for (Process *proc = job->first_process; proc; proc = proc->next) {
+    const CommandEntry *entry = find_command(proc->cmd->argv[0]);
+
+    proc->path = NULL;
+    proc->builtin = -1;
+    if (!entry || entry->kind == COMMAND_NOT_FOUND)
+      continue;
+    if (entry->kind == COMMAND_BUILTIN)
+      proc->builtin = entry->builtin;
+    else
+      proc->path = arena_strdup(job->arena, entry->path);
+    if (entry->kind != COMMAND_DENIED)
+      found++;
+  }
+  return found;
+}
 
 static int execute(Job *job, Job **job_head) {
   JobResource job_res;
   pid_t shell_pgid = getpid();
   pid_t pgid = 0;
   sigset_t parent_block_mask, prev_mask;
-  int local_num_procs = job->num_procs;
+  int local_num_procs;
   char **envp = NULL;
   
   if (initialize_envp(&envp) < 0)
@@ -36,19 +70,42 @@ static int execute(Job *job, Job **job_head) {
 
   if (setup_exec_resource(job, &job_res) < 0)
     return -1;
+  local_num_procs = job->num_procs;
+
+  /* A background job waits for a jobserver token before anything is
+   * opened, so Ctrl+C during the wait leaves nothing behind. */
+  if (job->background && jobserver_take(job, job_head) < 0)
+    return 1;
+
+  /* parallel collects its jobs' output itself. */
+  if (job->background && !job->quiet && capture_enabled() &&
+      capture_open(job) < 0)
+    return 1;
 
+  /* Running out of descriptors fails the command, not the shell. */
   if (create_pipes(job, &job_res) < 0)
-    return -1;
+    return 1;
 
   if (block_parent_signals(&parent_block_mask, &prev_mask, job) < 0)
     return -1;
 
-  if (fork_and_setup_processes(job, job_res, &pgid, &prev_mask, envp) < 0)
+  if (fork_and_setup_processes(job, job_res, &pgid, &prev_mask, envp,
+                               job_head) < 0)
     return -1;
+  capture_close_writer(job->capture);
+
+  /* Every stage was a builtin that ran in the shell; there is nothing to
+   * wait for. */
+  if (pgid == 0) {
+    sigprocmask(SIG_SETMASK, &prev_mask, NULL);
+    do_job_notification(job, job_head);
+    cleanup_job_execution(local_num_procs, &job_res);
+    return 0;
+  }
 
   setup_job_control(job, job_head, &prev_mask, shell_pgid);
 
-  cleanup_job_execution(local_num_procs, &job_res, envp);
+  cleanup_job_execution(local_num_procs, &job_res);
 
   return 0;
 }
@@ -60,7 +117,23 @@ int executor(Job *job, Job **job_head) {
     return -1;
   }
 
+  /* Nothing can run; only a denied stage still has a path. */
+  if (resolve_commands(job) == 0) {
+    for (Process *proc = job->first_process; proc; proc = proc->next) {
+      fprintf(stderr, "%s: %s\n", proc->cmd->argv[0],
+              proc->path ? strerror(EACCES) : "command not found");
+      last_exit_status = proc->path ? 126 : 127;
+    }
+    free_job(job, job_head);
+    return 0;
+  }
+
   int execute_status = execute(job, job_head);
+  if (execute_status > 0) {
+    last_exit_status = 1;
+    free_job(job, job_head);
+    return 0;
+  }
   if (execute_status < 0) {
     free_job(job, job_head);
     printf("job freed\n in execute_status < 0\n");
@@ -69,8 +142,37 @@ int executor(Job *job, Job **job_head) {
   return execute_status;
 }
 
-static void cleanup_job_execution(int num_procs, JobResource *job_res, char **envp) {
+void exec_in_place(Job *job) {
+  Process *proc = job->first_process;
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  ResourceSettings resources;
+  char **envp = NULL;
+  sigset_t mask;
+
+  if (!proc || proc->next || resolve_commands(job) == 0 || !proc->path)
+    return;
+  if (initialize_envp(&envp) < 0 || sigprocmask(SIG_SETMASK, NULL, &mask) < 0)
+    return;
+
+  /* The command inherits the shell's pid, group and descriptors; nothing
+   * the shell buffered or started may outlive it. */
+  SpawnPlan plan = {
+      .path = proc->path,
+      .argv = proc->cmd->argv,
+      .envp = envp,
+      .pgid = -1,
+      .mask = &mask,
+      .actions = actions,
+      .num_actions = jobserver_child_actions(
+          actions, build_child_actions(proc->cmd, NULL, 0, 1, actions)),
+      .resources =
+          merge_resources(&resources, proc->resources) ? &resources : NULL,
+  };
+  fflush(NULL);
+  zygote_stop();
+  exec_child(&plan);
+}
+
+static void cleanup_job_execution(int num_procs, JobResource *job_res) {
   close_pipe_ends(num_procs, job_res->pipes);
-  free_pipes(job_res->pipes);
-  free_envp(envp); 
 }
@@ -1,34 +1,57 @@
 /**
  * @file process_control.c
- * @brief Handles forking and setting up child and parent processes.
- *         Includes utilities for creating and freeing pipes.
+ * @brief Handles starting child processes and setting up the parent side.
+ *         Includes utilities for creating pipes.
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
 
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include "builtin.h"
+#include "cpu_topology.h"
 #include "env_utils.h"
-#include "expander.h"
 #include "io_redirection.h"
+#include "job_capture.h"
+#include "job_control.h"
 #include "job_utils.h"
+#include "jobserver.h"
 #include "process_control.h"
-#include "signal_utils.h"
+#include "resource_control.h"
+#include "spawn_backend.h"
 
-static void exec_command(Command *cmd, char **envp);
+/* Descriptors the shell keeps besides the pipes: stdio, the terminal and
+ * whatever a redirection opens while the pipes exist. */
+#define RESERVED_FDS 16
+
+static int raise_fd_limit(int num_procs);
+static void set_pipe_size(Job *job, JobResource *job_res);
+static CpuTopology *placement_topology(void);
 static int allocate_pipe(Job *job, JobResource *job_res);
 static int allocate_pids(Job *job);
-static void child_setup(pid_t pgid, sigset_t *prev_mask, int (*pipes)[],
-                        int proc_num, Command *cmd, Job *job, char **envp);
 static void parent_setup(pid_t *pgid, int pid, int proc_num, int (*pipes)[2],
                          Process *proc, Job *job);
+static int run_builtin(void *arg);
+static int run_stage_in_shell(Job *job, int (*pipes)[2], Process *proc,
+                              int proc_num, Job **job_head);
+
+/* What a builtin stage forked without exec needs. */
+typedef struct {
+  Process *proc;
+  Job **job_head;
+} BuiltinStage;
 
 int setup_exec_resource(Job *job, JobResource *job_res) {
   job->num_procs = get_num_procs(job);
@@ -36,48 +59,199 @@ int setup_exec_resource(Job *job, JobResource *job_res) {
   if (allocate_pipe(job, job_res) < 0)
     return -1;
 
-  if (allocate_pids(job) < 0) {
-    free(job_res->pipes);
+  if (allocate_pids(job) < 0)
     return -1;
-  }
 
   return 0;
 }
 
 int create_pipes(Job *job, JobResource *job_res) {
+  if (raise_fd_limit(job->num_procs) < 0)
+    return -1;
+
   for (int num = 0; num < job->num_procs - 1; num++) {
-    if (pipe(job_res->pipes[num]) < 0) {
+    if (pipe2(job_res->pipes[num], O_CLOEXEC) < 0) {
       perror("pipe failed");
-      free_pipes(job_res->pipes);
+      close_pipe_ends(job->num_procs, job_res->pipes);
       return -1;
     }
   }
+  set_pipe_size(job, job_res);
+  return 0;
+}
+
+/* All pipes of a pipeline are open in the shell at once. */
+static int raise_fd_limit(int num_procs) {
+  struct rlimit rl;
+  rlim_t needed = 2 * (rlim_t)(num_procs - 1) + RESERVED_FDS;
+
+  if (getrlimit(RLIMIT_NOFILE, &rl) < 0 || rl.rlim_cur >= needed)
+    return 0;
+  if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < needed) {
+    fprintf(stderr, "pipeline of %d commands needs more than %llu open files\n",
+            num_procs, (unsigned long long)rl.rlim_max);
+    return -1;
+  }
+  rl.rlim_cur = needed;
+  if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+    perror("setrlimit(RLIMIT_NOFILE) failed");
+    return -1;
+  }
+  return 0;
+}
+
+/* PIPESIZE asks for larger kernel buffers for the pipes of the pipelines
+ * started while it is set. */
+static void set_pipe_size(Job *job, JobResource *job_res) {
+  Variable *vp = lookup("PIPESIZE");
+  char *end;
+
+  if (!vp || job->num_procs < 2)
+    return;
+  long size = strtol(vp->value, &end, 10);
+  if (*vp->value == '\0' || *end != '\0' || size <= 0) {
+    fprintf(stderr, "PIPESIZE: invalid size '%s'\n", vp->value);
+    return;
+  }
+
+  for (int num = 0; num < job->num_procs - 1; num++) {
+    if (fcntl(job_res->pipes[num][1], F_SETPIPE_SZ, (int)size) < 0) {
+      perror("PIPESIZE: F_SETPIPE_SZ failed");
+      return;
+    }
+  }
+}
+
+/* PLACEMENT=topology pins the stages of the jobs started while it is set
+ * to cores chosen from the CPU topology. */
+static CpuTopology *placement_topology(void) {
+  Variable *vp = lookup("PLACEMENT");
+
+  if (!vp || *vp->value == '\0')
+    return NULL;
+  if (strcmp(vp->value, "topology") != 0) {
+    fprintf(stderr, "PLACEMENT: unknown mode '%s'\n", vp->value);
+    return NULL;
+  }
+  return system_topology();
+}
+
+static int run_builtin(void *arg) {
+  BuiltinStage *stage = arg;
+  return builtin_commands[stage->proc->builtin].func(stage->proc,
+                                                     stage->job_head);
+}
+
+/* Runs a builtin stage in the shell with its stdin and stdout redirected to
+ * the stage's ends. Nothing reads the next pipe yet, so the output goes to a
+ * memory file that becomes the next stage's input instead; the previous
+ * stage's output has no reader and its writer gets SIGPIPE, as when a
+ * command exits without reading. Returns -1 if the stage has to be forked
+ * after all. */
+static int run_stage_in_shell(Job *job, int (*pipes)[2], Process *proc,
+                              int proc_num, Job **job_head) {
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  RedirectionFrame frame;
+  int last = proc_num == job->num_procs - 1;
+  int spool = -1;
+  int status = 1;
+
+  if (!last) {
+    spool = memfd_create("builtin", MFD_CLOEXEC);
+    if (spool < 0)
+      return -1;
+    close(pipes[proc_num][0]);
+    close(pipes[proc_num][1]);
+    pipes[proc_num][0] = -1;
+    pipes[proc_num][1] = spool;
+  }
+
+  size_t num_actions = build_child_actions(proc->cmd, pipes, proc_num,
+                                           job->num_procs, actions);
+  const ChildAction *failed = push_redirections(actions, num_actions, &frame);
+  if (failed) {
+    fprintf(stderr, "%s: %s: %s\n", proc->cmd->argv[0], failed->error,
+            strerror(errno));
+  } else {
+    status = builtin_commands[proc->builtin].func(proc, job_head);
+    pop_redirections(&frame);
+  }
+
+  if (!last) {
+    lseek(spool, 0, SEEK_SET);
+    pipes[proc_num][0] = spool;
+    pipes[proc_num][1] = -1;
+  }
+  if (proc_num > 0) {
+    close(pipes[proc_num - 1][0]);
+    pipes[proc_num - 1][0] = -1;
+  }
+
+  proc->pid = 0;
+  proc->completed = 1;
+  proc->status = W_EXITCODE(status, 0);
+  job->pids[proc_num] = 0;
+  if (last && !job->background)
+    last_exit_status = status;
   return 0;
 }
 
 int fork_and_setup_processes(Job *job, JobResource job_res, int *pgid,
-                             sigset_t *prev_mask, char **envp) {
+                             sigset_t *prev_mask, char **envp,
+                             Job **job_head) {
   Process *proc;
   int proc_num;
-  Command *cmd;
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  int foreground =
+      shell_interactive && !job->background && isatty(STDIN_FILENO);
+  CpuTopology *topo = placement_topology();
+  Placement placement;
+
+  if (topo)
+    placement_start(&placement, topo, job->num_procs);
 
   for (proc = job->first_process, proc_num = 0; proc;
        proc = proc->next, proc_num++) {
-    cmd = proc->cmd;
+    /* A captured job's stages are forked: the shell is the pipe's reader,
+     * so it must not block writing to it. */
+    if (proc->builtin >= 0 && !job->capture &&
+        builtin_commands[proc->builtin].in_process == BUILTIN_IN_PROCESS &&
+        run_stage_in_shell(job, job_res.pipes, proc, proc_num, job_head) == 0)
+      continue;
 
-    pid_t pid = fork();
+    BuiltinStage stage = {proc, job_head};
+    ResourceSettings resources;
+    int has_resources = merge_resources(&resources, proc->resources);
+    // an affinity the user gave wins
+    if (topo && !resources.set_affinity) {
+      placement_next(&placement, &resources.affinity);
+      resources.set_affinity = has_resources = 1;
+    }
+    size_t num_actions = build_child_actions(proc->cmd, job_res.pipes,
+                                             proc_num, job->num_procs, actions);
+    num_actions = capture_child_actions(job->capture, proc->cmd,
+                                        proc_num == job->num_procs - 1,
+                                        actions, num_actions);
+    SpawnPlan plan = {
+        .path = proc->path,
+        .argv = proc->cmd->argv,
+        .envp = envp,
+        .pgid = shell_interactive ? *pgid : -1,
+        .foreground = foreground,
+        .mask = prev_mask,
+        .actions = actions,
+        .num_actions = jobserver_child_actions(actions, num_actions),
+        .resources = has_resources ? &resources : NULL,
+        .run = proc->builtin >= 0 ? run_builtin : NULL,
+        .arg = &stage,
+    };
 
+    pid_t pid = spawn_process(&plan);
     if (pid < 0) {
-      perror("fork failed");
       close_pipe_ends(job->num_procs, job_res.pipes);
-      free_pipes(job_res.pipes);
       return -1;
     }
-
-    if (pid == 0)
-      child_setup(*pgid, prev_mask, job_res.pipes, proc_num, cmd, job, envp);
-    else
-      parent_setup(pgid, pid, proc_num, job_res.pipes, proc, job);
+    parent_setup(pgid, pid, proc_num, job_res.pipes, proc, job);
   }
   return 0;
 }
@@ -85,11 +259,13 @@ int fork_and_setup_processes(Job *job, JobResource job_res, int *pgid,
 static int allocate_pipe(Job *job, JobResource *job_res) {
   int(*pipes)[2];
 
-  pipes = malloc(sizeof *pipes * (job->num_procs - 1));
+  pipes = arena_alloc(job->arena, sizeof *pipes * (job->num_procs - 1));
   if (pipes == NULL) {
-    perror("malloc for pipes failed");
+    perror("arena allocation for pipes failed");
     return -1;
   }
+  for (int num = 0; num < job->num_procs - 1; num++)
+    pipes[num][0] = pipes[num][1] = -1;
   job_res->pipes = pipes;
 
   return 0;
@@ -98,9 +274,9 @@ static int allocate_pipe(Job *job, JobResource *job_res) {
 static int allocate_pids(Job *job) {
   pid_t *pids;
 
-  pids = malloc(sizeof(pid_t) * job->num_procs);
+  pids = arena_alloc(job->arena, sizeof(pid_t) * job->num_procs);
   if (pids == NULL) {
-    perror("malloc for pids failed");
+    perror("arena allocation for pids failed");
     return -1;
   }
 
@@ -108,62 +284,32 @@ static int allocate_pids(Job *job) {
   return 0;
 }
 
-static void child_setup(pid_t pgid, sigset_t *prev_mask, int (*pipes)[],
-                        int proc_num, Command *cmd, Job *job, char **envp) {
-  install_child_signal_handler();
-
-  if (setpgid(0, pgid) < 0) {
-    perror("child: setpgid failed");
-    exit(EXIT_FAILURE);
-  }
-
-  if (sigprocmask(SIG_SETMASK, prev_mask, NULL) < 0) {
-    perror("sigprocmask(unblock) in child");
-    exit(EXIT_FAILURE);
-  }
-
-  if (child_stdin_setup(cmd, pipes, proc_num) < 0) {
-    perror("failed to open input file");
-    exit(EXIT_FAILURE);
-  }
-
-  if (child_stdout_setup(cmd, pipes, proc_num, job->num_procs) < 0) {
-    perror("failed to open output file");
-    exit(EXIT_FAILURE);
-  }
-
-  close_pipe_ends(job->num_procs, pipes);
-  exec_command(cmd, envp);
-  perror("execve failed");
-  exit(EXIT_FAILURE);
-}
-
 static void parent_setup(pid_t *pgid, int pid, int proc_num, int (*pipes)[2],
                          Process *proc, Job *job) {
-  if (proc_num == 0) {
+  /* The first child started leads the group; builtin stages run in the
+   * shell have no process. Without job control there is no group: the
+   * children stay in the shell's, and pgid only names the job. */
+  if (*pgid == 0) {
     *pgid = pid;
     job->pgid = *pgid;
   }
   proc->pid = pid;
-  if (setpgid(pid, *pgid) < 0 && errno != EACCES && errno != EINVAL) {
+  if (job_table_add_process(proc) < 0)
+    fprintf(stderr, "job %d: lost track of process %ld\n", job->job_num,
+            (long)pid);
+  if (shell_interactive && setpgid(pid, *pgid) < 0 && errno != EACCES &&
+      errno != EINVAL) {
     perror("parent: setpgid failed");
   }
   job->pids[proc_num] = pid;
 
+  /* The stage has its ends now; the parent drops its copies. */
   if (proc_num > 0) {
     close(pipes[proc_num - 1][0]);
+    pipes[proc_num - 1][0] = -1;
   }
   if (proc_num < job->num_procs - 1) {
     close(pipes[proc_num][1]);
+    pipes[proc_num][1] = -1;
   }
 }
-
-static void exec_command(Command *cmd, char **envp) {
-  char *full_path = get_full_path(cmd->argv[0]);
-  if (!full_path) {
-    fprintf(stderr, "%s: command not found\n", cmd->argv[0]);
-    exit(EXIT_FAILURE);
-  }
-
-  execve(full_path, cmd->argv, envp);
-}
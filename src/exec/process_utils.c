@@ -14,41 +14,29 @@
 #include "parser.h"
 #include "process_utils.h"
 
-static Process *create_process(Process **proc_ptr, Command *cmd);
-
-Process *initalize_processes(char *tokens[], size_t num_tokens,
-                             Command **cmd_ptr, Process **proc_ptr) {
-  int i = 0;
-
-  // see if bakground job character is valid
-  if (is_background_char_valid(tokens, num_tokens) == 0)
-    return NULL;
-
-  while (i < (int)num_tokens) {
-    int split_indx = split_on_pipe(tokens, num_tokens, cmd_ptr, i);
-    if (split_indx < 0) {
+Process *initalize_processes(char *line, const Token tokens[],
+                             size_t num_tokens, Command **cmd_ptr,
+                             Process **proc_ptr, Arena *arena) {
+  Process **tail = proc_ptr;
+  size_t i = 0;
+
+  *proc_ptr = NULL;
+  while (i < num_tokens) {
+    if (parse_stage(line, tokens, num_tokens, &i, cmd_ptr, arena) < 0)
       return NULL;
-    }
-
-    *proc_ptr = create_process(proc_ptr, *cmd_ptr);
 
-    expander(*cmd_ptr);
+    Process *proc = arena_calloc(arena, 1, sizeof *proc);
+    if (proc == NULL)
+      return NULL;
+    proc->cmd = *cmd_ptr;
 
-    if (split_indx < (int)num_tokens && strcmp(tokens[split_indx], "|") == 0) {
-      i = split_indx + 1;
-    } else {
-      break;
-    }
+    *tail = proc;
+    tail = &proc->next;
   }
   return *proc_ptr;
 }
 
-static Process *create_process(Process **proc_ptr, Command *cmd) {
-  if (*proc_ptr == NULL) {
-    *proc_ptr = calloc(1, sizeof(Process));
-    (*proc_ptr)->cmd = cmd;
-  } else
-    (*proc_ptr)->next = create_process(&(*proc_ptr)->next, cmd);
-
-  return *proc_ptr;
-}
\ No newline at end of file
+void expand_processes(Process *proc_head, Arena *arena) {
+  for (Process *proc = proc_head; proc; proc = proc->next)
+    expander(proc->cmd, arena);
+}
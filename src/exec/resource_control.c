@@ -0,0 +1,146 @@
+/**
+ * @file resource_control.c
+ * @brief Resource settings of children: combining the shell-wide defaults
+ *         with a command's own settings in the parent, and applying them in
+ *         the child before exec.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "resource_control.h"
+
+ResourceSettings resource_defaults;
+
+void set_resource_limit(ResourceSettings *settings,
+                        const ResourceLimit *limit) {
+  size_t i = 0;
+
+  while (i < settings->num_limits &&
+         settings->limits[i].resource != limit->resource)
+    i++;
+  if (i == settings->num_limits) {
+    if (i == RESOURCE_LIMITS_MAX)
+      return;
+    settings->limits[i] = (ResourceLimit){.resource = limit->resource};
+    settings->num_limits++;
+  }
+
+  ResourceLimit *l = &settings->limits[i];
+  if (limit->set_soft) {
+    l->set_soft = 1;
+    l->soft = limit->soft;
+  }
+  if (limit->set_hard) {
+    l->set_hard = 1;
+    l->hard = limit->hard;
+  }
+}
+
+int merge_resources(ResourceSettings *out, const ResourceSettings *own) {
+  *out = resource_defaults;
+  if (own) {
+    if (own->set_nice) {
+      out->set_nice = 1;
+      out->nice = own->nice;
+    }
+    if (own->set_affinity) {
+      out->set_affinity = 1;
+      out->affinity = own->affinity;
+    }
+    for (size_t i = 0; i < own->num_limits; i++)
+      set_resource_limit(out, &own->limits[i]);
+  }
+  return (out->set_nice && out->nice != 0) || out->set_affinity ||
+         out->num_limits > 0;
+}
+
+const char *apply_resources(const ResourceSettings *settings) {
+  for (size_t i = 0; i < settings->num_limits; i++) {
+    const ResourceLimit *l = &settings->limits[i];
+    struct rlimit rl;
+
+    if (getrlimit(l->resource, &rl) < 0)
+      return "ulimit: getrlimit failed";
+    if (l->set_soft)
+      rl.rlim_cur = l->soft;
+    if (l->set_hard)
+      rl.rlim_max = l->hard;
+    if (setrlimit(l->resource, &rl) < 0)
+      return "ulimit: setrlimit failed";
+  }
+
+  if (settings->set_affinity &&
+      sched_setaffinity(0, sizeof settings->affinity, &settings->affinity) <
+          0)
+    return "affinity: sched_setaffinity failed";
+
+  if (settings->set_nice && settings->nice != 0) {
+    // -1 is a valid niceness, so only errno tells a failure
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, 0);
+    if (errno == 0)
+      setpriority(PRIO_PROCESS, 0, nice + settings->nice);
+  }
+  return NULL;
+}
+
+int parse_cpu_list(const char *list, cpu_set_t *set) {
+  CPU_ZERO(set);
+  if (strcmp(list, "all") == 0)
+    return sched_getaffinity(0, sizeof *set, set) < 0 ? -1 : 0;
+
+  const char *p = list;
+  while (*p) {
+    char *end;
+    if (*p < '0' || *p > '9')
+      return -1;
+    unsigned long first = strtoul(p, &end, 10), last = first;
+    if (*end == '-') {
+      p = end + 1;
+      if (*p < '0' || *p > '9')
+        return -1;
+      last = strtoul(p, &end, 10);
+    }
+    if (first > last || last >= CPU_SETSIZE)
+      return -1;
+    for (unsigned long cpu = first; cpu <= last; cpu++)
+      CPU_SET(cpu, set);
+
+    if (*end == ',' && end[1])
+      end++;
+    else if (*end)
+      return -1;
+    p = end;
+  }
+  return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+void format_cpu_list(const cpu_set_t *set, char *buf, size_t size) {
+  size_t len = 0;
+
+  buf[0] = '\0';
+  for (int cpu = 0; cpu < CPU_SETSIZE && len < size; cpu++) {
+    if (!CPU_ISSET(cpu, set))
+      continue;
+    int last = cpu;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set))
+      last++;
+
+    int n = last == cpu
+                ? snprintf(buf + len, size - len, "%s%d", len ? "," : "", cpu)
+                : snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "",
+                           cpu, last);
+    if (n < 0)
+      break;
+    len += n;
+    cpu = last;
+  }
+}
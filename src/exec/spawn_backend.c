@@ -0,0 +1,276 @@
+/**
+ * @file spawn_backend.c
+ * @brief Starting the processes of a pipeline with fork(), posix_spawn() or
+ *         clone(CLONE_VM | CLONE_VFORK). fork() copies the page tables of the
+ *         whole shell for every stage; the other two share the parent's
+ *         memory until the child execs.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "resource_control.h"
+#include "signal_utils.h"
+#include "spawn_backend.h"
+#include "zygote.h"
+
+#define VFORK_STACK_SIZE (64 * 1024)
+
+SpawnBackend spawn_backend = SPAWN_POSIX_SPAWN;
+
+static const char *const backend_names[] = {"fork", "posix_spawn", "vfork",
+                                            "zygote"};
+
+/* The vfork child runs on this stack while the parent is suspended, so one
+ * stack serves every child. */
+static char *vfork_stack;
+
+static void write_error(const char *what, const char *detail);
+static pid_t spawn_fork(const SpawnPlan *plan);
+static pid_t spawn_posix(const SpawnPlan *plan);
+static int vfork_child(void *arg);
+static pid_t spawn_vfork(const SpawnPlan *plan);
+
+/* stdio is not safe in a child that shares the parent's memory. The message
+ * goes out in one write so it does not interleave with other output. */
+static void write_error(const char *what, const char *detail) {
+  const char *parts[] = {what, ": ", detail, "\n"};
+  char buf[512];
+  size_t len = 0;
+
+  for (size_t i = 0; i < sizeof parts / sizeof *parts; i++) {
+    size_t n = strlen(parts[i]);
+    if (n > sizeof buf - len)
+      n = sizeof buf - len;
+    memcpy(buf + len, parts[i], n);
+    len += n;
+  }
+  if (write(STDERR_FILENO, buf, len) < 0)
+    return;
+}
+
+void exec_child(const SpawnPlan *plan) {
+  install_child_signal_handler();
+
+  if (plan->pgid >= 0 && setpgid(0, plan->pgid) < 0) {
+    write_error("child: setpgid failed", strerror(errno));
+    _exit(1);
+  }
+
+  /* Do not race the parent: the job must own the terminal before it
+   * reads from it. */
+  if (plan->foreground)
+    tcsetpgrp(STDIN_FILENO, plan->pgid ? plan->pgid : getpid());
+
+  if (sigprocmask(SIG_SETMASK, plan->mask, NULL) < 0) {
+    write_error("sigprocmask(unblock) in child", strerror(errno));
+    _exit(1);
+  }
+
+  const ChildAction *failed =
+      apply_child_actions(plan->actions, plan->num_actions);
+  if (failed) {
+    write_error(failed->error ? failed->error : "dup2 failed",
+                strerror(errno));
+    _exit(1);
+  }
+
+  if (plan->resources) {
+    const char *error = apply_resources(plan->resources);
+    if (error) {
+      write_error(error, strerror(errno));
+      _exit(1);
+    }
+  }
+
+  if (plan->run)
+    _exit(plan->run(plan->arg));
+
+  if (!plan->path) {
+    write_error(plan->argv[0], "command not found");
+    _exit(127);
+  }
+
+  execve(plan->path, plan->argv, plan->envp);
+  write_error(plan->argv[0], strerror(errno));
+  _exit(126);
+}
+
+static pid_t spawn_fork(const SpawnPlan *plan) {
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    perror("fork failed");
+    return -1;
+  }
+  if (pid == 0)
+    exec_child(plan);
+  return pid;
+}
+
+static pid_t spawn_posix(const SpawnPlan *plan) {
+  posix_spawn_file_actions_t file_actions;
+  posix_spawnattr_t attr;
+  sigset_t defaults;
+  pid_t pid = -1;
+  int err = 0;
+
+  /* A missing command still needs a child to report it. */
+  if (!plan->path)
+    return spawn_fork(plan);
+  /* posix_spawn() has no attributes for rlimits, niceness or affinity. */
+  if (plan->resources)
+    return spawn_vfork(plan);
+#ifndef POSIX_SPAWN_TCSETPGROUP
+  /* Only the child can hand itself the terminal without a race. */
+  if (plan->foreground)
+    return spawn_vfork(plan);
+#endif
+
+  if (posix_spawn_file_actions_init(&file_actions) != 0)
+    return spawn_fork(plan);
+  if (posix_spawnattr_init(&attr) != 0) {
+    posix_spawn_file_actions_destroy(&file_actions);
+    return spawn_fork(plan);
+  }
+
+  for (size_t i = 0; i < plan->num_actions && err == 0; i++) {
+    const ChildAction *a = &plan->actions[i];
+    switch (a->kind) {
+    case ACTION_OPEN:
+      err = posix_spawn_file_actions_addopen(&file_actions, a->target,
+                                             a->path, a->flags, 0644);
+      break;
+    case ACTION_DUP2:
+      err = posix_spawn_file_actions_adddup2(&file_actions, a->fd, a->target);
+      break;
+    case ACTION_CLOSE_FROM:
+#if __GLIBC_PREREQ(2, 34)
+      err = posix_spawn_file_actions_addclosefrom_np(&file_actions, a->fd);
+#endif
+      break;
+    }
+  }
+
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGINT);
+  sigaddset(&defaults, SIGQUIT);
+  sigaddset(&defaults, SIGTSTP);
+  short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+  if (plan->pgid >= 0)
+    flags |= POSIX_SPAWN_SETPGROUP;
+#ifdef POSIX_SPAWN_TCSETPGROUP
+  if (plan->foreground) {
+    flags |= POSIX_SPAWN_TCSETPGROUP;
+    if (err == 0)
+      err = posix_spawnattr_tcsetpgrp_np(&attr, STDIN_FILENO);
+  }
+#endif
+  if (err == 0)
+    err = posix_spawnattr_setflags(&attr, flags);
+  if (err == 0 && plan->pgid >= 0)
+    err = posix_spawnattr_setpgroup(&attr, plan->pgid);
+  if (err == 0)
+    err = posix_spawnattr_setsigmask(&attr, plan->mask);
+  if (err == 0)
+    err = posix_spawnattr_setsigdefault(&attr, &defaults);
+  if (err == 0)
+    err = posix_spawn(&pid, plan->path, &file_actions, &attr, plan->argv,
+                      plan->envp);
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&file_actions);
+
+  /* The failed child is already gone; fork one that reports the error the
+   * way the other backends do. */
+  if (err != 0)
+    return spawn_fork(plan);
+  return pid;
+}
+
+static int vfork_child(void *arg) {
+  struct sigaction sa;
+
+  /* The parent's SIGCHLD handler would run on shared memory. */
+  sa.sa_handler = SIG_DFL;
+  sa.sa_flags = 0;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGCHLD, &sa, NULL);
+
+  exec_child(arg);
+  return 0;
+}
+
+static pid_t spawn_vfork(const SpawnPlan *plan) {
+  sigset_t all, prev;
+  pid_t pid;
+
+  if (!vfork_stack) {
+    void *stack = mmap(NULL, VFORK_STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+      perror("mmap for spawn stack failed");
+      return spawn_fork(plan);
+    }
+    vfork_stack = stack;
+  }
+
+  /* No handler may run in the child before it resets them. */
+  sigfillset(&all);
+  sigprocmask(SIG_BLOCK, &all, &prev);
+  pid = clone(vfork_child, vfork_stack + VFORK_STACK_SIZE,
+              CLONE_VM | CLONE_VFORK | SIGCHLD, (void *)plan);
+  sigprocmask(SIG_SETMASK, &prev, NULL);
+
+  if (pid < 0) {
+    perror("clone failed");
+    return -1;
+  }
+  return pid;
+}
+
+pid_t spawn_process(const SpawnPlan *plan) {
+  /* The function needs a copy of the shell's memory. */
+  if (plan->run)
+    return spawn_fork(plan);
+
+  switch (spawn_backend) {
+  case SPAWN_POSIX_SPAWN:
+    return spawn_posix(plan);
+  case SPAWN_VFORK:
+    return spawn_vfork(plan);
+  case SPAWN_ZYGOTE: {
+    // the pool's children are not sent resource settings
+    pid_t pid = !plan->resources && zygote_start() == 0 ? zygote_spawn(plan)
+                                                         : -1;
+    return pid > 0 ? pid : spawn_fork(plan);
+  }
+  case SPAWN_FORK:
+  default:
+    return spawn_fork(plan);
+  }
+}
+
+int set_spawn_backend(const char *name) {
+  for (size_t i = 0; i < sizeof backend_names / sizeof *backend_names; i++) {
+    if (strcmp(name, backend_names[i]) == 0) {
+      spawn_backend = (SpawnBackend)i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+const char *spawn_backend_name(SpawnBackend backend) {
+  return backend_names[backend];
+}
@@ -0,0 +1,419 @@
+/**
+ * @file zygote.c
+ * @brief Opt-in pool of pre-forked children. The helper process is forked
+ *         while the shell is small and clones warm children with
+ *         CLONE_PARENT, which makes them children of the shell. A warm child
+ *         takes one spawn request from the shared socket, tells the helper to
+ *         replace it, answers with its pid and execs.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "zygote.h"
+
+#define ZYGOTE_STACK_SIZE (64 * 1024)
+
+/* The working directory and stdio of the shell come first. */
+#define FIXED_FDS 4
+#define MAX_FDS (FIXED_FDS + CHILD_ACTIONS_MAX)
+
+/**
+ * @struct RequestHeader
+ * @brief The start of a spawn request. The actions follow, then the
+ * strings: the path if there is one, the arguments and the environment.
+ */
+typedef struct {
+  uint32_t size;
+  pid_t pgid;
+  int32_t foreground;
+  sigset_t mask;
+  uint32_t num_args;
+  uint32_t num_env;
+  uint32_t num_actions;
+  int32_t has_path;
+} RequestHeader;
+
+/**
+ * @struct PackedAction
+ * @brief A ChildAction with its descriptor given as an index into the
+ * descriptors sent along and its strings as offsets; -1 means none.
+ */
+typedef struct {
+  int32_t kind;
+  int32_t fd;
+  int32_t target;
+  int32_t flags;
+  int32_t path;
+  int32_t error;
+} PackedAction;
+
+typedef struct {
+  int sock;
+  int refill;
+} WarmArgs;
+
+static int zygote_sock = -1;
+static pid_t zygote_pid;
+
+/* Requests are built and received here; a child has its own copy. */
+static char request[ZYGOTE_MAX_MESSAGE];
+
+static int pack(size_t *used, const void *data, size_t n);
+static int pack_string(size_t *used, size_t strings, const char *s,
+                       int32_t *offset);
+static size_t pack_request(const SpawnPlan *plan, int *fds, int *num_fds);
+static char **unpack_strings(char **s, char *end, uint32_t count);
+static void run_request(ssize_t len, int *fds, int num_fds, int sock,
+                        int refill);
+static int warm_child(void *arg);
+static void zygote_main(int sock, int refill_r, int refill_w);
+
+static int pack(size_t *used, const void *data, size_t n) {
+  if (n > sizeof request - *used)
+    return -1;
+  memcpy(request + *used, data, n);
+  *used += n;
+  return 0;
+}
+
+static int pack_string(size_t *used, size_t strings, const char *s,
+                       int32_t *offset) {
+  if (offset)
+    *offset = s ? (int32_t)(*used - strings) : -1;
+  return s ? pack(used, s, strlen(s) + 1) : 0;
+}
+
+static size_t pack_request(const SpawnPlan *plan, int *fds, int *num_fds) {
+  RequestHeader header = {0};
+  PackedAction *packed;
+  size_t used = sizeof header;
+  size_t strings;
+
+  header.pgid = plan->pgid;
+  header.foreground = plan->foreground;
+  header.mask = *plan->mask;
+  header.num_actions = plan->num_actions;
+  header.has_path = plan->path != NULL;
+  while (plan->argv[header.num_args])
+    header.num_args++;
+  while (plan->envp && plan->envp[header.num_env])
+    header.num_env++;
+
+  packed = (PackedAction *)(request + used);
+  used += plan->num_actions * sizeof *packed;
+  strings = used;
+  if (used > sizeof request)
+    return 0;
+
+  *num_fds = FIXED_FDS;
+  for (size_t i = 0; i < plan->num_actions; i++) {
+    const ChildAction *a = &plan->actions[i];
+    PackedAction *p = &packed[i];
+
+    p->kind = a->kind;
+    p->target = a->target;
+    p->flags = a->flags;
+    p->fd = a->fd;
+    if (a->kind == ACTION_DUP2) {
+      fds[*num_fds] = a->fd;
+      p->fd = (*num_fds)++;
+    }
+    if (pack_string(&used, strings, a->path, &p->path) < 0 ||
+        pack_string(&used, strings, a->error, &p->error) < 0)
+      return 0;
+  }
+
+  if (pack_string(&used, strings, plan->path, NULL) < 0)
+    return 0;
+  for (uint32_t i = 0; i < header.num_args; i++) {
+    if (pack_string(&used, strings, plan->argv[i], NULL) < 0)
+      return 0;
+  }
+  for (uint32_t i = 0; i < header.num_env; i++) {
+    if (pack_string(&used, strings, plan->envp[i], NULL) < 0)
+      return 0;
+  }
+
+  header.size = used;
+  memcpy(request, &header, sizeof header);
+  return used;
+}
+
+static char **unpack_strings(char **s, char *end, uint32_t count) {
+  char **list = malloc((count + 1) * sizeof *list);
+
+  if (!list)
+    return NULL;
+  for (uint32_t i = 0; i < count; i++) {
+    if (*s >= end)
+      return NULL;
+    list[i] = *s;
+    *s += strlen(*s) + 1;
+  }
+  list[count] = NULL;
+  return list;
+}
+
+/* Runs in a warm child that has taken a request; never returns. */
+static void run_request(ssize_t len, int *fds, int num_fds, int sock,
+                        int refill) {
+  RequestHeader header;
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  pid_t self = getpid();
+
+  memcpy(&header, request, sizeof header);
+  if ((size_t)len < sizeof header || header.size != (size_t)len ||
+      header.num_actions > CHILD_ACTIONS_MAX || num_fds < FIXED_FDS)
+    _exit(1);
+
+  PackedAction *packed = (PackedAction *)(request + sizeof header);
+  char *strings = (char *)(packed + header.num_actions);
+  char *end = request + len;
+
+  for (uint32_t i = 0; i < header.num_actions; i++) {
+    const PackedAction *p = &packed[i];
+    ChildAction *a = &actions[i];
+
+    a->kind = p->kind;
+    a->fd = p->fd;
+    if (p->kind == ACTION_DUP2)
+      a->fd = p->fd < num_fds ? fds[p->fd] : -1;
+    a->target = p->target;
+    a->flags = p->flags;
+    a->path = p->path < 0 ? NULL : strings + p->path;
+    a->error = p->error < 0 ? NULL : strings + p->error;
+  }
+
+  /* Skip the action strings; the path, arguments and environment follow. */
+  char *s = strings;
+  for (uint32_t i = 0; i < header.num_actions; i++) {
+    if (packed[i].path >= 0)
+      s += strlen(s) + 1;
+    if (packed[i].error >= 0)
+      s += strlen(s) + 1;
+  }
+  char *path = NULL;
+  if (header.has_path) {
+    path = s;
+    s += strlen(s) + 1;
+  }
+  char **argv = unpack_strings(&s, end, header.num_args);
+  char **envp = unpack_strings(&s, end, header.num_env);
+  if (!argv || !envp)
+    _exit(1);
+
+  if (fchdir(fds[0]) < 0 || dup2(fds[1], STDIN_FILENO) < 0 ||
+      dup2(fds[2], STDOUT_FILENO) < 0 || dup2(fds[3], STDERR_FILENO) < 0)
+    _exit(1);
+
+  /* The shell learns the pid before the child can exit. */
+  if (send(sock, &self, sizeof self, MSG_NOSIGNAL) != sizeof self)
+    _exit(1);
+  close(sock);
+  close(refill);
+
+  SpawnPlan plan = {
+      .path = path,
+      .argv = argv,
+      .envp = envp,
+      .pgid = header.pgid,
+      .foreground = header.foreground,
+      .mask = &header.mask,
+      .actions = actions,
+      .num_actions = header.num_actions,
+  };
+  exec_child(&plan);
+}
+
+static int warm_child(void *arg) {
+  const WarmArgs *args = arg;
+  char control[CMSG_SPACE(MAX_FDS * sizeof(int))];
+  struct iovec iov = {request, sizeof request};
+  struct msghdr msg = {0};
+  ssize_t len;
+
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+
+  do
+    len = recvmsg(args->sock, &msg, MSG_CMSG_CLOEXEC);
+  while (len < 0 && errno == EINTR);
+  if (len <= 0)
+    _exit(0);
+
+  /* Taken: the helper starts a replacement. */
+  if (write(args->refill, "", 1) < 0)
+    _exit(1);
+
+  int fds[MAX_FDS];
+  int num_fds = 0;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+      cmsg->cmsg_type == SCM_RIGHTS) {
+    num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    memcpy(fds, CMSG_DATA(cmsg), num_fds * sizeof(int));
+  }
+  run_request(len, fds, num_fds, args->sock, args->refill);
+  return 0;
+}
+
+static void zygote_main(int sock, int refill_r, int refill_w) {
+  WarmArgs args = {sock, refill_w};
+  struct sigaction sa;
+  sigset_t none;
+  int warm = 0;
+
+  /* Go away with the shell. */
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+  sa.sa_handler = SIG_IGN;
+  sa.sa_flags = 0;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGQUIT, &sa, NULL);
+  sa.sa_handler = SIG_DFL;
+  sigaction(SIGCHLD, &sa, NULL);
+  sigemptyset(&none);
+  sigprocmask(SIG_SETMASK, &none, NULL);
+
+  char *stack = mmap(NULL, ZYGOTE_STACK_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED)
+    _exit(1);
+
+  while (1) {
+    /* Each clone gets its own copy of the stack. */
+    while (warm < ZYGOTE_WARM &&
+           clone(warm_child, stack + ZYGOTE_STACK_SIZE,
+                 CLONE_PARENT | SIGCHLD, &args) > 0)
+      warm++;
+
+    struct pollfd pfds[2] = {{refill_r, POLLIN, 0}, {sock, 0, 0}};
+    if (poll(pfds, 2, warm < ZYGOTE_WARM ? 100 : -1) < 0 && errno != EINTR)
+      _exit(1);
+    if (pfds[1].revents & (POLLHUP | POLLERR))
+      _exit(0);
+    if (pfds[0].revents & POLLIN) {
+      char taken[ZYGOTE_WARM];
+      ssize_t n = read(refill_r, taken, sizeof taken);
+      if (n > 0)
+        warm -= n;
+    }
+  }
+}
+
+int zygote_start(void) {
+  int sv[2], refill[2];
+
+  if (zygote_sock >= 0)
+    return 0;
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+    perror("zygote: socketpair failed");
+    return -1;
+  }
+  if (pipe2(refill, O_CLOEXEC) < 0) {
+    perror("zygote: pipe failed");
+    close(sv[0]);
+    close(sv[1]);
+    return -1;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("zygote: fork failed");
+    close(sv[0]);
+    close(sv[1]);
+    close(refill[0]);
+    close(refill[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    close(sv[0]);
+    zygote_main(sv[1], refill[0], refill[1]);
+  }
+
+  close(sv[1]);
+  close(refill[0]);
+  close(refill[1]);
+  zygote_sock = sv[0];
+  zygote_pid = pid;
+  return 0;
+}
+
+int zygote_running(void) { return zygote_sock >= 0; }
+
+pid_t zygote_spawn(const SpawnPlan *plan) {
+  int fds[MAX_FDS];
+  int num_fds;
+  pid_t pid;
+  ssize_t n;
+
+  if (zygote_sock < 0)
+    return -1;
+  size_t len = pack_request(plan, fds, &num_fds);
+  if (len == 0)
+    return -1;
+
+  fds[0] = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fds[0] < 0)
+    return -1;
+  fds[1] = STDIN_FILENO;
+  fds[2] = STDOUT_FILENO;
+  fds[3] = STDERR_FILENO;
+
+  char control[CMSG_SPACE(MAX_FDS * sizeof(int))] = {0};
+  struct iovec iov = {request, len};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = CMSG_SPACE(num_fds * sizeof(int));
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+  memcpy(CMSG_DATA(cmsg), fds, num_fds * sizeof(int));
+
+  n = sendmsg(zygote_sock, &msg, MSG_NOSIGNAL);
+  close(fds[0]);
+  if (n != (ssize_t)len) {
+    zygote_stop();
+    return -1;
+  }
+
+  do
+    n = recv(zygote_sock, &pid, sizeof pid, 0);
+  while (n < 0 && errno == EINTR);
+  if (n != sizeof pid) {
+    fprintf(stderr, "zygote: no reply, falling back to fork\n");
+    zygote_stop();
+    return -1;
+  }
+  return pid;
+}
+
+void zygote_stop(void) {
+  if (zygote_sock < 0)
+    return;
+  close(zygote_sock);
+  zygote_sock = -1;
+  kill(zygote_pid, SIGTERM);
+}
@@ -0,0 +1,94 @@
+/**
+ * @file fd_writer.c
+ * @brief Buffered writer on a file descriptor
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fd_writer.h"
+
+static int write_all(FdWriter *w, const char *data, size_t n);
+
+static int write_all(FdWriter *w, const char *data, size_t n) {
+  while (n > 0 && !w->failed) {
+    ssize_t done = write(w->fd, data, n);
+    if (done < 0) {
+      if (errno == EINTR)
+        continue;
+      w->failed = 1;
+      break;
+    }
+    data += done;
+    n -= done;
+  }
+  return w->failed ? -1 : 0;
+}
+
+void fd_writer_init(FdWriter *w, int fd) {
+  w->fd = fd;
+  w->failed = 0;
+  w->len = 0;
+}
+
+int fd_writer_put(FdWriter *w, const char *data, size_t n) {
+  if (w->len + n > FD_WRITER_SIZE) {
+    if (fd_writer_flush(w) < 0)
+      return -1;
+    /* Too big to be worth copying. */
+    if (n > FD_WRITER_SIZE)
+      return write_all(w, data, n);
+  }
+  memcpy(w->buf + w->len, data, n);
+  w->len += n;
+  return w->failed ? -1 : 0;
+}
+
+int fd_writer_puts(FdWriter *w, const char *s) {
+  return fd_writer_put(w, s, strlen(s));
+}
+
+int fd_writer_putc(FdWriter *w, char c) {
+  if (w->len == FD_WRITER_SIZE && fd_writer_flush(w) < 0)
+    return -1;
+  w->buf[w->len++] = c;
+  return 0;
+}
+
+int fd_writer_printf(FdWriter *w, const char *fmt, ...) {
+  va_list ap;
+  size_t room = FD_WRITER_SIZE - w->len;
+
+  va_start(ap, fmt);
+  int n = vsnprintf(w->buf + w->len, room, fmt, ap);
+  va_end(ap);
+  if (n < 0)
+    return -1;
+  if ((size_t)n < room) {
+    w->len += n;
+    return w->failed ? -1 : 0;
+  }
+
+  /* It did not fit: format it again on the heap. */
+  char *text = malloc(n + 1);
+  if (!text)
+    return -1;
+  va_start(ap, fmt);
+  vsnprintf(text, n + 1, fmt, ap);
+  va_end(ap);
+  int status = fd_writer_put(w, text, n);
+  free(text);
+  return status;
+}
+
+int fd_writer_flush(FdWriter *w) {
+  int status = write_all(w, w->buf, w->len);
+  w->len = 0;
+  return status;
+}
@@ -1,55 +1,151 @@
 /**
  * @file io_redirection.c
- * @brief Functions for setting up input and output redirection for child processes and
- *         closing pipe ends and freeing pipes
+ * @brief Functions for computing and performing the input and output
+ *         redirection of child processes and closing pipe ends
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
 
+#define _GNU_SOURCE
+
+#include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <unistd.h>
 
 #include "io_redirection.h"
 
-int child_stdin_setup(Command *cmd, int (*pipes)[2], int proc_num) {
-  if (cmd->infile) {
-    int in_fd = open(cmd->infile, O_RDONLY);
-    if (in_fd < 0)
-      return -1;
+static void add_action(ChildAction *actions, size_t *n, ChildActionKind kind,
+                       int fd, int target) {
+  ChildAction *a = &actions[(*n)++];
+  a->kind = kind;
+  a->fd = fd;
+  a->target = target;
+  a->flags = 0;
+  a->path = NULL;
+  a->error = NULL;
+}
 
-    dup2(in_fd, STDIN_FILENO);
-    close(in_fd);
+size_t build_child_actions(const Command *cmd, int (*pipes)[2], int proc_num,
+                           int num_procs, ChildAction *actions) {
+  size_t n = 0;
+
+  if (cmd->infile) {
+    add_action(actions, &n, ACTION_OPEN, -1, STDIN_FILENO);
+    actions[n - 1].flags = O_RDONLY;
+    actions[n - 1].path = cmd->infile;
+    actions[n - 1].error = "failed to open input file";
   } else if (proc_num > 0) {
-    dup2(pipes[proc_num - 1][0], STDIN_FILENO);
-    close(pipes[proc_num - 1][0]);
+    add_action(actions, &n, ACTION_DUP2, pipes[proc_num - 1][0],
+               STDIN_FILENO);
+  }
+
+  if (cmd->outfile) {
+    add_action(actions, &n, ACTION_OPEN, -1, STDOUT_FILENO);
+    actions[n - 1].flags =
+        O_WRONLY | O_CREAT | (cmd->append_output ? O_APPEND : O_TRUNC);
+    actions[n - 1].path = cmd->outfile;
+    actions[n - 1].error = "failed to open output file";
+  } else if (proc_num < num_procs - 1) {
+    add_action(actions, &n, ACTION_DUP2, pipes[proc_num][1], STDOUT_FILENO);
   }
 
-  return 0;
+  /* The pipes are close-on-exec; this catches anything else the shell
+   * left open. */
+  add_action(actions, &n, ACTION_CLOSE_FROM, STDERR_FILENO + 1, -1);
+
+  return n;
 }
 
-int child_stdout_setup(Command *cmd, int (*pipes)[2], int proc_num,
-                       int num_procs) {
-  if (cmd->outfile) {
-    int flags = O_WRONLY | O_CREAT | (cmd->append_output ? O_APPEND : O_TRUNC);
-    int out_fd = open(cmd->outfile, flags, 0644);
-    if (out_fd < 0)
-      return -1;
+const ChildAction *apply_child_actions(const ChildAction *actions,
+                                       size_t num_actions) {
+  for (size_t i = 0; i < num_actions; i++) {
+    const ChildAction *a = &actions[i];
+    int fd;
 
-    dup2(out_fd, STDOUT_FILENO);
-    close(out_fd);
-  } else if (proc_num < num_procs - 1) {
-    dup2(pipes[proc_num][1], STDOUT_FILENO);
-    close(pipes[proc_num][1]);
+    switch (a->kind) {
+    case ACTION_OPEN:
+      fd = open(a->path, a->flags, 0644);
+      if (fd < 0)
+        return a;
+      if (fd != a->target) {
+        if (dup2(fd, a->target) < 0)
+          return a;
+        close(fd);
+      }
+      break;
+    case ACTION_DUP2:
+      /* dup2 onto itself would keep close-on-exec set. */
+      if (a->fd == a->target) {
+        if (fcntl(a->fd, F_SETFD, 0) < 0)
+          return a;
+      } else if (dup2(a->fd, a->target) < 0) {
+        return a;
+      }
+      break;
+    case ACTION_CLOSE_FROM:
+      close_range(a->fd, ~0U, 0);
+      break;
+    }
   }
+  return NULL;
+}
+
+/* The saved copies stay clear of the descriptors redirections use, and are
+ * close-on-exec so children started meanwhile do not inherit them. */
+#define SAVED_FD_MIN 10
+
+/* Puts back what was replaced so far, keeping errno for the caller. */
+static const ChildAction *undo_redirections(RedirectionFrame *frame,
+                                            const ChildAction *failed) {
+  int err = errno;
+  pop_redirections(frame);
+  errno = err;
+  return failed;
+}
+
+const ChildAction *push_redirections(const ChildAction *actions,
+                                     size_t num_actions,
+                                     RedirectionFrame *frame) {
+  frame->count = 0;
+  fflush(stdout);
+
+  for (size_t i = 0; i < num_actions; i++) {
+    const ChildAction *a = &actions[i];
+    if (a->kind == ACTION_CLOSE_FROM)
+      continue;
 
-  return 0;
+    int saved = fcntl(a->target, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+    if (saved < 0 && errno != EBADF)
+      return undo_redirections(frame, a);
+    frame->target[frame->count] = a->target;
+    frame->saved[frame->count++] = saved;
+    if (apply_child_actions(a, 1))
+      return undo_redirections(frame, a);
+  }
+  return NULL;
+}
+
+void pop_redirections(RedirectionFrame *frame) {
+  fflush(stdout);
+
+  while (frame->count > 0) {
+    size_t i = --frame->count;
+    if (frame->saved[i] < 0) {
+      close(frame->target[i]);
+      continue;
+    }
+    dup2(frame->saved[i], frame->target[i]);
+    close(frame->saved[i]);
+  }
 }
 
 void close_pipe_ends(int num_procs, int (*pipes)[2]) {
   for (int i = 0; i < num_procs - 1; i++) {
-    close(pipes[i][0]);
-    close(pipes[i][1]);
+    for (int end = 0; end < 2; end++) {
+      if (pipes[i][end] >= 0)
+        close(pipes[i][end]);
+      pipes[i][end] = -1;
+    }
   }
 }
-
-void free_pipes(int (*pipes)[2]) { free(pipes); }
\ No newline at end of file
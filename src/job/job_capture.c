@@ -0,0 +1,330 @@
+/**
+ * @file job_capture.c
+ * @brief Capture pipes for background jobs: the child side of the pipe,
+ *         draining it into a ring that spills into a memory file, keeping
+ *         the captures of ended jobs and replaying them.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "env_utils.h"
+#include "fd_writer.h"
+#include "job_capture.h"
+
+#define RING_MIN 4096
+#define READ_CHUNK 16384
+
+/* The captures of ended jobs, by job number. */
+static JobCapture **kept;
+static size_t kept_capacity;
+static int last_finished;
+
+static void close_reader(JobCapture *capture);
+static void free_capture(JobCapture *capture);
+static int grow_ring(JobCapture *capture);
+static void spill(JobCapture *capture, const char *data, size_t n);
+static void evict(JobCapture *capture, size_t n);
+static void append(JobCapture *capture, const char *data, size_t n);
+
+int capture_enabled(void) {
+  Variable *vp = lookup("JOBOUTPUT");
+
+  if (!vp || *vp->value == '\0')
+    return 0;
+  if (strcmp(vp->value, "capture") != 0) {
+    fprintf(stderr, "JOBOUTPUT: unknown mode '%s'\n", vp->value);
+    return 0;
+  }
+  return 1;
+}
+
+int capture_open(Job *job) {
+  int fds[2];
+  JobCapture *capture = calloc(1, sizeof *capture);
+
+  if (!capture) {
+    perror("calloc for capture failed");
+    return -1;
+  }
+  if (pipe2(fds, O_CLOEXEC) < 0) {
+    perror("capture: pipe");
+    free(capture);
+    return -1;
+  }
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  // a smaller pipe still works; the job just blocks sooner
+  fcntl(fds[1], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE);
+
+  capture->fd = fds[0];
+  capture->write_fd = fds[1];
+  capture->epoll_fd = -1;
+  capture->spill_fd = -1;
+  capture->job_num = job->job_num;
+  job->capture = capture;
+  return 0;
+}
+
+size_t capture_child_actions(const JobCapture *capture, const Command *cmd,
+                             int last, ChildAction *actions,
+                             size_t num_actions) {
+  if (!capture || capture->write_fd < 0 || num_actions == 0 ||
+      actions[num_actions - 1].kind != ACTION_CLOSE_FROM)
+    return num_actions;
+
+  ChildAction *a = &actions[num_actions - 1];
+  ChildAction out = {.kind = ACTION_DUP2,
+                     .fd = capture->write_fd,
+                     .target = STDOUT_FILENO,
+                     .error = "failed to capture output"};
+  size_t n = 0;
+
+  if (last && !cmd->outfile)
+    a[n++] = out;
+  out.target = STDERR_FILENO;
+  a[n++] = out;
+  a[n++] = (ChildAction){
+      .kind = ACTION_CLOSE_FROM, .fd = STDERR_FILENO + 1, .target = -1};
+  return num_actions - 1 + n;
+}
+
+void capture_close_writer(JobCapture *capture) {
+  if (!capture || capture->write_fd < 0)
+    return;
+  close(capture->write_fd);
+  capture->write_fd = -1;
+}
+
+static void close_reader(JobCapture *capture) {
+  if (capture->fd < 0)
+    return;
+  if (capture->epoll_fd >= 0)
+    epoll_ctl(capture->epoll_fd, EPOLL_CTL_DEL, capture->fd, NULL);
+  close(capture->fd);
+  capture->fd = -1;
+  capture->epoll_fd = -1;
+}
+
+static void free_capture(JobCapture *capture) {
+  close_reader(capture);
+  capture_close_writer(capture);
+  if (capture->spill_fd >= 0)
+    close(capture->spill_fd);
+  free(capture->ring);
+  free(capture);
+}
+
+/* The ring starts small and doubles up to its limit; it only wraps once it
+ * is at the limit, so start is 0 while it grows. */
+static int grow_ring(JobCapture *capture) {
+  if (capture->size >= CAPTURE_RING_SIZE)
+    return -1;
+  size_t size = capture->size ? capture->size * 2 : RING_MIN;
+  if (size > CAPTURE_RING_SIZE)
+    size = CAPTURE_RING_SIZE;
+  char *ring = realloc(capture->ring, size);
+  if (!ring)
+    return -1;
+  capture->ring = ring;
+  capture->size = size;
+  return 0;
+}
+
+/* The spill file holds an unbroken prefix of the output; once anything was
+ * dropped nothing more may follow it there. */
+static void spill(JobCapture *capture, const char *data, size_t n) {
+  if (capture->dropped == 0 && capture->spilled < CAPTURE_SPILL_MAX) {
+    size_t room = CAPTURE_SPILL_MAX - capture->spilled;
+    size_t len = n < room ? n : room;
+
+    if (capture->spill_fd < 0)
+      capture->spill_fd = memfd_create("job-output", MFD_CLOEXEC);
+    while (len > 0 && capture->spill_fd >= 0) {
+      ssize_t w = pwrite(capture->spill_fd, data, len, capture->spilled);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        break;
+      capture->spilled += w;
+      data += w;
+      len -= w;
+      n -= w;
+    }
+  }
+  capture->dropped += n;
+}
+
+/* Moves the n oldest bytes of the ring out to the spill file. */
+static void evict(JobCapture *capture, size_t n) {
+  size_t first = capture->size - capture->start;
+
+  if (first > n)
+    first = n;
+  spill(capture, capture->ring + capture->start, first);
+  spill(capture, capture->ring, n - first);
+  capture->start = (capture->start + n) % capture->size;
+  capture->len -= n;
+}
+
+static void append(JobCapture *capture, const char *data, size_t n) {
+  while (n > 0) {
+    if (capture->len == capture->size && grow_ring(capture) < 0) {
+      if (capture->size == 0) {
+        spill(capture, data, n);
+        return;
+      }
+      evict(capture, n < capture->len ? n : capture->len);
+    }
+
+    size_t room = capture->size - capture->len;
+    size_t len = n < room ? n : room;
+    size_t end = (capture->start + capture->len) % capture->size;
+    size_t first = capture->size - end;
+    if (first > len)
+      first = len;
+    memcpy(capture->ring + end, data, first);
+    memcpy(capture->ring, data + first, len - first);
+    capture->len += len;
+    data += len;
+    n -= len;
+  }
+}
+
+int capture_drain(JobCapture *capture, int relay_fd, size_t limit) {
+  char buf[READ_CHUNK];
+  FdWriter relay;
+  size_t total = 0;
+  int status = 0;
+
+  if (capture->fd < 0)
+    return 1;
+  fd_writer_init(&relay, relay_fd);
+  while (total < limit) {
+    ssize_t n = read(capture->fd, buf, sizeof buf);
+    if (n > 0) {
+      append(capture, buf, n);
+      if (relay_fd >= 0)
+        fd_writer_put(&relay, buf, n);
+      total += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EAGAIN)
+      break;
+    if (n < 0) {
+      perror("capture: read");
+      status = -1;
+    } else {
+      status = 1;
+    }
+    close_reader(capture);
+    break;
+  }
+  if (relay_fd >= 0)
+    fd_writer_flush(&relay);
+  return status;
+}
+
+/* What is left in the pipe is read, but no more: the pipe stays open, and
+ * watched, if something the job started still writes to it. */
+void capture_finish(Job *job) {
+  JobCapture *capture = job->capture;
+  size_t num = (size_t)job->job_num;
+
+  if (!capture)
+    return;
+  job->capture = NULL;
+  capture_close_writer(capture);
+  capture_drain(capture, -1, CAPTURE_PIPE_SIZE);
+
+  if (num >= kept_capacity) {
+    size_t capacity = kept_capacity ? kept_capacity : JOB_TABLE_MIN;
+    while (capacity <= num)
+      capacity *= 2;
+    JobCapture **grown = realloc(kept, capacity * sizeof *grown);
+    if (!grown) {
+      perror("realloc for captures failed");
+      free_capture(capture);
+      return;
+    }
+    memset(grown + kept_capacity, 0,
+           (capacity - kept_capacity) * sizeof *grown);
+    kept = grown;
+    kept_capacity = capacity;
+  }
+  if (kept[num])
+    free_capture(kept[num]);
+  kept[num] = capture;
+  last_finished = (int)num;
+}
+
+void capture_discard(int job_num) {
+  size_t num = (size_t)job_num;
+
+  if (num >= kept_capacity || !kept[num])
+    return;
+  free_capture(kept[num]);
+  kept[num] = NULL;
+  if (last_finished == job_num)
+    last_finished = 0;
+}
+
+JobCapture *capture_find(int job_num) {
+  size_t num = (size_t)job_num;
+
+  if (job_num <= 0)
+    return NULL;
+  if (num < job_table.capacity && job_table.jobs[num])
+    return job_table.jobs[num]->capture;
+  return num < kept_capacity ? kept[num] : NULL;
+}
+
+int capture_last_finished(void) { return last_finished; }
+
+int capture_replay(const JobCapture *capture, int fd) {
+  char buf[READ_CHUNK];
+  FdWriter out;
+  size_t first = capture->size - capture->start;
+
+  fd_writer_init(&out, fd);
+  for (size_t off = 0; off < capture->spilled;) {
+    ssize_t n = pread(capture->spill_fd, buf, sizeof buf, off);
+    if (n <= 0)
+      return -1;
+    if (fd_writer_put(&out, buf, n) < 0)
+      return -1;
+    off += n;
+  }
+  if (capture->dropped &&
+      fd_writer_printf(&out, "\n[... %zu bytes of output dropped ...]\n",
+                       capture->dropped) < 0)
+    return -1;
+  if (first > capture->len)
+    first = capture->len;
+  if (capture->len &&
+      (fd_writer_put(&out, capture->ring + capture->start, first) < 0 ||
+       fd_writer_put(&out, capture->ring, capture->len - first) < 0))
+    return -1;
+  return fd_writer_flush(&out);
+}
+
+void capture_free_all(void) {
+  for (size_t i = 0; i < kept_capacity; i++)
+    if (kept[i])
+      free_capture(kept[i]);
+  free(kept);
+  kept = NULL;
+  kept_capacity = 0;
+  last_finished = 0;
+}
@@ -6,20 +6,24 @@
  * @date 2025-06-06
  */
 
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 
 #include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "job_capture.h"
 #include "job_control.h"
 
+static void relay_output(JobCapture *capture);
 static void wait_for_children(Job *job, int *pids, int num_procs);
 
 int last_exit_status = 0;
+int shell_interactive = 1;
 
 void setup_job_control(Job *job, Job **job_head, sigset_t *prev_mask,
                        pid_t shell_pgid) {
@@ -32,14 +36,18 @@ void setup_job_control(Job *job, Job **job_head, sigset_t *prev_mask,
 void handle_foreground_job(sigset_t *prev_list, Job *job, pid_t shell_pgid,
                            Job **job_head) {
 
-  if (tcsetpgrp(STDIN_FILENO, job->pgid) < 0)
+  if (shell_interactive && tcsetpgrp(STDIN_FILENO, job->pgid) < 0)
     perror("parent: tcsetpgrp failed");
 
   wait_for_children(job, job->pids, job->num_procs);
 
   drain_remaining_statuses(job);
 
-  if (tcsetpgrp(STDIN_FILENO, shell_pgid) < 0) {
+  // what the job wrote last is still in its pipe
+  if (job->capture)
+    capture_drain(job->capture, STDOUT_FILENO, CAPTURE_PIPE_SIZE);
+
+  if (shell_interactive && tcsetpgrp(STDIN_FILENO, shell_pgid) < 0) {
     perror("parent: couldn't reclaim terminal");
   }
 
@@ -55,40 +63,49 @@ void handle_background_job(sigset_t *prev_mask, Job *job) {
     perror("sigprocmask(restore) in parent (bg)");
   }
 
-  fprintf(stderr, "[%ld]  %ld\n", (long)job->job_num, (long)job->pgid);
+  if (!job->quiet)
+    fprintf(stderr, "[%ld]  %ld\n", (long)job->job_num, (long)job->pgid);
+}
+
+/* Shows what a captured job in the foreground writes, keeping it in the
+ * capture as well, until it writes more or a child changes. SIGCHLD is
+ * blocked while the shell waits, so one that comes before ppoll() is not
+ * missed. */
+static void relay_output(JobCapture *capture) {
+  struct pollfd pfd = {.fd = capture->fd, .events = POLLIN};
+  sigset_t mask;
+
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+  sigdelset(&mask, SIGCHLD);
+  if (ppoll(&pfd, 1, NULL, &mask) > 0)
+    capture_drain(capture, STDOUT_FILENO, CAPTURE_DRAIN_MAX);
 }
 
 static void wait_for_children(Job *job, int *pids, int num_procs) {
   int status;
   pid_t w;
+  int flags = WUNTRACED | (job->capture ? WNOHANG : 0);
 
   while (1) {
-    w = waitpid(-job->pgid, &status, WUNTRACED);
+    w = wait_job(job, &status, flags);
     if (w > 0) {
-      Process *p;
-      for (p = job->first_process; p; p = p->next) {
-        if (p->pid == w) {
-          if (w == pids[num_procs - 1]) {
-            if (WIFEXITED(status)) {
-              last_exit_status = WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-              last_exit_status = 128 + WTERMSIG(status);
-            }
-          }
-          if (WIFSTOPPED(status)) {
-            p->stopped = 1;
-            return;
-          }
-          if (WIFEXITED(status) || WIFSIGNALED(status)) {
-            p->completed = 1;
-            p->status = status;
-            break;
-          }
+      mark_process(w, status);
+      if (w == pids[num_procs - 1]) {
+        if (WIFEXITED(status)) {
+          last_exit_status = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+          last_exit_status = 128 + WTERMSIG(status);
         }
       }
+      if (WIFSTOPPED(status))
+        return;
       continue;
     }
     if (w == 0) {
+      if (job->capture) {
+        relay_output(job->capture);
+        continue;
+      }
       return;
     }
     if (w == -1) {
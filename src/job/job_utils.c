@@ -6,37 +6,54 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <wait.h>
 
+#include "fd_writer.h"
+#include "hash.h"
+#include "job_capture.h"
+#include "job_control.h"
 #include "job_utils.h"
+#include "jobserver.h"
+#include "signal_utils.h"
 
-static Job *create_job(Job **job_ptr, char *line_buffer, Command *cmd);
+static Job *create_job(Job **job_ptr, char *line_buffer, Command *cmd,
+                       Arena *arena);
 static void free_process_list(Process *proc);
-
-int pending_indx = 0;
-struct Pending pending_bg_jobs[256] = {0};
-static long job_num = 1;
+static Process *copy_process_list(Process *proc);
+static int take_job_number(Job *job);
+static int job_listed(Job *job);
+static void forget_job(Job *job);
+static void unlink_job(Job *job, Job **head);
+static size_t process_home(pid_t pid);
+static int grow_process_table(void);
+static ProcessSlot *find_process_slot(pid_t pid);
+static void remove_process(Process *proc);
+
+JobTable job_table;
 
 Job *initialize_job_control(char *line_buffer, Command *cmd_ptr,
-                            Process *proc_ptr, Job **job_head) {
+                            Process *proc_ptr, Job **job_head, Arena *arena) {
 
-  Job *new_job = create_job(job_head, line_buffer, cmd_ptr);
+  Job *new_job = create_job(job_head, line_buffer, cmd_ptr, arena);
+  if (!new_job)
+    return NULL;
   new_job->first_process = proc_ptr;
-  new_job->job_num = job_num++;
   return new_job;
 }
 
 void kill_jobs(Job **job_head) {
   for (Job *j = *job_head; j; j = j->next) {
-    kill(-j->pgid, SIGHUP);
-    kill(-j->pgid, SIGCONT);
-    kill(-j->pgid, SIGTERM);
+    signal_job(j, SIGHUP);
+    signal_job(j, SIGCONT);
+    signal_job(j, SIGTERM);
   }
 }
 
@@ -63,54 +80,185 @@ static void free_process_list(Process *proc) {
   }
 }
 
-void free_job(Job *job, Job **head) {
-  Job *prev = NULL;
-  Job *curr = *head;
+/* Gives the job the lowest free number. */
+static int take_job_number(Job *job) {
+  JobTable *t = &job_table;
+  size_t num = t->next_free ? t->next_free : 1;
 
-  while (curr) {
-    if (curr == job) {
-      if (prev)
-        prev->next = curr->next;
-      else
-        *head = curr->next;
-
-      free_process_list(curr->first_process);
-      free(curr->command);
-      free(curr->pids);
-      free(curr);
-      return;
+  while (num < t->capacity && t->jobs[num])
+    num++;
+  if (num >= t->capacity) {
+    size_t capacity = t->capacity ? t->capacity * 2 : JOB_TABLE_MIN;
+    Job **jobs = realloc(t->jobs, capacity * sizeof *jobs);
+    if (!jobs) {
+      perror("realloc for job table failed");
+      return -1;
     }
-    prev = curr;
-    curr = curr->next;
+    memset(jobs + t->capacity, 0, (capacity - t->capacity) * sizeof *jobs);
+    t->jobs = jobs;
+    t->capacity = capacity;
   }
+  t->jobs[num] = job;
+  t->next_free = num + 1;
+  job->job_num = (int)num;
+  return 0;
+}
+
+static int job_listed(Job *job) {
+  size_t num = (size_t)job->job_num;
+  return num > 0 && num < job_table.capacity && job_table.jobs[num] == job;
 }
 
-static Job *create_job(Job **job_head_ptr, char *line_buffer, Command *cmd) {
+/* Gives back the job's number and jobserver token, keeps its captured
+ * output and drops its processes from the table. */
+static void forget_job(Job *job) {
+  size_t num = (size_t)job->job_num;
+
+  jobserver_put(job);
+  capture_finish(job);
+
+  for (Process *p = job->first_process; p; p = p->next)
+    if (p->pid > 0)
+      remove_process(p);
+  job_table.jobs[num] = NULL;
+  if (num < job_table.next_free)
+    job_table.next_free = num;
+}
+
+static void unlink_job(Job *job, Job **head) {
+  if (job == *head) {
+    *head = job->next;
+    if (*head)
+      (*head)->prev = job->prev;
+  } else {
+    job->prev->next = job->next;
+    if (job->next)
+      job->next->prev = job->prev;
+    else
+      (*head)->prev = job->prev;
+  }
+  forget_job(job);
+}
+
+void free_job(Job *job, Job **head) {
+  if (!job_listed(job))
+    return;
+  unlink_job(job, head);
+
+  if (job->arena)
+    return;
+  if (job->output) {
+    unlink(job->output);
+    free(job->output);
+  }
+  free_process_list(job->first_process);
+  free(job->command);
+  free(job->pids);
+  free(job);
+}
+
+static Job *create_job(Job **job_head_ptr, char *line_buffer, Command *cmd,
+                       Arena *arena) {
+  Job *job = arena_calloc(arena, 1, sizeof(Job));
+  if (!job) {
+    perror("arena allocation for Job failed");
+    return NULL;
+  }
+  job->command = get_raw_input(line_buffer, arena);
+  if (!job->command)
+    return NULL;
+  job->background = (cmd->background ? 1 : 0);
+  job->arena = arena;
+  if (take_job_number(job) < 0)
+    return NULL;
+
   if (*job_head_ptr == NULL) {
-    *job_head_ptr = calloc(1, sizeof(Job));
-    if (!*job_head_ptr) {
-      perror("calloc for Job failed");
+    job->prev = job;
+    *job_head_ptr = job;
+    return job;
+  }
+
+  Job *last = (*job_head_ptr)->prev;
+  last->next = job;
+  job->prev = last;
+  (*job_head_ptr)->prev = job;
+  return job;
+}
+
+static Process *copy_process_list(Process *proc) {
+  Process *head = NULL;
+  Process **tail = &head;
+
+  for (; proc; proc = proc->next) {
+    Process *copy = malloc(sizeof *copy);
+    if (!copy) {
+      free_process_list(head);
+      return NULL;
+    }
+    *copy = *proc;
+    copy->next = NULL;
+    copy->path = NULL;
+    copy->builtin = -1;
+    copy->resources = NULL;
+    copy->cmd = copy_command(proc->cmd);
+    *tail = copy;
+    tail = &copy->next;
+    if (!copy->cmd) {
+      free_process_list(head);
       return NULL;
     }
-    (*job_head_ptr)->command = get_raw_input(line_buffer);
-    (*job_head_ptr)->background = (cmd->background ? 1 : 0);
-
-    return *job_head_ptr;
   }
+  return head;
+}
 
-  Job *curr = *job_head_ptr;
-  while (curr->next)
-    curr = curr->next;
+Job *persist_job(Job *job, Job **job_head) {
+  if (!job_listed(job))
+    return NULL;
+  if (!job->arena)
+    return job;
 
-  curr->next = calloc(1, sizeof(Job));
-  if (!curr->next) {
-    perror("calloc for Job failed");
+  Job *copy = malloc(sizeof *copy);
+  if (!copy) {
+    perror("malloc for Job failed");
+    unlink_job(job, job_head);
     return NULL;
   }
-  curr->next->command = get_raw_input(line_buffer);
-  curr->next->background = (cmd->background ? 1 : 0);
+  *copy = *job;
+  copy->arena = NULL;
+  copy->command = strdup(job->command);
+  copy->first_process = copy_process_list(job->first_process);
+  copy->pids = malloc(sizeof(pid_t) * job->num_procs);
+  if (!copy->command || !copy->first_process || !copy->pids) {
+    perror("failed to copy job");
+    free_process_list(copy->first_process);
+    free(copy->command);
+    free(copy->pids);
+    free(copy);
+    // the arena copy is about to go away, so stop tracking the job
+    unlink_job(job, job_head);
+    return NULL;
+  }
+  memcpy(copy->pids, job->pids, sizeof(pid_t) * job->num_procs);
 
-  return curr->next;
+  // the copies replace the originals in the list and the table
+  if (job == *job_head)
+    *job_head = copy;
+  else
+    job->prev->next = copy;
+  if (job->next)
+    job->next->prev = copy;
+  else
+    (*job_head)->prev = copy;
+  if (copy->prev == job)
+    copy->prev = copy;
+  job_table.jobs[copy->job_num] = copy;
+  // the number now means this job, not an earlier one that was captured
+  capture_discard(copy->job_num);
+  for (Process *p = copy->first_process; p; p = p->next)
+    if (p->pid > 0 && job_table_add_process(p) < 0)
+      fprintf(stderr, "job %d: lost track of process %ld\n", copy->job_num,
+              (long)p->pid);
+  return copy;
 }
 
 int get_num_procs(Job *job) {
@@ -126,15 +274,8 @@ Job *find_job(Process *proc, Job **job_head) {
   char **argv = proc->cmd->argv;
   long job_num = -1;
 
-  if (argv[1] == NULL) {
-    Job *curr = *job_head;
-    Job *last = NULL;
-    while (curr) {
-      last = curr;
-      curr = curr->next;
-    }
-    return last;
-  }
+  if (argv[1] == NULL)
+    return *job_head ? (*job_head)->prev : NULL;
 
   if (argv[1][0] != '%' || argv[1][1] == '\0') {
     return NULL;
@@ -143,88 +284,209 @@ Job *find_job(Process *proc, Job **job_head) {
   char *endptr;
   job_num = strtol(argv[1] + 1, &endptr, 10);
 
-  if (*endptr != '\0' || job_num <= 0) {
+  if (*endptr != '\0' || job_num <= 0 ||
+      (unsigned long)job_num >= job_table.capacity) {
     return NULL;
   }
+  return job_table.jobs[job_num];
+}
 
-  Job *curr = *job_head;
-  while (curr) {
-    if ((long)curr->job_num == job_num) {
-      return curr;
-    }
-    curr = curr->next;
+static size_t process_home(pid_t pid) {
+  return hash_bytes(&pid, sizeof pid) & job_table.proc_mask;
+}
+
+/* Moves the processes to a table twice the size. */
+static int grow_process_table(void) {
+  JobTable *t = &job_table;
+  ProcessSlot *old = t->procs;
+  size_t old_size = old ? t->proc_mask + 1 : 0;
+  size_t size = old ? old_size * 2 : JOB_TABLE_MIN;
+
+  ProcessSlot *procs = calloc(size, sizeof *procs);
+  if (!procs) {
+    perror("calloc for process table failed");
+    return -1;
+  }
+  t->procs = procs;
+  t->proc_mask = size - 1;
+  for (size_t i = 0; i < old_size; i++) {
+    if (!old[i].pid)
+      continue;
+    size_t j = process_home(old[i].pid);
+    while (procs[j].pid)
+      j = (j + 1) & t->proc_mask;
+    procs[j] = old[i];
+  }
+  free(old);
+  return 0;
+}
+
+int job_table_add_process(Process *proc) {
+  JobTable *t = &job_table;
+
+  if ((!t->procs || (t->num_procs + 1) * 2 > t->proc_mask + 1) &&
+      grow_process_table() < 0)
+    return -1;
+  size_t i = process_home(proc->pid);
+  while (t->procs[i].pid && t->procs[i].pid != proc->pid)
+    i = (i + 1) & t->proc_mask;
+  if (!t->procs[i].pid) {
+    t->num_procs++;
+    t->procs[i].pid = proc->pid;
+    t->procs[i].pidfd = -1;
+  }
+  t->procs[i].proc = proc;
+  return 0;
+}
+
+static ProcessSlot *find_process_slot(pid_t pid) {
+  JobTable *t = &job_table;
+
+  if (!t->procs || pid <= 0)
+    return NULL;
+  for (size_t i = process_home(pid); t->procs[i].pid;
+       i = (i + 1) & t->proc_mask) {
+    if (t->procs[i].pid == pid)
+      return &t->procs[i];
   }
   return NULL;
 }
 
-void queue_pending_procs(pid_t pid, int status) {
-  pending_bg_jobs[pending_indx].pid = pid;
-  pending_bg_jobs[pending_indx].status = status;
-  pending_indx++;
-}
-
-void mark_bg_jobs(Job **job_head, struct Pending pending_bg_jobs[],
-                  int pending_count) {
-  for (int i = 0; i < pending_count; i++) {
-    pid_t pid = pending_bg_jobs[i].pid;
-    int status = pending_bg_jobs[i].status;
-    int found = 0;
-
-    for (Job *job = *job_head; job && !found; job = job->next) {
-      for (Process *p = job->first_process; p; p = p->next) {
-        if (p->pid == pid) {
-          if (WIFSTOPPED(status)) {
-            p->stopped = 1;
-          } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
-            p->completed = 1;
-            p->status = status;
-          }
-          found = 1;
-          break;
-        }
-      }
+Process *job_table_find_process(pid_t pid) {
+  ProcessSlot *slot = find_process_slot(pid);
+  return slot ? slot->proc : NULL;
+}
+
+int job_table_set_pidfd(pid_t pid, int pidfd) {
+  ProcessSlot *slot = find_process_slot(pid);
+
+  if (!slot)
+    return -1;
+  if (slot->pidfd >= 0)
+    close(slot->pidfd);
+  slot->pidfd = pidfd;
+  return 0;
+}
+
+/* Empties the process's slot and moves later entries of the same run back
+ * into the gap, so the table needs no deleted markers. A slot whose ID was
+ * reused by another job's process is left alone. */
+static void remove_process(Process *proc) {
+  JobTable *t = &job_table;
+  size_t mask = t->proc_mask;
+
+  if (!t->procs)
+    return;
+  size_t i = process_home(proc->pid);
+  while (t->procs[i].pid && t->procs[i].pid != proc->pid)
+    i = (i + 1) & mask;
+  if (t->procs[i].proc != proc)
+    return;
+  if (t->procs[i].pidfd >= 0)
+    close(t->procs[i].pidfd);
+
+  for (size_t j = (i + 1) & mask; t->procs[j].pid; j = (j + 1) & mask) {
+    size_t home = process_home(t->procs[j].pid);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      t->procs[i] = t->procs[j];
+      i = j;
     }
   }
+  t->procs[i].pid = 0;
+  t->procs[i].proc = NULL;
+  t->num_procs--;
+}
 
-  pending_indx = 0;
+void job_table_free(void) {
+  for (size_t i = 0; job_table.procs && i <= job_table.proc_mask; i++)
+    if (job_table.procs[i].pid && job_table.procs[i].pidfd >= 0)
+      close(job_table.procs[i].pidfd);
+  free(job_table.jobs);
+  free(job_table.procs);
+  memset(&job_table, 0, sizeof job_table);
+}
+
+Process *mark_process(pid_t pid, int status) {
+  ProcessSlot *slot = find_process_slot(pid);
+
+  if (!slot)
+    return NULL;
+  Process *p = slot->proc;
+  if (WIFSTOPPED(status)) {
+    p->stopped = 1;
+  } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
+    p->completed = 1;
+    p->status = status;
+    // a reaped process's pidfd would stay readable
+    if (slot->pidfd >= 0) {
+      close(slot->pidfd);
+      slot->pidfd = -1;
+    }
+  }
+  return p;
 }
 
-void format_job_info(Job *job, char *status) {
+void reap_children(void) {
+  pid_t w;
+  int status;
+
+  while ((w = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0)
+    mark_process(w, status);
+}
+
+void mark_bg_jobs(void) {
+  sigset_t mask;
+
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+  if (sigismember(&mask, SIGCHLD)) {
+    child_changed = 1;
+    return;
+  }
+  reap_children();
+}
+
+void format_job_info(int fd, Job *job, char *status) {
   if (job->background)
-    fprintf(stderr, "[%ld]  %s      %s &\n", (long)job->job_num, status,
+    dprintf(fd, "[%ld]  %s      %s &\n", (long)job->job_num, status,
             job->command);
   else
-    fprintf(stderr, "[%ld]  %s      %s\n", (long)job->job_num, status,
+    dprintf(fd, "[%ld]  %s      %s\n", (long)job->job_num, status,
             job->command);
-  fflush(stdout);
+}
+
+pid_t wait_job(Job *job, int *status, int flags) {
+  if (shell_interactive)
+    return waitpid(-job->pgid, status, flags);
+  for (Process *proc = job->first_process; proc; proc = proc->next) {
+    if (proc->pid > 0 && !proc->completed)
+      return waitpid(proc->pid, status, flags);
+  }
+  errno = ECHILD;
+  return -1;
+}
+
+int signal_job(const Job *job, int sig) {
+  int sent = 0;
+
+  if (shell_interactive)
+    return kill(-job->pgid, sig);
+  for (Process *proc = job->first_process; proc; proc = proc->next) {
+    if (proc->pid > 0 && !proc->completed && kill(proc->pid, sig) == 0)
+      sent = 1;
+  }
+  return sent ? 0 : -1;
 }
 
 void drain_remaining_statuses(Job *job) {
   pid_t w;
   int status;
 
-  while ((w = waitpid(-job->pgid, &status, WNOHANG | WUNTRACED))) {
+  while ((w = wait_job(job, &status, WNOHANG | WUNTRACED))) {
     if (w > 0) {
-      Process *p;
-      for (p = job->first_process; p; p = p->next) {
-        if (p->pid == w) {
-          if (WIFSTOPPED(status)) {
-            p->stopped = 1;
-            break;
-          }
-          if (WIFEXITED(status) || WIFSIGNALED(status)) {
-            p->completed = 1;
-            p->status = status;
-            break;
-          }
-        }
-      }
+      mark_process(w, status);
       continue;
 
-    } else if (w == 0)
-      return;
-
-    else if (w == -1) {
+    } else if (w == -1) {
       if (errno == EINTR) {
         continue;
       }
@@ -237,13 +499,35 @@ void drain_remaining_statuses(Job *job) {
   }
 }
 
+void print_output_file(char **path) {
+  static char buf[65536];
+  FdWriter out;
+  ssize_t n;
+  int fd = open(*path, O_RDONLY | O_CLOEXEC);
+
+  if (fd >= 0) {
+    fflush(stdout);
+    fd_writer_init(&out, STDOUT_FILENO);
+    while ((n = read(fd, buf, sizeof buf)) > 0)
+      if (fd_writer_put(&out, buf, n) < 0)
+        break;
+    fd_writer_flush(&out);
+    close(fd);
+  }
+  unlink(*path);
+  free(*path);
+  *path = NULL;
+}
+
 void do_job_notification(Job *job, Job **job_head) {
   if (job_is_completed(job)) {
-    if (job->background)
-      format_job_info(job, "Done");
+    if (job->output)
+      print_output_file(&job->output);
+    if (job->background && !job->quiet)
+      format_job_info(STDERR_FILENO, job, "Done");
     free_job(job, job_head);
   } else if (job_is_stopped(job))
-    format_job_info(job, "Stopped");
+    format_job_info(STDERR_FILENO, job, "Stopped");
 }
 
 void notify_bg_jobs(Job **job_head) {
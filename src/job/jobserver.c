@@ -0,0 +1,241 @@
+/**
+ * @file jobserver.c
+ * @brief The jobserver FIFO: filling it, handing its tokens to background
+ *         jobs and passing it to children through MAKEFLAGS and two
+ *         inherited descriptors.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "env_utils.h"
+#include "jobserver.h"
+#include "signal_utils.h"
+
+/* The shell's own descriptors stay clear of the ones children get. */
+#define JOBSERVER_FD_MIN 10
+
+#define TOKEN '+'
+
+Jobserver jobserver = {.child_fd = -1, .shell_fd = -1};
+
+static int open_fifo(int *child_fd, int *shell_fd);
+static int fill_tokens(int tokens);
+static int export_makeflags(int tokens);
+static void put_finished(Job *job_head);
+
+/* Opens a new FIFO twice and removes its name; only the descriptors are
+ * needed, since make is told their numbers. */
+static int open_fifo(int *child_fd, int *shell_fd) {
+  char dir[] = "/tmp/yega-jobserver.XXXXXX";
+  char path[sizeof dir + sizeof "/fifo"];
+  int fds[2] = {-1, -1};
+  int err = 0;
+
+  if (!mkdtemp(dir))
+    return -1;
+  snprintf(path, sizeof path, "%s/fifo", dir);
+  if (mkfifo(path, 0600) == 0) {
+    // O_RDWR does not wait for the other end of a FIFO
+    fds[0] = open(path, O_RDWR | O_CLOEXEC);
+    fds[1] = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  }
+  err = errno;
+  unlink(path);
+  rmdir(dir);
+
+  for (int i = 0; i < 2; i++) {
+    if (fds[i] < 0 || fds[i] >= JOBSERVER_FD_MIN)
+      continue;
+    int moved = fcntl(fds[i], F_DUPFD_CLOEXEC, JOBSERVER_FD_MIN);
+    if (moved < 0)
+      err = errno;
+    close(fds[i]);
+    fds[i] = moved;
+  }
+  if (fds[0] < 0 || fds[1] < 0) {
+    if (fds[0] >= 0)
+      close(fds[0]);
+    if (fds[1] >= 0)
+      close(fds[1]);
+    errno = err;
+    return -1;
+  }
+  *child_fd = fds[0];
+  *shell_fd = fds[1];
+  return 0;
+}
+
+static int fill_tokens(int tokens) {
+  char buf[JOBSERVER_MAX];
+
+  memset(buf, TOKEN, tokens);
+  return write(jobserver.shell_fd, buf, tokens) == tokens ? 0 : -1;
+}
+
+/* Adds the jobserver to whatever MAKEFLAGS already says, in the form make
+ * itself passes to sub-makes. */
+static int export_makeflags(int tokens) {
+  Variable *old = lookup("MAKEFLAGS");
+  char *value;
+
+  if (old) {
+    jobserver.saved_makeflags = strdup(old->value);
+    jobserver.saved_exported = old->exported;
+    if (!jobserver.saved_makeflags)
+      return -1;
+  }
+  if (asprintf(&value, "%s%s-j%d --jobserver-auth=%d,%d",
+               old ? jobserver.saved_makeflags : "",
+               old && *jobserver.saved_makeflags ? " " : "", tokens,
+               JOBSERVER_READ_FD, JOBSERVER_WRITE_FD) < 0)
+    return -1;
+  Variable *var = add_variable("MAKEFLAGS", value, 1);
+  free(value);
+  return var ? 0 : -1;
+}
+
+int jobserver_start(int tokens) {
+  if (tokens < 1 || tokens > JOBSERVER_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+  jobserver_stop();
+
+  if (open_fifo(&jobserver.child_fd, &jobserver.shell_fd) < 0)
+    return -1;
+  jobserver.tokens = tokens;
+  jobserver.generation++;
+  if (fill_tokens(tokens) < 0 || export_makeflags(tokens) < 0) {
+    int err = errno;
+    jobserver_stop();
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+void jobserver_stop(void) {
+  if (jobserver.child_fd < 0)
+    return;
+  close(jobserver.child_fd);
+  close(jobserver.shell_fd);
+  jobserver.child_fd = jobserver.shell_fd = -1;
+  jobserver.tokens = 0;
+
+  if (jobserver.saved_makeflags)
+    add_variable("MAKEFLAGS", jobserver.saved_makeflags,
+                 jobserver.saved_exported);
+  else
+    remove_variable("MAKEFLAGS");
+  free(jobserver.saved_makeflags);
+  jobserver.saved_makeflags = NULL;
+  jobserver.saved_exported = 0;
+}
+
+int jobserver_active(void) { return jobserver.child_fd >= 0; }
+
+int jobserver_free_tokens(void) {
+  int n;
+
+  if (jobserver.shell_fd < 0 || ioctl(jobserver.shell_fd, FIONREAD, &n) < 0)
+    return -1;
+  return n;
+}
+
+/* Jobs that ended hold on to their tokens until they are freed, which may
+ * be a while if nobody is at the prompt to see them. */
+static void put_finished(Job *job_head) {
+  for (Job *j = job_head; j; j = j->next)
+    if (j->token && job_is_completed(j))
+      jobserver_put(j);
+}
+
+int jobserver_take(Job *job, Job **job_head) {
+  struct pollfd pfd = {.fd = jobserver.shell_fd, .events = POLLIN};
+  sigset_t block, prev;
+  char token;
+  int status = 0;
+
+  if (jobserver.shell_fd < 0 || job->token)
+    return 0;
+
+  /* The handlers only run inside ppoll(), so a child that exits or a
+   * Ctrl+C cannot slip in between a check and the wait. */
+  sigemptyset(&block);
+  sigaddset(&block, SIGCHLD);
+  sigaddset(&block, SIGINT);
+  sigaddset(&block, SIGQUIT);
+  sigprocmask(SIG_BLOCK, &block, &prev);
+  interrupted = 0;
+
+  while (read(jobserver.shell_fd, &token, 1) != 1) {
+    if (errno != EAGAIN && errno != EINTR) {
+      perror("jobserver: read");
+      status = -1;
+      break;
+    }
+    if (interrupted) {
+      status = -1;
+      break;
+    }
+    if (child_changed) {
+      child_changed = 0;
+      reap_children();
+      put_finished(*job_head);
+      continue;
+    }
+    if (ppoll(&pfd, 1, NULL, &prev) < 0 && errno != EINTR) {
+      perror("jobserver: ppoll");
+      status = -1;
+      break;
+    }
+  }
+  if (status == 0)
+    job->token = jobserver.generation;
+
+  sigprocmask(SIG_SETMASK, &prev, NULL);
+  return status;
+}
+
+void jobserver_put(Job *job) {
+  char token = TOKEN;
+
+  if (!job->token)
+    return;
+  // a token of a server that was replaced goes nowhere
+  if (job->token == jobserver.generation && jobserver.shell_fd >= 0 &&
+      write(jobserver.shell_fd, &token, 1) != 1)
+    perror("jobserver: write");
+  job->token = 0;
+}
+
+size_t jobserver_child_actions(ChildAction *actions, size_t num_actions) {
+  if (jobserver.child_fd < 0 || num_actions == 0 ||
+      actions[num_actions - 1].kind != ACTION_CLOSE_FROM)
+    return num_actions;
+
+  ChildAction *a = &actions[num_actions - 1];
+  a[0] = (ChildAction){.kind = ACTION_DUP2,
+                       .fd = jobserver.child_fd,
+                       .target = JOBSERVER_READ_FD,
+                       .error = "failed to pass the jobserver"};
+  a[1] = a[0];
+  a[1].target = JOBSERVER_WRITE_FD;
+  a[2] = (ChildAction){.kind = ACTION_CLOSE_FROM,
+                       .fd = JOBSERVER_WRITE_FD + 1,
+                       .target = -1};
+  return num_actions + 2;
+}
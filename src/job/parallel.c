@@ -0,0 +1,608 @@
+/**
+ * @file parallel.c
+ * @brief The `parallel` scheduler: parsing its words, starting a task
+ *         whenever a slot is free, reaping and collecting finished ones,
+ *         the halt policy, and printing outputs as tasks finish or in
+ *         input order.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "executor.h"
+#include "job_control.h"
+#include "parallel.h"
+#include "signal_utils.h"
+
+#define INTERRUPTED_STATUS 130
+#define SUSPENDED_STATUS (128 + SIGTSTP)
+
+#define READ_CHUNK 4096
+
+static volatile sig_atomic_t suspend_requested = 0;
+
+static void tstp_handler(int sig);
+static int default_slots(void);
+static int parse_count(const char *word, int *count);
+static int parse_halt(const char *word, HaltPolicy *halt);
+static int read_inputs(ParallelRun *run);
+static int add_task(ParallelRun *run, char *arg);
+static char *substitute(Arena *arena, const char *word, const char *arg);
+static char **task_argv(ParallelRun *run, const char *arg);
+static char *task_line(Arena *arena, char **argv);
+static int task_exit_code(int status);
+static int can_start(const ParallelRun *run);
+static void start_task(ParallelRun *run, Job **job_head);
+static void finish_task(ParallelRun *run, size_t index, int status,
+                        Job **job_head);
+static void collect(ParallelRun *run, Job **job_head);
+static void check_halt(ParallelRun *run, ParallelTask *task, int ok);
+static void signal_running(ParallelRun *run, int sig);
+static void print_task(ParallelTask *task);
+static void print_in_order(ParallelRun *run, int skip_unfinished);
+static void log_task(ParallelRun *run, size_t index);
+static void suspend_run(ParallelRun *run);
+
+static void tstp_handler(int sig) {
+  (void)sig;
+  suspend_requested = 1;
+}
+
+/* One task per CPU the shell may run on, as GNU parallel does. */
+static int default_slots(void) {
+  cpu_set_t set;
+
+  if (sched_getaffinity(0, sizeof set, &set) == 0 && CPU_COUNT(&set) > 0)
+    return CPU_COUNT(&set);
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+
+static int parse_count(const char *word, int *count) {
+  char *end;
+
+  if (!word || *word < '0' || *word > '9')
+    return -1;
+  errno = 0;
+  long n = strtol(word, &end, 10);
+  if (*end || errno || n < 1 || n > 1000000)
+    return -1;
+  *count = (int)n;
+  return 0;
+}
+
+/* "never", or "soon" or "now" followed by ",fail=N" or ",success=N". */
+static int parse_halt(const char *word, HaltPolicy *halt) {
+  const char *comma;
+
+  if (!word)
+    return -1;
+  if (strcmp(word, "never") == 0) {
+    halt->when = HALT_NEVER;
+    return 0;
+  }
+  comma = strchr(word, ',');
+  if (!comma)
+    return -1;
+  if (strncmp(word, "soon", comma - word) == 0 && comma - word == 4)
+    halt->when = HALT_SOON;
+  else if (strncmp(word, "now", comma - word) == 0 && comma - word == 3)
+    halt->when = HALT_NOW;
+  else
+    return -1;
+
+  if (strncmp(comma + 1, "fail=", 5) == 0) {
+    halt->on_success = 0;
+    return parse_count(comma + 6, &halt->threshold);
+  }
+  if (strncmp(comma + 1, "success=", 8) == 0) {
+    halt->on_success = 1;
+    return parse_count(comma + 9, &halt->threshold);
+  }
+  return -1;
+}
+
+static int add_task(ParallelRun *run, char *arg) {
+  if (run->num_tasks == run->capacity) {
+    size_t n = run->capacity ? run->capacity * 2 : 64;
+    ParallelTask *tasks = realloc(run->tasks, n * sizeof *tasks);
+    if (!tasks) {
+      perror("parallel");
+      return -1;
+    }
+    run->tasks = tasks;
+    run->capacity = n;
+  }
+  run->tasks[run->num_tasks++] = (ParallelTask){.arg = arg};
+  return 0;
+}
+
+/* Reads stdin with read(), not stdio, so nothing the shell still has to
+ * read is taken into a buffer; each line is one input. */
+static int read_inputs(ParallelRun *run) {
+  size_t len = 0, size = 0;
+  ssize_t n;
+
+  do {
+    if (size - len < READ_CHUNK) {
+      size = size ? size * 2 : READ_CHUNK * 4;
+      char *input = realloc(run->input, size);
+      if (!input) {
+        perror("parallel");
+        return -1;
+      }
+      run->input = input;
+    }
+    n = read(STDIN_FILENO, run->input + len, size - len - 1);
+    if (n > 0)
+      len += n;
+  } while (n > 0 || (n < 0 && errno == EINTR && !interrupted));
+  if (n < 0) {
+    if (!interrupted)
+      perror("parallel: stdin");
+    return -1;
+  }
+  if (!run->input)
+    return 0;
+
+  run->input[len] = '\0';
+  for (char *line = run->input; line < run->input + len;) {
+    char *newline = memchr(line, '\n', run->input + len - line);
+    if (newline)
+      *newline = '\0';
+    if (add_task(run, line) < 0)
+      return -1;
+    line = newline ? newline + 1 : run->input + len;
+  }
+  return 0;
+}
+
+int parallel_parse(ParallelRun *run, char **argv) {
+  int i = 1;
+
+  memset(run, 0, sizeof *run);
+  arena_init(&run->arena, ARENA_BLOCK_SIZE);
+  run->slots = default_slots();
+
+  for (; argv[i] && argv[i][0] == '-' && argv[i][1]; i++) {
+    const char *opt = argv[i];
+    const char *value = NULL;
+
+    if (strcmp(opt, "--") == 0) {
+      i++;
+      break;
+    }
+    if (strcmp(opt, "-k") == 0 || strcmp(opt, "--keep-order") == 0) {
+      run->keep_order = 1;
+    } else if (strcmp(opt, "-u") == 0 || strcmp(opt, "--ungroup") == 0) {
+      run->ungroup = 1;
+    } else if (strcmp(opt, "-j") == 0 || strcmp(opt, "--jobs") == 0 ||
+               (strncmp(opt, "-j", 2) == 0 && opt[2] >= '0' &&
+                opt[2] <= '9')) {
+      value = opt[2] && opt[1] == 'j' ? opt + 2 : argv[++i];
+      if (parse_count(value, &run->slots) < 0) {
+        fprintf(stderr, "parallel: invalid number of jobs '%s'\n",
+                value ? value : "");
+        return -1;
+      }
+    } else if (strcmp(opt, "--halt") == 0) {
+      value = argv[++i];
+      if (parse_halt(value, &run->halt) < 0) {
+        fprintf(stderr, "parallel: invalid halt policy '%s'\n",
+                value ? value : "");
+        return -1;
+      }
+    } else if (strcmp(opt, "--joblog") == 0) {
+      run->joblog_path = argv[++i];
+      if (!run->joblog_path) {
+        fprintf(stderr, "parallel: --joblog needs a file\n");
+        return -1;
+      }
+    } else {
+      fprintf(stderr, "parallel: invalid option '%s'\n", opt);
+      return -1;
+    }
+  }
+
+  run->template = &argv[i];
+  while (argv[i] && strcmp(argv[i], PARALLEL_ARGS) != 0) {
+    if (strstr(argv[i], PARALLEL_PLACEHOLDER))
+      run->has_placeholder = 1;
+    i++;
+  }
+  if (run->template == &argv[i]) {
+    fprintf(stderr,
+            "parallel: usage: parallel [-j N] [-k] [-u] "
+            "[--halt when,fail|success=N] [--joblog file] command "
+            "[word...] [::: input...]\n");
+    return -1;
+  }
+
+  if (!argv[i])
+    return read_inputs(run);
+  // the template ends here; the inputs follow
+  argv[i++] = NULL;
+  for (; argv[i]; i++) {
+    if (strcmp(argv[i], PARALLEL_ARGS) == 0) {
+      fprintf(stderr, "parallel: only one list of inputs is supported\n");
+      return -1;
+    }
+    if (add_task(run, argv[i]) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+static char *substitute(Arena *arena, const char *word, const char *arg) {
+  size_t count = 0, arg_len = strlen(arg);
+  size_t mark_len = strlen(PARALLEL_PLACEHOLDER);
+
+  for (const char *p = word; (p = strstr(p, PARALLEL_PLACEHOLDER));
+       p += mark_len)
+    count++;
+  if (count == 0)
+    return (char *)word;
+
+  char *out = arena_alloc(arena, strlen(word) + count * arg_len + 1);
+  if (!out)
+    return NULL;
+  char *dst = out;
+  for (const char *p = word, *mark; *p; p = mark + mark_len) {
+    mark = strstr(p, PARALLEL_PLACEHOLDER);
+    if (!mark) {
+      strcpy(dst, p);
+      return out;
+    }
+    memcpy(dst, p, mark - p);
+    dst += mark - p;
+    memcpy(dst, arg, arg_len);
+    dst += arg_len;
+  }
+  *dst = '\0';
+  return out;
+}
+
+static char **task_argv(ParallelRun *run, const char *arg) {
+  size_t n = 0;
+
+  while (run->template[n])
+    n++;
+  char **argv = arena_alloc(&run->arena, (n + 2) * sizeof *argv);
+  if (!argv)
+    return NULL;
+  for (size_t i = 0; i < n; i++) {
+    argv[i] = substitute(&run->arena, run->template[i], arg);
+    if (!argv[i])
+      return NULL;
+  }
+  if (!run->has_placeholder) {
+    argv[n] = arena_strdup(&run->arena, arg);
+    if (!argv[n++])
+      return NULL;
+  }
+  argv[n] = NULL;
+  return argv;
+}
+
+/* The words joined by spaces, as `jobs` shows the task. */
+static char *task_line(Arena *arena, char **argv) {
+  size_t len = 0;
+
+  for (size_t i = 0; argv[i]; i++)
+    len += strlen(argv[i]) + 1;
+  char *line = arena_alloc(arena, len + 1);
+  if (!line)
+    return NULL;
+  char *dst = line;
+  for (size_t i = 0; argv[i]; i++) {
+    if (i > 0)
+      *dst++ = ' ';
+    dst = stpcpy(dst, argv[i]);
+  }
+  *dst = '\0';
+  return line;
+}
+
+static int task_exit_code(int status) {
+  if (WIFEXITED(status))
+    return WEXITSTATUS(status);
+  if (WIFSIGNALED(status))
+    return 128 + WTERMSIG(status);
+  return 1;
+}
+
+static int can_start(const ParallelRun *run) {
+  return run->halted == HALT_NEVER && !run->interrupted && !interrupted &&
+         !suspend_requested && run->num_running < run->slots &&
+         run->next < run->num_tasks;
+}
+
+/* Starts the first queued task as a background job. A task the shell runs
+ * itself, or one that cannot start, is finished before this returns. */
+static void start_task(ParallelRun *run, Job **job_head) {
+  size_t index = run->next++;
+  ParallelTask *task = &run->tasks[index];
+  char path[] = "/tmp/yega-parallel.XXXXXX";
+  int status = 0;
+
+  arena_reset(&run->arena);
+  task->state = TASK_RUNNING;
+  clock_gettime(CLOCK_REALTIME, &task->start);
+
+  if (!run->ungroup) {
+    int fd = mkstemp(path);
+    if (fd < 0 || !(task->output = strdup(path))) {
+      perror("parallel: output file");
+      if (fd >= 0) {
+        close(fd);
+        unlink(path);
+      }
+      finish_task(run, index, W_EXITCODE(1, 0), job_head);
+      return;
+    }
+    close(fd);
+  }
+
+  Command *cmd = arena_calloc(&run->arena, 1, sizeof *cmd);
+  Process *proc = arena_calloc(&run->arena, 1, sizeof *proc);
+  char **argv = task_argv(run, task->arg);
+  char *line = argv ? task_line(&run->arena, argv) : NULL;
+  Job *job = NULL;
+  if (cmd && proc && line) {
+    cmd->argv = argv;
+    cmd->infile = "/dev/null";
+    cmd->outfile = task->output;
+    cmd->background = 1;
+    proc->cmd = cmd;
+    job = initialize_job_control(line, cmd, proc, job_head, &run->arena);
+  }
+  if (!job) {
+    fprintf(stderr, "parallel: cannot start '%s'\n", task->arg);
+    finish_task(run, index, W_EXITCODE(1, 0), job_head);
+    return;
+  }
+
+  job->quiet = 1;
+  status = executor(job, job_head);
+  task->job = persist_job(job, job_head);
+  if (task->job) {
+    run->running[run->num_running++] = index;
+    return;
+  }
+  // done already, or never started; the executor freed the job
+  finish_task(run, index,
+              proc->completed
+                  ? proc->status
+                  : W_EXITCODE(status < 0 ? 1 : last_exit_status, 0),
+              job_head);
+}
+
+static void finish_task(ParallelRun *run, size_t index, int status,
+                        Job **job_head) {
+  ParallelTask *task = &run->tasks[index];
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  task->runtime = (now.tv_sec - task->start.tv_sec) +
+                  (now.tv_nsec - task->start.tv_nsec) / 1e9;
+  task->status = status;
+  task->state = TASK_DONE;
+  if (task->job) {
+    free_job(task->job, job_head);
+    task->job = NULL;
+  }
+
+  int ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (ok)
+    run->succeeded++;
+  else
+    run->failed++;
+  if (run->joblog)
+    log_task(run, index);
+  check_halt(run, task, ok);
+
+  if (run->keep_order)
+    print_in_order(run, 0);
+  else
+    print_task(task);
+}
+
+/* Hands the tasks whose jobs have ended to finish_task(). */
+static void collect(ParallelRun *run, Job **job_head) {
+  for (int i = 0; i < run->num_running;) {
+    size_t index = run->running[i];
+    Job *job = run->tasks[index].job;
+
+    if (!job_is_completed(job)) {
+      i++;
+      continue;
+    }
+    run->running[i] = run->running[--run->num_running];
+    finish_task(run, index, job->first_process->status, job_head);
+  }
+}
+
+static void check_halt(ParallelRun *run, ParallelTask *task, int ok) {
+  if (run->halt.when == HALT_NEVER || run->halted != HALT_NEVER ||
+      ok != run->halt.on_success)
+    return;
+  if ((ok ? run->succeeded : run->failed) < run->halt.threshold)
+    return;
+
+  run->halted = run->halt.when;
+  run->halt_status = task_exit_code(task->status);
+  fprintf(stderr, "parallel: %s after input '%s' %s\n",
+          run->halted == HALT_NOW ? "stopping" : "starting no more tasks",
+          task->arg, ok ? "succeeded" : "failed");
+  if (run->halted == HALT_NOW)
+    signal_running(run, SIGTERM);
+}
+
+/* Stopped tasks are continued so the signal reaches them. */
+static void signal_running(ParallelRun *run, int sig) {
+  for (int i = 0; i < run->num_running; i++) {
+    const Job *job = run->tasks[run->running[i]].job;
+    signal_job(job, sig);
+    if (sig != SIGTSTP)
+      signal_job(job, SIGCONT);
+  }
+}
+
+static void print_task(ParallelTask *task) {
+  if (task->output)
+    print_output_file(&task->output);
+  task->state = TASK_PRINTED;
+}
+
+/* Prints the finished tasks that no unfinished one comes before; at the end
+ * of a run, tasks that never ran or still run are skipped instead. */
+static void print_in_order(ParallelRun *run, int skip_unfinished) {
+  for (; run->next_print < run->num_tasks; run->next_print++) {
+    ParallelTask *task = &run->tasks[run->next_print];
+    if (task->state == TASK_DONE)
+      print_task(task);
+    else if (task->state != TASK_PRINTED && !skip_unfinished)
+      return;
+  }
+}
+
+/* One line in the format of GNU parallel's --joblog. */
+static void log_task(ParallelRun *run, size_t index) {
+  ParallelTask *task = &run->tasks[index];
+  struct stat st;
+  char **argv = task_argv(run, task->arg);
+  char *line = argv ? task_line(&run->arena, argv) : NULL;
+
+  fprintf(run->joblog, "%zu\t:\t%ld.%03ld\t%.3f\t0\t%lld\t%d\t%d\t%s\n",
+          index + 1, (long)task->start.tv_sec, task->start.tv_nsec / 1000000,
+          task->runtime,
+          task->output && stat(task->output, &st) == 0 ? (long long)st.st_size
+                                                       : 0LL,
+          WIFEXITED(task->status) ? WEXITSTATUS(task->status) : 0,
+          WIFSIGNALED(task->status) ? WTERMSIG(task->status) : 0,
+          line ? line : task->arg);
+  fflush(run->joblog);
+}
+
+/* Ctrl+Z: the running tasks are stopped and become ordinary jobs, which
+ * print what they collected when they are reported done. */
+static void suspend_run(ParallelRun *run) {
+  signal_running(run, SIGTSTP);
+  for (int i = 0; i < run->num_running; i++) {
+    ParallelTask *task = &run->tasks[run->running[i]];
+    task->job->quiet = 0;
+    task->job->output = task->output;
+    task->output = NULL;
+    task->job = NULL;
+  }
+  run->num_running = 0;
+  run->suspended = 1;
+  if (run->next < run->num_tasks)
+    fprintf(stderr, "parallel: %zu tasks not started\n",
+            run->num_tasks - run->next);
+}
+
+int parallel_run(ParallelRun *run, Job **job_head) {
+  struct sigaction sa, old_tstp;
+  sigset_t block, prev;
+
+  if (run->joblog_path) {
+    run->joblog = fopen(run->joblog_path, "w");
+    if (!run->joblog) {
+      fprintf(stderr, "parallel: %s: %s\n", run->joblog_path,
+              strerror(errno));
+      return 1;
+    }
+    fprintf(run->joblog, "Seq\tHost\tStarttime\tJobRuntime\tSend\tReceive\t"
+                         "Exitval\tSignal\tCommand\n");
+  }
+  run->running = calloc(run->slots, sizeof *run->running);
+  if (!run->running) {
+    perror("parallel");
+    return 1;
+  }
+
+  /* The handlers only run while nothing else is to be done: in sigsuspend()
+   * and while tasks are started, with the shell's own mask, which the
+   * tasks inherit. */
+  sigemptyset(&block);
+  sigaddset(&block, SIGCHLD);
+  sigaddset(&block, SIGINT);
+  sigaddset(&block, SIGQUIT);
+  sigaddset(&block, SIGTSTP);
+  sigprocmask(SIG_BLOCK, &block, &prev);
+  sa.sa_handler = tstp_handler;
+  sa.sa_flags = 0;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGTSTP, &sa, &old_tstp);
+  suspend_requested = 0;
+  interrupted = 0;
+
+  while (1) {
+    if (child_changed) {
+      child_changed = 0;
+      reap_children();
+    }
+    // the jobserver may have reaped while a task waited for a token
+    collect(run, job_head);
+    if (interrupted && !run->interrupted) {
+      run->interrupted = 1;
+      signal_running(run, SIGINT);
+    }
+    if (suspend_requested) {
+      suspend_requested = 0;
+      suspend_run(run);
+      break;
+    }
+    if (can_start(run)) {
+      sigprocmask(SIG_SETMASK, &prev, NULL);
+      while (can_start(run))
+        start_task(run, job_head);
+      sigprocmask(SIG_BLOCK, &block, NULL);
+      continue;
+    }
+    if (run->num_running == 0)
+      break;
+    sigsuspend(&prev);
+  }
+
+  sigaction(SIGTSTP, &old_tstp, NULL);
+  sigprocmask(SIG_SETMASK, &prev, NULL);
+  print_in_order(run, 1);
+
+  if (run->suspended)
+    return SUSPENDED_STATUS;
+  if (run->interrupted)
+    return INTERRUPTED_STATUS;
+  if (run->halted != HALT_NEVER)
+    return run->halt_status;
+  return run->failed < PARALLEL_MAX_FAILED ? run->failed
+                                           : PARALLEL_MAX_FAILED;
+}
+
+void parallel_free(ParallelRun *run) {
+  for (size_t i = 0; i < run->num_tasks; i++) {
+    if (run->tasks[i].output) {
+      unlink(run->tasks[i].output);
+      free(run->tasks[i].output);
+    }
+  }
+  if (run->joblog)
+    fclose(run->joblog);
+  free(run->tasks);
+  free(run->running);
+  free(run->input);
+  arena_free(&run->arena);
+  memset(run, 0, sizeof *run);
+}
@@ -1,7 +1,9 @@
 /**
  * @file expander.c
  * @brief Implements functionality for expanding environment variables used in
- * execution phase.
+ * execution phase. Each word is compiled into literal and variable segments;
+ * the values are looked up once, the exact size is summed and the result is
+ * written into a single arena allocation.
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
@@ -16,96 +18,163 @@
 #include "expander.h"
 #include "parser.h"
 
-static const char *get_env(const char *name);
-static char *expand_variable(const char *token);
+#define INITIAL_SEGMENTS 16
 
-static const char *get_env(const char *name) {
-  Variable *vp = lookup(name);
-  if (vp != NULL) {
-    return vp->value;
+/**
+ * @enum SegmentKind
+ * @brief What a segment of a compiled word stands for.
+ */
+typedef enum { SEGMENT_LITERAL, SEGMENT_VARIABLE } SegmentKind;
+
+/**
+ * @struct Segment
+ * @brief A slice of a word: literal text, or the name of a variable.
+ */
+typedef struct {
+  SegmentKind kind;
+  const char *text;
+  size_t len;
+} Segment;
+
+/* Reused for every word, so compiling stops allocating once it has seen
+ * the longest word. */
+static Segment *segments;
+static size_t num_segments, segments_capacity;
+
+static char pid_text[24];
+static char status_text[12];
+
+static int add_segment(SegmentKind kind, const char *text, size_t len);
+static size_t name_length(const char *name);
+static int compile_word(char *word);
+static const char *variable_value(const char *name, size_t len);
+static char *evaluate(Arena *arena);
+static char *expand_word(char *word, Arena *arena);
+
+static int add_segment(SegmentKind kind, const char *text, size_t len) {
+  if (kind == SEGMENT_LITERAL && len == 0)
+    return 0;
+  if (num_segments == segments_capacity) {
+    size_t capacity = segments_capacity ? segments_capacity * 2
+                                        : INITIAL_SEGMENTS;
+    Segment *items = realloc(segments, capacity * sizeof *items);
+    if (!items)
+      return -1;
+    segments = items;
+    segments_capacity = capacity;
   }
-  return getenv(name);
+  segments[num_segments].kind = kind;
+  segments[num_segments].text = text;
+  segments[num_segments].len = len;
+  num_segments++;
+  return 0;
 }
 
-static char *expand_variable(const char *token) {
-  int i = 1;
-  if (!(isalpha(token[i]) || token[i] == '_'))
-    return NULL;
-  char arg[MAXSIZ];
-  int j = 0;
-  while ((isalnum(token[i]) || token[i] == '_') && j < MAXSIZ - 1) {
-    arg[j++] = token[i++];
-  }
-  arg[j] = '\0';
+static size_t name_length(const char *name) {
+  size_t len = 0;
 
-  size_t rest_len = strlen(token + i);
+  /* The second `$` of `$$` is marked as well. */
+  if (*name == EXPANSION_MARK || *name == '?')
+    return 1;
+  if (!(isalpha((unsigned char)*name) || *name == '_'))
+    return 0;
+  while (isalnum((unsigned char)name[len]) || name[len] == '_')
+    len++;
+  return len;
+}
 
-  const char *env = get_env(arg);
-  size_t env_len = env ? strlen(env) : 0;
+/* Splits a word at its expansion marks: `$NAME`, `${NAME}`, `$$` and `$?`
+ * become variable segments, everything else literal text. A mark that does
+ * not start a valid expansion stands for a plain `$`. */
+static int compile_word(char *word) {
+  char *lit = word, *p = word;
 
-  char *out = malloc(env_len + rest_len + 1);
-  if (!out)
-    return NULL;
+  num_segments = 0;
+  while ((p = strchr(p, EXPANSION_MARK)) != NULL) {
+    if (add_segment(SEGMENT_LITERAL, lit, p - lit) < 0)
+      return -1;
 
-  if (env_len)
-    memcpy(out, env, env_len);
-  if (rest_len)
-    memcpy(out + env_len, token + i, rest_len);
+    int braced = p[1] == '{';
+    char *name = p + 1 + braced;
+    size_t len = name_length(name);
 
-  out[env_len + rest_len] = '\0';
-  return out;
+    if (braced && (len == 0 || name[len] != '}')) {
+      fprintf(stderr, "expander: bad substitution\n");
+      len = 0;
+    }
+    if (len == 0) {
+      if (add_segment(SEGMENT_LITERAL, "$", 1) < 0)
+        return -1;
+      lit = ++p;
+      continue;
+    }
+
+    if (add_segment(SEGMENT_VARIABLE, name, len) < 0)
+      return -1;
+    p = name + len + braced;
+    lit = p;
+  }
+  return add_segment(SEGMENT_LITERAL, lit, strlen(lit));
 }
 
-void expander(Command *cmd) {
-  for (int i = 1; cmd->argv[i] != NULL; i++) {
-    char *token = cmd->argv[i];
-    if (token[0] == '$') {
-      char *newstr = NULL;
-      if (strcmp(token, "$$") == 0) {
-        char pid_tmp[20];
-        snprintf(pid_tmp, sizeof pid_tmp, "%d", getpid());
-        newstr = strdup(pid_tmp);
-      } else if (strcmp(token, "$?") == 0) {
-        char exit_status[12];
-        snprintf(exit_status, sizeof exit_status, "%d", last_exit_status);
-        newstr = strdup(exit_status);
-      } else {
-        newstr = expand_variable(token);
-        if (!newstr) {
-          newstr = strdup(""); 
-          fprintf(stderr, "expander: failed to expand variable '%s'\n", token);
-        }
-      }
-
-      free(token);
-      cmd->argv[i] = newstr;
-    }
+static const char *variable_value(const char *name, size_t len) {
+  if (len == 1 && *name == EXPANSION_MARK) {
+    if (pid_text[0] == '\0')
+      snprintf(pid_text, sizeof pid_text, "%d", getpid());
+    return pid_text;
   }
+  if (len == 1 && *name == '?')
+    return status_text;
+
+  Variable *vp = lookup_len(name, len);
+  return vp ? vp->value : "";
+}
 
-  if (cmd->infile && cmd->infile[0] == '$') {
-    char *old = cmd->infile;
-    char *newstr = expand_variable(old);
-    if (newstr) {
-      cmd->infile = newstr;
-      free(old);
-    } else {
-      fprintf(stderr, "expander: failed to expand infile variable '%s'\n", old);
-      cmd->infile = strdup("");
-      free(old);
+static char *evaluate(Arena *arena) {
+  size_t total = 0;
+
+  for (size_t i = 0; i < num_segments; i++) {
+    Segment *seg = &segments[i];
+    if (seg->kind == SEGMENT_VARIABLE) {
+      seg->text = variable_value(seg->text, seg->len);
+      seg->len = strlen(seg->text);
     }
+    total += seg->len;
   }
 
-  if (cmd->outfile && cmd->outfile[0] == '$') {
-    char *old = cmd->outfile;
-    char *newstr = expand_variable(old);
-    if (newstr) {
-      cmd->outfile = newstr;
-      free(old);
-    } else {
-      fprintf(stderr, "expander: failed to expand outfile variable '%s'\n",
-              old);
-      cmd->outfile = strdup("");
-      free(old);
-    }
+  char *out = arena_alloc(arena, total + 1);
+  if (!out)
+    return NULL;
+
+  char *w = out;
+  for (size_t i = 0; i < num_segments; i++) {
+    memcpy(w, segments[i].text, segments[i].len);
+    w += segments[i].len;
+  }
+  *w = '\0';
+  return out;
+}
+
+static char *expand_word(char *word, Arena *arena) {
+  if (!word || !strchr(word, EXPANSION_MARK))
+    return word;
+
+  char *out = NULL;
+  if (compile_word(word) == 0)
+    out = evaluate(arena);
+  if (!out) {
+    fprintf(stderr, "expander: failed to expand '%s'\n", word);
+    return "";
   }
+  return out;
+}
+
+void expander(Command *cmd, Arena *arena) {
+  snprintf(status_text, sizeof status_text, "%d", last_exit_status);
+
+  for (int i = 0; cmd->argv[i] != NULL; i++)
+    cmd->argv[i] = expand_word(cmd->argv[i], arena);
+
+  cmd->infile = expand_word(cmd->infile, arena);
+  cmd->outfile = expand_word(cmd->outfile, arena);
 }
@@ -2,8 +2,8 @@
  * @file parser.c
  * @brief Implements functionalities for parsing user command. Related to
  * parsing phase. Includes functions for allocating and freeing memory for
- * commands. Also includes functions for validating the position of special
- * characters. characters.
+ * commands. The pipeline is parsed in one pass over the tokens, which also
+ * validates the position of special characters.
  * @author Yegane Gholipur
  * @date 2025-06-06
  */
@@ -15,31 +15,37 @@
 
 #include "parser.h"
 
-static const char *special_characters[OPERATORSLEN] = {">", "<", "&", ">>"};
-
-Command *allocate_memory(size_t num_args);
-static int is_background(char *tok) { return strcmp(tok, "&") == 0; }
-static int is_append_output(char *tok) { return strcmp(tok, ">>") == 0; }
-static int is_output_redirection(char *tok) { return strcmp(tok, ">") == 0; }
-static int is_input_redirection(char *tok) { return strcmp(tok, "<") == 0; }
-static int is_special_char(char *tok) {
-  for (int i = 0; i < OPERATORSLEN; i++)
-    if (strcmp(tok, special_characters[i]) == 0)
-      return 1;
-  return 0;
+#define INITIAL_ARGS 8
+
+Command *allocate_memory(size_t num_args, Arena *arena);
+static int push_arg(Command *cmd, size_t *argc, size_t *capacity, char *arg,
+                    Arena *arena);
+static char *redirection_target(char *line, const Token tokens[],
+                                size_t num_tokens, size_t *i);
+static char *copy_string(const char *s, int *failed);
+static int is_background(const Token *tok) {
+  return tok->kind == TOKEN_BACKGROUND;
+}
+static int is_append_output(const Token *tok) {
+  return tok->kind == TOKEN_REDIR_APPEND;
+}
+static int is_output_redirection(const Token *tok) {
+  return tok->kind == TOKEN_REDIR_OUT;
+}
+static int is_input_redirection(const Token *tok) {
+  return tok->kind == TOKEN_REDIR_IN;
 }
+static int is_special_char(const Token *tok) { return tok->kind != TOKEN_WORD; }
 
-Command *allocate_memory(size_t num_args) {
-  Command *cmd = malloc(sizeof *cmd);
+Command *allocate_memory(size_t num_args, Arena *arena) {
+  Command *cmd = arena_alloc(arena, sizeof *cmd);
   if (!cmd)
     return NULL;
 
   if (num_args > 0) {
-    cmd->argv = calloc(num_args + 1, sizeof *cmd->argv);
-    if (!cmd->argv) {
-      free(cmd);
+    cmd->argv = arena_calloc(arena, num_args + 1, sizeof *cmd->argv);
+    if (!cmd->argv)
       return NULL;
-    }
   } else {
     cmd->argv = NULL;
   }
@@ -51,6 +57,22 @@ Command *allocate_memory(size_t num_args) {
   return cmd;
 }
 
+/* The stage's length is not known up front, so argv doubles inside the
+ * arena; the outgrown array is left to the arena. */
+static int push_arg(Command *cmd, size_t *argc, size_t *capacity, char *arg,
+                    Arena *arena) {
+  if (*argc == *capacity) {
+    char **argv = arena_alloc(arena, (*capacity * 2 + 1) * sizeof *argv);
+    if (!argv)
+      return -1;
+    memcpy(argv, cmd->argv, *argc * sizeof *argv);
+    cmd->argv = argv;
+    *capacity *= 2;
+  }
+  cmd->argv[(*argc)++] = arg;
+  return 0;
+}
+
 void free_struct_memory(Command *cmd) {
   if (!cmd)
     return;
@@ -65,75 +87,141 @@ void free_struct_memory(Command *cmd) {
   free(cmd);
 }
 
-int parse(char *tokens[], Command **cmd_ptr, size_t num_tokens) {
-  if (tokens == NULL || num_tokens == 0 || tokens[0] == NULL) {
-    fprintf(stderr, "parser: no tokens to parse\n");
+static char *copy_string(const char *s, int *failed) {
+  if (!s)
+    return NULL;
+  char *copy = strdup(s);
+  if (!copy)
+    *failed = 1;
+  return copy;
+}
+
+Command *copy_command(const Command *cmd) {
+  Command *copy = calloc(1, sizeof *copy);
+  int failed = 0;
+  size_t argc = 0;
+
+  if (!copy)
+    return NULL;
+
+  if (cmd->argv) {
+    while (cmd->argv[argc])
+      argc++;
+    copy->argv = calloc(argc + 1, sizeof *copy->argv);
+    if (!copy->argv) {
+      free(copy);
+      return NULL;
+    }
+    for (size_t i = 0; i < argc; i++)
+      copy->argv[i] = copy_string(cmd->argv[i], &failed);
+  }
+  copy->infile = copy_string(cmd->infile, &failed);
+  copy->outfile = copy_string(cmd->outfile, &failed);
+  copy->append_output = cmd->append_output;
+  copy->background = cmd->background;
+
+  if (failed) {
+    free_struct_memory(copy);
+    return NULL;
+  }
+  return copy;
+}
+
+int parse(char *line, const Token tokens[], Command **cmd_ptr,
+          size_t num_tokens, Arena *arena) {
+  size_t i = 0;
+
+  if (parse_stage(line, tokens, num_tokens, &i, cmd_ptr, arena) < 0)
+    return -1;
+  if (i < num_tokens) {
+    fprintf(stderr, "parser: syntax error, unsupported operator '|'\n");
     return -1;
   }
-  Command *cmd = allocate_memory(num_tokens);
+  return 0;
+}
+
+/* Returns the word after the redirection at tokens[*i - 1] and steps over
+ * it. */
+static char *redirection_target(char *line, const Token tokens[],
+                                size_t num_tokens, size_t *i) {
+  if (*i < num_tokens && !is_special_char(&tokens[*i]))
+    return line + tokens[(*i)++].offset;
+
+  fprintf(stderr, "parser: syntax error after '%s'\n",
+          token_text(line, &tokens[*i - 1]));
+  return NULL;
+}
+
+int parse_stage(char *line, const Token tokens[], size_t num_tokens,
+                size_t *indx, Command **cmd_ptr, Arena *arena) {
+  size_t i = *indx;
+  size_t argc = 1, capacity = INITIAL_ARGS;
+
+  if (tokens == NULL || i >= num_tokens) {
+    fprintf(stderr, i > 0 ? "parser: syntax error near unexpected `|`\n"
+                          : "parser: no tokens to parse\n");
+    return -1;
+  }
+  Command *cmd = allocate_memory(capacity, arena);
   if (!cmd)
     return -1;
   *cmd_ptr = cmd;
 
   // check if the first token is a valid
-  char *first_tok = tokens[0];
-  if (!is_special_char(first_tok) && !is_background(first_tok) &&
-      !is_append_output(first_tok) && !is_output_redirection(first_tok) &&
-      !is_input_redirection(first_tok)) {
-    cmd->argv[0] = strdup(first_tok);
+  const Token *first_tok = &tokens[i++];
+  if (first_tok->kind == TOKEN_PIPE) {
+    fprintf(stderr, "parser: syntax error near unexpected `|`\n");
+    return -1;
+  } else if (!is_special_char(first_tok)) {
+    cmd->argv[0] = line + first_tok->offset;
   } else {
     fprintf(stderr, "parser: syntax error, first token is invalid\n");
-    free_struct_memory(cmd);
     return -1;
   }
 
-  size_t i = 1, argc = 1;
   while (i < num_tokens) {
-    char *tok = tokens[i++];
+    const Token *tok = &tokens[i++];
 
-    if (is_background(tok)) {
+    if (tok->kind == TOKEN_PIPE) {
+      if (i == num_tokens) {
+        fprintf(stderr, "parser: syntax error near unexpected `|`\n");
+        return -1;
+      }
+      break;
+    } else if (is_background(tok)) {
       if (i == num_tokens)
         cmd->background = 1;
       else {
         fprintf(stderr, "parser: syntax error, '&' must be the last token\n");
-        free_struct_memory(cmd);
         return -1;
       }
     } else if (is_append_output(tok)) {
-      if (i < num_tokens && !is_special_char(tokens[i])) {
-        cmd->outfile = strdup(tokens[i++]);
-        cmd->append_output = 1;
-      } else {
-        fprintf(stderr, "parser: syntax error after '>>'\n");
-        free_struct_memory(cmd);
+      if (!(cmd->outfile = redirection_target(line, tokens, num_tokens, &i)))
         return -1;
-      }
+      cmd->append_output = 1;
 
     } else if (is_output_redirection(tok)) {
-      if (i < num_tokens && !is_special_char(tokens[i])) {
-        cmd->outfile = strdup(tokens[i++]);
-      } else {
-        fprintf(stderr, "parser: syntax error after '>'\n");
-        free_struct_memory(cmd);
+      if (!(cmd->outfile = redirection_target(line, tokens, num_tokens, &i)))
         return -1;
-      }
+      cmd->append_output = 0;
 
     } else if (is_input_redirection(tok)) {
-      if (i < num_tokens && !is_special_char(tokens[i])) {
-        cmd->infile = strdup(tokens[i++]);
-      } else {
-        fprintf(stderr, "parser: syntax error after '<'\n");
-        free_struct_memory(cmd);
+      if (!(cmd->infile = redirection_target(line, tokens, num_tokens, &i)))
         return -1;
-      }
 
-    } else {
-      cmd->argv[argc++] = strdup(tok);
+    } else if (is_special_char(tok)) {
+      fprintf(stderr, "parser: syntax error, unsupported operator '%s'\n",
+              token_text(line, tok));
+      return -1;
+
+    } else if (push_arg(cmd, &argc, &capacity, line + tok->offset, arena) <
+               0) {
+      return -1;
     }
   }
 
-  if (cmd->argv)
-    cmd->argv[argc] = NULL;
+  cmd->argv[argc] = NULL;
+  *indx = i;
   return 0;
 }
 
@@ -153,66 +241,14 @@ void print_command_ptr(Command *cmd) {
   printf("background: %d\n", cmd->background);
 }
 
-int split_on_pipe(char *tokens[], size_t num_tokens, Command **cmd_ptr,
-                  int indx) {
-  char *process_command[num_tokens + 1];
-  int j = 0;
-
-  while (indx < (int)num_tokens && tokens[indx] != NULL &&
-         strcmp(tokens[indx], "|") != 0) {
-    process_command[j++] = tokens[indx++];
-  }
-  process_command[j] = NULL;
-
-  if (j == 0) {
-    // No real token before the "|" (or tokens[indx] was NULL).
-    fprintf(stderr, "parser: syntax error near unexpected `|`\n");
-    return -1;
-  }
-
-  int parser_status = parse(process_command, cmd_ptr, j);
-  if (parser_status < 0) {
-    fprintf(stderr, "parser: error\n");
-    return -1;
-  }
-
-  return indx;
-}
-
-char *get_raw_input(char *line_buffer) {
+char *get_raw_input(char *line_buffer, Arena *arena) {
   size_t length = strlen(line_buffer);
-  char *raw_input = NULL;
 
-  if (length > 0 && line_buffer[length - 1] == '&') {
-    raw_input = malloc(length);
-    if (raw_input == NULL) {
-      perror("malloc failed");
-      return NULL;
-    }
-    strncpy(raw_input, line_buffer, length - 1);
-    raw_input[length - 1] = '\0';
-  } else {
-    raw_input = malloc(length + 1);
-    if (raw_input == NULL) {
-      perror("malloc failed");
-      return NULL;
-    }
-    strcpy(raw_input, line_buffer);
-  }
+  if (length > 0 && line_buffer[length - 1] == '&')
+    length--;
 
+  char *raw_input = arena_strndup(arena, line_buffer, length);
+  if (raw_input == NULL)
+    perror("arena allocation failed");
   return raw_input;
 }
-
-int is_background_char_valid(char *tokens[], size_t num_tokens) {
-  for (size_t i = 0; i < num_tokens; i++) {
-    if (strcmp(tokens[i], "&") == 0) {
-      if (i == num_tokens - 1) {
-        return 1;
-      } else {
-        fprintf(stderr, "parser: error on '&' character: must be last\n");
-        return 0;
-      }
-    }
-  }
-  return 1;
-}
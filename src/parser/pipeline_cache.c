@@ -0,0 +1,214 @@
+/**
+ * @file pipeline_cache.c
+ * @brief LRU cache of parsed pipelines keyed by the raw command line. A hit
+ *         skips tokenizing and parsing; the template is cloned into the line
+ *         arena and only expanded.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "pipeline_cache.h"
+
+static PipelineTemplate **find_link(PipelineCache *cache, uint64_t hash,
+                                    const char *line, size_t len);
+static void lru_unlink(PipelineCache *cache, PipelineTemplate *tpl);
+static void lru_push_front(PipelineCache *cache, PipelineTemplate *tpl);
+static void evict(PipelineCache *cache);
+static long store_string(char *strings, size_t *used, const char *s);
+
+void pipeline_cache_init(PipelineCache *cache, size_t capacity) {
+  memset(cache, 0, sizeof *cache);
+  if (capacity == 0 || capacity > PIPELINE_CACHE_SIZE)
+    capacity = PIPELINE_CACHE_SIZE;
+  cache->capacity = capacity;
+}
+
+static PipelineTemplate **find_link(PipelineCache *cache, uint64_t hash,
+                                    const char *line, size_t len) {
+  PipelineTemplate **link =
+      &cache->buckets[hash & (PIPELINE_CACHE_BUCKETS - 1)];
+
+  for (; *link; link = &(*link)->hash_next) {
+    PipelineTemplate *tpl = *link;
+    if (tpl->hash == hash && tpl->key_len == len &&
+        memcmp(tpl->strings, line, len) == 0)
+      break;
+  }
+  return link;
+}
+
+static void lru_unlink(PipelineCache *cache, PipelineTemplate *tpl) {
+  if (tpl->lru_prev)
+    tpl->lru_prev->lru_next = tpl->lru_next;
+  else
+    cache->lru_head = tpl->lru_next;
+  if (tpl->lru_next)
+    tpl->lru_next->lru_prev = tpl->lru_prev;
+  else
+    cache->lru_tail = tpl->lru_prev;
+}
+
+static void lru_push_front(PipelineCache *cache, PipelineTemplate *tpl) {
+  tpl->lru_prev = NULL;
+  tpl->lru_next = cache->lru_head;
+  if (cache->lru_head)
+    cache->lru_head->lru_prev = tpl;
+  else
+    cache->lru_tail = tpl;
+  cache->lru_head = tpl;
+}
+
+static void evict(PipelineCache *cache) {
+  PipelineTemplate *victim = cache->lru_tail;
+  PipelineTemplate **link = find_link(cache, victim->hash, victim->strings,
+                                      victim->key_len);
+
+  *link = victim->hash_next;
+  lru_unlink(cache, victim);
+  cache->count--;
+  free(victim);
+}
+
+const PipelineTemplate *pipeline_cache_lookup(PipelineCache *cache,
+                                              const char *line, size_t len) {
+  PipelineTemplate *tpl = *find_link(cache, hash_bytes(line, len), line, len);
+
+  if (!tpl) {
+    cache->misses++;
+    return NULL;
+  }
+  cache->hits++;
+  if (tpl != cache->lru_head) {
+    lru_unlink(cache, tpl);
+    lru_push_front(cache, tpl);
+  }
+  return tpl;
+}
+
+static long store_string(char *strings, size_t *used, const char *s) {
+  if (!s)
+    return -1;
+  size_t offset = *used;
+  size_t n = strlen(s) + 1;
+  memcpy(strings + offset, s, n);
+  *used += n;
+  return (long)offset;
+}
+
+int pipeline_cache_store(PipelineCache *cache, const char *line, size_t len,
+                         const Process *proc_head) {
+  uint64_t hash = hash_bytes(line, len);
+  size_t num_stages = 0, num_args = 0, strings_len = 0;
+  const Process *proc;
+
+  if (*find_link(cache, hash, line, len))
+    return 0;
+
+  for (proc = proc_head; proc; proc = proc->next) {
+    Command *cmd = proc->cmd;
+    num_stages++;
+    for (char **arg = cmd->argv; arg && *arg; arg++, num_args++)
+      strings_len += strlen(*arg) + 1;
+    if (cmd->infile)
+      strings_len += strlen(cmd->infile) + 1;
+    if (cmd->outfile)
+      strings_len += strlen(cmd->outfile) + 1;
+  }
+
+  PipelineTemplate *tpl =
+      malloc(sizeof *tpl + num_stages * sizeof *tpl->stages +
+             num_args * sizeof *tpl->args + len + 1 + strings_len);
+  if (!tpl) {
+    perror("malloc for pipeline template failed");
+    return -1;
+  }
+  tpl->hash = hash;
+  tpl->key_len = len;
+  tpl->num_stages = num_stages;
+  tpl->num_args = num_args;
+  tpl->strings_len = strings_len;
+  tpl->stages = (StageTemplate *)(tpl + 1);
+  tpl->args = (size_t *)(tpl->stages + num_stages);
+  tpl->strings = (char *)(tpl->args + num_args);
+  memcpy(tpl->strings, line, len);
+  tpl->strings[len] = '\0';
+
+  char *strings = tpl->strings + len + 1;
+  size_t used = 0, arg_indx = 0;
+  StageTemplate *stage = tpl->stages;
+  for (proc = proc_head; proc; proc = proc->next, stage++) {
+    Command *cmd = proc->cmd;
+    stage->first_arg = arg_indx;
+    for (char **arg = cmd->argv; arg && *arg; arg++)
+      tpl->args[arg_indx++] = store_string(strings, &used, *arg);
+    stage->argc = arg_indx - stage->first_arg;
+    stage->infile = store_string(strings, &used, cmd->infile);
+    stage->outfile = store_string(strings, &used, cmd->outfile);
+    stage->append_output = cmd->append_output;
+    stage->background = cmd->background;
+  }
+
+  if (cache->count == cache->capacity)
+    evict(cache);
+  PipelineTemplate **bucket =
+      &cache->buckets[hash & (PIPELINE_CACHE_BUCKETS - 1)];
+  tpl->hash_next = *bucket;
+  *bucket = tpl;
+  lru_push_front(cache, tpl);
+  cache->count++;
+  return 0;
+}
+
+Process *pipeline_instantiate(const PipelineTemplate *tpl, Command **cmd_ptr,
+                              Process **proc_ptr, Arena *arena) {
+  size_t n = tpl->num_stages;
+  Process *procs = arena_calloc(arena, n, sizeof *procs);
+  Command *cmds = arena_alloc(arena, n * sizeof *cmds);
+  char **argv = arena_alloc(arena, (tpl->num_args + n) * sizeof *argv);
+  char *strings = arena_alloc(arena, tpl->strings_len);
+
+  *proc_ptr = NULL;
+  if (!procs || !cmds || !argv || !strings)
+    return NULL;
+  memcpy(strings, tpl->strings + tpl->key_len + 1, tpl->strings_len);
+
+  for (size_t i = 0; i < n; i++) {
+    const StageTemplate *stage = &tpl->stages[i];
+    Command *cmd = &cmds[i];
+
+    cmd->argv = argv;
+    for (size_t j = 0; j < stage->argc; j++)
+      *argv++ = strings + tpl->args[stage->first_arg + j];
+    *argv++ = NULL;
+    cmd->infile = stage->infile < 0 ? NULL : strings + stage->infile;
+    cmd->outfile = stage->outfile < 0 ? NULL : strings + stage->outfile;
+    cmd->append_output = stage->append_output;
+    cmd->background = stage->background;
+
+    procs[i].cmd = cmd;
+    procs[i].next = i + 1 < n ? &procs[i + 1] : NULL;
+  }
+
+  *cmd_ptr = &cmds[n - 1];
+  *proc_ptr = procs;
+  return procs;
+}
+
+void pipeline_cache_clear(PipelineCache *cache) {
+  PipelineTemplate *tpl = cache->lru_head;
+
+  while (tpl) {
+    PipelineTemplate *next = tpl->lru_next;
+    free(tpl);
+    tpl = next;
+  }
+  memset(cache->buckets, 0, sizeof cache->buckets);
+  cache->lru_head = NULL;
+  cache->lru_tail = NULL;
+  cache->count = 0;
+}
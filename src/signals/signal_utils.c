@@ -11,7 +11,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <wait.h>
 
 #include "job_utils.h"
 #include "signal_utils.h"
@@ -39,12 +38,7 @@ static void sigquit_handler(int sig) {
 
 static void sigchld_handler(int sig) {
   (void)sig;
-  pid_t w;
-  int status;
-  while ((w = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0) {
-    child_changed = 1;
-    queue_pending_procs(w, status);
-  }
+  child_changed = 1;
 }
 
 void ignore_job_control_signals(void) {
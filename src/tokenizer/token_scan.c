@@ -0,0 +1,176 @@
+/**
+ * @file token_scan.c
+ * @brief Delimiter scanning used by the tokenizer. Finds the next byte that
+ * ends a run of plain word characters, using SSE2 or AVX2 when the CPU
+ * supports them.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "token_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+static size_t scan_resolve(const char *s, size_t len);
+
+static size_t (*scan_impl)(const char *, size_t) = scan_resolve;
+static ScanKernel current_kernel = SCAN_SCALAR;
+
+/* One entry per byte value, so the scalar path needs neither isspace() nor a
+ * search through the operator list. */
+static const unsigned char delimiter_table[256] = {
+    ['\0'] = 1, ['\t'] = 1, ['\n'] = 1, ['\v'] = 1, ['\f'] = 1, ['\r'] = 1,
+    [' '] = 1,  ['\''] = 1, ['"'] = 1,  ['\\'] = 1, ['>'] = 1,  ['<'] = 1,
+    ['&'] = 1,  ['|'] = 1};
+
+int is_scan_delimiter(unsigned char c) { return delimiter_table[c]; }
+
+size_t scan_delimiter(const char *s, size_t len) { return scan_impl(s, len); }
+
+size_t scan_delimiter_scalar(const char *s, size_t len) {
+  size_t i = 0;
+  while (i < len && !delimiter_table[(unsigned char)s[i]])
+    i++;
+  return i;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse2"))) size_t scan_delimiter_sse2(const char *s,
+                                                            size_t len) {
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i ws_span = _mm_set1_epi8('\r' - '\t');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i squote = _mm_set1_epi8('\'');
+  const __m128i dquote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i gt = _mm_set1_epi8('>');
+  const __m128i lt = _mm_set1_epi8('<');
+  const __m128i amp = _mm_set1_epi8('&');
+  const __m128i bar = _mm_set1_epi8('|');
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    /* \t..\r is a contiguous range: v - '\t' <= '\r' - '\t' (unsigned). */
+    __m128i off = _mm_sub_epi8(v, tab);
+    __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(off, ws_span), off);
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, space));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, squote));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dquote));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, backslash));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, gt));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, lt));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, amp));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, bar));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, zero));
+
+    unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+    if (mask)
+      return i + (size_t)__builtin_ctz(mask);
+  }
+  return i + scan_delimiter_scalar(s + i, len - i);
+}
+
+__attribute__((target("avx2"))) size_t scan_delimiter_avx2(const char *s,
+                                                            size_t len) {
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i ws_span = _mm256_set1_epi8('\r' - '\t');
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i squote = _mm256_set1_epi8('\'');
+  const __m256i dquote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i gt = _mm256_set1_epi8('>');
+  const __m256i lt = _mm256_set1_epi8('<');
+  const __m256i amp = _mm256_set1_epi8('&');
+  const __m256i bar = _mm256_set1_epi8('|');
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i off = _mm256_sub_epi8(v, tab);
+    __m256i hit = _mm256_cmpeq_epi8(_mm256_min_epu8(off, ws_span), off);
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, space));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, squote));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, dquote));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, backslash));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, gt));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, lt));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, amp));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, bar));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, zero));
+
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+    if (mask)
+      return i + (size_t)__builtin_ctz(mask);
+  }
+  /* Finish the tail 16 bytes at a time rather than byte by byte. */
+  return i + scan_delimiter_sse2(s + i, len - i);
+}
+
+int token_scan_supported(ScanKernel kernel) {
+  __builtin_cpu_init();
+  switch (kernel) {
+  case SCAN_AVX2:
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse2");
+  case SCAN_SSE2:
+    return __builtin_cpu_supports("sse2");
+  default:
+    return 1;
+  }
+}
+
+#else
+
+size_t scan_delimiter_sse2(const char *s, size_t len) {
+  return scan_delimiter_scalar(s, len);
+}
+
+size_t scan_delimiter_avx2(const char *s, size_t len) {
+  return scan_delimiter_scalar(s, len);
+}
+
+int token_scan_supported(ScanKernel kernel) { return kernel == SCAN_SCALAR; }
+
+#endif
+
+int token_scan_select(ScanKernel kernel) {
+  if (!token_scan_supported(kernel))
+    return -1;
+
+  switch (kernel) {
+  case SCAN_AVX2:
+    scan_impl = scan_delimiter_avx2;
+    break;
+  case SCAN_SSE2:
+    scan_impl = scan_delimiter_sse2;
+    break;
+  default:
+    scan_impl = scan_delimiter_scalar;
+    break;
+  }
+  current_kernel = kernel;
+  return 0;
+}
+
+ScanKernel token_scan_kernel(void) {
+  if (scan_impl == scan_resolve)
+    scan_resolve("", 0);
+  return current_kernel;
+}
+
+/* Runs once: picks the widest kernel the CPU supports and then gets out of
+ * the way, so later calls go straight to the kernel. */
+static size_t scan_resolve(const char *s, size_t len) {
+  if (token_scan_select(SCAN_AVX2) < 0 && token_scan_select(SCAN_SSE2) < 0)
+    token_scan_select(SCAN_SCALAR);
+  return scan_impl(s, len);
+}
@@ -16,19 +16,37 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "token_scan.h"
 #include "tokenizer.h"
 
+#define INITIAL_TOKENS 64
+
 static const char special_characters[SPECIALCHARLEN] = {'>', '<', '&', '|'};
 
-static int store_token(char *argument, char *tokens[], int max_tokens, int *token_num);
+static const char *operator_text[] = {
+    [TOKEN_PIPE] = "|",          [TOKEN_OR] = "||",
+    [TOKEN_BACKGROUND] = "&",    [TOKEN_AND] = "&&",
+    [TOKEN_REDIR_IN] = "<",      [TOKEN_HEREDOC] = "<<",
+    [TOKEN_REDIR_OUT] = ">",     [TOKEN_REDIR_APPEND] = ">>"};
+
+static int store_token(TokenVector *tokens, size_t offset, size_t length,
+                       TokenKind kind);
 static bool is_special_char(char character);
-static bool is_valid_double_operator(char first, char second);
-static char *handle_single_quotes(char token_buffer[], char *p, int max_len);
-static char *handle_double_quotes(char token_buffer[], char *p, int max_len);
-static char *handle_special_characters(char token_buffer[], char *p, int max_len);
+static TokenKind operator_kind(char first, char second, size_t *len);
+static void terminate_words(char *line, TokenVector *tokens);
+static char *copy_plain_run(char **write, char *p, char *end);
+static int handle_single_quotes(Lexer *lexer, char **write, char **cursor,
+                                char *end);
+static int handle_double_quotes(Lexer *lexer, char **write, char **cursor,
+                                char *end);
+static int handle_word(Lexer *lexer, char *line, char **cursor, char *end,
+                       TokenVector *tokens);
+static char *handle_special_characters(char *line, char *p,
+                                       TokenVector *tokens);
 
-int prompt_and_read(char **line_buffer, ssize_t *read, size_t *buffsize) {
-  printf("YegaShell> ");
+int prompt_and_read(const char *prompt, char **line_buffer, ssize_t *read,
+                    size_t *buffsize) {
+  printf("%s", prompt);
   *read = getline(line_buffer, buffsize, stdin);
 
   if (*read == -1)
@@ -37,81 +55,144 @@ int prompt_and_read(char **line_buffer, ssize_t *read, size_t *buffsize) {
   return 0;
 }
 
-void free_memory(char *tokens[], int token_num) {
-  for (int i = 0; i < token_num; i++) {
-    free(tokens[i]);
-    tokens[i] = NULL;
-  }
+void free_memory(TokenVector *tokens) {
+  free(tokens->items);
+  tokens->items = NULL;
+  tokens->count = 0;
+  tokens->capacity = 0;
+}
+
+const char *token_text(const char *line, const Token *tok) {
+  if (tok->kind == TOKEN_WORD)
+    return line + tok->offset;
+  return operator_text[tok->kind];
 }
 
-void print_tokens(char *tokens[], int token_num) {
-  for (int i = 0; i < token_num; i++) {
-    printf("%s\n", tokens[i]);
+void print_tokens(const char *line, const TokenVector *tokens) {
+  for (size_t i = 0; i < tokens->count; i++) {
+    printf("%s\n", token_text(line, &tokens->items[i]));
   }
 }
 
-static int store_token(char *argument, char *tokens[], int max_tokens,
-                int *token_num) {
-  char *p;
-  if (*token_num < max_tokens && ((p = malloc(strlen(argument) + 1)) != NULL)) {
-    strcpy(p, argument);
-    tokens[(*token_num)++] = p;
-  } else {
-    return -1;
+static int store_token(TokenVector *tokens, size_t offset, size_t length,
+                       TokenKind kind) {
+  if (tokens->count == tokens->capacity) {
+    size_t capacity = tokens->capacity ? tokens->capacity * 2 : INITIAL_TOKENS;
+    Token *items = realloc(tokens->items, capacity * sizeof *items);
+    if (items == NULL)
+      return -1;
+    tokens->items = items;
+    tokens->capacity = capacity;
   }
 
+  Token *tok = &tokens->items[tokens->count++];
+  tok->offset = offset;
+  tok->length = length;
+  tok->kind = kind;
   return 0;
 }
 
-int tokenize_line(char *line, char *tokens[], int max_tokens, int max_len,
-                  int *token_num) {
-  char *cursor = line;
-  char token_buffer[MAXLEN] = {0};
+int tokenize_line(char *line, TokenVector *tokens) {
+  Lexer lexer;
 
-  *token_num = 0;
+  lexer_reset(&lexer, tokens);
+  int status = lexer_feed(&lexer, line, strlen(line), tokens);
+  if (status == LEX_INCOMPLETE)
+    status = lexer_finish(&lexer, line, tokens);
+  return status;
+}
 
-  while (*cursor != '\0') {
-    while (isspace(*cursor))
-      cursor++;
-    if (*cursor == '\0')
-      break;
+void lexer_reset(Lexer *lexer, TokenVector *tokens) {
+  lexer->read = 0;
+  lexer->write = 0;
+  lexer->word_start = 0;
+  lexer->state = LEX_START;
+  tokens->count = 0;
+}
 
-    char *token_pointer = token_buffer;
-    int remaining_len = max_len;
+int lexer_feed(Lexer *lexer, char *line, size_t len, TokenVector *tokens) {
+  char *cursor = line + lexer->read;
+  char *end = line + len;
 
-    if (*cursor == '"') {
-      cursor = handle_double_quotes(token_buffer, cursor, remaining_len);
-      if (cursor == NULL) {
-        fprintf(stderr, "Unmatched double quotes\n");
-        return -1;
-      }
-    } else if (*cursor == '\'') {
-      cursor = handle_single_quotes(token_buffer, cursor, remaining_len);
-      if (cursor == NULL) {
-        fprintf(stderr, "Unmatched single quotes\n");
-        return -1;
+  while (1) {
+    if (lexer->state == LEX_START) {
+      while (isspace((unsigned char)*cursor))
+        cursor++;
+      if (*cursor == '\\' && cursor[1] == '\n') {
+        cursor += 2;
+        if (cursor == end) {
+          lexer->read = cursor - line;
+          return LEX_INCOMPLETE;
+        }
+        continue;
       }
-    } else if (is_special_char(*cursor)) {
-      cursor = handle_special_characters(token_buffer, cursor, remaining_len);
-    } else {
-      while (remaining_len > 1 && *cursor != '\0' &&
-             !is_special_char(*cursor) && !isspace(*cursor)) {
-        *token_pointer++ = *cursor++;
-        remaining_len--;
+      if (*cursor == '\0')
+        break;
+
+      if (is_special_char(*cursor)) {
+        cursor = handle_special_characters(line, cursor, tokens);
+        if (cursor == NULL)
+          return -1;
+        continue;
       }
-      *token_pointer = '\0';
+
+      lexer->word_start = cursor - line;
+      lexer->write = lexer->word_start;
+      lexer->state = LEX_WORD;
     }
 
-    if (store_token(token_buffer, tokens, max_tokens, token_num) == -1) {
+    int status = handle_word(lexer, line, &cursor, end, tokens);
+    if (status != 0) {
+      lexer->read = cursor - line;
+      return status;
+    }
+  }
+
+  lexer->read = cursor - line;
+
+  /* A pipe at the end of the input means the command goes on in the next
+   * line. `||` and `&&` are not, as the parser rejects them anyway. */
+  if (tokens->count > 0 &&
+      tokens->items[tokens->count - 1].kind == TOKEN_PIPE)
+    return LEX_INCOMPLETE;
+
+  terminate_words(line, tokens);
+  return LEX_COMPLETE;
+}
+
+int lexer_finish(Lexer *lexer, char *line, TokenVector *tokens) {
+  if (lexer->state == LEX_SINGLE_QUOTE) {
+    fprintf(stderr, "Unmatched single quotes\n");
+    return -1;
+  }
+  if (lexer->state == LEX_DOUBLE_QUOTE) {
+    fprintf(stderr, "Unmatched double quotes\n");
+    return -1;
+  }
+  if (lexer->state == LEX_WORD) {
+    if (store_token(tokens, lexer->word_start,
+                    lexer->write - lexer->word_start, TOKEN_WORD) == -1) {
       fprintf(stderr, "Error allocating memory\n");
       return -1;
     }
+    lexer->state = LEX_START;
   }
 
-  tokens[*token_num] = NULL;
+  terminate_words(line, tokens);
   return 0;
 }
 
+/* Words are terminated only once the command is complete: a word that ends
+ * right before an operator shares its terminating byte with that operator,
+ * and operators are only ever read back through their kind. */
+static void terminate_words(char *line, TokenVector *tokens) {
+  for (size_t i = 0; i < tokens->count; i++) {
+    Token *tok = &tokens->items[i];
+    if (tok->kind == TOKEN_WORD)
+      line[tok->offset + tok->length] = '\0';
+  }
+}
+
 static bool is_special_char(char character) {
   for (int i = 0; i < SPECIALCHARLEN; i++)
     if (character == special_characters[i])
@@ -119,65 +200,151 @@ static bool is_special_char(char character) {
   return false;
 }
 
-static bool is_valid_double_operator(char first, char second) {
-  return (first == '>' && second == '>') || (first == '<' && second == '<') ||
-         (first == '&' && second == '&') || (first == '|' && second == '|');
+static TokenKind operator_kind(char first, char second, size_t *len) {
+  bool doubled = first == second;
+  *len = doubled ? 2 : 1;
+
+  switch (first) {
+  case '>':
+    return doubled ? TOKEN_REDIR_APPEND : TOKEN_REDIR_OUT;
+  case '<':
+    return doubled ? TOKEN_HEREDOC : TOKEN_REDIR_IN;
+  case '&':
+    return doubled ? TOKEN_AND : TOKEN_BACKGROUND;
+  default:
+    return doubled ? TOKEN_OR : TOKEN_PIPE;
+  }
 }
 
-static char *handle_single_quotes(char token_buffer[], char *p, int max_len) {
-  while (max_len > 1) {
-    if (*++p == '\0')
-      return NULL;
-    if (*p == '\'')
-      break;
-    *token_buffer++ = *p;
-    max_len--;
+/* Moves the run of plain characters at p down to *write, a block at a time,
+ * and marks the expansions in it. Returns the delimiter that ended the run.
+ * Runs are only copied outside quotes or inside double quotes, so every `$`
+ * here starts an expansion. */
+static char *copy_plain_run(char **write, char *p, char *end) {
+  size_t run = scan_delimiter(p, end - p);
+  char *dollar = *write;
+  char *run_end = *write + run;
+
+  if (*write != p)
+    memmove(*write, p, run);
+  while ((dollar = memchr(dollar, '$', run_end - dollar)) != NULL)
+    *dollar++ = EXPANSION_MARK;
+  *write = run_end;
+  return p + run;
+}
+
+/* Copies the quoted text down to *write. Return LEX_INCOMPLETE when the
+ * input ends before the closing quote, which may still arrive in the next
+ * line. */
+static int handle_single_quotes(Lexer *lexer, char **write, char **cursor,
+                                char *end) {
+  char *p = *cursor;
+  char *close = memchr(p, '\'', end - p);
+  char *stop = close ? close : end;
+
+  memmove(*write, p, stop - p);
+  *write += stop - p;
+
+  if (close == NULL) {
+    *cursor = end;
+    return LEX_INCOMPLETE;
   }
-  if (max_len <= 1)
-    return NULL;
-  *token_buffer = '\0';
-  return p + 1;
+  *cursor = close + 1;
+  lexer->state = LEX_WORD;
+  return 0;
 }
 
-static char *handle_double_quotes(char token_buffer[], char *p, int max_len) {
-  while (max_len > 1) {
-    if (*++p == '\0')
-      return NULL;
+static int handle_double_quotes(Lexer *lexer, char **write, char **cursor,
+                                char *end) {
+  char *p = *cursor;
+
+  while (1) {
+    p = copy_plain_run(write, p, end);
+    if (*p == '"') {
+      lexer->state = LEX_WORD;
+      p++;
+      break;
+    }
+    if (p == end) {
+      *cursor = p;
+      return LEX_INCOMPLETE;
+    }
     if (*p == '\\') {
-      if (*++p == '\0')
-        return NULL;
-      *token_buffer++ = *p;
-      max_len--;
+      if (p[1] == '\n') {
+        p += 2;
+        continue;
+      }
+      if (p + 1 == end) {
+        *cursor = p;
+        return LEX_INCOMPLETE;
+      }
+      p++;
+    }
+    *(*write)++ = *p++;
+  }
+
+  *cursor = p;
+  return 0;
+}
+
+/* A word runs until unquoted whitespace or an operator. Quoted parts and
+ * escapes are unescaped in place: the write cursor never passes the read
+ * cursor, so the result always fits where the word was. The word may be
+ * resumed here after a continuation line was appended. */
+static int handle_word(Lexer *lexer, char *line, char **cursor, char *end,
+                       TokenVector *tokens) {
+  char *p = *cursor;
+  char *w = line + lexer->write;
+  int status = 0;
+
+  while (status == 0 && lexer->state != LEX_START) {
+    if (lexer->state == LEX_SINGLE_QUOTE) {
+      status = handle_single_quotes(lexer, &w, &p, end);
+      continue;
+    }
+    if (lexer->state == LEX_DOUBLE_QUOTE) {
+      status = handle_double_quotes(lexer, &w, &p, end);
+      continue;
+    }
+
+    p = copy_plain_run(&w, p, end);
+    if (*p == '\'') {
+      lexer->state = LEX_SINGLE_QUOTE;
+      p++;
     } else if (*p == '"') {
-      break;
+      lexer->state = LEX_DOUBLE_QUOTE;
+      p++;
+    } else if (*p == '\\' && p[1] == '\n') {
+      p += 2;
+      if (p == end)
+        status = LEX_INCOMPLETE;
+    } else if (*p == '\\') {
+      if (p + 1 != end)
+        p++;
+      *w++ = *p++;
     } else {
-      *token_buffer++ = *p;
-      max_len--;
+      if (store_token(tokens, lexer->word_start, w - (line + lexer->word_start),
+                      TOKEN_WORD) == -1) {
+        fprintf(stderr, "Error allocating memory\n");
+        return -1;
+      }
+      lexer->state = LEX_START;
     }
   }
-  if (max_len <= 1)
-    return NULL;
-  *token_buffer = '\0';
-  return p + 1;
-}
-
-// Escape characters are not processed in single quotes yet (like in real
-// shells)
-static char *handle_special_characters(char token_buffer[], char *p, int max_len) {
-  char character = *p;
-  if (max_len > 1) {
-    *token_buffer++ = character;
-    max_len--;
-
-    char *next = p + 1;
-    if (*next != '\0' && is_valid_double_operator(character, *next)) {
-      *token_buffer++ = *next;
-      max_len--;
-      p = next;
-    }
 
-    *token_buffer = '\0';
-    return p + 1;
+  lexer->write = w - line;
+  *cursor = p;
+  return status;
+}
+
+static char *handle_special_characters(char *line, char *p,
+                                       TokenVector *tokens) {
+  size_t len;
+  TokenKind kind = operator_kind(p[0], p[1], &len);
+
+  if (store_token(tokens, p - line, len, kind) == -1) {
+    fprintf(stderr, "Error allocating memory\n");
+    return NULL;
   }
-  return NULL;
+  return p + len;
 }
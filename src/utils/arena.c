@@ -0,0 +1,123 @@
+/**
+ * @file arena.c
+ * @brief Bump-pointer allocator for objects that live for one command line.
+ *         Everything allocated from an arena is released at once by
+ *         arena_reset(); there is no per-object free.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+static ArenaBlock *new_block(Arena *arena, size_t size);
+static void free_blocks(ArenaBlock *block);
+
+static ArenaBlock *new_block(Arena *arena, size_t size) {
+  ArenaBlock *block = malloc(sizeof *block + size);
+  if (!block)
+    return NULL;
+  block->size = size;
+  block->used = 0;
+  block->next = arena->blocks;
+  arena->blocks = block;
+  arena->current.mallocs++;
+  return block;
+}
+
+static void free_blocks(ArenaBlock *block) {
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+void arena_init(Arena *arena, size_t block_size) {
+  memset(arena, 0, sizeof *arena);
+  arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size_t rounded = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  ArenaBlock *block = arena->blocks;
+
+  if (rounded < size)
+    return NULL;
+
+  if (!block || block->size - block->used < rounded) {
+    size_t block_size = arena->block_size;
+    if (block_size < rounded)
+      block_size = rounded;
+    block = new_block(arena, block_size);
+    if (!block)
+      return NULL;
+  }
+
+  void *p = block->data + block->used;
+  block->used += rounded;
+  arena->current.allocations++;
+  arena->current.bytes += rounded;
+  return p;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+  if (size && count > SIZE_MAX / size)
+    return NULL;
+  void *p = arena_alloc(arena, count * size);
+  if (p)
+    memset(p, 0, count * size);
+  return p;
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t n) {
+  size_t len = strnlen(s, n);
+  char *p = arena_alloc(arena, len + 1);
+  if (!p)
+    return NULL;
+  memcpy(p, s, len);
+  p[len] = '\0';
+  return p;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+  size_t len = strlen(s);
+  char *p = arena_alloc(arena, len + 1);
+  if (p)
+    memcpy(p, s, len + 1);
+  return p;
+}
+
+void arena_reset(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+
+  if (block && block->next) {
+    size_t total = 0;
+    for (ArenaBlock *b = block; b; b = b->next)
+      total += b->size;
+    free_blocks(block);
+    arena->blocks = NULL;
+    /* Counted against the cycle that outgrew the old block. */
+    new_block(arena, total);
+  } else if (block) {
+    block->used = 0;
+  }
+
+  arena->last = arena->current;
+  arena->total.allocations += arena->current.allocations;
+  arena->total.mallocs += arena->current.mallocs;
+  arena->total.bytes += arena->current.bytes;
+  memset(&arena->current, 0, sizeof arena->current);
+}
+
+void arena_free(Arena *arena) {
+  free_blocks(arena->blocks);
+  arena->blocks = NULL;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file hash.c
+ * @brief String hashing shared by the shell's hash tables.
+ * @author Yegane Gholipur
+ * @date 2025-06-06
+ */
+
+#include <string.h>
+
+#include "hash.h"
+
+#define HASH_SEED 0x243f6a8885a308d3ULL
+#define HASH_MUL1 0x9e3779b97f4a7c15ULL
+#define HASH_MUL2 0xbf58476d1ce4e5b9ULL
+#define HASH_MUL3 0x94d049bb133111ebULL
+
+static uint64_t mix(uint64_t h, uint64_t k);
+static uint64_t finalize(uint64_t h);
+
+static uint64_t mix(uint64_t h, uint64_t k) {
+  k *= HASH_MUL1;
+  k ^= k >> 32;
+  return (h ^ k) * HASH_MUL2;
+}
+
+/* The splitmix64 finalizer. */
+static uint64_t finalize(uint64_t h) {
+  h ^= h >> 30;
+  h *= HASH_MUL2;
+  h ^= h >> 27;
+  h *= HASH_MUL3;
+  return h ^ (h >> 31);
+}
+
+uint64_t hash_bytes(const void *data, size_t len) {
+  const unsigned char *p = data;
+  uint64_t h = HASH_SEED ^ len;
+  uint64_t k;
+
+  for (; len >= 8; p += 8, len -= 8) {
+    memcpy(&k, p, 8);
+    h = mix(h, k);
+  }
+  if (len > 0) {
+    k = 0;
+    memcpy(&k, p, len);
+    h = mix(h, k);
+  }
+  return finalize(h);
+}
+
+uint64_t hash_string(const char *s) { return hash_bytes(s, strlen(s)); }
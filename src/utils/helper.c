@@ -6,28 +6,44 @@
  * @date 2025-06-06
  */
 
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "builtin.h"
+#include "command_table.h"
 #include "executor.h"
 #include "helper.h"
+#include "io_redirection.h"
 
 int is_bulitin(Process *proc) {
-  char *command = proc->cmd->argv[0];
-  for (int i = 0; builtin_commands[i].name != NULL; i++) {
-    if (strcmp(command, builtin_commands[i].name) == 0)
-      return i;
-  }
-  return -1;
+  const CommandEntry *entry = find_command(proc->cmd->argv[0]);
+  return entry && entry->kind == COMMAND_BUILTIN ? entry->builtin : -1;
 }
 
 int builtin_routine(int func_num, Process *proc_head, Job **job_ptr,
                     Process **process_ptr, Command **command_ptr) {
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  RedirectionFrame frame;
+  size_t num_actions =
+      build_child_actions(proc_head->cmd, NULL, 0, 1, actions);
+
+  /* The builtin runs in the shell, so its redirections are applied around
+   * the call rather than in a child. */
+  const ChildAction *failed = push_redirections(actions, num_actions, &frame);
+  if (failed) {
+    fprintf(stderr, "%s: %s: %s\n", proc_head->cmd->argv[0], failed->error,
+            strerror(errno));
+    last_exit_status = 1;
+    *process_ptr = NULL;
+    *command_ptr = NULL;
+    return 0;
+  }
   last_exit_status = builtin_commands[func_num].func(proc_head, job_ptr);
+  pop_redirections(&frame);
 
-  free(proc_head);
-  free_struct_memory(*command_ptr);
+  /* The process and command live in the line arena. */
   *process_ptr = NULL;
   *command_ptr = NULL;
 
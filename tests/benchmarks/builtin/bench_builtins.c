@@ -0,0 +1,139 @@
+/* Per-command latency of the utility builtins against the coreutils they
+ * replace, with output to /dev/null. Builtins that may block are timed the
+ * way the shell runs them, forked without exec. Run with `make bench`. */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "command_table.h"
+#include "env_utils.h"
+#include "helper.h"
+#include "spawn_backend.h"
+
+#define BUILTIN_RUNS 20000
+#define EXTERNAL_RUNS 300
+
+extern char **environ;
+
+static char *commands[][5] = {
+    {"true", NULL},
+    {"echo", "hello", "world", NULL},
+    {"printf", "%s=%d\\n", "x", "42", NULL},
+    {"test", "-f", "/etc/passwd", NULL},
+    {"cat", "/etc/passwd", NULL},
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* A builtin that runs in the shell, as the shell runs it: through
+ * builtin_routine(), redirection frame included. */
+static double run_builtin(char **argv) {
+  Command cmd = {.argv = argv};
+  Process proc = {.cmd = &cmd};
+  Process *process_ptr = NULL;
+  Command *command_ptr = NULL;
+  Job *jobs = NULL;
+  int func_num = is_bulitin(&proc);
+
+  double t = now();
+  for (int i = 0; i < BUILTIN_RUNS; i++)
+    builtin_routine(func_num, &proc, &jobs, &process_ptr, &command_ptr);
+  return (now() - t) / BUILTIN_RUNS;
+}
+
+static int run_stage(void *arg) {
+  Process *proc = arg;
+  Job *jobs = NULL;
+  return builtin_commands[proc->builtin].func(proc, &jobs);
+}
+
+/* A BUILTIN_BLOCKING builtin, as the shell runs it: a stage of a job,
+ * forked without exec, and a wait. */
+static double run_forked(char **argv) {
+  Command cmd = {.argv = argv};
+  Process proc = {.cmd = &cmd};
+  proc.builtin = is_bulitin(&proc);
+  ChildAction actions[CHILD_ACTIONS_MAX] = {
+      {.kind = ACTION_CLOSE_FROM, .fd = 3}};
+  sigset_t mask;
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+  SpawnPlan plan = {.argv = argv, .mask = &mask, .actions = actions,
+                    .num_actions = 1, .run = run_stage, .arg = &proc};
+
+  double t = now();
+  for (int i = 0; i < EXTERNAL_RUNS; i++) {
+    pid_t pid = spawn_process(&plan);
+    if (pid < 0 || waitpid(pid, NULL, 0) != pid) {
+      perror("spawn");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return (now() - t) / EXTERNAL_RUNS;
+}
+
+/* The command as it ran before: posix_spawn() of the binary and a wait. */
+static double run_external(char **argv, char **envp) {
+  char path[64];
+  ChildAction actions[CHILD_ACTIONS_MAX] = {
+      {.kind = ACTION_CLOSE_FROM, .fd = 3}};
+  sigset_t mask;
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+
+  snprintf(path, sizeof path, "/usr/bin/%s", argv[0]);
+  if (access(path, X_OK) < 0)
+    snprintf(path, sizeof path, "/bin/%s", argv[0]);
+  SpawnPlan plan = {.path = path, .argv = argv, .envp = envp, .mask = &mask,
+                    .actions = actions, .num_actions = 1};
+
+  double t = now();
+  for (int i = 0; i < EXTERNAL_RUNS; i++) {
+    pid_t pid = spawn_process(&plan);
+    if (pid < 0 || waitpid(pid, NULL, 0) != pid) {
+      perror("spawn");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return (now() - t) / EXTERNAL_RUNS;
+}
+
+int main(void) {
+  char **envp = NULL;
+
+  if (import_environment(environ) < 0 || command_table_init() < 0 ||
+      initialize_envp(&envp) < 0)
+    return EXIT_FAILURE;
+
+  int null = open("/dev/null", O_WRONLY);
+  int saved = dup(STDOUT_FILENO);
+  for (size_t i = 0; i < sizeof commands / sizeof *commands; i++) {
+    dup2(null, STDOUT_FILENO);
+    Command cmd = {.argv = commands[i]};
+    Process proc = {.cmd = &cmd};
+    int forked =
+        builtin_commands[is_bulitin(&proc)].in_process == BUILTIN_BLOCKING;
+    double builtin =
+        forked ? run_forked(commands[i]) : run_builtin(commands[i]);
+    double external = run_external(commands[i], envp);
+    dup2(saved, STDOUT_FILENO);
+    printf("%-7s builtin %7.2f us %-8s  external %8.1f us  %6.0fx\n",
+           commands[i][0], builtin * 1e6, forked ? "(forked)" : "",
+           external * 1e6, external / builtin);
+    fflush(stdout);
+  }
+
+  command_table_free();
+  free_variable_table();
+  return 0;
+}
@@ -0,0 +1,151 @@
+/* Compares the variable table with the fixed 100-bucket chained table it
+ * replaced. Run with `make bench`. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "env_utils.h"
+
+#define LEGACY_TABLESIZE 100
+#define ROUNDS 3
+#define LOOKUPS 200000
+
+/* The previous implementation, kept here for comparison. */
+typedef struct LegacyVariable {
+  char *key;
+  char *value;
+  int exported;
+  struct LegacyVariable *next;
+} LegacyVariable;
+
+static LegacyVariable *legacy_table[LEGACY_TABLESIZE];
+
+static unsigned legacy_hash(const char *s) {
+  unsigned hashval = 0;
+  while (*s)
+    hashval = *s++ + 31 * hashval;
+  return hashval % LEGACY_TABLESIZE;
+}
+
+static LegacyVariable *legacy_lookup(const char *key) {
+  for (LegacyVariable *vp = legacy_table[legacy_hash(key)]; vp; vp = vp->next)
+    if (strcmp(key, vp->key) == 0)
+      return vp;
+  return NULL;
+}
+
+static LegacyVariable *legacy_add(const char *key, const char *value) {
+  LegacyVariable *vp = legacy_lookup(key);
+  if (vp) {
+    free(vp->value);
+    vp->value = strdup(value);
+    return vp;
+  }
+  vp = malloc(sizeof *vp);
+  vp->key = strdup(key);
+  vp->value = strdup(value);
+  vp->exported = 1;
+  unsigned idx = legacy_hash(key);
+  vp->next = legacy_table[idx];
+  legacy_table[idx] = vp;
+  return vp;
+}
+
+static void legacy_free(void) {
+  for (int i = 0; i < LEGACY_TABLESIZE; i++) {
+    LegacyVariable *vp = legacy_table[i];
+    while (vp) {
+      LegacyVariable *next = vp->next;
+      free(vp->key);
+      free(vp->value);
+      free(vp);
+      vp = next;
+    }
+    legacy_table[i] = NULL;
+  }
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char **make_keys(int n, const char *prefix) {
+  char **keys = malloc(n * sizeof *keys);
+  char buf[64];
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof buf, "%s_VARIABLE_%d", prefix, i);
+    keys[i] = strdup(buf);
+  }
+  return keys;
+}
+
+static void free_keys(char **keys, int n) {
+  for (int i = 0; i < n; i++)
+    free(keys[i]);
+  free(keys);
+}
+
+static void run(int n) {
+  char **keys = make_keys(n, "SOME");
+  char **missing = make_keys(n, "NONE");
+  int lookups = LOOKUPS / n * n;
+  double t, legacy_insert = 0, legacy_hit = 0, legacy_miss = 0;
+  double table_insert = 0, table_hit = 0, table_miss = 0;
+  volatile size_t sink = 0;
+
+  for (int round = 0; round < ROUNDS; round++) {
+    t = now();
+    for (int i = 0; i < n; i++)
+      legacy_add(keys[i], "value");
+    legacy_insert += now() - t;
+    t = now();
+    for (int i = 0; i < lookups; i++)
+      sink += legacy_lookup(keys[i % n]) != NULL;
+    legacy_hit += now() - t;
+    t = now();
+    for (int i = 0; i < lookups; i++)
+      sink += legacy_lookup(missing[i % n]) != NULL;
+    legacy_miss += now() - t;
+    legacy_free();
+
+    t = now();
+    for (int i = 0; i < n; i++)
+      add_variable(keys[i], "value", 1);
+    table_insert += now() - t;
+    t = now();
+    for (int i = 0; i < lookups; i++)
+      sink += lookup(keys[i % n]) != NULL;
+    table_hit += now() - t;
+    t = now();
+    for (int i = 0; i < lookups; i++)
+      sink += lookup(missing[i % n]) != NULL;
+    table_miss += now() - t;
+    free_variable_table();
+  }
+
+  double per_insert = 1e9 / ((double)n * ROUNDS);
+  double per_lookup = 1e9 / ((double)lookups * ROUNDS);
+  printf("%6d vars  insert %8.1f / %6.1f ns  hit %8.1f / %6.1f ns  "
+         "miss %8.1f / %6.1f ns\n",
+         n, legacy_insert * per_insert, table_insert * per_insert,
+         legacy_hit * per_lookup, table_hit * per_lookup,
+         legacy_miss * per_lookup, table_miss * per_lookup);
+
+  free_keys(keys, n);
+  free_keys(missing, n);
+}
+
+int main(void) {
+  printf("variable table: chained[100] / open addressing, per operation\n");
+  run(50);
+  run(500);
+  run(5000);
+  run(20000);
+  return 0;
+}
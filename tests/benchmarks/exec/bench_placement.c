@@ -0,0 +1,92 @@
+/* Throughput of a CPU-bound pipeline, decompress | transform | checksum,
+ * with the stages left to the scheduler and with PLACEMENT=topology. Run
+ * with `make bench`. */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "command_table.h"
+#include "cpu_topology.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "tokenizer.h"
+
+#define INPUT "/tmp/bench_placement.gz"
+#define INPUT_MB 64
+#define RUNS 5
+
+extern char **environ;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run(Arena *arena, const char *text) {
+  char line[256];
+  TokenVector tokens = {0};
+  Command *cmd = NULL;
+  Process *proc = NULL;
+  Job *jobs = NULL;
+
+  strcpy(line, text);
+  if (tokenize_line(line, &tokens) < 0)
+    return -1;
+  Process *head = initalize_processes(line, tokens.items, tokens.count, &cmd,
+                                      &proc, arena);
+  free_memory(&tokens);
+  Job *job = head ? initialize_job_control(line, cmd, head, &jobs, arena)
+                  : NULL;
+  int status = job && executor(job, &jobs) == 0 ? last_exit_status : -1;
+  arena_reset(arena);
+  return status;
+}
+
+static double throughput(Arena *arena) {
+  const char *pipeline = "gzip -dc " INPUT " | tr a-z A-Z | cksum > /dev/null";
+
+  double t = now();
+  for (int i = 0; i < RUNS; i++) {
+    if (run(arena, pipeline) != 0) {
+      fprintf(stderr, "pipeline failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return INPUT_MB * RUNS / (now() - t);
+}
+
+int main(void) {
+  Arena arena;
+  char setup[256];
+
+  // text that compresses about as well as logs do
+  snprintf(setup, sizeof setup,
+           "seq 1 20000000 | head -c %d | tr 0-9 a-j | gzip -1 > " INPUT,
+           INPUT_MB << 20);
+  if (system(setup) != 0)
+    return EXIT_FAILURE;
+
+  shell_interactive = 0;
+  if (import_environment(environ) < 0 || command_table_init() < 0)
+    return EXIT_FAILURE;
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  CpuTopology *topo = system_topology();
+  printf("%zu cpus in %zu cache domains\n", topo ? topo->num_cpus : 0,
+         topo ? topo->num_domains : 0);
+  printf("scheduler  %7.1f MB/s\n", throughput(&arena));
+  add_variable("PLACEMENT", "topology", 0);
+  printf("topology   %7.1f MB/s\n", throughput(&arena));
+
+  arena_free(&arena);
+  command_table_free();
+  free_variable_table();
+  unlink(INPUT);
+  return 0;
+}
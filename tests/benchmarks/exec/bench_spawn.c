@@ -0,0 +1,73 @@
+/* Spawn latency of `true` with each backend, with a small shell heap and
+ * with a large one. Run with `make bench`. */
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include "spawn_backend.h"
+#include "zygote.h"
+
+#define SPAWNS 300
+#define LARGE_HEAP (512 * 1024 * 1024)
+
+static const char *const backends[] = {"fork", "posix_spawn", "vfork",
+                                       "zygote"};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(const char *heap) {
+  char *argv[] = {"true", NULL};
+  char *envp[] = {"PATH=/bin:/usr/bin", NULL};
+  ChildAction actions[CHILD_ACTIONS_MAX] = {
+      {.kind = ACTION_CLOSE_FROM, .fd = 3}};
+  sigset_t mask;
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+  SpawnPlan plan = {.path = "/bin/true", .argv = argv, .envp = envp,
+                    .mask = &mask, .actions = actions, .num_actions = 1};
+
+  printf("%-6s heap", heap);
+  for (size_t b = 0; b < sizeof backends / sizeof *backends; b++) {
+    set_spawn_backend(backends[b]);
+    double t = now();
+    for (int i = 0; i < SPAWNS; i++) {
+      pid_t pid = spawn_process(&plan);
+      if (pid < 0 || waitpid(pid, NULL, 0) != pid) {
+        perror("spawn");
+        exit(EXIT_FAILURE);
+      }
+    }
+    printf("  %s %7.1f us", backends[b], (now() - t) * 1e6 / SPAWNS);
+  }
+  printf("\n");
+}
+
+int main(void) {
+  // the zygote is forked while the process is small, as in the shell
+  if (zygote_start() < 0)
+    return EXIT_FAILURE;
+
+  run("small");
+  // small pages, like a heap grown by many small allocations
+  char *heap = mmap(NULL, LARGE_HEAP, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (heap != MAP_FAILED) {
+    madvise(heap, LARGE_HEAP, MADV_NOHUGEPAGE);
+    memset(heap, 1, LARGE_HEAP);
+    run("512M");
+    munmap(heap, LARGE_HEAP);
+  }
+
+  zygote_stop();
+  return 0;
+}
@@ -0,0 +1,191 @@
+/* Compares the job table with the linear job list it replaced, as jobs are
+ * started, looked up by number, reaped and freed, and times reaping a burst
+ * of real exits. Run with `make bench`. */
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "job_utils.h"
+#include "signal_utils.h"
+
+#define FIRST_PID 100000
+#define BURST 10000
+
+/* The previous implementation, kept here for comparison. */
+typedef struct LegacyJob {
+  struct LegacyJob *next;
+  Process *first_process;
+  int job_num;
+} LegacyJob;
+
+static LegacyJob *legacy_jobs;
+static int legacy_job_num = 1;
+
+static void legacy_add(LegacyJob *job) {
+  job->job_num = legacy_job_num++;
+  job->next = NULL;
+  if (!legacy_jobs) {
+    legacy_jobs = job;
+    return;
+  }
+  LegacyJob *curr = legacy_jobs;
+  while (curr->next)
+    curr = curr->next;
+  curr->next = job;
+}
+
+static LegacyJob *legacy_find(int job_num) {
+  for (LegacyJob *j = legacy_jobs; j; j = j->next)
+    if (j->job_num == job_num)
+      return j;
+  return NULL;
+}
+
+static void legacy_mark(pid_t pid, int status) {
+  for (LegacyJob *j = legacy_jobs; j; j = j->next) {
+    for (Process *p = j->first_process; p; p = p->next) {
+      if (p->pid == pid) {
+        p->completed = 1;
+        p->status = status;
+        return;
+      }
+    }
+  }
+}
+
+static void legacy_free(LegacyJob *job) {
+  LegacyJob **link = &legacy_jobs;
+  while (*link && *link != job)
+    link = &(*link)->next;
+  if (*link)
+    *link = job->next;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Runs n one-process jobs through both; they finish in reverse order. */
+static void run(int n) {
+  static char *words[] = {"sleep", "1", NULL};
+  static Command cmd = {.argv = words, .background = 1};
+  char line[] = "sleep 1 &";
+  Process *procs = calloc(n, sizeof *procs);
+  LegacyJob *legacy = calloc(n, sizeof *legacy);
+  Job **table = malloc(n * sizeof *table);
+  Job *jobs = NULL;
+  Arena arena;
+  double t, legacy_add_t, legacy_find_t, legacy_reap_t;
+  double add_t, find_t, reap_t;
+  volatile int sink = 0;
+
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+  for (int i = 0; i < n; i++) {
+    procs[i].cmd = &cmd;
+    procs[i].pid = FIRST_PID + i;
+    legacy[i].first_process = &procs[i];
+  }
+
+  t = now();
+  for (int i = 0; i < n; i++)
+    legacy_add(&legacy[i]);
+  legacy_add_t = now() - t;
+  t = now();
+  for (int i = 0; i < n; i++)
+    sink += legacy_find(i + 1) != NULL;
+  legacy_find_t = now() - t;
+  t = now();
+  for (int i = n - 1; i >= 0; i--) {
+    legacy_mark(FIRST_PID + i, 0);
+    legacy_free(&legacy[i]);
+  }
+  legacy_reap_t = now() - t;
+
+  t = now();
+  for (int i = 0; i < n; i++) {
+    table[i] = initialize_job_control(line, &cmd, &procs[i], &jobs, &arena);
+    job_table_add_process(&procs[i]);
+  }
+  add_t = now() - t;
+  char **names = malloc(n * sizeof *names);
+  for (int i = 0; i < n; i++) {
+    names[i] = malloc(16);
+    snprintf(names[i], 16, "%%%d", i + 1);
+  }
+  t = now();
+  for (int i = 0; i < n; i++) {
+    char *argv[] = {"fg", names[i], NULL};
+    Command fg = {.argv = argv};
+    Process proc = {.cmd = &fg};
+    sink += find_job(&proc, &jobs) != NULL;
+  }
+  find_t = now() - t;
+  for (int i = 0; i < n; i++)
+    free(names[i]);
+  free(names);
+  t = now();
+  for (int i = n - 1; i >= 0; i--) {
+    mark_process(FIRST_PID + i, 0);
+    free_job(table[i], &jobs);
+  }
+  reap_t = now() - t;
+
+  printf("%6d jobs  add %8.1f / %5.1f ns  find %8.1f / %5.1f ns  "
+         "reap %8.1f / %5.1f ns\n",
+         n, legacy_add_t * 1e9 / n, add_t * 1e9 / n, legacy_find_t * 1e9 / n,
+         find_t * 1e9 / n, legacy_reap_t * 1e9 / n, reap_t * 1e9 / n);
+
+  arena_free(&arena);
+  free(table);
+  free(legacy);
+  free(procs);
+}
+
+/* Forks n children that exit at once and times handing their statuses to
+ * their processes. */
+static void burst(int n) {
+  siginfo_t info;
+  Process *procs = calloc(n, sizeof *procs);
+
+  for (int i = 0; i < n; i++) {
+    procs[i].pid = fork();
+    if (procs[i].pid < 0) {
+      perror("fork");
+      exit(1);
+    }
+    if (procs[i].pid == 0)
+      _exit(0);
+    job_table_add_process(&procs[i]);
+  }
+  for (int i = 0; i < n; i++)
+    waitid(P_PID, procs[i].pid, &info, WEXITED | WNOWAIT);
+
+  double t = now();
+  mark_bg_jobs();
+  t = now() - t;
+
+  int reaped = 0;
+  for (int i = 0; i < n; i++)
+    reaped += procs[i].completed;
+  printf("%6d exits reaped %d in %.1f ms\n", n, reaped, t * 1e3);
+  free(procs);
+  job_table_free();
+}
+
+int main(void) {
+  printf("job list / job table, per job\n");
+  run(100);
+  run(1000);
+  run(10000);
+  init_shell_signals();
+  burst(BURST);
+  return 0;
+}
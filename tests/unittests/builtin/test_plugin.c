@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "command_table.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "helper.h"
+#include "process_utils.h"
+#include "run_line.h"
+
+#define PLUGIN "build/plugins/pathname.so"
+
+extern char **environ;
+
+static Arena arena;
+static Job *jobs;
+static char out[] = "/tmp/plugin_XXXXXX";
+
+/* Runs a line the way the shell runs a single builtin and returns $?. */
+int run_builtin(const char *text) {
+  char line[256];
+  Command *cmd = NULL;
+  Process *head = parse_command_line(text, line, &cmd, &arena);
+  Process *proc = head;
+  int func_num = is_bulitin(head);
+
+  assert(func_num >= 0);
+  assert(builtin_routine(func_num, head, &jobs, &proc, &cmd) == 0);
+  arena_reset(&arena);
+  return last_exit_status;
+}
+
+int quiet(const char *text) {
+  int saved = dup(STDERR_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDERR_FILENO);
+  int status = run_builtin(text);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  close(null);
+  return status;
+}
+
+void test_load_by_name() {
+  char line[300];
+
+  assert(run_builtin("enable -f " PLUGIN " basename") == 0);
+  assert(find_command("basename")->kind == COMMAND_BUILTIN);
+  // only the named builtins are enabled
+  assert(find_command("dirname")->kind != COMMAND_BUILTIN);
+
+  snprintf(line, sizeof line, "basename /usr/lib/libc.so .so > %s", out);
+  assert(run_builtin(line) == 0);
+  assert(strcmp(read_output(out), "libc\n") == 0);
+  snprintf(line, sizeof line, "basename // >> %s", out);
+  assert(run_builtin(line) == 0);
+  assert(strcmp(read_output(out), "libc\n/\n") == 0);
+  printf("test_load_by_name passed.\n");
+}
+
+/* Counts the builtins with this name. */
+int count_builtin(const char *name) {
+  int n = 0;
+  for (int i = 0; builtin_commands[i].name; i++)
+    n += strcmp(builtin_commands[i].name, name) == 0;
+  return n;
+}
+
+void test_load_all() {
+  char line[300];
+  int slot = find_command("basename")->builtin;
+
+  assert(run_builtin("enable -f " PLUGIN) == 0);
+  assert(find_command("dirname")->kind == COMMAND_BUILTIN);
+  // basename was loaded before; it keeps its slot
+  assert(count_builtin("basename") == 1 &&
+         find_command("basename")->builtin == slot);
+  assert(run_builtin("enable -f " PLUGIN) == 0);
+  assert(count_builtin("dirname") == 1);
+
+  snprintf(line, sizeof line, "dirname a/b//c/ > %s", out);
+  assert(run_builtin(line) == 0);
+  assert(strcmp(read_output(out), "a/b\n") == 0);
+  snprintf(line, sizeof line, "dirname file >> %s", out);
+  assert(run_builtin(line) == 0);
+  assert(strcmp(read_output(out), "a/b\n.\n") == 0);
+  printf("test_load_all passed.\n");
+}
+
+void test_pipelines() {
+  char line[300];
+
+  // first stage, in the shell
+  snprintf(line, sizeof line, "basename /x/y.c | tr a-z A-Z > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  assert(strcmp(read_output(out), "Y.C\n") == 0);
+  // last stage
+  snprintf(line, sizeof line, "true | dirname /x/y.c > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  assert(strcmp(read_output(out), "/x\n") == 0);
+  printf("test_pipelines passed.\n");
+}
+
+void test_errors() {
+  assert(quiet("enable -f /no/such/plugin.so") == 1);
+  assert(quiet("enable -f " PLUGIN " no_such_builtin") == 1);
+  assert(quiet("enable -x") == 2);
+  assert(quiet("basename") == 2);
+  printf("test_errors passed.\n");
+}
+
+int main(void) {
+  int fd = mkstemp(out);
+  assert(fd >= 0);
+  close(fd);
+  shell_interactive = 0;
+  assert(import_environment(environ) == 0);
+  assert(command_table_init() == 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  test_load_by_name();
+  test_load_all();
+  test_pipelines();
+  test_errors();
+
+  arena_free(&arena);
+  command_table_free();
+  free_variable_table();
+  unlink(out);
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,216 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "fd_writer.h"
+#include "signal_utils.h"
+
+static char out_path[] = "/tmp/utilities_XXXXXX";
+static char output[65536];
+
+/* Runs a builtin with stdout and stderr in a file; the output is left in
+ * `output`. */
+int run(int (*func)(Process *, Job **), char **argv) {
+  Command cmd = {.argv = argv};
+  Process proc = {.cmd = &cmd};
+  int fd = open(out_path, O_RDWR | O_TRUNC);
+  int saved_out = dup(STDOUT_FILENO), saved_err = dup(STDERR_FILENO);
+
+  assert(fd >= 0);
+  dup2(fd, STDOUT_FILENO);
+  dup2(fd, STDERR_FILENO);
+  int status = func(&proc, NULL);
+  dup2(saved_out, STDOUT_FILENO);
+  dup2(saved_err, STDERR_FILENO);
+  close(saved_out);
+  close(saved_err);
+
+  ssize_t n = pread(fd, output, sizeof output - 1, 0);
+  assert(n >= 0);
+  output[n] = '\0';
+  close(fd);
+  return status;
+}
+
+void test_echo() {
+  assert(run(echo_func, (char *[]){"echo", "a", "b", NULL}) == 0);
+  assert(strcmp(output, "a b\n") == 0);
+  assert(run(echo_func, (char *[]){"echo", "-n", "a", NULL}) == 0);
+  assert(strcmp(output, "a") == 0);
+  assert(run(echo_func, (char *[]){"echo", "-e", "a\\tb\\0101\\c", "x",
+                                   NULL}) == 0);
+  assert(strcmp(output, "a\tbA") == 0);
+  // not an option
+  assert(run(echo_func, (char *[]){"echo", "-x", "a\\t", NULL}) == 0);
+  assert(strcmp(output, "-x a\\t\n") == 0);
+  printf("test_echo passed.\n");
+}
+
+void test_printf() {
+  assert(run(printf_func, (char *[]){"printf", "%s=%03d|%-3s|%x\\n", "a",
+                                     "7", "b", "255", NULL}) == 0);
+  assert(strcmp(output, "a=007|b  |ff\n") == 0);
+  // the format is reused for the remaining arguments
+  assert(run(printf_func, (char *[]){"printf", "<%s>", "1", "2", "3",
+                                     NULL}) == 0);
+  assert(strcmp(output, "<1><2><3>") == 0);
+  assert(run(printf_func, (char *[]){"printf", "%.1f %c %b%%", "2.25", "xy",
+                                     "\\101", NULL}) == 0);
+  assert(strcmp(output, "2.2 x A%") == 0);
+  assert(run(printf_func, (char *[]){"printf", "%d\\n", "x1", NULL}) == 1);
+  // integers are read as C constants, or as the code of a quoted character
+  assert(run(printf_func, (char *[]){"printf", "%d %i %d %u %x", "0x1f",
+                                     "010", "'A", "\"a", "'0", NULL}) == 0);
+  assert(strcmp(output, "31 8 65 97 30") == 0);
+  assert(run(printf_func, (char *[]){"printf", "%d", "-0x10", NULL}) == 0);
+  assert(strcmp(output, "-16") == 0);
+  assert(run(printf_func, (char *[]){"printf", "%d", "09", NULL}) == 1);
+  assert(run(printf_func, (char *[]){"printf", NULL}) == 2);
+  printf("test_printf passed.\n");
+}
+
+void test_test() {
+  assert(run(test_func, (char *[]){"test", "-f", out_path, NULL}) == 0);
+  assert(run(test_func, (char *[]){"test", "-d", out_path, NULL}) == 1);
+  assert(run(test_func, (char *[]){"[", "2", "-lt", "10", "]", NULL}) == 0);
+  assert(run(test_func, (char *[]){"[", "b", "<", "a", "]", NULL}) == 1);
+  assert(run(test_func, (char *[]){"[", "!", "-z", "x", "-a", "(", "1", "=",
+                                   "1", ")", "]", NULL}) == 0);
+  assert(run(test_func, (char *[]){"test", "-n", NULL}) == 0);
+  assert(run(test_func, (char *[]){"test", "", "-o", "", NULL}) == 1);
+  assert(run(test_func, (char *[]){"test", NULL}) == 1);
+  assert(run(test_func, (char *[]){"[", "1", NULL}) == 2);
+  assert(run(test_func, (char *[]){"test", "a", "-eq", "1", NULL}) == 2);
+
+  // stdout is a file while run() runs the builtin
+  assert(run(test_func, (char *[]){"[", "-t", "1", "]", NULL}) == 1);
+  assert(run(test_func, (char *[]){"test", "-t", "x", NULL}) == 2);
+  int master, tty;
+  char tty_fd[16];
+  assert(openpty(&master, &tty, NULL, NULL, NULL) == 0);
+  snprintf(tty_fd, sizeof tty_fd, "%d", tty);
+  assert(run(test_func, (char *[]){"test", "-t", tty_fd, NULL}) == 0);
+  close(tty);
+  close(master);
+  assert(run(test_func, (char *[]){"test", "-k", "/tmp", NULL}) == 0);
+  assert(run(test_func, (char *[]){"test", "-k", out_path, NULL}) == 1);
+  assert(run(test_func, (char *[]){"test", "-O", out_path, NULL}) == 0);
+  assert(run(test_func, (char *[]){"test", "-G", out_path, NULL}) == 0);
+  assert(run(test_func, (char *[]){"test", "-O", "/nonexistent", NULL}) == 1);
+
+  // -N: modified since it was last read
+  char read_path[] = "/tmp/utilities_read_XXXXXX";
+  int fd = mkstemp(read_path);
+  assert(fd >= 0);
+  close(fd);
+  struct timespec times[2] = {{.tv_sec = 2000}, {.tv_sec = 1000}};
+  assert(utimensat(AT_FDCWD, read_path, times, 0) == 0);
+  assert(run(test_func, (char *[]){"test", "-N", read_path, NULL}) == 1);
+  times[1].tv_sec = 3000;
+  assert(utimensat(AT_FDCWD, read_path, times, 0) == 0);
+  assert(run(test_func, (char *[]){"test", "-N", read_path, NULL}) == 0);
+  unlink(read_path);
+  printf("test_test passed.\n");
+}
+
+void test_sleep() {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  assert(run(sleep_func, (char *[]){"sleep", "0.05", "0.05s", NULL}) == 0);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed =
+      end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+  assert(elapsed >= 0.1 && elapsed < 1);
+  assert(run(sleep_func, (char *[]){"sleep", "1x", NULL}) == 1);
+  assert(run(sleep_func, (char *[]){"sleep", NULL}) == 1);
+  assert(run(sleep_func, (char *[]){"sleep", "nan", NULL}) == 1);
+  assert(run(sleep_func, (char *[]){"sleep", "-inf", NULL}) == 1);
+  assert(run(sleep_func, (char *[]){"sleep", "1e999", NULL}) == 1);
+
+  // inf and huge values wait until Ctrl-C
+  char *forever[][3] = {{"sleep", "infinity", NULL},
+                        {"sleep", "inf", NULL},
+                        {"sleep", "1e300d", NULL}};
+  for (size_t i = 0; i < sizeof forever / sizeof *forever; i++) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+      init_shell_signals();
+      _exit(run(sleep_func, forever[i]));
+    }
+    int status;
+    usleep(100 * 1000);
+    assert(waitpid(pid, &status, WNOHANG) == 0);
+    kill(pid, SIGINT);
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 130);
+  }
+  assert(run(true_func, (char *[]){"true", NULL}) == 0);
+  assert(run(false_func, (char *[]){"false", NULL}) == 1);
+  printf("test_sleep passed.\n");
+}
+
+void test_cat() {
+  char src[] = "/tmp/utilities_src_XXXXXX";
+  int fd = mkstemp(src);
+  FdWriter w;
+  assert(fd >= 0);
+
+  // bigger than one writer buffer
+  fd_writer_init(&w, fd);
+  for (int i = 0; i < 1000; i++)
+    fd_writer_printf(&w, "line %d\n", i);
+  assert(fd_writer_flush(&w) == 0);
+  close(fd);
+
+  assert(run(cat_func, (char *[]){"cat", src, src, NULL}) == 0);
+  struct stat st;
+  assert(stat(src, &st) == 0);
+  assert(strlen(output) == 2 * (size_t)st.st_size);
+  assert(strncmp(output, "line 0\nline 1\n", 14) == 0);
+
+  // through a pipe, and from /proc where files look empty
+  int pipes[2];
+  assert(pipe(pipes) == 0);
+  int saved = dup(STDIN_FILENO);
+  dup2(pipes[0], STDIN_FILENO);
+  assert(write(pipes[1], "piped\n", 6) == 6);
+  close(pipes[1]);
+  assert(run(cat_func, (char *[]){"cat", "-", "/proc/self/stat", NULL}) == 0);
+  assert(strncmp(output, "piped\n", 6) == 0 && strlen(output) > 6);
+  dup2(saved, STDIN_FILENO);
+  close(saved);
+  close(pipes[0]);
+
+  assert(run(cat_func, (char *[]){"cat", "/nonexistent", src, NULL}) == 1);
+  assert(strstr(output, "cat: /nonexistent") != NULL);
+  unlink(src);
+  printf("test_cat passed.\n");
+}
+
+int main(void) {
+  int fd = mkstemp(out_path);
+  assert(fd >= 0);
+  close(fd);
+
+  test_echo();
+  test_printf();
+  test_test();
+  test_sleep();
+  test_cat();
+
+  unlink(out_path);
+  printf("All tests passed!\n");
+  return 0;
+}
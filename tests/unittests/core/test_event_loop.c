@@ -0,0 +1,165 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+#include "signal_utils.h"
+
+static Arena arena;
+static Job *jobs;
+static EventLoop loop;
+static int input[2];
+static char notices[] = "/tmp/event_loop_XXXXXX";
+static char *words[] = {"sleep", "1", NULL};
+static Command command = {.argv = words, .background = 1};
+
+/* Forks a child that sleeps, then does what it is told and exits. */
+static pid_t after(int ms, const char *text, int sig) {
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    usleep(ms * 1000);
+    if (text && write(input[1], text, strlen(text)) < 0)
+      _exit(1);
+    if (sig)
+      kill(getppid(), sig);
+    _exit(0);
+  }
+  return pid;
+}
+
+/* Starts a background job whose one process exits after ms. */
+static Job *start_job(int ms) {
+  char line[] = "sleep 1 &";
+  Process *proc = arena_calloc(&arena, 1, sizeof *proc);
+  proc->cmd = &command;
+  proc->pid = after(ms, NULL, 0);
+  Job *job = initialize_job_control(line, &command, proc, &jobs, &arena);
+  job->num_procs = 1;
+  job->pgid = proc->pid;
+  job->pids = arena_alloc(&arena, sizeof *job->pids);
+  job->pids[0] = proc->pid;
+  assert(job_table_add_process(proc) == 0);
+  job = persist_job(job, &jobs);
+  arena_reset(&arena);
+  event_loop_watch_job(&loop, job);
+  return job;
+}
+
+static const char *read_notices(void) {
+  static char buf[512];
+  int fd = open(notices, O_RDONLY);
+  ssize_t n = read(fd, buf, sizeof buf - 1);
+  buf[n > 0 ? n : 0] = '\0';
+  close(fd);
+  return buf;
+}
+
+void test_notice_while_waiting() {
+  char *line = NULL;
+  size_t size = 0;
+
+  // the job ends well before the line is typed
+  start_job(50);
+  after(300, "ls -l\n", 0);
+  assert(event_loop_read_line(&loop, "", &line, &size) == 0);
+  assert(strcmp(line, "ls -l\n") == 0);
+  assert(strstr(read_notices(), "[1]  Done      sleep 1  &\n") != NULL);
+  assert(jobs == NULL && job_table.num_procs == 0);
+
+  // waiting does not wake up for nothing
+  unsigned long before = loop.wakeups;
+  after(400, "pwd\n", 0);
+  assert(event_loop_read_line(&loop, "", &line, &size) == 0);
+  assert(strcmp(line, "pwd\n") == 0);
+  assert(loop.wakeups - before <= 3);
+  reap_children();
+  free(line);
+  printf("test_notice_while_waiting passed.\n");
+}
+
+void test_lines_and_interrupts() {
+  char *line = NULL;
+  size_t size = 0;
+
+  // several lines in one read come out one at a time
+  assert(write(input[1], "a\nb\n", 4) == 4);
+  assert(event_loop_read_line(&loop, "", &line, &size) == 0);
+  assert(strcmp(line, "a\n") == 0);
+  assert(event_loop_read_line(&loop, "", &line, &size) == 0);
+  assert(strcmp(line, "b\n") == 0);
+
+  // Ctrl-C drops what was typed
+  assert(write(input[1], "partial", 7) == 7);
+  after(100, NULL, SIGINT);
+  errno = 0;
+  assert(event_loop_read_line(&loop, "", &line, &size) == -1);
+  assert(errno == EINTR && !loop.eof && loop.pending_len == 0);
+  reap_children();
+
+  // the last line needs no newline
+  assert(write(input[1], "exit", 4) == 4);
+  close(input[1]);
+  assert(event_loop_read_line(&loop, "", &line, &size) == 0);
+  assert(strcmp(line, "exit") == 0);
+  assert(event_loop_read_line(&loop, "", &line, &size) == -1 && loop.eof);
+  free(line);
+  printf("test_lines_and_interrupts passed.\n");
+}
+
+void test_regular_file() {
+  char path[] = "/tmp/event_loop_input_XXXXXX";
+  char *line = NULL;
+  size_t size = 0;
+  EventLoop file_loop;
+
+  int fd = mkstemp(path);
+  assert(write(fd, "x\ny\n", 4) == 4);
+  lseek(fd, 0, SEEK_SET);
+  dup2(fd, STDIN_FILENO);
+  close(fd);
+  assert(event_loop_init(&file_loop, &jobs) == 0 && !file_loop.poll_stdin);
+  assert(event_loop_read_line(&file_loop, "", &line, &size) == 0);
+  assert(strcmp(line, "x\n") == 0);
+  assert(event_loop_read_line(&file_loop, "", &line, &size) == 0);
+  assert(strcmp(line, "y\n") == 0);
+  assert(event_loop_read_line(&file_loop, "", &line, &size) == -1);
+  assert(file_loop.eof);
+  event_loop_free(&file_loop);
+  free(line);
+  unlink(path);
+  printf("test_regular_file passed.\n");
+}
+
+int main(void) {
+  int saved_err = dup(STDERR_FILENO);
+  int fd = mkstemp(notices);
+
+  assert(fd >= 0 && pipe(input) == 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+  init_shell_signals();
+  dup2(input[0], STDIN_FILENO);
+  assert(event_loop_init(&loop, &jobs) == 0 && loop.poll_stdin);
+
+  dup2(fd, STDERR_FILENO);
+  test_notice_while_waiting();
+  test_lines_and_interrupts();
+  test_regular_file();
+  dup2(saved_err, STDERR_FILENO);
+
+  event_loop_free(&loop);
+  job_table_free();
+  arena_free(&arena);
+  close(fd);
+  unlink(notices);
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,78 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shell.h"
+
+static char script[] = "/tmp/script_mode_XXXXXX";
+static char text[4096];
+
+/* Runs the script in a shell whose terminal is a pty, types the input into
+ * it and returns the shell's exit status; what the terminal showed ends up
+ * in text. */
+static int run_on_pty(const char *lines, const char *typed) {
+  int fd = mkstemp(script);
+  assert(fd >= 0 && write(fd, lines, strlen(lines)) == (ssize_t)strlen(lines));
+  close(fd);
+
+  int master;
+  pid_t pid = forkpty(&master, NULL, NULL, NULL);
+  assert(pid >= 0);
+  if (pid == 0) {
+    char *argv[] = {"my_program", script, NULL};
+    _exit(shell(2, argv));
+  }
+
+  assert(write(master, typed, strlen(typed)) == (ssize_t)strlen(typed));
+  size_t len = 0;
+  struct pollfd pfd = {.fd = master, .events = POLLIN};
+  // a stopped child would keep the pty open; give up after a while
+  while (len < sizeof text - 1 && poll(&pfd, 1, 5000) > 0) {
+    ssize_t n = read(master, text + len, sizeof text - 1 - len);
+    if (n <= 0)
+      break;
+    len += n;
+  }
+  text[len] = '\0';
+
+  int status;
+  if (waitpid(pid, &status, WNOHANG) == 0) {
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+  }
+  close(master);
+  unlink(script);
+  strcpy(script, "/tmp/script_mode_XXXXXX");
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+void test_reads_the_terminal() {
+  // the children stay in the shell's group, so reading does not stop them
+  assert(run_on_pty("cat\necho after\n", "aaa\n\004") == 0);
+  assert(strstr(text, "Stopped") == NULL);
+  assert(strstr(text, "aaa\r\naaa\r\n") && strstr(text, "after"));
+  printf("test_reads_the_terminal passed.\n");
+}
+
+void test_pipeline_reads_the_terminal() {
+  assert(run_on_pty("cat | tr a b\necho after\n", "aaa\n\004") == 0);
+  assert(strstr(text, "Stopped") == NULL);
+  assert(strstr(text, "bbb") && strstr(text, "after"));
+  printf("test_pipeline_reads_the_terminal passed.\n");
+}
+
+int main(void) {
+  test_reads_the_terminal();
+  test_pipeline_reads_the_terminal();
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -5,12 +5,10 @@
 
 #include "env_utils.h"
 
+// the envp array belongs to the variable table
 void cleanup(char **envp) {
+  (void)envp;
   free_variable_table();
-  for (int i = 0; envp[i]; i++)
-    free(envp[i]);
-
-  free(envp);
 }
 
 void test_add_variable() {
@@ -45,18 +43,26 @@ void test_remove_variable_does_not_exist() {
 }
 
 void test_valid_command_path() {
+  add_variable("PATH", "/usr/bin:/bin", 1);
   char *path = get_full_path("ls");
   assert(path != NULL);
   assert(strcmp(path, "/usr/bin/ls") == 0);
   free(path);
+  free_variable_table();
 
   printf("test_valid_command_path passes.\n");
 }
 
 void test_invalid_command_path() {
-  char *path = get_full_path("bb");
+  char *path = get_full_path("ls");
+  // without PATH nothing is found
   assert(path == NULL);
 
+  add_variable("PATH", "/usr/bin:/bin", 1);
+  path = get_full_path("bb");
+  assert(path == NULL);
+  free_variable_table();
+
   printf("test_invalid_command_path passes.\n");
 }
 
@@ -75,6 +81,98 @@ void test_build_envp() {
   printf("test_build_envp passes.\n");
 }
 
+void test_many_variables() {
+  char key[32], value[32];
+
+  for (int i = 0; i < 5000; i++) {
+    snprintf(key, sizeof key, "VAR_%d", i);
+    snprintf(value, sizeof value, "%d", i);
+    assert(add_variable(key, value, i % 2) != NULL);
+    // every few insertions, drop an older one while the table is resizing
+    if (i % 7 == 6) {
+      snprintf(key, sizeof key, "VAR_%d", i - 3);
+      assert(remove_variable(key) == 0);
+    }
+  }
+
+  for (int i = 0; i < 5000; i++) {
+    snprintf(key, sizeof key, "VAR_%d", i);
+    Variable *vp = lookup(key);
+    if (i % 7 == 3) {
+      assert(vp == NULL);
+      continue;
+    }
+    assert(vp != NULL);
+    assert(atoi(vp->value) == i);
+  }
+  assert(variable_table.count == 5000 - 5000 / 7);
+  assert(((variable_table.mask + 1) & variable_table.mask) == 0);
+  assert(lookup_len("VAR_12345", 6) != NULL);
+
+  free_variable_table();
+  printf("test_many_variables passes.\n");
+}
+
+void test_update_keeps_order() {
+  add_variable("A", "1", 1);
+  add_variable("B", "2", 1);
+  add_variable("A", lookup("A")->value, 1);
+  add_variable("A", "3", 1);
+
+  char **envp = build_envp();
+  assert(strcmp(envp[0], "A=3") == 0);
+  assert(strcmp(envp[1], "B=2") == 0);
+  assert(envp[2] == NULL);
+
+  cleanup(envp);
+  printf("test_update_keeps_order passes.\n");
+}
+
+void test_envp_is_cached() {
+  add_variable("HOME", "/home/yegane", 1);
+  char **envp = build_envp();
+  unsigned long generation = variable_table.generation;
+
+  // the same array, entries are the variables' own strings
+  assert(build_envp() == envp);
+  assert(envp[0] == lookup("HOME")->entry);
+
+  add_variable("LOCAL", "1", 0);
+  assert(variable_table.generation == generation);
+  assert(build_envp()[1] == NULL);
+
+  add_variable("TERM", "xterm", 1);
+  assert(variable_table.generation != generation);
+  envp = build_envp();
+  assert(strcmp(envp[0], "HOME=/home/yegane") == 0);
+  assert(strcmp(envp[1], "TERM=xterm") == 0);
+  assert(envp[2] == NULL);
+
+  remove_variable("HOME");
+  envp = build_envp();
+  assert(strcmp(envp[0], "TERM=xterm") == 0);
+  assert(envp[1] == NULL);
+
+  add_variable("TERM", "vt100", 0);
+  assert(build_envp()[0] == NULL);
+
+  free_variable_table();
+  printf("test_envp_is_cached passes.\n");
+}
+
+void test_import_environment() {
+  char *envp[] = {"HOME=/home/yegane", "EMPTY=", "NOEQUALS", "X=a=b", NULL};
+
+  assert(import_environment(envp) == 0);
+  assert(strcmp(lookup("HOME")->value, "/home/yegane") == 0);
+  assert(strcmp(lookup("EMPTY")->value, "") == 0);
+  assert(strcmp(lookup("X")->value, "a=b") == 0);
+  assert(lookup("NOEQUALS") == NULL);
+  assert(lookup("HOME")->exported);
+
+  free_variable_table();
+  printf("test_import_environment passes.\n");
+}
 
 int main(void) {
   test_add_variable();
@@ -83,6 +181,10 @@ int main(void) {
   test_valid_command_path();
   test_invalid_command_path();
   test_build_envp();
+  test_many_variables();
+  test_update_keeps_order();
+  test_import_environment();
+  test_envp_is_cached();
 
   printf("All tests passed!\n");
   return 0;
@@ -0,0 +1,99 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "command_table.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "process_utils.h"
+#include "run_line.h"
+
+extern char **environ;
+
+static Arena arena;
+static Job *jobs;
+static char out[] = "/tmp/builtin_stages_XXXXXX";
+
+void test_first_stage() {
+  char cwd[256], line[300], expected[300];
+  assert(getcwd(cwd, sizeof cwd) != NULL);
+  snprintf(expected, sizeof expected, "%s\n", cwd);
+
+  snprintf(line, sizeof line, "pwd | cat > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  assert(strcmp(read_output(out), expected) == 0);
+
+  snprintf(line, sizeof line, "type cd | tr a-z A-Z > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  assert(strcmp(read_output(out), "CD IS A SHELL BUILTIN\n") == 0);
+
+  // forked builtins see the shell's variables
+  add_variable("STAGE_TEST", "yes", 1);
+  snprintf(line, sizeof line, "export | grep STAGE_TEST > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  assert(strncmp(read_output(out), "STAGE_TEST=yes", 14) == 0);
+  printf("test_first_stage passed.\n");
+}
+
+void test_later_stages() {
+  char cwd[256], line[300], expected[300];
+  assert(getcwd(cwd, sizeof cwd) != NULL);
+  snprintf(expected, sizeof expected, "%s\n", cwd);
+
+  // the writer loses its reader instead of blocking the shell
+  snprintf(line, sizeof line, "yes | pwd > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  assert(strcmp(read_output(out), expected) == 0);
+
+  // no process at all
+  snprintf(line, sizeof line, "help | pwd | cat > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  assert(strcmp(read_output(out), expected) == 0);
+
+  // the last stage's status is the pipeline's
+  int saved = dup(STDERR_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDERR_FILENO);
+  assert(run_line("true | type no_such_command_here", &jobs, &arena) == 1);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  close(null);
+  printf("test_later_stages passed.\n");
+}
+
+void test_state_is_not_shared() {
+  char before[256], after[256];
+  assert(getcwd(before, sizeof before) != NULL);
+
+  // as in other shells, a pipeline stage cannot change the shell
+  assert(run_line("cd / | cat", &jobs, &arena) == 0);
+  assert(run_line("export STAGE_SET=1 | cat", &jobs, &arena) == 0);
+  assert(getcwd(after, sizeof after) != NULL);
+  assert(strcmp(before, after) == 0);
+  assert(lookup("STAGE_SET") == NULL);
+  printf("test_state_is_not_shared passed.\n");
+}
+
+int main(void) {
+  int fd = mkstemp(out);
+  assert(fd >= 0);
+  close(fd);
+  shell_interactive = 0;
+  assert(import_environment(environ) == 0);
+  assert(command_table_init() == 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  test_first_stage();
+  test_later_stages();
+  test_state_is_not_shared();
+
+  arena_free(&arena);
+  command_table_free();
+  free_variable_table();
+  unlink(out);
+  printf("All tests passed!\n");
+  return 0;
+}
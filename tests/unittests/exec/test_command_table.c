@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "command_table.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "run_line.h"
+
+static char dir[] = "/tmp/command_table_XXXXXX";
+static char tool[64];
+static Arena arena;
+static Job *jobs;
+
+void make_tool(void) {
+  int fd = open(tool, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+  assert(fd >= 0);
+  close(fd);
+}
+
+void test_builtins() {
+  const CommandEntry *entry = find_command("cd");
+
+  assert(entry != NULL && entry->kind == COMMAND_BUILTIN);
+  assert(strcmp(builtin_commands[entry->builtin].name, "cd") == 0);
+  entry = find_command("type");
+  assert(entry->kind == COMMAND_BUILTIN);
+  assert(strcmp(builtin_commands[entry->builtin].name, "type") == 0);
+  printf("test_builtins passed.\n");
+}
+
+void test_path_is_cached() {
+  size_t hits = command_table.hits, misses = command_table.misses;
+
+  const CommandEntry *entry = find_command("tool");
+  assert(entry->kind == COMMAND_FILE && strcmp(entry->path, tool) == 0);
+  assert(command_table.misses == misses + 1);
+
+  entry = find_command("tool");
+  assert(entry->kind == COMMAND_FILE && entry->hits == 1);
+  assert(command_table.hits == hits + 1);
+  printf("test_path_is_cached passed.\n");
+}
+
+void test_stale_path() {
+  assert(find_command("tool")->kind == COMMAND_FILE);
+  unlink(tool);
+
+  size_t misses = command_table.misses;
+  assert(find_command("tool")->kind == COMMAND_NOT_FOUND);
+  assert(command_table.misses == misses + 1);
+
+  // the negative entry answers until it expires
+  make_tool();
+  assert(find_command("tool")->kind == COMMAND_NOT_FOUND);
+  assert(command_table.misses == misses + 1);
+
+  command_table_forget();
+  assert(find_command("tool")->kind == COMMAND_FILE);
+  printf("test_stale_path passed.\n");
+}
+
+void test_path_change() {
+  assert(find_command("tool")->kind == COMMAND_FILE);
+
+  add_variable("PATH", "/nonexistent", 1);
+  assert(find_command("tool")->kind == COMMAND_NOT_FOUND);
+  assert(find_command("cd")->kind == COMMAND_BUILTIN);
+
+  add_variable("PATH", dir, 1);
+  assert(find_command("tool")->kind == COMMAND_FILE);
+  printf("test_path_change passed.\n");
+}
+
+void test_pathname() {
+  const CommandEntry *entry = find_command(tool);
+  assert(entry->kind == COMMAND_FILE && strcmp(entry->path, tool) == 0);
+
+  size_t count = command_table.count;
+  assert(find_command("./no/such/tool")->kind == COMMAND_NOT_FOUND);
+  assert(command_table.count == count);
+
+  // a file that may not be run is told apart from a missing one
+  chmod(tool, 0644);
+  entry = find_command(tool);
+  assert(entry->kind == COMMAND_DENIED && strcmp(entry->path, tool) == 0);
+  chmod(tool, 0755);
+  printf("test_pathname passed.\n");
+}
+
+void test_denied_status() {
+  char line[128];
+
+  // 126 and "Permission denied" rather than 127, alone or in a pipeline
+  chmod(tool, 0644);
+  assert(run_line(tool, &jobs, &arena) == 126);
+  snprintf(line, sizeof line, "true | %s", tool);
+  assert(run_line(line, &jobs, &arena) == 126);
+  assert(run_line("./no/such/tool", &jobs, &arena) == 127);
+  chmod(tool, 0755);
+  printf("test_denied_status passed.\n");
+}
+
+int main(void) {
+  assert(mkdtemp(dir) != NULL);
+  snprintf(tool, sizeof tool, "%s/tool", dir);
+  make_tool();
+  add_variable("PATH", dir, 1);
+  shell_interactive = 0;
+  assert(command_table_init() == 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  test_builtins();
+  test_path_is_cached();
+  test_stale_path();
+  test_path_change();
+  test_pathname();
+  test_denied_status();
+
+  arena_free(&arena);
+  command_table_free();
+  free_variable_table();
+  unlink(tool);
+  rmdir(dir);
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "command_table.h"
+#include "cpu_topology.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "resource_control.h"
+#include "run_line.h"
+
+/* Two packages of two cache domains, each with two cores of two threads.
+ * As on Linux, the second threads are numbered after all first ones. */
+#define FAKE_CPUS 16
+
+extern char **environ;
+
+static char root[] = "/tmp/cpu_topology_XXXXXX";
+
+static void write_file(const char *dir, const char *name, const char *text) {
+  char path[512];
+  snprintf(path, sizeof path, "%s/%s", dir, name);
+  FILE *f = fopen(path, "w");
+  assert(f != NULL);
+  fputs(text, f);
+  fclose(f);
+}
+
+static void make_dirs(const char *path) {
+  char buf[512];
+  strcpy(buf, path);
+  for (char *p = buf + 1; *p; p++) {
+    if (*p == '/') {
+      *p = '\0';
+      mkdir(buf, 0755);
+      *p = '/';
+    }
+  }
+  mkdir(buf, 0755);
+}
+
+static void make_fake_sysfs(void) {
+  char dir[512], text[64];
+
+  assert(mkdtemp(root) != NULL);
+  write_file(root, "online", "0-15\n");
+  for (int cpu = 0; cpu < FAKE_CPUS; cpu++) {
+    int core = cpu % 8;
+    int first = core / 2 * 2;
+
+    snprintf(dir, sizeof dir, "%s/cpu%d/topology", root, cpu);
+    make_dirs(dir);
+    snprintf(text, sizeof text, "%d\n", core / 4);
+    write_file(dir, "physical_package_id", text);
+    snprintf(text, sizeof text, "%d\n", core);
+    write_file(dir, "core_id", text);
+
+    // a private L1 and L2, and an L3 shared by two cores
+    const char *types[] = {"Data", "Instruction", "Unified", "Unified"};
+    const char *levels[] = {"1", "1", "2", "3"};
+    for (int i = 0; i < 4; i++) {
+      snprintf(dir, sizeof dir, "%s/cpu%d/cache/index%d", root, cpu, i);
+      make_dirs(dir);
+      write_file(dir, "type", types[i]);
+      write_file(dir, "level", levels[i]);
+      if (i < 3)
+        snprintf(text, sizeof text, "%d,%d\n", core, core + 8);
+      else
+        snprintf(text, sizeof text, "%d-%d,%d-%d\n", first, first + 1,
+                 first + 8, first + 9);
+      write_file(dir, "shared_cpu_list", text);
+    }
+  }
+}
+
+/* The CPUs of the next stage, as a list. */
+static const char *next_cpus(Placement *placement) {
+  static char list[128];
+  cpu_set_t set;
+  placement_next(placement, &set);
+  format_cpu_list(&set, list, sizeof list);
+  return list;
+}
+
+void test_load() {
+  CpuTopology topo;
+  cpu_set_t allowed;
+
+  // cpu 15 is not ours
+  assert(parse_cpu_list("0-14", &allowed) == 0);
+  assert(cpu_topology_load(&topo, root, &allowed) == 0);
+  assert(topo.num_cpus == 15 && topo.num_domains == 4);
+  int expected[] = {0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14};
+  for (size_t i = 0; i < topo.num_cpus; i++)
+    assert(topo.cpus[i] == expected[i]);
+  assert(topo.domains[0].package == 0 && topo.domains[0].count == 4);
+  assert(topo.domains[3].package == 1 && topo.domains[3].count == 3);
+  // alternating packages
+  size_t spread[] = {0, 2, 1, 3};
+  for (size_t i = 0; i < 4; i++)
+    assert(topo.spread[i] == spread[i]);
+  cpu_topology_free(&topo);
+  printf("test_load passed.\n");
+}
+
+void test_placement() {
+  CpuTopology topo;
+  cpu_set_t allowed;
+  Placement placement;
+
+  assert(parse_cpu_list("0-14", &allowed) == 0);
+  assert(cpu_topology_load(&topo, root, &allowed) == 0);
+
+  // separate cores of one cache first, then their second threads
+  placement_start(&placement, &topo, 3);
+  assert(strcmp(next_cpus(&placement), "0") == 0);
+  assert(strcmp(next_cpus(&placement), "1") == 0);
+  assert(strcmp(next_cpus(&placement), "8") == 0);
+
+  // the next job goes to the other package
+  placement_start(&placement, &topo, 2);
+  assert(strcmp(next_cpus(&placement), "4") == 0);
+  assert(strcmp(next_cpus(&placement), "5") == 0);
+  placement_start(&placement, &topo, 2);
+  assert(strcmp(next_cpus(&placement), "2") == 0);
+  placement_start(&placement, &topo, 2);
+  assert(strcmp(next_cpus(&placement), "6") == 0);
+
+  // a single command gets its whole domain
+  placement_start(&placement, &topo, 1);
+  assert(strcmp(next_cpus(&placement), "0-1,8-9") == 0);
+
+  // a long pipeline continues in the next domain of the package
+  placement_start(&placement, &topo, 6);
+  const char *cpus[] = {"4", "5", "12", "13", "6", "7"};
+  for (int i = 0; i < 6; i++)
+    assert(strcmp(next_cpus(&placement), cpus[i]) == 0);
+
+  // and goes round within the package rather than into the other one
+  placement_start(&placement, &topo, 5);
+  const char *first[] = {"2", "3", "10", "11", "0"};
+  for (int i = 0; i < 5; i++)
+    assert(strcmp(next_cpus(&placement), first[i]) == 0);
+  placement_start(&placement, &topo, 4);
+  const char *last[] = {"6", "7", "14", "4"};
+  for (int i = 0; i < 4; i++)
+    assert(strcmp(next_cpus(&placement), last[i]) == 0);
+  cpu_topology_free(&topo);
+  printf("test_placement passed.\n");
+}
+
+void test_missing_sysfs() {
+  CpuTopology topo;
+  cpu_set_t allowed;
+
+  // every CPU is a domain of its own
+  assert(parse_cpu_list("0-3", &allowed) == 0);
+  assert(cpu_topology_load(&topo, "/nonexistent", &allowed) == 0);
+  assert(topo.num_cpus == 4 && topo.num_domains == 4);
+  cpu_topology_free(&topo);
+
+  CPU_ZERO(&allowed);
+  assert(cpu_topology_load(&topo, root, &allowed) == -1);
+  printf("test_missing_sysfs passed.\n");
+}
+
+void test_pipeline() {
+  char out[] = "/tmp/cpu_topology_out_XXXXXX";
+  char line[256], buf[256];
+  Arena arena;
+  Job *jobs = NULL;
+  cpu_set_t set;
+
+  int fd = mkstemp(out);
+  assert(fd >= 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+  add_variable("PLACEMENT", "topology", 0);
+  assert(system_topology() != NULL);
+
+  // the stages run on CPUs of the shell's topology
+  snprintf(line, sizeof line,
+           "grep Cpus_allowed_list /proc/self/status | cut -f2 > %s", out);
+  assert(run_line(line, &jobs, &arena) == 0);
+  snprintf(buf, sizeof buf, "%s", read_output(out));
+  buf[strcspn(buf, "\n")] = '\0';
+  assert(parse_cpu_list(buf, &set) == 0 && CPU_COUNT(&set) == 1);
+
+  remove_variable("PLACEMENT");
+  arena_free(&arena);
+  close(fd);
+  unlink(out);
+  printf("test_pipeline passed.\n");
+}
+
+int main(void) {
+  make_fake_sysfs();
+  shell_interactive = 0;
+  assert(import_environment(environ) == 0);
+  assert(command_table_init() == 0);
+
+  test_load();
+  test_placement();
+  test_missing_sysfs();
+  test_pipeline();
+
+  command_table_free();
+  free_variable_table();
+  char cmd[600];
+  snprintf(cmd, sizeof cmd, "rm -rf %s", root);
+  assert(system(cmd) == 0);
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "command_table.h"
+#include "env_utils.h"
+#include "executor.h"
+
+extern char **environ;
+
+static Arena arena;
+
+/* Runs exec_in_place() in a child; 99 means it returned. */
+int run(Job *job, pid_t *child) {
+  int status;
+  pid_t pid = fork();
+
+  assert(pid >= 0);
+  if (pid == 0) {
+    exec_in_place(job);
+    _exit(99);
+  }
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status));
+  if (child)
+    *child = pid;
+  return WEXITSTATUS(status);
+}
+
+void test_replaces_the_process() {
+  char path[] = "/tmp/exec_in_place_XXXXXX";
+  char buf[32] = {0};
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+
+  // the command keeps the pid and gets the redirection
+  char *argv[] = {"sh", "-c", "echo $$; exit 4", NULL};
+  Command cmd = {.argv = argv, .outfile = path};
+  Process proc = {.cmd = &cmd};
+  Job job = {.first_process = &proc, .arena = &arena, .num_procs = 1};
+
+  pid_t pid;
+  assert(run(&job, &pid) == 4);
+  assert(read(fd, buf, sizeof buf - 1) > 0);
+  assert(atoi(buf) == pid);
+
+  close(fd);
+  unlink(path);
+  printf("test_replaces_the_process passed.\n");
+}
+
+void test_returns_when_it_cannot() {
+  char *argv[] = {"sh", "-c", ":", NULL};
+  char *missing[] = {"no_such_command_here", NULL};
+  char *builtin[] = {"true", NULL};
+  Command cmd = {.argv = argv};
+  Command missing_cmd = {.argv = missing};
+  Command builtin_cmd = {.argv = builtin};
+  Process second = {.cmd = &cmd};
+  Process first = {.cmd = &cmd, .next = &second};
+  Job job = {.first_process = &first, .arena = &arena, .num_procs = 2};
+
+  // a pipeline still needs the shell to wire it
+  assert(run(&job, NULL) == 99);
+
+  // so does a command that has to be reported as not found
+  first.cmd = &missing_cmd;
+  first.next = NULL;
+  job.num_procs = 1;
+  assert(run(&job, NULL) == 99);
+
+  // and a builtin, which runs in the shell anyway
+  first.cmd = &builtin_cmd;
+  assert(run(&job, NULL) == 99);
+
+  first.cmd = &cmd;
+  assert(run(&job, NULL) == 0);
+  printf("test_returns_when_it_cannot passed.\n");
+}
+
+int main(void) {
+  assert(import_environment(environ) == 0);
+  assert(command_table_init() == 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  test_replaces_the_process();
+  test_returns_when_it_cannot();
+
+  arena_free(&arena);
+  command_table_free();
+  free_variable_table();
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,206 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "command_table.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "process_utils.h"
+#include "resource_control.h"
+#include "run_line.h"
+#include "spawn_backend.h"
+
+extern char **environ;
+
+static Arena arena;
+static Job *jobs;
+static char out[] = "/tmp/resource_control_XXXXXX";
+
+/* Runs a line as a foreground job with its output in `out` and returns
+ * $?. */
+int run(const char *text) {
+  char redirected[512];
+
+  snprintf(redirected, sizeof redirected, "%s > %s", text, out);
+  return run_line(redirected, &jobs, &arena);
+}
+
+/* Calls a builtin directly with its output in `out`, stderr discarded. */
+int run_builtin(int (*func)(Process *, Job **), char **argv) {
+  Command cmd = {.argv = argv};
+  Process proc = {.cmd = &cmd};
+  int fd = open(out, O_WRONLY | O_TRUNC);
+  int null = open("/dev/null", O_WRONLY);
+  int saved_out = dup(STDOUT_FILENO), saved_err = dup(STDERR_FILENO);
+
+  dup2(fd, STDOUT_FILENO);
+  dup2(null, STDERR_FILENO);
+  int status = func(&proc, &jobs);
+  dup2(saved_out, STDOUT_FILENO);
+  dup2(saved_err, STDERR_FILENO);
+  close(saved_out);
+  close(saved_err);
+  close(null);
+  close(fd);
+  return status;
+}
+
+void test_cpu_lists() {
+  cpu_set_t set;
+  char list[64];
+
+  assert(parse_cpu_list("0-3,8", &set) == 0 && CPU_COUNT(&set) == 5);
+  format_cpu_list(&set, list, sizeof list);
+  assert(strcmp(list, "0-3,8") == 0);
+  assert(parse_cpu_list("5,1,2", &set) == 0);
+  format_cpu_list(&set, list, sizeof list);
+  assert(strcmp(list, "1-2,5") == 0);
+  assert(parse_cpu_list("all", &set) == 0 && CPU_COUNT(&set) > 0);
+
+  const char *bad[] = {"", "3-1", "a", "1,", "0-", "-1", "1;2", "99999"};
+  for (size_t i = 0; i < sizeof bad / sizeof *bad; i++)
+    assert(parse_cpu_list(bad[i], &set) < 0);
+  printf("test_cpu_lists passed.\n");
+}
+
+void test_prefixes_are_removed() {
+  char line[256];
+  Command *cmd = NULL;
+
+  Process *head = parse_command_line(
+      "affinity 0 nice -n 3 ulimit -S -n 64 ls -l | nice cat", line, &cmd,
+      &arena);
+  assert(strcmp(head->cmd->argv[0], "ls") == 0);
+  const ResourceSettings *r = head->resources;
+  assert(r && r->set_affinity && CPU_COUNT(&r->affinity) == 1);
+  assert(r->set_nice && r->nice == 3);
+  assert(r->num_limits == 1 && r->limits[0].resource == RLIMIT_NOFILE);
+  assert(r->limits[0].set_soft && !r->limits[0].set_hard);
+  assert(r->limits[0].soft == 64);
+  // nice(1) without a number
+  assert(strcmp(head->next->cmd->argv[0], "cat") == 0);
+  assert(head->next->resources && head->next->resources->nice == 10);
+  // -N is an increment of N, as in nice(1)
+  head = parse_command_line("nice -5 ls | nice --5 cat", line, &cmd, &arena);
+  assert(head->resources && head->resources->nice == 5);
+  assert(head->next->resources && head->next->resources->nice == -5);
+
+  // without a command they are the builtins
+  head = parse_command_line("nice 5", line, &cmd, &arena);
+  assert(strcmp(head->cmd->argv[0], "nice") == 0 && !head->resources);
+  head = parse_command_line("ulimit -n", line, &cmd, &arena);
+  assert(strcmp(head->cmd->argv[0], "ulimit") == 0 && !head->resources);
+  head = parse_command_line("ulimit -n x ls", line, &cmd, &arena);
+  assert(strcmp(head->cmd->argv[0], "ulimit") == 0 && !head->resources);
+  arena_reset(&arena);
+  printf("test_prefixes_are_removed passed.\n");
+}
+
+void test_applied_in_child() {
+  const char *backends[] = {"posix_spawn", "fork", "vfork", "zygote"};
+  char expected[64];
+
+  int nice = getpriority(PRIO_PROCESS, 0) + 5;
+  snprintf(expected, sizeof expected, "64\nCpus_allowed_list:\t0\n%d\n",
+           nice > 19 ? 19 : nice);
+  for (size_t i = 0; i < sizeof backends / sizeof *backends; i++) {
+    assert(set_spawn_backend(backends[i]) == 0);
+    assert(run("affinity 0 nice 5 ulimit -n 64 sh -c 'ulimit -n; grep "
+               "Cpus_allowed_list /proc/self/status; nice'") == 0);
+    assert(strcmp(read_output(out), expected) == 0);
+  }
+  set_spawn_backend("posix_spawn");
+
+  // a limit the child cannot take fails the command, not the shell
+  int saved = dup(STDERR_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDERR_FILENO);
+  assert(run("ulimit -S -n 1000 ulimit -H -n 10 sh -c :") == 1);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  close(null);
+  printf("test_applied_in_child passed.\n");
+}
+
+void test_defaults() {
+  struct rlimit before, after;
+  getrlimit(RLIMIT_NOFILE, &before);
+
+  assert(run_builtin(ulimit_func, (char *[]){"ulimit", "-n", "32", NULL}) ==
+         0);
+  assert(run_builtin(ulimit_func, (char *[]){"ulimit", "-n", NULL}) == 0);
+  assert(strcmp(read_output(out), "32\n") == 0);
+  assert(run_builtin(nice_func, (char *[]){"nice", "2", NULL}) == 0);
+  assert(run_builtin(nice_func, (char *[]){"nice", NULL}) == 0);
+  assert(strcmp(read_output(out), "2\n") == 0);
+
+  // the shell keeps its own limits
+  getrlimit(RLIMIT_NOFILE, &after);
+  assert(before.rlim_cur == after.rlim_cur);
+
+  assert(run("sh -c 'ulimit -n; ulimit -Hn'") == 0);
+  assert(strcmp(read_output(out), "32\n32\n") == 0);
+  // a prefix replaces the default
+  assert(run("ulimit -S -n 16 sh -c 'ulimit -n; ulimit -Hn'") == 0);
+  assert(strcmp(read_output(out), "16\n32\n") == 0);
+
+  assert(run_builtin(ulimit_func, (char *[]){"ulimit", "-x", NULL}) == 2);
+  assert(run_builtin(ulimit_func, (char *[]){"ulimit", "-n", "abc", NULL}) ==
+         2);
+  assert(run_builtin(ulimit_func,
+                     (char *[]){"ulimit", "-S", "-n", "unlimited", NULL}) == 1);
+  assert(run_builtin(nice_func, (char *[]){"nice", "-q", NULL}) == 2);
+  assert(run_builtin(affinity_func, (char *[]){"affinity", "x", NULL}) == 2);
+  assert(run_builtin(ulimit_func, (char *[]){"ulimit", "-n", NULL}) == 0);
+  assert(strcmp(read_output(out), "32\n") == 0);
+
+  resource_defaults = (ResourceSettings){0};
+  printf("test_defaults passed.\n");
+}
+
+void test_affinity_query() {
+  cpu_set_t set;
+  char expected[1024];
+
+  assert(sched_getaffinity(0, sizeof set, &set) == 0);
+  format_cpu_list(&set, expected, sizeof expected - 1);
+  strcat(expected, "\n");
+  assert(run_builtin(affinity_func, (char *[]){"affinity", NULL}) == 0);
+  assert(strcmp(read_output(out), expected) == 0);
+
+  assert(run_builtin(affinity_func, (char *[]){"affinity", "0", NULL}) == 0);
+  assert(run_builtin(affinity_func, (char *[]){"affinity", NULL}) == 0);
+  assert(strcmp(read_output(out), "0\n") == 0);
+  resource_defaults = (ResourceSettings){0};
+  printf("test_affinity_query passed.\n");
+}
+
+int main(void) {
+  int fd = mkstemp(out);
+  assert(fd >= 0);
+  close(fd);
+  shell_interactive = 0;
+  assert(import_environment(environ) == 0);
+  assert(command_table_init() == 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  test_cpu_lists();
+  test_prefixes_are_removed();
+  test_applied_in_child();
+  test_defaults();
+  test_affinity_query();
+
+  arena_free(&arena);
+  command_table_free();
+  free_variable_table();
+  unlink(out);
+  printf("All tests passed!\n");
+  return 0;
+}
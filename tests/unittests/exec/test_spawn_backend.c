@@ -0,0 +1,171 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "io_redirection.h"
+#include "spawn_backend.h"
+
+static char **envp;
+static sigset_t mask;
+
+int run(const SpawnPlan *plan) {
+  int status;
+  pid_t pid = spawn_process(plan);
+
+  assert(pid > 0);
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status));
+  return WEXITSTATUS(status);
+}
+
+void test_action_list() {
+  char *argv[] = {"cat", NULL};
+  Command cmd = {.argv = argv};
+  int pipes[3][2] = {{10, 11}, {12, 13}, {14, 15}};
+  ChildAction actions[CHILD_ACTIONS_MAX];
+
+  // middle stage: only its own ends, however long the pipeline
+  size_t n = build_child_actions(&cmd, pipes, 1, 4, actions);
+  assert(n == 3);
+  assert(actions[0].kind == ACTION_DUP2 && actions[0].fd == 10 &&
+         actions[0].target == STDIN_FILENO);
+  assert(actions[1].kind == ACTION_DUP2 && actions[1].fd == 13 &&
+         actions[1].target == STDOUT_FILENO);
+  assert(actions[2].kind == ACTION_CLOSE_FROM && actions[2].fd == 3);
+
+  // redirections win over the pipes
+  cmd.infile = "in.txt";
+  cmd.outfile = "out.txt";
+  cmd.append_output = 1;
+  n = build_child_actions(&cmd, pipes, 3, 4, actions);
+  assert(n == 3);
+  assert(actions[0].kind == ACTION_OPEN && actions[0].flags == O_RDONLY);
+  assert(actions[1].kind == ACTION_OPEN && (actions[1].flags & O_APPEND));
+  assert(actions[2].kind == ACTION_CLOSE_FROM);
+  printf("test_action_list passed.\n");
+}
+
+void test_close_pipe_ends() {
+  int pipes[2][2];
+  assert(pipe2(pipes[0], O_CLOEXEC) == 0 && pipe2(pipes[1], O_CLOEXEC) == 0);
+  assert(fcntl(pipes[1][0], F_GETFD) & FD_CLOEXEC);
+
+  int fd = pipes[0][1];
+  close(fd);
+  pipes[0][1] = -1;
+  close_pipe_ends(3, pipes);
+  for (int i = 0; i < 2; i++)
+    assert(pipes[i][0] == -1 && pipes[i][1] == -1);
+  assert(fcntl(fd, F_GETFD) == -1);
+  printf("test_close_pipe_ends passed.\n");
+}
+
+ino_t inode(int fd) {
+  struct stat st;
+  assert(fstat(fd, &st) == 0);
+  return st.st_ino;
+}
+
+void test_redirection_frame() {
+  char path[] = "/tmp/redirection_frame_XXXXXX";
+  char buf[64] = {0};
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  ino_t in = inode(STDIN_FILENO), out = inode(STDOUT_FILENO);
+
+  char *argv[] = {"pwd", NULL};
+  Command cmd = {.argv = argv, .outfile = path};
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  RedirectionFrame frame;
+  size_t n = build_child_actions(&cmd, NULL, 0, 1, actions);
+
+  // output goes to the file while the frame is pushed, then back
+  assert(push_redirections(actions, n, &frame) == NULL);
+  assert(frame.count == 1 && inode(STDOUT_FILENO) == inode(fd));
+  dprintf(STDOUT_FILENO, "inside\n");
+  pop_redirections(&frame);
+  assert(frame.count == 0 && inode(STDOUT_FILENO) == out);
+  assert(read(fd, buf, sizeof buf - 1) == 7);
+  assert(strcmp(buf, "inside\n") == 0);
+
+  // a failed redirection undoes the ones before it
+  cmd.infile = path;
+  cmd.outfile = "/nonexistent/output";
+  n = build_child_actions(&cmd, NULL, 0, 1, actions);
+  const ChildAction *failed = push_redirections(actions, n, &frame);
+  assert(failed == &actions[1]);
+  assert(frame.count == 0 && inode(STDIN_FILENO) == in);
+  assert(fcntl(10, F_GETFD) == -1);
+
+  close(fd);
+  unlink(path);
+  printf("test_redirection_frame passed.\n");
+}
+
+void test_backend(const char *name) {
+  char path[] = "/tmp/spawn_backend_XXXXXX";
+  char buf[64] = {0};
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  assert(set_spawn_backend(name) == 0);
+  assert(strcmp(spawn_backend_name(spawn_backend), name) == 0);
+
+  char *argv[] = {"sh", "-c", "echo $0; exit 3", "hello", NULL};
+  Command cmd = {.argv = argv, .outfile = path};
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  SpawnPlan plan = {.path = "/bin/sh", .argv = argv, .envp = envp,
+                    .mask = &mask, .actions = actions};
+
+  plan.num_actions = build_child_actions(&cmd, NULL, 0, 1, actions);
+  assert(run(&plan) == 3);
+  fd = open(path, O_RDONLY);
+  assert(read(fd, buf, sizeof buf - 1) == 6);
+  assert(strcmp(buf, "hello\n") == 0);
+  close(fd);
+
+  // a missing command and a failed redirection still leave a child
+  int saved = dup(STDERR_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDERR_FILENO);
+
+  plan.path = NULL;
+  assert(run(&plan) == 127);
+
+  plan.path = "/bin/sh";
+  cmd.outfile = NULL;
+  cmd.infile = "/nonexistent/input";
+  plan.num_actions = build_child_actions(&cmd, NULL, 0, 1, actions);
+  assert(run(&plan) == 1);
+
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  close(null);
+  unlink(path);
+  printf("test_backend(%s) passed.\n", name);
+}
+
+int main(void) {
+  char *env[] = {"PATH=/bin:/usr/bin", NULL};
+  envp = env;
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+
+  test_action_list();
+  test_close_pipe_ends();
+  test_redirection_frame();
+  test_backend("fork");
+  test_backend("posix_spawn");
+  test_backend("vfork");
+  assert(set_spawn_backend("rfork") == -1);
+
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "io_redirection.h"
+#include "zygote.h"
+
+static char *envp[] = {"PATH=/bin:/usr/bin", "GREETING=hello", NULL};
+static sigset_t mask;
+
+int wait_status(pid_t pid) {
+  int status;
+  assert(pid > 0);
+  // the pool's children are children of the caller
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status));
+  return WEXITSTATUS(status);
+}
+
+void test_exec_with_redirection() {
+  char dir[] = "/tmp/zygote_XXXXXX";
+  char cwd[256], buf[64] = {0};
+  assert(mkdtemp(dir) != NULL);
+  assert(getcwd(cwd, sizeof cwd) != NULL);
+  assert(chdir(dir) == 0);
+
+  // the child runs in the caller's current directory
+  char *argv[] = {"sh", "-c", "echo $GREETING $0; exit 5", "world", NULL};
+  Command cmd = {.argv = argv, .outfile = "out.txt"};
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  SpawnPlan plan = {.path = "/bin/sh", .argv = argv, .envp = envp,
+                    .mask = &mask, .actions = actions};
+  plan.num_actions = build_child_actions(&cmd, NULL, 0, 1, actions);
+
+  assert(wait_status(zygote_spawn(&plan)) == 5);
+  int fd = open("out.txt", O_RDONLY);
+  assert(fd >= 0 && read(fd, buf, sizeof buf - 1) == 12);
+  assert(strcmp(buf, "hello world\n") == 0);
+  close(fd);
+
+  unlink("out.txt");
+  assert(chdir(cwd) == 0);
+  rmdir(dir);
+  printf("test_exec_with_redirection passed.\n");
+}
+
+void test_pipe_and_group() {
+  int pipes[2][2];
+  char buf[64] = {0};
+  assert(pipe2(pipes[0], O_CLOEXEC) == 0 && pipe2(pipes[1], O_CLOEXEC) == 0);
+
+  // the child waits for a line, so it is still there to be looked at
+  char *argv[] = {"sh", "-c", "echo $$; read line", NULL};
+  Command cmd = {.argv = argv};
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  SpawnPlan plan = {.path = "/bin/sh", .argv = argv, .envp = envp,
+                    .mask = &mask, .actions = actions};
+  plan.num_actions = build_child_actions(&cmd, pipes, 1, 3, actions);
+
+  pid_t pid = zygote_spawn(&plan);
+  assert(pid > 0);
+  close(pipes[0][0]);
+  close(pipes[1][1]);
+  assert(read(pipes[1][0], buf, sizeof buf - 1) > 0);
+  assert(atoi(buf) == pid);
+  pid_t pgid = getpgid(pid);
+  assert(write(pipes[0][1], "\n", 1) == 1);
+  assert(pgid == pid);
+  assert(wait_status(pid) == 0);
+  close(pipes[0][1]);
+  close(pipes[1][0]);
+  printf("test_pipe_and_group passed.\n");
+}
+
+void test_many_spawns() {
+  char *argv[] = {"true", NULL};
+  ChildAction actions[CHILD_ACTIONS_MAX] = {
+      {.kind = ACTION_CLOSE_FROM, .fd = 3}};
+  SpawnPlan plan = {.path = "/bin/true", .argv = argv, .envp = envp,
+                    .mask = &mask, .actions = actions, .num_actions = 1};
+
+  // more than the pool holds, so it has to be refilled
+  for (int i = 0; i < 4 * ZYGOTE_WARM; i++)
+    assert(wait_status(zygote_spawn(&plan)) == 0);
+
+  plan.path = NULL;
+  int saved = dup(STDERR_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDERR_FILENO);
+  assert(wait_status(zygote_spawn(&plan)) == 127);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  close(null);
+  printf("test_many_spawns passed.\n");
+}
+
+int main(void) {
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+  assert(zygote_running() == 0);
+  assert(zygote_start() == 0 && zygote_running());
+
+  test_exec_with_redirection();
+  test_pipe_and_group();
+  test_many_spawns();
+
+  zygote_stop();
+  assert(!zygote_running());
+  char *argv[] = {"true", NULL};
+  SpawnPlan plan = {.path = "/bin/true", .argv = argv, .mask = &mask};
+  assert(zygote_spawn(&plan) == -1);
+
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,191 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "command_table.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "job_capture.h"
+#include "run_line.h"
+#include "signal_utils.h"
+
+extern char **environ;
+
+static Arena arena;
+static Job *jobs;
+static char out[] = "/tmp/test_job_capture_XXXXXX";
+static char *text;
+static size_t text_len;
+
+/* Replays a capture into a file and reads it back into text. */
+static void replay(const JobCapture *capture) {
+  int fd = open(out, O_RDWR | O_TRUNC);
+  assert(fd >= 0 && capture_replay(capture, fd) == 0);
+  off_t size = lseek(fd, 0, SEEK_END);
+  text = realloc(text, size + 1);
+  assert(text && pread(fd, text, size, 0) == size);
+  text[size] = '\0';
+  text_len = size;
+  close(fd);
+}
+
+/* Starts a line as a job, the way the shell does, and keeps it. */
+static Job *start(const char *line_text) {
+  char line[256];
+  Job *job = start_line(line_text, line, &jobs, &arena);
+
+  job = persist_job(job, &jobs);
+  arena_reset(&arena);
+  return job;
+}
+
+static void wait_done(Job *job) {
+  while (!job_is_completed(job)) {
+    usleep(10 * 1000);
+    reap_children();
+  }
+}
+
+void test_child_actions() {
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  char *argv[] = {"ls", NULL};
+  Command cmd = {.argv = argv};
+  Job job = {.job_num = 1};
+
+  size_t n = build_child_actions(&cmd, NULL, 0, 1, actions);
+  assert(capture_child_actions(NULL, &cmd, 1, actions, n) == n);
+
+  assert(capture_open(&job) == 0);
+  // the last stage sends both streams, the others only stderr
+  size_t m = capture_child_actions(job.capture, &cmd, 1, actions, n);
+  assert(m == n + 2 && actions[m - 1].kind == ACTION_CLOSE_FROM);
+  assert(actions[m - 3].target == STDOUT_FILENO &&
+         actions[m - 2].target == STDERR_FILENO &&
+         actions[m - 2].fd == job.capture->write_fd);
+  n = build_child_actions(&cmd, NULL, 0, 1, actions);
+  assert(capture_child_actions(job.capture, &cmd, 0, actions, n) == n + 1);
+  cmd.outfile = "/dev/null";
+  n = build_child_actions(&cmd, NULL, 0, 1, actions);
+  assert(capture_child_actions(job.capture, &cmd, 1, actions, n) == n + 1);
+
+  // no writer is handed out once it is closed
+  capture_close_writer(job.capture);
+  assert(capture_child_actions(job.capture, &cmd, 1, actions, n) == n);
+
+  capture_finish(&job);
+  assert(job.capture == NULL && capture_find(1) != NULL);
+  capture_discard(1);
+  assert(capture_find(1) == NULL && capture_last_finished() == 0);
+  printf("test_child_actions passed.\n");
+}
+
+void test_bounded() {
+  static char chunk[32 * 1024];
+  Job job = {.job_num = 2};
+  size_t total = CAPTURE_SPILL_MAX + CAPTURE_RING_SIZE + 3 * sizeof chunk;
+
+  assert(capture_open(&job) == 0);
+  JobCapture *capture = job.capture;
+  for (size_t i = 0; i < total / sizeof chunk; i++) {
+    memset(chunk, 'a' + i % 26, sizeof chunk);
+    assert(write(capture->write_fd, chunk, sizeof chunk) == sizeof chunk);
+    assert(capture_drain(capture, -1, CAPTURE_DRAIN_MAX) == 0);
+  }
+  // the ring stops growing; the rest is in the memory file or dropped
+  assert(capture->size == CAPTURE_RING_SIZE && capture->len == capture->size);
+  assert(capture->spilled == CAPTURE_SPILL_MAX);
+  assert(capture->dropped == 3 * sizeof chunk);
+
+  replay(capture);
+  size_t last_spilled = CAPTURE_SPILL_MAX / sizeof chunk - 1;
+  assert(text[0] == 'a' &&
+         text[CAPTURE_SPILL_MAX - 1] == (char)('a' + last_spilled % 26));
+  char note[64];
+  snprintf(note, sizeof note, "\n[... %zu bytes of output dropped ...]\n",
+           3 * sizeof chunk);
+  assert(strncmp(text + CAPTURE_SPILL_MAX, note, strlen(note)) == 0);
+  assert(text_len == CAPTURE_SPILL_MAX + strlen(note) + CAPTURE_RING_SIZE);
+  assert(text[text_len - 1] == (char)('a' + (total / sizeof chunk - 1) % 26));
+
+  // the pipe ends when its writer is closed
+  capture_close_writer(capture);
+  assert(capture_drain(capture, -1, CAPTURE_DRAIN_MAX) == 1 &&
+         capture->fd == -1);
+  capture_finish(&job);
+  assert(capture_last_finished() == 2);
+  printf("test_bounded passed.\n");
+}
+
+void test_background_job() {
+  // without JOBOUTPUT the job writes where it always did
+  Job *job = start("sh -c true &");
+  assert(job->capture == NULL);
+  wait_done(job);
+  free_job(job, &jobs);
+
+  assert(add_variable("JOBOUTPUT", "capture", 0) != NULL);
+  job = start("sh -c 'echo one; echo two >&2' | tr a-z A-Z &");
+  int num = job->job_num;
+  assert(job->capture && capture_find(num) == job->capture);
+  assert(job->capture->write_fd == -1);
+  wait_done(job);
+
+  // the job is gone but its output stays under its number
+  free_job(job, &jobs);
+  JobCapture *capture = capture_find(num);
+  assert(capture && capture_last_finished() == num);
+  replay(capture);
+  assert(strcmp(text, "ONE\ntwo\n") == 0 || strcmp(text, "two\nONE\n") == 0);
+
+  // until a new job takes the number
+  job = start("sleep 0 &");
+  assert(job->job_num == num && capture_find(num) == job->capture);
+  wait_done(job);
+  free_job(job, &jobs);
+
+  // builtins that would run in the shell are captured too
+  job = start("echo x &");
+  num = job->job_num;
+  wait_done(job);
+  free_job(job, &jobs);
+  replay(capture_find(num));
+  assert(strcmp(text, "x\n") == 0);
+
+  job = start("echo y | printf z &");
+  num = job->job_num;
+  wait_done(job);
+  free_job(job, &jobs);
+  replay(capture_find(num));
+  assert(strcmp(text, "z") == 0);
+
+  remove_variable("JOBOUTPUT");
+  printf("test_background_job passed.\n");
+}
+
+int main(void) {
+  int fd = mkstemp(out);
+  assert(fd >= 0);
+  close(fd);
+  shell_interactive = 0;
+  init_shell_signals();
+  assert(import_environment(environ) == 0);
+  assert(command_table_init() == 0);
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  test_child_actions();
+  test_bounded();
+  test_background_job();
+
+  capture_free_all();
+  job_table_free();
+  arena_free(&arena);
+  command_table_free();
+  free_variable_table();
+  free(text);
+  unlink(out);
+  printf("All tests passed!\n");
+  return 0;
+}
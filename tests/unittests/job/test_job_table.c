@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "job_utils.h"
+#include "signal_utils.h"
+
+#define BURST 600
+
+static Arena arena;
+static Job *jobs;
+static char *words[] = {"sleep", "1", NULL};
+static Command command = {.argv = words, .background = 1};
+
+/* Makes a job of n processes with the given pids, all in the table. */
+static Job *make_job(int n, pid_t first_pid) {
+  char line[] = "sleep 1 &";
+  Process *head = NULL, **tail = &head;
+
+  for (int i = 0; i < n; i++) {
+    Process *proc = arena_calloc(&arena, 1, sizeof *proc);
+    assert(proc != NULL);
+    proc->cmd = &command;
+    proc->pid = first_pid + i;
+    *tail = proc;
+    tail = &proc->next;
+  }
+  Job *job = initialize_job_control(line, &command, head, &jobs, &arena);
+  assert(job != NULL);
+  job->num_procs = n;
+  job->pids = arena_alloc(&arena, n * sizeof *job->pids);
+  for (Process *p = head; p; p = p->next) {
+    job->pids[p->pid - first_pid] = p->pid;
+    assert(job_table_add_process(p) == 0);
+  }
+  return job;
+}
+
+static Job *find(const char *arg) {
+  char *argv[] = {"fg", (char *)arg, NULL};
+  Command cmd = {.argv = argv};
+  Process proc = {.cmd = &cmd};
+  return find_job(&proc, &jobs);
+}
+
+void test_job_numbers() {
+  Job *a = make_job(1, 100);
+  Job *b = make_job(1, 200);
+  Job *c = make_job(1, 300);
+  assert(a->job_num == 1 && b->job_num == 2 && c->job_num == 3);
+  assert(find("%2") == b && find(NULL) == c);
+
+  // a freed number is the next one given out
+  free_job(b, &jobs);
+  assert(find("%2") == NULL && jobs == a && a->next == c && c->prev == a);
+  Job *d = make_job(1, 400);
+  assert(d->job_num == 2 && find("%2") == d && find(NULL) == d);
+
+  // the last job can go, and the list is still in order
+  free_job(d, &jobs);
+  assert(find(NULL) == c && c->next == NULL);
+  free_job(a, &jobs);
+  assert(jobs == c && c->prev == c);
+  assert(make_job(1, 500)->job_num == 1);
+  assert(find("%0") == NULL && find("%99999") == NULL && find("x") == NULL);
+
+  free_all_jobs(&jobs);
+  assert(jobs == NULL && job_table.num_procs == 0);
+  arena_reset(&arena);
+  printf("test_job_numbers passed.\n");
+}
+
+void test_process_lookup() {
+  Job *many[100];
+
+  // enough to grow the table several times, with neighbouring pids
+  for (int i = 0; i < 100; i++)
+    many[i] = make_job(20, 1000 + 20 * i);
+  assert(job_table.num_procs == 2000);
+  for (pid_t pid = 1000; pid < 3000; pid++)
+    assert(job_table_find_process(pid)->pid == pid);
+
+  // removing entries keeps the others reachable
+  for (int i = 0; i < 100; i += 2)
+    free_job(many[i], &jobs);
+  assert(job_table.num_procs == 1000);
+  for (pid_t pid = 1000; pid < 3000; pid++) {
+    Process *p = job_table_find_process(pid);
+    assert((pid - 1000) / 20 % 2 == 0 ? p == NULL : p->pid == pid);
+  }
+  assert(job_table_find_process(0) == NULL);
+
+  // statuses go to their processes
+  assert(mark_process(1020, 0x0100) != NULL);
+  assert(many[1]->first_process->completed &&
+         WEXITSTATUS(many[1]->first_process->status) == 1);
+  assert(mark_process(1000, 0) == NULL);
+
+  free_all_jobs(&jobs);
+  assert(job_table.num_procs == 0);
+  arena_reset(&arena);
+  printf("test_process_lookup passed.\n");
+}
+
+void test_persisted_processes() {
+  Job *job = make_job(3, 700);
+  Process *old = job_table_find_process(701);
+
+  Job *copy = persist_job(job, &jobs);
+  assert(copy && copy != job && jobs == copy && copy->prev == copy);
+  Process *p = job_table_find_process(701);
+  assert(p && p != old && p == copy->first_process->next);
+  assert(find("%1") == copy);
+  arena_reset(&arena);
+
+  free_job(copy, &jobs);
+  assert(jobs == NULL && job_table_find_process(701) == NULL);
+  printf("test_persisted_processes passed.\n");
+}
+
+void test_burst_of_exits() {
+  sigset_t block, prev;
+  pid_t pids[BURST];
+  siginfo_t info;
+
+  init_shell_signals();
+  Process *procs = calloc(BURST, sizeof *procs);
+  for (int i = 0; i < BURST; i++) {
+    pids[i] = fork();
+    assert(pids[i] >= 0);
+    if (pids[i] == 0)
+      _exit(i % 100);
+    procs[i].pid = pids[i];
+    assert(job_table_add_process(&procs[i]) == 0);
+  }
+  for (int i = 0; i < BURST; i++)
+    assert(waitid(P_PID, pids[i], &info, WEXITED | WNOWAIT) == 0);
+  assert(child_changed);
+
+  // nothing is reaped while a foreground job could be waiting
+  sigemptyset(&block);
+  sigaddset(&block, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &block, &prev);
+  child_changed = 0;
+  mark_bg_jobs();
+  assert(child_changed && !procs[0].completed);
+  sigprocmask(SIG_SETMASK, &prev, NULL);
+
+  // the handler only noted the exits; every one is reaped here
+  mark_bg_jobs();
+  for (int i = 0; i < BURST; i++) {
+    assert(procs[i].completed);
+    assert(WEXITSTATUS(procs[i].status) == i % 100);
+  }
+  assert(waitpid(-1, NULL, WNOHANG) == -1);
+
+  free(procs);
+  job_table_free();
+  printf("test_burst_of_exits passed.\n");
+}
+
+int main(void) {
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  test_job_numbers();
+  test_process_lookup();
+  test_persisted_processes();
+  test_burst_of_exits();
+
+  arena_free(&arena);
+  printf("All tests passed!\n");
+  return 0;
+}
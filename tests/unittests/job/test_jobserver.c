@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "env_utils.h"
+#include "jobserver.h"
+#include "signal_utils.h"
+
+static Arena arena;
+static Job *jobs;
+static char *words[] = {"make", NULL};
+static Command command = {.argv = words, .background = 1};
+
+/* Forks a child that sleeps, sends a signal to the test if asked, and
+ * exits. */
+static pid_t after(int ms, int sig) {
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    usleep(ms * 1000);
+    if (sig)
+      kill(getppid(), sig);
+    _exit(0);
+  }
+  return pid;
+}
+
+/* Makes a background job whose one process is pid, or none if pid is 0. */
+static Job *make_job(pid_t pid) {
+  char line[] = "make &";
+  Process *proc = arena_calloc(&arena, 1, sizeof *proc);
+  proc->cmd = &command;
+  proc->pid = pid;
+  Job *job = initialize_job_control(line, &command, proc, &jobs, &arena);
+  assert(job != NULL);
+  job->num_procs = 1;
+  job->pids = arena_alloc(&arena, sizeof *job->pids);
+  job->pids[0] = pid;
+  if (pid > 0)
+    assert(job_table_add_process(proc) == 0);
+  return job;
+}
+
+void test_makeflags() {
+  assert(jobserver_start(0) == -1 && errno == EINVAL);
+  assert(jobserver_start(JOBSERVER_MAX + 1) == -1 && !jobserver_active());
+
+  // the flags already there are kept
+  add_variable("MAKEFLAGS", "k", 0);
+  assert(jobserver_start(3) == 0 && jobserver_active());
+  Variable *flags = lookup("MAKEFLAGS");
+  assert(strcmp(flags->value, "k -j3 --jobserver-auth=3,4") == 0);
+  assert(flags->exported && jobserver_free_tokens() == 3);
+
+  // a new server replaces the old one, and stopping puts MAKEFLAGS back
+  assert(jobserver_start(5) == 0 && jobserver_free_tokens() == 5);
+  assert(strcmp(lookup("MAKEFLAGS")->value, "k -j5 --jobserver-auth=3,4") ==
+         0);
+  jobserver_stop();
+  flags = lookup("MAKEFLAGS");
+  assert(strcmp(flags->value, "k") == 0 && !flags->exported);
+  assert(!jobserver_active() && jobserver_free_tokens() == -1);
+
+  remove_variable("MAKEFLAGS");
+  assert(jobserver_start(1) == 0);
+  assert(strcmp(lookup("MAKEFLAGS")->value, "-j1 --jobserver-auth=3,4") == 0);
+  jobserver_stop();
+  assert(lookup("MAKEFLAGS") == NULL);
+  printf("test_makeflags passed.\n");
+}
+
+void test_tokens_follow_jobs() {
+  assert(jobserver_start(2) == 0);
+  Job *a = make_job(0), *b = make_job(0);
+  assert(jobserver_take(a, &jobs) == 0 && jobserver_take(b, &jobs) == 0);
+  assert(a->token && jobserver_free_tokens() == 0);
+
+  // taking twice does not take two
+  assert(jobserver_take(a, &jobs) == 0 && jobserver_free_tokens() == 0);
+
+  // freeing a job gives its token back
+  free_job(a, &jobs);
+  assert(jobserver_free_tokens() == 1);
+  Job *c = make_job(after(100, 0));
+  assert(jobserver_take(c, &jobs) == 0);
+
+  // none is free: the wait lasts until c's process ends, and c gives its
+  // token back although it stays in the list to be reported
+  Job *d = make_job(0);
+  assert(jobserver_take(d, &jobs) == 0);
+  assert(d->token && c->token == 0 && c->first_process->completed);
+  assert(job_is_completed(c) && jobs->prev == d);
+  assert(jobserver_free_tokens() == 0);
+
+  free_all_jobs(&jobs);
+  assert(jobserver_free_tokens() == 2);
+  jobserver_stop();
+  arena_reset(&arena);
+  printf("test_tokens_follow_jobs passed.\n");
+}
+
+void test_interrupted_wait() {
+  assert(jobserver_start(1) == 0);
+  Job *a = make_job(0), *b = make_job(0);
+  assert(jobserver_take(a, &jobs) == 0);
+
+  pid_t pid = after(100, SIGINT);
+  assert(jobserver_take(b, &jobs) == -1 && b->token == 0);
+  assert(waitpid(pid, NULL, 0) == pid);
+
+  // a token of a server that was replaced is not given to the new one
+  assert(jobserver_start(1) == 0 && jobserver_free_tokens() == 1);
+  free_job(a, &jobs);
+  assert(jobserver_free_tokens() == 1);
+
+  free_all_jobs(&jobs);
+  jobserver_stop();
+  arena_reset(&arena);
+  printf("test_interrupted_wait passed.\n");
+}
+
+void test_child_actions() {
+  ChildAction actions[CHILD_ACTIONS_MAX];
+  char *argv[] = {"make", NULL};
+  Command cmd = {.argv = argv};
+
+  size_t n = build_child_actions(&cmd, NULL, 0, 1, actions);
+  assert(jobserver_child_actions(actions, n) == n);
+
+  assert(jobserver_start(2) == 0);
+  size_t m = jobserver_child_actions(actions, n);
+  assert(m == n + 2 && m <= CHILD_ACTIONS_MAX);
+  assert(actions[m - 1].kind == ACTION_CLOSE_FROM &&
+         actions[m - 1].fd == JOBSERVER_WRITE_FD + 1);
+
+  // the child finds a token on 3, gives it back on 4 and has nothing else
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    char token;
+    if (apply_child_actions(actions, m) ||
+        read(JOBSERVER_READ_FD, &token, 1) != 1 ||
+        write(JOBSERVER_WRITE_FD, &token, 1) != 1 ||
+        fcntl(JOBSERVER_WRITE_FD + 1, F_GETFD) != -1)
+      _exit(1);
+    _exit(0);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  assert(jobserver_free_tokens() == 2);
+
+  jobserver_stop();
+  printf("test_child_actions passed.\n");
+}
+
+int main(void) {
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+  init_shell_signals();
+
+  test_makeflags();
+  test_tokens_follow_jobs();
+  test_interrupted_wait();
+  test_child_actions();
+
+  job_table_free();
+  arena_free(&arena);
+  free_variable_table();
+  printf("All tests passed!\n");
+  return 0;
+}
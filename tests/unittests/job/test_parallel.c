@@ -0,0 +1,216 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "command_table.h"
+#include "env_utils.h"
+#include "executor.h"
+#include "parallel.h"
+#include "signal_utils.h"
+
+extern char **environ;
+
+static Job *jobs;
+static char out[] = "/tmp/test_parallel_XXXXXX";
+static char text[4096];
+
+/* Runs `parallel` on the words with stdout going to a file, which ends up
+ * in text, and returns its status. */
+static int run(char **argv) {
+  ParallelRun run;
+  int status = 2;
+
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int fd = open(out, O_WRONLY | O_TRUNC);
+  assert(saved >= 0 && fd >= 0);
+  dup2(fd, STDOUT_FILENO);
+  close(fd);
+
+  if (parallel_parse(&run, argv) == 0)
+    status = parallel_run(&run, &jobs);
+  parallel_free(&run);
+
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  fd = open(out, O_RDONLY);
+  ssize_t n = read(fd, text, sizeof text - 1);
+  assert(n >= 0);
+  text[n] = '\0';
+  close(fd);
+
+  // every task was collected and freed
+  assert(jobs == NULL && job_table.num_procs == 0);
+  return status;
+}
+
+void test_parse() {
+  ParallelRun run;
+  char *a[] = {"parallel", "-j3", "-k", "--halt", "soon,fail=2", "echo",
+               "x{}y",     ":::", "1",  "2",      NULL};
+  assert(parallel_parse(&run, a) == 0);
+  assert(run.slots == 3 && run.keep_order && !run.ungroup);
+  assert(run.halt.when == HALT_SOON && !run.halt.on_success &&
+         run.halt.threshold == 2);
+  assert(run.has_placeholder && run.num_tasks == 2);
+  assert(strcmp(run.template[1], "x{}y") == 0 && run.template[2] == NULL);
+  assert(strcmp(run.tasks[1].arg, "2") == 0);
+  parallel_free(&run);
+
+  char *b[] = {"parallel", "--jobs", "2", "--", "-u", ":::", NULL};
+  assert(parallel_parse(&run, b) == 0);
+  assert(run.slots == 2 && !run.ungroup && !run.has_placeholder);
+  assert(strcmp(run.template[0], "-u") == 0 && run.num_tasks == 0);
+  parallel_free(&run);
+
+  char *bad[][5] = {{"parallel", "-j", "0", "echo", NULL},
+                    {"parallel", "--halt", "later,fail=1", "echo", NULL},
+                    {"parallel", "--halt", "now,fail=x", "echo", NULL},
+                    {"parallel", "-x", "echo", NULL},
+                    {"parallel", ":::", "a", NULL},
+                    {"parallel", "-k", NULL}};
+  for (size_t i = 0; i < sizeof bad / sizeof *bad; i++) {
+    assert(parallel_parse(&run, bad[i]) == -1);
+    parallel_free(&run);
+  }
+  char *twice[] = {"parallel", "echo", ":::", "a", ":::", "b", NULL};
+  assert(parallel_parse(&run, twice) == -1);
+  parallel_free(&run);
+  printf("test_parse passed.\n");
+}
+
+void test_keep_order() {
+  // the later inputs finish first but are printed in order
+  char *argv[] = {"parallel", "-j4", "-k", "sh", "-c", "sleep 0.{}; echo {}",
+                  ":::",      "3",   "2",  "1",  "0",  NULL};
+  assert(run(argv) == 0);
+  assert(strcmp(text, "3\n2\n1\n0\n") == 0);
+
+  // without a placeholder the input is the last word
+  char *last[] = {"parallel", "-j1", "echo", "in", ":::", "a", "b", NULL};
+  assert(run(last) == 0);
+  assert(strcmp(text, "in a\nin b\n") == 0);
+  printf("test_keep_order passed.\n");
+}
+
+void test_stdin_inputs() {
+  char in[] = "/tmp/test_parallel_in_XXXXXX";
+  int fd = mkstemp(in);
+  assert(fd >= 0 && write(fd, "a\nb c\n", 6) == 6);
+  lseek(fd, 0, SEEK_SET);
+  int saved = dup(STDIN_FILENO);
+  dup2(fd, STDIN_FILENO);
+  close(fd);
+
+  char *argv[] = {"parallel", "-k", "echo", "<{}>", NULL};
+  assert(run(argv) == 0);
+  assert(strcmp(text, "<a>\n<b c>\n") == 0);
+
+  dup2(saved, STDIN_FILENO);
+  close(saved);
+  unlink(in);
+  printf("test_stdin_inputs passed.\n");
+}
+
+void test_exit_status() {
+  char *argv[] = {"parallel", "sh", "-c", "exit {}", ":::", "0", "1", "2",
+                  "0",        NULL};
+  assert(run(argv) == 2);
+
+  char *missing[] = {"parallel", "no-such-command-here", ":::", "1", NULL};
+  assert(run(missing) == 1);
+  printf("test_exit_status passed.\n");
+}
+
+void test_halt() {
+  // soon: the running task finishes, nothing more is started
+  char *soon[] = {"parallel", "-j2", "-k",  "--halt",
+                  "soon,fail=1", "sh", "-c", "sleep 0.{}; echo {}; exit {}",
+                  ":::",      "1",   "3",   "5",      NULL};
+  assert(run(soon) == 1);
+  assert(strcmp(text, "1\n3\n") == 0);
+
+  // now: the running task is terminated
+  char *now[] = {"parallel", "-j2", "--halt", "now,fail=1", "sh", "-c",
+                 "sleep {}; exit 4", ":::", "0", "5", NULL};
+  assert(run(now) == 4);
+
+  char *success[] = {"parallel", "-j1", "--halt", "soon,success=1", "true",
+                     ":::",      "a",   "b",      NULL};
+  assert(run(success) == 0);
+  printf("test_halt passed.\n");
+}
+
+void test_joblog() {
+  char log[] = "/tmp/test_parallel_log_XXXXXX";
+  int fd = mkstemp(log);
+  assert(fd >= 0);
+  close(fd);
+
+  char *argv[] = {"parallel", "-j1", "--joblog", log, "sh", "-c",
+                  "echo {}; exit {}", ":::", "0", "3", NULL};
+  assert(run(argv) == 1);
+
+  FILE *f = fopen(log, "r");
+  char line[256];
+  assert(fgets(line, sizeof line, f));
+  assert(strncmp(line, "Seq\tHost\tStarttime", 18) == 0);
+  int seq, exitval, sig;
+  long long received;
+  char command[64];
+  assert(fgets(line, sizeof line, f));
+  assert(fgets(line, sizeof line, f));
+  assert(sscanf(line, "%d\t:\t%*f\t%*f\t0\t%lld\t%d\t%d\t%63[^\n]", &seq,
+                &received, &exitval, &sig, command) == 5);
+  assert(seq == 2 && received == 2 && exitval == 3 && sig == 0);
+  assert(strcmp(command, "sh -c echo 3; exit 3") == 0);
+  assert(!fgets(line, sizeof line, f));
+  fclose(f);
+  unlink(log);
+  printf("test_joblog passed.\n");
+}
+
+void test_interrupt() {
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    usleep(200 * 1000);
+    kill(getppid(), SIGINT);
+    _exit(0);
+  }
+  char *argv[] = {"parallel", "-j2", "sleep", ":::", "5", "5", "5", NULL};
+  assert(run(argv) == 130);
+  // the shell may have reaped the sender already
+  waitpid(pid, NULL, 0);
+  printf("test_interrupt passed.\n");
+}
+
+int main(void) {
+  int fd = mkstemp(out);
+  assert(fd >= 0);
+  close(fd);
+  shell_interactive = 0;
+  init_shell_signals();
+  assert(import_environment(environ) == 0);
+  assert(command_table_init() == 0);
+
+  test_parse();
+  test_keep_order();
+  test_stdin_inputs();
+  test_exit_status();
+  test_halt();
+  test_joblog();
+  test_interrupt();
+
+  job_table_free();
+  command_table_free();
+  free_variable_table();
+  unlink(out);
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "env_utils.h"
+#include "expander.h"
+#include "parser.h"
+#include "tokenizer.h"
+
+static Arena arena;
+
+Command *expand_line(char *line) {
+  TokenVector tokens = {0};
+  Command *cmd = NULL;
+
+  assert(tokenize_line(line, &tokens) == 0);
+  assert(parse(line, tokens.items, &cmd, tokens.count, &arena) == 0);
+  free_memory(&tokens);
+  expander(cmd, &arena);
+  return cmd;
+}
+
+void test_simple_variable() {
+  char line[] = "echo $NAME";
+  Command *cmd = expand_line(line);
+
+  assert(strcmp(cmd->argv[0], "echo") == 0);
+  assert(strcmp(cmd->argv[1], "yega") == 0);
+
+  arena_reset(&arena);
+  printf("test_simple_variable passed.\n");
+}
+
+void test_several_per_word() {
+  char line[] = "echo a$NAME-b${NAME}c$NAME";
+  Command *cmd = expand_line(line);
+
+  assert(strcmp(cmd->argv[1], "ayega-byegacyega") == 0);
+
+  arena_reset(&arena);
+  printf("test_several_per_word passed.\n");
+}
+
+void test_quotes() {
+  char line[] = "echo \"$NAME is here\" '$NAME' \\$NAME";
+  Command *cmd = expand_line(line);
+
+  assert(strcmp(cmd->argv[1], "yega is here") == 0);
+  assert(strcmp(cmd->argv[2], "$NAME") == 0);
+  assert(strcmp(cmd->argv[3], "$NAME") == 0);
+
+  arena_reset(&arena);
+  printf("test_quotes passed.\n");
+}
+
+void test_special_parameters() {
+  char line[] = "echo $$ $? x$$y";
+  char pid[32], wrapped[40];
+  Command *cmd;
+
+  last_exit_status = 3;
+  cmd = expand_line(line);
+  snprintf(pid, sizeof pid, "%d", getpid());
+  snprintf(wrapped, sizeof wrapped, "x%sy", pid);
+
+  assert(strcmp(cmd->argv[1], pid) == 0);
+  assert(strcmp(cmd->argv[2], "3") == 0);
+  assert(strcmp(cmd->argv[3], wrapped) == 0);
+
+  last_exit_status = 0;
+  arena_reset(&arena);
+  printf("test_special_parameters passed.\n");
+}
+
+void test_unset_and_lone_dollar() {
+  char line[] = "echo $UNSET_VARIABLE_X a$ $ $1 ${NAME";
+  Command *cmd = expand_line(line);
+
+  assert(strcmp(cmd->argv[1], "") == 0);
+  assert(strcmp(cmd->argv[2], "a$") == 0);
+  assert(strcmp(cmd->argv[3], "$") == 0);
+  assert(strcmp(cmd->argv[4], "$1") == 0);
+  assert(strcmp(cmd->argv[5], "${NAME") == 0);
+
+  arena_reset(&arena);
+  printf("test_unset_and_lone_dollar passed.\n");
+}
+
+void test_redirections() {
+  char line[] = "cat < $NAME.in > \"${NAME}.out\"";
+  Command *cmd = expand_line(line);
+
+  assert(strcmp(cmd->infile, "yega.in") == 0);
+  assert(strcmp(cmd->outfile, "yega.out") == 0);
+
+  arena_reset(&arena);
+  printf("test_redirections passed.\n");
+}
+
+int main(void) {
+  // bad substitutions are expected
+  freopen("/dev/null", "w", stderr);
+  arena_init(&arena, 0);
+  add_variable("NAME", "yega", 0);
+
+  test_simple_variable();
+  test_several_per_word();
+  test_quotes();
+  test_special_parameters();
+  test_unset_and_lone_dollar();
+  test_redirections();
+
+  free_variable_table();
+  arena_free(&arena);
+  printf("All tests passed!\n");
+  return 0;
+}
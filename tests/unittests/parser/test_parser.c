@@ -3,7 +3,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "parser.h"
+#include "tokenizer.h"
+
+static Arena arena;
+
+int parse_line(char *line, Command **cmd) {
+  TokenVector tokens = {0};
+  int status = tokenize_line(line, &tokens);
+  if (status == 0)
+    status = parse(line, tokens.items, cmd, tokens.count, &arena);
+  free_memory(&tokens);
+  return status;
+}
 
 int compare_string_arrays(char *a[], char *b[]) {
   int i = 0;
@@ -16,11 +29,10 @@ int compare_string_arrays(char *a[], char *b[]) {
 }
 
 void test_only_command() {
-  char *tokens[] = {"pwd"};
-  size_t num_tokens = sizeof(tokens) / sizeof(tokens[0]);
+  char line[] = "pwd";
   Command *cmd = NULL;
 
-  int status = parse(tokens, &cmd, num_tokens);
+  int status = parse_line(line, &cmd);
 
   assert(status == 0);
   assert(strcmp(cmd->argv[0], "pwd") == 0);
@@ -29,16 +41,15 @@ void test_only_command() {
   assert(cmd->background == 0);
   assert(cmd->append_output == 0);
 
-  free_struct_memory(cmd);
+  arena_reset(&arena);
   printf("test_only_command passed.\n");
 }
 
 void test_argv_command() {
-  char *tokens[] = {"ls", "-l", "/home/user"};
-  size_t num_tokens = sizeof(tokens) / sizeof(tokens[0]);
+  char line[] = "ls -l /home/user";
   Command *cmd = NULL;
 
-  int status = parse(tokens, &cmd, num_tokens);
+  int status = parse_line(line, &cmd);
 
   assert(status == 0);
   char *expected[] = {"ls", "-l", "/home/user", NULL};
@@ -48,16 +59,15 @@ void test_argv_command() {
   assert(cmd->background == 0);
   assert(cmd->append_output == 0);
 
-  free_struct_memory(cmd);
+  arena_reset(&arena);
   printf("test_argv_command passed.\n");
 }
 
 void test_redirection_command() {
-  char *tokens[] = {"grep", "foo", ">", "out.txt", "<", "in.txt"};
-  size_t num_tokens = sizeof(tokens) / sizeof(tokens[0]);
+  char line[] = "grep foo > out.txt < in.txt";
   Command *cmd = NULL;
 
-  int status = parse(tokens, &cmd, num_tokens);
+  int status = parse_line(line, &cmd);
 
   assert(status == 0);
   char *expected[] = {"grep", "foo", NULL};
@@ -67,16 +77,15 @@ void test_redirection_command() {
   assert(cmd->background == 0);
   assert(cmd->append_output == 0);
 
-  free_struct_memory(cmd);
+  arena_reset(&arena);
   printf("test_redirection_command passed.\n");
 }
 
 void test_background_command() {
-  char *tokens[] = {"sleep", "5", "&"};
-  size_t num_tokens = sizeof(tokens) / sizeof(tokens[0]);
+  char line[] = "sleep 5 &";
   Command *cmd = NULL;
 
-  int status = parse(tokens, &cmd, num_tokens);
+  int status = parse_line(line, &cmd);
 
   assert(status == 0);
   char *expected[] = {"sleep", "5", NULL};
@@ -86,15 +95,124 @@ void test_background_command() {
   assert(cmd->background == 1);
   assert(cmd->append_output == 0);
 
-  free_struct_memory(cmd);
+  arena_reset(&arena);
   printf("test_background_command passed.\n");
 }
 
+void test_copy_outlives_arena() {
+  char line[] = "cat < in.txt >> out.txt";
+  Command *cmd = NULL;
+
+  int status = parse_line(line, &cmd);
+  assert(status == 0);
+
+  Command *copy = copy_command(cmd);
+  arena_reset(&arena);
+  // overwrite what the arena handed out for the original
+  memset(arena_alloc(&arena, 256), 'x', 256);
+  arena_reset(&arena);
+
+  char *expected[] = {"cat", NULL};
+  assert(compare_string_arrays(copy->argv, expected) == 0);
+  assert(strcmp(copy->infile, "in.txt") == 0);
+  assert(strcmp(copy->outfile, "out.txt") == 0);
+  assert(copy->append_output == 1);
+
+  free_struct_memory(copy);
+  printf("test_copy_outlives_arena passed.\n");
+}
+
+void test_many_arguments() {
+  char line[] = "echo 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20";
+  Command *cmd = NULL;
+
+  int status = parse_line(line, &cmd);
+
+  assert(status == 0);
+  char *expected[] = {"echo", "1",  "2",  "3",  "4",  "5",  "6",
+                      "7",    "8",  "9",  "10", "11", "12", "13",
+                      "14",   "15", "16", "17", "18", "19", "20", NULL};
+  assert(compare_string_arrays(cmd->argv, expected) == 0);
+
+  arena_reset(&arena);
+  printf("test_many_arguments passed.\n");
+}
+
+void test_pipeline_stages() {
+  char line[] = "cat < in.txt | grep foo | sort -r >> out.txt &";
+  TokenVector tokens = {0};
+  Command *cmd = NULL;
+  size_t i = 0;
+
+  assert(tokenize_line(line, &tokens) == 0);
+
+  assert(parse_stage(line, tokens.items, tokens.count, &i, &cmd, &arena) == 0);
+  char *first[] = {"cat", NULL};
+  assert(compare_string_arrays(cmd->argv, first) == 0);
+  assert(strcmp(cmd->infile, "in.txt") == 0);
+  assert(cmd->background == 0);
+
+  assert(parse_stage(line, tokens.items, tokens.count, &i, &cmd, &arena) == 0);
+  char *second[] = {"grep", "foo", NULL};
+  assert(compare_string_arrays(cmd->argv, second) == 0);
+
+  assert(parse_stage(line, tokens.items, tokens.count, &i, &cmd, &arena) == 0);
+  char *third[] = {"sort", "-r", NULL};
+  assert(compare_string_arrays(cmd->argv, third) == 0);
+  assert(strcmp(cmd->outfile, "out.txt") == 0);
+  assert(cmd->append_output == 1);
+  assert(cmd->background == 1);
+  assert(i == tokens.count);
+
+  free_memory(&tokens);
+  arena_reset(&arena);
+  printf("test_pipeline_stages passed.\n");
+}
+
+int parse_pipeline(char *line) {
+  TokenVector tokens = {0};
+  Command *cmd = NULL;
+  size_t i = 0;
+  int status = tokenize_line(line, &tokens);
+
+  while (status == 0 && i < tokens.count)
+    status = parse_stage(line, tokens.items, tokens.count, &i, &cmd, &arena);
+  free_memory(&tokens);
+  arena_reset(&arena);
+  return status;
+}
+
+void test_pipeline_errors() {
+  char empty_stage[] = "ls | | wc";
+  char leading_pipe[] = "| wc";
+  char trailing_pipe[] = "ls |";
+  char background_in_middle[] = "sleep 1 & | wc";
+  char missing_target[] = "ls > | wc";
+  char valid[] = "ls | wc -l > out.txt";
+
+  assert(parse_pipeline(empty_stage) == -1);
+  assert(parse_pipeline(leading_pipe) == -1);
+  assert(parse_pipeline(trailing_pipe) == -1);
+  assert(parse_pipeline(background_in_middle) == -1);
+  assert(parse_pipeline(missing_target) == -1);
+  assert(parse_pipeline(valid) == 0);
+
+  printf("test_pipeline_errors passed.\n");
+}
+
 int main(void) {
+  // syntax errors are expected
+  freopen("/dev/null", "w", stderr);
+  arena_init(&arena, 0);
   test_only_command();
   test_argv_command();
   test_redirection_command();
   test_background_command();
+  test_copy_outlives_arena();
+  test_many_arguments();
+  test_pipeline_stages();
+  test_pipeline_errors();
+  arena_free(&arena);
 
   printf("All tests passed!\n");
   return 0;
@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "pipeline_cache.h"
+#include "process_utils.h"
+#include "tokenizer.h"
+
+static Arena arena;
+
+Process *build(const char *text, char *line) {
+  TokenVector tokens = {0};
+  Command *cmd = NULL;
+  Process *proc = NULL;
+
+  strcpy(line, text);
+  assert(tokenize_line(line, &tokens) == 0);
+  Process *head = initalize_processes(line, tokens.items, tokens.count, &cmd,
+                                      &proc, &arena);
+  free_memory(&tokens);
+  return head;
+}
+
+int store_line(PipelineCache *cache, const char *text) {
+  char line[256];
+  Process *head = build(text, line);
+  assert(head != NULL);
+  return pipeline_cache_store(cache, text, strlen(text), head);
+}
+
+const PipelineTemplate *find_line(PipelineCache *cache, const char *text) {
+  return pipeline_cache_lookup(cache, text, strlen(text));
+}
+
+void test_hit_rebuilds_pipeline() {
+  const char *text = "cat < in.txt | grep \"a b\" | sort -r >> out.txt &";
+  PipelineCache cache;
+  pipeline_cache_init(&cache, 0);
+
+  assert(find_line(&cache, text) == NULL);
+  assert(store_line(&cache, text) == 0);
+  arena_reset(&arena);
+
+  const PipelineTemplate *tpl = find_line(&cache, text);
+  assert(tpl != NULL);
+  assert(cache.hits == 1 && cache.misses == 1);
+
+  Command *cmd = NULL;
+  Process *proc = NULL;
+  Process *head = pipeline_instantiate(tpl, &cmd, &proc, &arena);
+  assert(head != NULL && head == proc);
+
+  Command *c = head->cmd;
+  assert(strcmp(c->argv[0], "cat") == 0 && c->argv[1] == NULL);
+  assert(strcmp(c->infile, "in.txt") == 0 && c->outfile == NULL);
+
+  c = head->next->cmd;
+  assert(strcmp(c->argv[0], "grep") == 0);
+  assert(strcmp(c->argv[1], "a b") == 0 && c->argv[2] == NULL);
+
+  c = head->next->next->cmd;
+  assert(c == cmd);
+  assert(strcmp(c->argv[0], "sort") == 0 && strcmp(c->argv[1], "-r") == 0);
+  assert(strcmp(c->outfile, "out.txt") == 0);
+  assert(c->append_output == 1 && c->background == 1);
+  assert(head->next->next->next == NULL);
+
+  // the clone owns its strings
+  c->argv[0][0] = 'X';
+  arena_reset(&arena);
+  head = pipeline_instantiate(tpl, &cmd, &proc, &arena);
+  assert(strcmp(cmd->argv[0], "sort") == 0);
+
+  arena_reset(&arena);
+  pipeline_cache_clear(&cache);
+  printf("test_hit_rebuilds_pipeline passed.\n");
+}
+
+void test_variables_are_not_expanded() {
+  const char *text = "echo $HOME";
+  PipelineCache cache;
+  pipeline_cache_init(&cache, 0);
+
+  assert(store_line(&cache, text) == 0);
+  arena_reset(&arena);
+
+  Command *cmd = NULL;
+  Process *proc = NULL;
+  pipeline_instantiate(find_line(&cache, text), &cmd, &proc, &arena);
+  assert(strcmp(cmd->argv[1], "\001HOME") == 0);
+
+  arena_reset(&arena);
+  pipeline_cache_clear(&cache);
+  printf("test_variables_are_not_expanded passed.\n");
+}
+
+void test_lru_eviction() {
+  PipelineCache cache;
+  pipeline_cache_init(&cache, 2);
+
+  assert(store_line(&cache, "ls") == 0);
+  assert(store_line(&cache, "pwd") == 0);
+  assert(find_line(&cache, "ls") != NULL);
+  // pwd is now the least recently used entry
+  assert(store_line(&cache, "date") == 0);
+  arena_reset(&arena);
+
+  assert(cache.count == 2);
+  assert(find_line(&cache, "pwd") == NULL);
+  assert(find_line(&cache, "ls") != NULL);
+  assert(find_line(&cache, "date") != NULL);
+  assert(find_line(&cache, "ls ") == NULL);
+
+  pipeline_cache_clear(&cache);
+  assert(cache.count == 0);
+  assert(find_line(&cache, "ls") == NULL);
+  printf("test_lru_eviction passed.\n");
+}
+
+int main(void) {
+  arena_init(&arena, 0);
+
+  test_hit_rebuilds_pipeline();
+  test_variables_are_not_expanded();
+  test_lru_eviction();
+
+  arena_free(&arena);
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "executor.h"
+#include "process_utils.h"
+#include "run_line.h"
+#include "tokenizer.h"
+
+Process *parse_command_line(const char *text, char *line, Command **cmd,
+                           Arena *arena) {
+  TokenVector tokens = {0};
+  Process *proc = NULL;
+
+  strcpy(line, text);
+  assert(tokenize_line(line, &tokens) == 0);
+  Process *head =
+      initalize_processes(line, tokens.items, tokens.count, cmd, &proc, arena);
+  free_memory(&tokens);
+  assert(head != NULL);
+  assert(take_resource_prefixes(head, arena) == 0);
+  return head;
+}
+
+Job *start_line(const char *text, char *line, Job **jobs, Arena *arena) {
+  Command *cmd = NULL;
+  Process *head = parse_command_line(text, line, &cmd, arena);
+
+  Job *job = initialize_job_control(line, cmd, head, jobs, arena);
+  assert(job != NULL && executor(job, jobs) == 0);
+  return job;
+}
+
+int run_line(const char *text, Job **jobs, Arena *arena) {
+  char line[512];
+
+  start_line(text, line, jobs, arena);
+  assert(*jobs == NULL);
+  arena_reset(arena);
+  return last_exit_status;
+}
+
+const char *read_output(const char *path) {
+  static char buf[256];
+  int fd = open(path, O_RDONLY);
+  assert(fd >= 0);
+  ssize_t n = read(fd, buf, sizeof buf - 1);
+  assert(n >= 0);
+  buf[n] = '\0';
+  close(fd);
+  return buf;
+}
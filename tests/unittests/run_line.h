@@ -0,0 +1,23 @@
+#ifndef RUN_LINE_H
+#define RUN_LINE_H
+
+/* Test fixture that runs command lines through the shell's phases. */
+
+#include "arena.h"
+#include "job_control.h"
+
+/* Tokenizes and parses a line copied into line, taking its resource
+ * prefixes, and returns its first process. */
+Process *parse_command_line(const char *text, char *line, Command **cmd,
+                           Arena *arena);
+
+/* Starts a line as a job, the way the shell does; line holds its words. */
+Job *start_line(const char *text, char *line, Job **jobs, Arena *arena);
+
+/* Runs a line as a foreground job and returns $?. */
+int run_line(const char *text, Job **jobs, Arena *arena);
+
+/* Returns the contents of the file at path. */
+const char *read_output(const char *path);
+
+#endif
@@ -0,0 +1,118 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "token_scan.h"
+#include "tokenizer.h"
+
+#define FUZZ_ROUNDS 2000
+#define FUZZ_MAXLEN 300
+
+static const char alphabet[] = "abcxyz0129-_./=$ \t\n'\"\\><&|";
+
+void fill_random(char *buf, size_t len, int sparse) {
+  for (size_t i = 0; i < len; i++) {
+    // sparse inputs have long runs of plain characters
+    if (sparse && rand() % 40 != 0)
+      buf[i] = 'a' + rand() % 26;
+    else
+      buf[i] = alphabet[rand() % (sizeof alphabet - 1)];
+  }
+  buf[len] = '\0';
+}
+
+void test_kernels_match_scalar() {
+  ScanKernel kernels[] = {SCAN_SSE2, SCAN_AVX2};
+  char buf[FUZZ_MAXLEN + 1];
+
+  for (int round = 0; round < FUZZ_ROUNDS; round++) {
+    size_t len = rand() % FUZZ_MAXLEN;
+    fill_random(buf, len, round % 2);
+
+    for (size_t start = 0; start <= len; start++) {
+      size_t expected = scan_delimiter_scalar(buf + start, len - start);
+      for (size_t k = 0; k < 2; k++) {
+        if (!token_scan_supported(kernels[k]))
+          continue;
+        size_t got = kernels[k] == SCAN_SSE2
+                         ? scan_delimiter_sse2(buf + start, len - start)
+                         : scan_delimiter_avx2(buf + start, len - start);
+        assert(got == expected);
+      }
+    }
+  }
+  printf("test_kernels_match_scalar passed.\n");
+}
+
+void test_every_delimiter() {
+  char buf[64];
+
+  for (int c = 0; c < 256; c++) {
+    memset(buf, 'a', sizeof buf);
+    buf[37] = (char)c;
+    size_t expected = is_scan_delimiter((unsigned char)c) ? 37 : sizeof buf;
+
+    assert(scan_delimiter_scalar(buf, sizeof buf) == expected);
+    if (token_scan_supported(SCAN_SSE2))
+      assert(scan_delimiter_sse2(buf, sizeof buf) == expected);
+    if (token_scan_supported(SCAN_AVX2))
+      assert(scan_delimiter_avx2(buf, sizeof buf) == expected);
+  }
+  printf("test_every_delimiter passed.\n");
+}
+
+int tokenize_with(ScanKernel kernel, char *line, TokenVector *tokens) {
+  assert(token_scan_select(kernel) == 0);
+  return tokenize_line(line, tokens);
+}
+
+void test_tokenizer_output_matches() {
+  ScanKernel kernels[] = {SCAN_SSE2, SCAN_AVX2};
+  char input[FUZZ_MAXLEN + 1], scalar_line[FUZZ_MAXLEN + 1],
+      simd_line[FUZZ_MAXLEN + 1];
+  TokenVector scalar_tokens = {0}, simd_tokens = {0};
+
+  for (int round = 0; round < FUZZ_ROUNDS; round++) {
+    fill_random(input, rand() % FUZZ_MAXLEN, round % 2);
+
+    for (size_t k = 0; k < 2; k++) {
+      if (!token_scan_supported(kernels[k]))
+        continue;
+
+      strcpy(scalar_line, input);
+      strcpy(simd_line, input);
+      int scalar_status = tokenize_with(SCAN_SCALAR, scalar_line, &scalar_tokens);
+      int simd_status = tokenize_with(kernels[k], simd_line, &simd_tokens);
+
+      assert(scalar_status == simd_status);
+      if (scalar_status < 0)
+        continue;
+      assert(scalar_tokens.count == simd_tokens.count);
+      for (size_t i = 0; i < scalar_tokens.count; i++) {
+        Token *a = &scalar_tokens.items[i], *b = &simd_tokens.items[i];
+        assert(a->kind == b->kind);
+        assert(a->offset == b->offset && a->length == b->length);
+        assert(strcmp(token_text(scalar_line, a), token_text(simd_line, b)) ==
+               0);
+      }
+    }
+  }
+
+  free_memory(&scalar_tokens);
+  free_memory(&simd_tokens);
+  printf("test_tokenizer_output_matches passed.\n");
+}
+
+int main(void) {
+  // unmatched quotes are expected in fuzzed input
+  freopen("/dev/null", "w", stderr);
+  srand(1234);
+
+  test_kernels_match_scalar();
+  test_every_delimiter();
+  test_tokenizer_output_matches();
+
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -1,112 +1,249 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "tokenizer.h"
 
+#define TEXT(i) token_text(line, &tokens.items[i])
+
 void test_simple_command() {
-  char *tokens[MAXTOKENS];
-  int token_num = 0;
+  TokenVector tokens = {0};
   char line[] = "ls -l /home/user";
 
-  int status = tokenize_line(line, tokens, MAXTOKENS, MAXLEN, &token_num);
+  int status = tokenize_line(line, &tokens);
 
   assert(status == 0);
-  assert(token_num == 3);
-  assert(strcmp(tokens[0], "ls") == 0);
-  assert(strcmp(tokens[1], "-l") == 0);
-  assert(strcmp(tokens[2], "/home/user") == 0);
+  assert(tokens.count == 3);
+  assert(strcmp(TEXT(0), "ls") == 0);
+  assert(strcmp(TEXT(1), "-l") == 0);
+  assert(strcmp(TEXT(2), "/home/user") == 0);
 
-  free_memory(tokens, token_num);
+  free_memory(&tokens);
   printf("test_simple_command passed.\n");
 }
 
 void test_double_quotes() {
-  char *tokens[MAXTOKENS];
-  int token_num = 0;
+  TokenVector tokens = {0};
   char line[] = "echo \"hello world to you\"";
 
-  int status = tokenize_line(line, tokens, MAXTOKENS, MAXLEN, &token_num);
+  int status = tokenize_line(line, &tokens);
 
   assert(status == 0);
-  assert(token_num == 2);
-  assert(strcmp(tokens[0], "echo") == 0);
-  assert(strcmp(tokens[1], "hello world to you") == 0);
+  assert(tokens.count == 2);
+  assert(strcmp(TEXT(0), "echo") == 0);
+  assert(strcmp(TEXT(1), "hello world to you") == 0);
 
-  free_memory(tokens, token_num);
+  free_memory(&tokens);
   printf("test_double_quotes passed.\n");
 }
 
 void test_single_quotes() {
-  char *tokens[MAXTOKENS];
-  int token_num = 0;
+  TokenVector tokens = {0};
   char line[] = "echo 'h$llo' to you";
 
-  int status = tokenize_line(line, tokens, MAXTOKENS, MAXLEN, &token_num);
+  int status = tokenize_line(line, &tokens);
 
   assert(status == 0);
-  assert(token_num == 4);
-  assert(strcmp(tokens[0], "echo") == 0);
-  assert(strcmp(tokens[1], "h$llo") == 0);
-  assert(strcmp(tokens[2], "to") == 0);
-  assert(strcmp(tokens[3], "you") == 0);
+  assert(tokens.count == 4);
+  assert(strcmp(TEXT(0), "echo") == 0);
+  assert(strcmp(TEXT(1), "h$llo") == 0);
+  assert(strcmp(TEXT(2), "to") == 0);
+  assert(strcmp(TEXT(3), "you") == 0);
 
-  free_memory(tokens, token_num);
+  free_memory(&tokens);
   printf("test_single_quotes passed.\n");
 }
 
 void test_special_characters() {
-  char *tokens[MAXTOKENS];
-  int token_num = 0;
+  TokenVector tokens = {0};
   char line[] = "cat file.txt> output.txt";
 
-  int status = tokenize_line(line, tokens, MAXTOKENS, MAXLEN, &token_num);
+  int status = tokenize_line(line, &tokens);
 
   assert(status == 0);
-  assert(token_num == 4);
-  assert(strcmp(tokens[0], "cat") == 0);
-  assert(strcmp(tokens[1], "file.txt") == 0);
-  assert(strcmp(tokens[2], ">") == 0);
-  assert(strcmp(tokens[3], "output.txt") == 0);
+  assert(tokens.count == 4);
+  assert(strcmp(TEXT(0), "cat") == 0);
+  assert(strcmp(TEXT(1), "file.txt") == 0);
+  assert(strcmp(TEXT(2), ">") == 0);
+  assert(strcmp(TEXT(3), "output.txt") == 0);
 
-  free_memory(tokens, token_num);
+  free_memory(&tokens);
   printf("test_special_characters passed.\n");
 }
 
 void test_double_operator() {
-  char *tokens[MAXTOKENS];
-  int token_num = 0;
+  TokenVector tokens = {0};
   char line[] = "cmd >> logfile";
 
-  int status = tokenize_line(line, tokens, MAXTOKENS, MAXLEN, &token_num);
+  int status = tokenize_line(line, &tokens);
 
   assert(status == 0);
-  assert(token_num == 3);
-  assert(strcmp(tokens[0], "cmd") == 0);
-  assert(strcmp(tokens[1], ">>") == 0);
-  assert(strcmp(tokens[2], "logfile") == 0);
+  assert(tokens.count == 3);
+  assert(strcmp(TEXT(0), "cmd") == 0);
+  assert(strcmp(TEXT(1), ">>") == 0);
+  assert(strcmp(TEXT(2), "logfile") == 0);
 
-  free_memory(tokens, token_num);
+  free_memory(&tokens);
   printf("test_double_operator passed.\n");
 }
 
 void test_unclosed_quote() {
-  char *tokens[MAXTOKENS];
-  int token_num = 0;
+  TokenVector tokens = {0};
   char line[] = "echo \"missing end";
 
-  int status = tokenize_line(line, tokens, MAXTOKENS, MAXLEN, &token_num);
+  int status = tokenize_line(line, &tokens);
 
   assert(status == -1);
+  free_memory(&tokens);
   printf("test_unclosed_quote passed.\n");
 }
 
+void test_long_token() {
+  TokenVector tokens = {0};
+  char line[4096];
+  char expected[2048];
+
+  memset(expected, 'a', sizeof expected - 1);
+  expected[sizeof expected - 1] = '\0';
+  snprintf(line, sizeof line, "ls %s", expected);
+
+  int status = tokenize_line(line, &tokens);
+
+  assert(status == 0);
+  assert(tokens.count == 2);
+  assert(strcmp(TEXT(1), expected) == 0);
+
+  free_memory(&tokens);
+  printf("test_long_token passed.\n");
+}
+
+void test_many_tokens() {
+  TokenVector tokens = {0};
+  size_t num_args = 5000;
+  char *line = malloc(num_args * 2 + 1);
+
+  for (size_t i = 0; i < num_args; i++) {
+    line[2 * i] = 'x';
+    line[2 * i + 1] = ' ';
+  }
+  line[num_args * 2] = '\0';
+
+  int status = tokenize_line(line, &tokens);
+
+  assert(status == 0);
+  assert(tokens.count == num_args);
+  assert(strcmp(TEXT(num_args - 1), "x") == 0);
+
+  free_memory(&tokens);
+  free(line);
+  printf("test_many_tokens passed.\n");
+}
+
+void test_quotes_inside_word() {
+  TokenVector tokens = {0};
+  char line[] = "echo a\"b c\"'d'\\ e>out";
+
+  int status = tokenize_line(line, &tokens);
+
+  assert(status == 0);
+  assert(tokens.count == 4);
+  assert(strcmp(TEXT(1), "ab cd e") == 0);
+  assert(tokens.items[2].kind == TOKEN_REDIR_OUT);
+  assert(strcmp(TEXT(2), ">") == 0);
+  assert(strcmp(TEXT(3), "out") == 0);
+
+  free_memory(&tokens);
+  printf("test_quotes_inside_word passed.\n");
+}
+
+int feed(Lexer *lexer, char *buf, const char *text, TokenVector *tokens) {
+  strcat(buf, text);
+  return lexer_feed(lexer, buf, strlen(buf), tokens);
+}
+
+void test_continuation_lines() {
+  TokenVector tokens = {0};
+  Lexer lexer;
+  char line[256] = "";
+
+  lexer_reset(&lexer, &tokens);
+  assert(feed(&lexer, line, "echo \"open\n", &tokens) == LEX_INCOMPLETE);
+  assert(lexer.state == LEX_DOUBLE_QUOTE);
+  assert(tokens.count == 1);
+  assert(feed(&lexer, line, "quote\" ab\\\n", &tokens) == LEX_INCOMPLETE);
+  assert(feed(&lexer, line, "cd |\n", &tokens) == LEX_INCOMPLETE);
+  assert(feed(&lexer, line, "wc -l\n", &tokens) == LEX_COMPLETE);
+
+  assert(tokens.count == 6);
+  assert(strcmp(TEXT(0), "echo") == 0);
+  assert(strcmp(TEXT(1), "open\nquote") == 0);
+  assert(strcmp(TEXT(2), "abcd") == 0);
+  assert(tokens.items[3].kind == TOKEN_PIPE);
+  assert(strcmp(TEXT(4), "wc") == 0);
+  assert(strcmp(TEXT(5), "-l") == 0);
+
+  // only a pipe continues; the parser rejects `||` and `&&`
+  line[0] = '\0';
+  lexer_reset(&lexer, &tokens);
+  assert(feed(&lexer, line, "true ||\n", &tokens) == LEX_COMPLETE);
+  line[0] = '\0';
+  lexer_reset(&lexer, &tokens);
+  assert(feed(&lexer, line, "true &&\n", &tokens) == LEX_COMPLETE);
+
+  free_memory(&tokens);
+  printf("test_continuation_lines passed.\n");
+}
+
+void test_finish_incomplete() {
+  TokenVector tokens = {0};
+  Lexer lexer;
+  char line[64] = "";
+
+  lexer_reset(&lexer, &tokens);
+  assert(feed(&lexer, line, "ls \\\n", &tokens) == LEX_INCOMPLETE);
+  assert(lexer_finish(&lexer, line, &tokens) == 0);
+  assert(tokens.count == 1);
+  assert(strcmp(TEXT(0), "ls") == 0);
+
+  line[0] = '\0';
+  lexer_reset(&lexer, &tokens);
+  assert(feed(&lexer, line, "echo 'x\n", &tokens) == LEX_INCOMPLETE);
+  assert(lexer_finish(&lexer, line, &tokens) == -1);
+
+  free_memory(&tokens);
+  printf("test_finish_incomplete passed.\n");
+}
+
+void test_expansion_marks() {
+  TokenVector tokens = {0};
+  char line[] = "echo $A \"x$B\" '$C' \\$D";
+
+  int status = tokenize_line(line, &tokens);
+
+  assert(status == 0);
+  assert(tokens.count == 5);
+  assert(strcmp(TEXT(1), "\001A") == 0);
+  assert(strcmp(TEXT(2), "x\001B") == 0);
+  assert(strcmp(TEXT(3), "$C") == 0);
+  assert(strcmp(TEXT(4), "$D") == 0);
+
+  free_memory(&tokens);
+  printf("test_expansion_marks passed.\n");
+}
+
 int main(void) {
   test_simple_command();
   test_double_quotes();
   test_single_quotes();
   test_special_characters();
   test_double_operator();
+  test_long_token();
+  test_many_tokens();
+  test_quotes_inside_word();
+  test_continuation_lines();
+  test_finish_incomplete();
+  test_expansion_marks();
 
   printf("All tests passed!\n");
   return 0;
@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+
+void test_alignment() {
+  Arena arena;
+  arena_init(&arena, 0);
+
+  for (size_t size = 1; size < 100; size++) {
+    void *p = arena_alloc(&arena, size);
+    assert(p != NULL);
+    assert((uintptr_t)p % 16 == 0);
+    memset(p, 0xff, size);
+  }
+
+  arena_free(&arena);
+  printf("test_alignment passed.\n");
+}
+
+void test_calloc_and_strings() {
+  Arena arena;
+  arena_init(&arena, 0);
+
+  int *zeros = arena_calloc(&arena, 10, sizeof *zeros);
+  for (int i = 0; i < 10; i++)
+    assert(zeros[i] == 0);
+
+  char *copy = arena_strdup(&arena, "hello world");
+  assert(strcmp(copy, "hello world") == 0);
+  char *prefix = arena_strndup(&arena, "hello world", 5);
+  assert(strcmp(prefix, "hello") == 0);
+
+  arena_free(&arena);
+  printf("test_calloc_and_strings passed.\n");
+}
+
+void test_large_allocation() {
+  Arena arena;
+  arena_init(&arena, 64);
+
+  char *big = arena_alloc(&arena, 1000);
+  assert(big != NULL);
+  memset(big, 'a', 1000);
+  char *small = arena_alloc(&arena, 8);
+  assert(small != NULL);
+
+  arena_free(&arena);
+  printf("test_large_allocation passed.\n");
+}
+
+void test_reset_stops_mallocs() {
+  Arena arena;
+  arena_init(&arena, 128);
+
+  // the first cycle outgrows the first block several times
+  for (int i = 0; i < 40; i++)
+    arena_alloc(&arena, 32);
+  arena_reset(&arena);
+  assert(arena.last.allocations == 40);
+  assert(arena.last.mallocs > 1);
+
+  for (int cycle = 0; cycle < 10; cycle++) {
+    for (int i = 0; i < 40; i++)
+      arena_alloc(&arena, 32);
+    arena_reset(&arena);
+    assert(arena.last.mallocs == 0);
+    assert(arena.last.allocations == 40);
+    assert(arena.last.bytes == 40 * 32);
+  }
+  assert(arena.total.allocations == 11 * 40);
+
+  arena_free(&arena);
+  printf("test_reset_stops_mallocs passed.\n");
+}
+
+int main(void) {
+  test_alignment();
+  test_calloc_and_strings();
+  test_large_allocation();
+  test_reset_stops_mallocs();
+
+  printf("All tests passed!\n");
+  return 0;
+}